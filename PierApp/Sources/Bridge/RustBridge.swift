@@ -38,13 +38,13 @@ enum PierBridge {
         }
     }
 
-    /// Read output from a terminal session.
-    static func readFromTerminal(_ handle: OpaquePointer) -> Data? {
-        var buffer = [UInt8](repeating: 0, count: 65536)
-        let bytesRead = pier_terminal_read(handle, &buffer, UInt(buffer.count))
-
-        guard bytesRead > 0 else { return nil }
-        return Data(buffer[0..<Int(bytesRead)])
+    /// Read output from a terminal session into a caller-owned buffer.
+    /// The core `read(2)`s straight into `buffer`; returns the byte count (0 when idle).
+    static func readFromTerminal(_ handle: OpaquePointer, into buffer: inout [UInt8]) -> Int {
+        let bytesRead = buffer.withUnsafeMutableBufferPointer { ptr in
+            pier_terminal_read(handle, ptr.baseAddress, UInt(ptr.count))
+        }
+        return max(0, Int(bytesRead))
     }
 
     /// Resize a terminal session.
@@ -57,23 +57,54 @@ enum PierBridge {
         return pier_terminal_fd(handle)
     }
 
+    /// Receiver for reactor-delivered PTY output. Keep it alive until
+    /// `unwatchTerminal` (or destroy) has been called for the handle.
+    final class TerminalOutputWatch {
+        /// Called on the main queue with each coalesced chunk, or nil once the PTY closed.
+        let onOutput: ([UInt8]?) -> Void
+
+        init(onOutput: @escaping ([UInt8]?) -> Void) {
+            self.onOutput = onOutput
+        }
+    }
+
+    /// Have the core reactor push terminal output (at most once per frame)
+    /// instead of polling `readFromTerminal`.
+    static func watchTerminal(_ handle: OpaquePointer, onOutput: @escaping ([UInt8]?) -> Void) -> TerminalOutputWatch? {
+        let watch = TerminalOutputWatch(onOutput: onOutput)
+        let context = Unmanaged.passUnretained(watch).toOpaque()
+        let result = pier_terminal_watch(handle, { userData, data, len in
+            guard let userData else { return }
+            let watch = Unmanaged<TerminalOutputWatch>.fromOpaque(userData).takeUnretainedValue()
+            let bytes = data.map { Array(UnsafeBufferPointer(start: $0, count: Int(len))) }
+            DispatchQueue.main.async { watch.onOutput(bytes) }
+        }, context)
+        return result == 0 ? watch : nil
+    }
+
+    /// Stop reactor delivery for a terminal session.
+    static func unwatchTerminal(_ handle: OpaquePointer) {
+        _ = pier_terminal_unwatch(handle)
+    }
+
+    /// Record what the terminal displays (not what's typed) to `path`.
+    static func startRecording(_ handle: OpaquePointer, to path: String) -> Bool {
+        return path.withCString { pier_terminal_record_start(handle, $0) } == 0
+    }
+
+    /// Finish the current recording. Blocks until the file is complete.
+    static func stopRecording(_ handle: OpaquePointer) -> Bool {
+        return pier_terminal_record_stop(handle) == 0
+    }
+
     // MARK: - File Search
 
     /// Search files matching a pattern.
     static func searchFiles(root: String, pattern: String, maxResults: Int = 100) -> [[String: Any]] {
         return root.withCString { rootPtr in
             pattern.withCString { patternPtr in
-                guard let resultPtr = pier_search_files(rootPtr, patternPtr, UInt(maxResults)) else {
-                    return []
-                }
-                defer { pier_string_free(resultPtr) }
-
-                let jsonString = String(cString: resultPtr)
-                guard let data = jsonString.data(using: .utf8),
-                      let json = try? JSONSerialization.jsonObject(with: data) as? [[String: Any]] else {
-                    return []
-                }
-                return json
+                takeResult(pier_search_files_buffer(rootPtr, patternPtr, UInt(maxResults)),
+                           as: PierFileEntry.self, fileEntryDictionary) ?? []
             }
         }
     }
@@ -81,17 +112,412 @@ enum PierBridge {
     /// List directory contents.
     static func listDirectory(path: String) -> [[String: Any]] {
         return path.withCString { pathPtr in
-            guard let resultPtr = pier_list_directory(pathPtr) else {
-                return []
+            takeResult(pier_list_directory_buffer(pathPtr), as: PierFileEntry.self, fileEntryDictionary) ?? []
+        }
+    }
+
+    /// A streaming filename or content search. Hits arrive on the main queue
+    /// while the walk runs; the search stops when this object is released.
+    final class FileSearch {
+        /// Called on the main queue with each batch of hits, and once with
+        /// `done == true` when the walk has finished.
+        let onHits: (_ hits: [[String: Any]], _ done: Bool) -> Void
+        fileprivate var handle: OpaquePointer?
+        fileprivate let stopHandle: (OpaquePointer) -> Void
+
+        fileprivate init(onHits: @escaping ([[String: Any]], Bool) -> Void,
+                         stopHandle: @escaping (OpaquePointer) -> Void) {
+            self.onHits = onHits
+            self.stopHandle = stopHandle
+        }
+
+        /// Stop the walk; no more hits are delivered after this returns.
+        func stop() {
+            if let handle {
+                stopHandle(handle)
+                self.handle = nil
             }
-            defer { pier_string_free(resultPtr) }
+        }
+
+        deinit {
+            stop()
+        }
+    }
 
-            let jsonString = String(cString: resultPtr)
-            guard let data = jsonString.data(using: .utf8),
-                  let json = try? JSONSerialization.jsonObject(with: data) as? [[String: Any]] else {
-                return []
+    /// Start a streaming search; keep the returned object alive for as long
+    /// as results are wanted.
+    static func startFileSearch(root: String, pattern: String, maxResults: Int = 500,
+                                onHits: @escaping ([[String: Any]], Bool) -> Void) -> FileSearch? {
+        let search = FileSearch(onHits: onHits, stopHandle: { pier_search_files_stop($0) })
+        let context = Unmanaged.passUnretained(search).toOpaque()
+        let handle = root.withCString { rootPtr in
+            pattern.withCString { patternPtr in
+                pier_search_files_start(rootPtr, patternPtr, UInt(maxResults), { userData, hits, count, done in
+                    guard let userData else { return 1 }
+                    let search = Unmanaged<FileSearch>.fromOpaque(userData).takeUnretainedValue()
+                    let batch = UnsafeBufferPointer(start: hits, count: Int(count)).map { hit -> [String: Any] in
+                        ["path": hit.path.string, "name": hit.name.string, "is_dir": hit.is_dir]
+                    }
+                    DispatchQueue.main.async { [weak search] in search?.onHits(batch, done) }
+                    return 0
+                }, context)
+            }
+        }
+        guard let handle else { return nil }
+        search.handle = handle
+        return search
+    }
+
+    /// Start a streaming content search (literal text unless `regex`).
+    /// Hits carry `path`, `line`, `line_number`, `match_start` and
+    /// `match_end` (UTF-8 byte offsets into `line`). Returns nil for an
+    /// invalid regex.
+    static func startContentSearch(root: String, pattern: String, regex: Bool = false,
+                                   caseSensitive: Bool = false, maxResults: Int = 2000,
+                                   onHits: @escaping ([[String: Any]], Bool) -> Void) -> FileSearch? {
+        let search = FileSearch(onHits: onHits, stopHandle: { pier_search_content_stop($0) })
+        let context = Unmanaged.passUnretained(search).toOpaque()
+        let handle = root.withCString { rootPtr in
+            pattern.withCString { patternPtr in
+                pier_search_content_start(rootPtr, patternPtr, regex, caseSensitive, UInt(maxResults), { userData, matches, count, done in
+                    guard let userData else { return 1 }
+                    let search = Unmanaged<FileSearch>.fromOpaque(userData).takeUnretainedValue()
+                    let batch = UnsafeBufferPointer(start: matches, count: Int(count)).map { hit -> [String: Any] in
+                        ["path": hit.path.string, "line": hit.line.string, "line_number": hit.line_number,
+                         "match_start": Int(hit.match_start), "match_end": Int(hit.match_end)]
+                    }
+                    DispatchQueue.main.async { [weak search] in search?.onHits(batch, done) }
+                    return 0
+                }, context)
             }
-            return json
         }
+        guard let handle else { return nil }
+        search.handle = handle
+        return search
+    }
+
+    /// A background filename index for one root, kept current by a file
+    /// watcher and cached under Caches/Pier/FileIndex between launches.
+    final class FileIndex {
+        private let handle: PierFsIndexHandle
+
+        init?(root: String) {
+            let cacheDir = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first?
+                .appendingPathComponent("Pier/FileIndex").path
+            let handle: PierFsIndexHandle? = root.withCString { rootPtr in
+                guard let cacheDir else { return pier_fs_index_open(rootPtr, nil) }
+                return cacheDir.withCString { pier_fs_index_open(rootPtr, $0) }
+            }
+            guard let handle else { return nil }
+            self.handle = handle
+        }
+
+        /// False until the first crawl (or cache load) has finished.
+        var isReady: Bool {
+            pier_fs_index_is_ready(handle) == 1
+        }
+
+        /// Filename search answered from memory.
+        func search(pattern: String, maxResults: Int = 100) -> [[String: Any]] {
+            pattern.withCString { patternPtr in
+                PierBridge.takeResult(pier_fs_index_search(handle, patternPtr, UInt(maxResults)),
+                                      as: PierFileEntry.self, PierBridge.fileEntryDictionary) ?? []
+            }
+        }
+
+        /// Directory listing, cached until the watcher sees it change.
+        func listDirectory(path: String) -> [[String: Any]] {
+            path.withCString { pathPtr in
+                PierBridge.takeResult(pier_fs_index_list_directory(handle, pathPtr),
+                                      as: PierFileEntry.self, PierBridge.fileEntryDictionary) ?? []
+            }
+        }
+
+        deinit {
+            pier_fs_index_close(handle)
+        }
+    }
+
+    /// A sorted directory snapshot read in windows, for virtualized lists
+    /// of very large directories. Not thread-safe.
+    final class DirectoryListing {
+        private let handle: PierDirListingHandle
+        let count: Int
+
+        init?(path: String) {
+            guard let handle = path.withCString({ pier_dir_listing_open($0) }) else { return nil }
+            self.handle = handle
+            self.count = max(0, Int(pier_dir_listing_count(handle)))
+        }
+
+        /// Entries `offset ..< offset + limit`, with sizes.
+        func page(offset: Int, limit: Int) -> [[String: Any]] {
+            PierBridge.takeResult(pier_dir_listing_page(handle, UInt(offset), UInt(limit)),
+                                  as: PierFileEntry.self, PierBridge.fileEntryDictionary) ?? []
+        }
+
+        deinit {
+            pier_dir_listing_close(handle)
+        }
+    }
+
+    // MARK: - Database
+
+    /// A native MySQL / PostgreSQL / Redis connection. Rows are read from
+    /// the socket a page at a time. Calls block, so use it off the main
+    /// thread; they're serialized, one statement at a time.
+    final class DatabaseClient {
+        enum Kind: UInt8 {
+            case mysql = 0, postgres = 1, redis = 2
+        }
+
+        private let handle: PierDbHandle
+        private let lock = NSLock()
+
+        /// Connect over a local TCP port, e.g. an SSH tunnel's.
+        init?(kind: Kind, host: String, port: UInt16, user: String, password: String, database: String) {
+            let handle: PierDbHandle? = host.withCString { hostPtr in
+                user.withCString { userPtr in
+                    password.withCString { passwordPtr in
+                        database.withCString { databasePtr in
+                            pier_db_connect(kind.rawValue, nil, hostPtr, port, userPtr, passwordPtr, databasePtr)
+                        }
+                    }
+                }
+            }
+            guard let handle else { return nil }
+            self.handle = handle
+        }
+
+        /// Queries run so far; a page is only read for the latest one.
+        private var queries = 0
+
+        /// False once the connection is lost; close it and connect again.
+        var isConnected: Bool {
+            lock.lock()
+            defer { lock.unlock() }
+            return pier_db_is_connected(handle) == 1
+        }
+
+        /// Run a statement, then read up to `maxRows` rows of its result.
+        /// `more` is set when a full page came back: pass it to `fetch` for
+        /// the next one, until another query discards the rest. NULL reads
+        /// as "NULL".
+        func query(_ sql: String, maxRows: Int) -> (columns: [String], rows: [[String]], more: Int?, error: String?) {
+            lock.lock()
+            defer { lock.unlock() }
+
+            queries += 1
+            guard let json = sql.withCString({ pier_db_query(handle, $0) }) else {
+                return ([], [], nil, "Query failed")
+            }
+            defer { pier_string_free(json) }
+            guard let outcome = try? JSONSerialization.jsonObject(with: Data(String(cString: json).utf8)) as? [String: Any] else {
+                return ([], [], nil, "Query failed")
+            }
+            if let error = outcome["error"] as? String {
+                return ([], [], nil, error)
+            }
+            let columns = (outcome["columns"] as? [[String: Any]] ?? []).compactMap { $0["name"] as? String }
+            if columns.isEmpty {
+                return ([], [], nil, nil)
+            }
+
+            guard let rows = fetchPage(maxRows) else {
+                return (columns, [], nil, "Failed to read rows")
+            }
+            return (columns, rows, rows.count == maxRows ? queries : nil, nil)
+        }
+
+        /// The next `maxRows` rows of query `more`, with `more` again while
+        /// pages are full. Nil when the read failed or another query ran.
+        func fetch(_ more: Int, maxRows: Int) -> (rows: [[String]], more: Int?)? {
+            lock.lock()
+            defer { lock.unlock() }
+
+            guard more == queries, let rows = fetchPage(maxRows) else { return nil }
+            return (rows, rows.count == maxRows ? more : nil)
+        }
+
+        private func fetchPage(_ maxRows: Int) -> [[String]]? {
+            guard let page = PierBridge.takeResult(pier_db_fetch_buffer(handle, UInt32(maxRows)),
+                                                   as: PierDbColumn.self, { column in
+                UnsafeBufferPointer(start: column.cells, count: Int(column.rows)).map(DatabaseClient.cellText)
+            }) else {
+                return nil
+            }
+            let rowCount = page.first?.count ?? 0
+            return (0..<rowCount).map { row in page.map { $0[row] } }
+        }
+
+        /// Text cells as they are; BLOB and other binary cells as hex.
+        private static func cellText(_ cell: PierStr) -> String {
+            guard let ptr = cell.ptr else { return "NULL" }
+            let bytes = UnsafeRawBufferPointer(start: ptr, count: Int(cell.len))
+            if let text = String(bytes: bytes, encoding: .utf8) {
+                return text
+            }
+            return "0x" + bytes.map { String(format: "%02X", $0) }.joined()
+        }
+
+        deinit {
+            pier_db_close(handle)
+        }
+    }
+
+    // MARK: - Session Recording
+
+    /// A recorded terminal session, opened for replay. Seeking replays
+    /// from the nearest keyframe, so any point is cheap to reach. Not
+    /// thread-safe.
+    final class Recording {
+        enum Frame {
+            case output(time: UInt64, bytes: [UInt8])
+            case resize(time: UInt64, cols: UInt16, rows: UInt16)
+        }
+
+        private let handle: PierRecordingHandle
+        let startDate: Date
+        /// Microseconds from the start to the last recorded output.
+        let duration: UInt64
+        let cols: UInt16
+        let rows: UInt16
+
+        init?(path: String) {
+            guard let handle = path.withCString({ pier_recording_open($0) }) else { return nil }
+            guard let json = pier_recording_info(handle) else {
+                pier_recording_close(handle)
+                return nil
+            }
+            defer { pier_string_free(json) }
+            let info = (try? JSONSerialization.jsonObject(with: Data(String(cString: json).utf8)) as? [String: Any]) ?? [:]
+            self.handle = handle
+            self.startDate = Date(timeIntervalSince1970: Double(info["start_unix_ms"] as? Int64 ?? 0) / 1000)
+            self.duration = UInt64(info["duration_us"] as? Int64 ?? 0)
+            self.cols = UInt16(info["cols"] as? Int ?? 80)
+            self.rows = UInt16(info["rows"] as? Int ?? 24)
+        }
+
+        /// Bytes that draw the screen at `time` on a blank terminal of the
+        /// returned size.
+        func screen(at time: UInt64) -> (bytes: [UInt8], cols: UInt16, rows: UInt16)? {
+            var cols: UInt16 = 0
+            var rows: UInt16 = 0
+            guard let bytes = PierBridge.takeResult(pier_recording_screen_at(handle, time, &cols, &rows),
+                                                    as: UInt8.self, { $0 }) else {
+                return nil
+            }
+            return (bytes, cols, rows)
+        }
+
+        /// Frames in `from ..< to`, to play on after `screen(at: from)`.
+        func frames(from: UInt64, to: UInt64) -> [Frame] {
+            PierBridge.takeResult(pier_recording_frames(handle, from, to), as: PierRecordingFrame.self) { frame in
+                frame.data == nil && frame.len == 0 && frame.cols != 0
+                    ? .resize(time: frame.time_us, cols: frame.cols, rows: frame.rows)
+                    : .output(time: frame.time_us, bytes: Array(UnsafeBufferPointer(start: frame.data, count: Int(frame.len))))
+            } ?? []
+        }
+
+        /// Search recordings for `query` (ASCII case-insensitive). Each hit
+        /// has "path", "start_unix_ms", "time_us" and "line".
+        static func search(paths: [String], query: String, maxHits: Int = 100) -> [[String: Any]] {
+            return paths.joined(separator: "\n").withCString { pathsPtr in
+                query.withCString { queryPtr in
+                    guard let json = pier_recording_search(pathsPtr, queryPtr, UInt32(maxHits)) else { return [] }
+                    defer { pier_string_free(json) }
+                    return (try? JSONSerialization.jsonObject(with: Data(String(cString: json).utf8)) as? [[String: Any]]) ?? []
+                }
+            }
+        }
+
+        deinit {
+            pier_recording_close(handle)
+        }
+    }
+
+    // MARK: - Crypto
+
+    /// An AES-256-GCM key for encrypting stores at rest. Thread-safe.
+    final class Cipher {
+        private let handle: PierCipherHandle
+
+        /// `key` must be 32 bytes.
+        init?(key: Data) {
+            guard let handle = key.withUnsafeBytes({ pier_cipher_new($0.bindMemory(to: UInt8.self).baseAddress, UInt(key.count)) }) else {
+                return nil
+            }
+            self.handle = handle
+        }
+
+        func seal(_ plaintext: Data) -> Data? {
+            var sealed = Data(count: plaintext.count + Int(PIER_CIPHER_OVERHEAD))
+            let written = sealed.withUnsafeMutableBytes { out in
+                plaintext.withUnsafeBytes { input in
+                    pier_cipher_seal(handle, input.bindMemory(to: UInt8.self).baseAddress, UInt(plaintext.count),
+                                     out.bindMemory(to: UInt8.self).baseAddress, UInt(out.count))
+                }
+            }
+            return written < 0 ? nil : sealed
+        }
+
+        /// Nil if `sealed` was tampered with or sealed with another key.
+        func open(_ sealed: Data) -> Data? {
+            var plaintext = sealed
+            let length = plaintext.withUnsafeMutableBytes { buf in
+                pier_cipher_open(handle, buf.bindMemory(to: UInt8.self).baseAddress, UInt(buf.count),
+                                 buf.bindMemory(to: UInt8.self).baseAddress, UInt(buf.count))
+            }
+            guard length >= 0 else { return nil }
+            return plaintext.prefix(Int(length))
+        }
+
+        /// Encrypt a file of any size in constant memory. Blocks; call
+        /// off the main thread.
+        func encryptFile(at source: String, to destination: String) -> Bool {
+            source.withCString { src in
+                destination.withCString { pier_cipher_encrypt_file(handle, src, $0, 0) >= 0 }
+            }
+        }
+
+        /// Decrypt a file written by `encryptFile`. Nothing is left at
+        /// `destination` if any part fails to verify.
+        func decryptFile(at source: String, to destination: String) -> Bool {
+            source.withCString { src in
+                destination.withCString { pier_cipher_decrypt_file(handle, src, $0) >= 0 }
+            }
+        }
+
+        deinit {
+            pier_cipher_free(handle)
+        }
+    }
+
+    fileprivate static func fileEntryDictionary(_ entry: PierFileEntry) -> [String: Any] {
+        ["path": entry.path.string, "name": entry.name.string, "is_dir": entry.is_dir, "size": entry.size]
+    }
+
+    // MARK: - Result Buffers
+
+    /// Map the items of a `*_buffer` result, then free it.
+    /// Returns nil if the call failed (null result).
+    static func takeResult<Item, T>(_ result: UnsafeMutablePointer<PierResult>?,
+                                    as _: Item.Type,
+                                    _ transform: (Item) -> T) -> [T]? {
+        guard let result else { return nil }
+        defer { pier_result_free(result) }
+        let items = UnsafeBufferPointer(
+            start: result.pointee.items?.assumingMemoryBound(to: Item.self),
+            count: Int(result.pointee.count)
+        )
+        return items.map(transform)
+    }
+}
+
+extension PierStr {
+    /// Copy the string out of its result buffer.
+    var string: String {
+        guard let ptr else { return "" }
+        return String(decoding: UnsafeRawBufferPointer(start: ptr, count: Int(len)), as: UTF8.self)
     }
 }
@@ -80,6 +80,11 @@ class DatabaseViewModel: ObservableObject {
     @Published var queryError: String? = nil
     @Published var lastQueryTime: TimeInterval? = nil
     @Published var resultRowCount: Int? = nil
+    /// The native result has more rows than are shown; `loadMoreRows` reads them.
+    @Published var hasMoreRows = false
+    @Published var isLoadingMoreRows = false
+    /// Another query ran before the rest of the result was read.
+    @Published var resultTruncated = false
 
     // Data manipulation
     @Published var selectedRows: Set<Int> = []       // Selected row indices
@@ -113,6 +118,15 @@ class DatabaseViewModel: ObservableObject {
     /// Remote service manager for SSH command execution
     weak var serviceManager: RemoteServiceManager?
 
+    /// Native connection through the MySQL tunnel, reused across queries.
+    private var nativeClient: PierBridge.DatabaseClient?
+    private var nativeClientKey = ""
+
+    /// Rows read per page of a native result.
+    private let nativePageRows = 1_000
+    /// The shown native result's query, while it has pages left to read.
+    private var pagedQuery: Int?
+
     /// Debounced history save
     private var historySaveWork: DispatchWorkItem?
 
@@ -201,6 +215,11 @@ class DatabaseViewModel: ObservableObject {
 
     func disconnect() {
         isConnected = false
+        nativeClient = nil
+        nativeClientKey = ""
+        pagedQuery = nil
+        hasMoreRows = false
+        resultTruncated = false
         databases = []
         tables = []
         resultColumns = []
@@ -237,6 +256,13 @@ class DatabaseViewModel: ObservableObject {
         editingCell = nil
 
         Task {
+            // Before the query: running it after would discard unread pages.
+            let isSelect = queryText.trimmingCharacters(in: .whitespacesAndNewlines)
+                .uppercased().hasPrefix("SELECT")
+            if isSelect, let table = selectedTable {
+                await detectPrimaryKey(for: table)
+            }
+
             let start = Date()
             let result = await executeMysql(queryText, db: currentDB)
             let elapsed = Date().timeIntervalSince(start)
@@ -260,19 +286,17 @@ class DatabaseViewModel: ObservableObject {
                 resultColumns = []
                 resultRows = []
                 resultRowCount = nil
+                showPages(of: nil)
             } else {
                 resultColumns = result.columns
                 resultRows = result.rows
                 resultRowCount = result.rows.count
                 queryError = nil
+                showPages(of: result.moreRows)
 
-                // Remember for refresh and detect PK
-                if queryText.trimmingCharacters(in: .whitespacesAndNewlines)
-                    .uppercased().hasPrefix("SELECT") {
+                // Remember for refresh
+                if isSelect {
                     lastSelectQuery = queryText
-                    if let table = selectedTable {
-                        await detectPrimaryKey(for: table)
-                    }
                 }
             }
         }
@@ -436,10 +460,40 @@ class DatabaseViewModel: ObservableObject {
                 resultRows = result.rows
                 resultRowCount = result.rows.count
                 queryError = nil
+                showPages(of: result.moreRows)
+            }
+        }
+    }
+
+    /// Read the next page of the shown native result into the table.
+    func loadMoreRows() {
+        guard let query = pagedQuery, let client = nativeClient, !isLoadingMoreRows else { return }
+        isLoadingMoreRows = true
+        let pageRows = nativePageRows
+
+        Task {
+            let page = await Task.detached { client.fetch(query, maxRows: pageRows) }.value
+            isLoadingMoreRows = false
+            // Another query may have replaced the result meanwhile.
+            guard pagedQuery == query else { return }
+
+            if let page {
+                resultRows += page.rows
+                resultRowCount = resultRows.count
+                showPages(of: page.more)
+            } else {
+                showPages(of: nil)
+                resultTruncated = true
             }
         }
     }
 
+    private func showPages(of query: Int?) {
+        pagedQuery = query
+        hasMoreRows = query != nil
+        resultTruncated = false
+    }
+
     /// Toggle row selection
     func toggleRowSelection(_ index: Int) {
         if selectedRows.contains(index) {
@@ -475,6 +529,8 @@ class DatabaseViewModel: ObservableObject {
         let columns: [String]
         let rows: [[String]]
         let error: String?
+        /// Native query whose further pages can be read, if the first was full.
+        var moreRows: Int? = nil
     }
 
     private func executeMysql(
@@ -499,6 +555,10 @@ class DatabaseViewModel: ObservableObject {
         let pw = password ?? currentPassword
         let d = db ?? currentDB
 
+        if let result = await executeNative(query, host: h, port: p, user: u, password: pw, db: d, sm: sm) {
+            return result
+        }
+
         // Build the mysql command line for remote execution
         // Escape single quotes in the query for safe shell embedding
         let escapedQuery = query.replacingOccurrences(of: "'", with: "'\\''")
@@ -533,6 +593,72 @@ class DatabaseViewModel: ObservableObject {
         return parseTSV(output)
     }
 
+    /// Run the query over the MySQL SSH tunnel with the native client,
+    /// without a remote `mysql` process and login per query. A lost
+    /// connection is opened again once. Returns nil when there's no tunnel
+    /// for this server or the native client can't connect, so the caller
+    /// falls back to the CLI.
+    private func executeNative(
+        _ query: String,
+        host: String,
+        port: Int,
+        user: String,
+        password: String,
+        db: String,
+        sm: RemoteServiceManager
+    ) async -> QueryResult? {
+        guard host == "127.0.0.1" || host == "localhost",
+              let tunnel = sm.activeTunnels.first(where: { $0.serviceName == "mysql" && Int($0.remotePort) == port })
+        else { return nil }
+
+        let key = "\(tunnel.localPort)|\(user)|\(password)|\(db)"
+        if nativeClientKey != key {
+            nativeClient = nil
+        } else if let client = nativeClient, !(await Task.detached { client.isConnected }.value) {
+            nativeClient = nil
+        }
+
+        let pageRows = nativePageRows
+        for attempt in 1...2 {
+            let client: PierBridge.DatabaseClient
+            if let open = nativeClient {
+                client = open
+            } else {
+                guard let opened = await Task.detached(operation: {
+                    PierBridge.DatabaseClient(kind: .mysql, host: "127.0.0.1", port: tunnel.localPort,
+                                              user: user, password: password, database: db)
+                }).value else { return nil }
+                client = opened
+                nativeClient = opened
+                nativeClientKey = key
+            }
+
+            // This query discards what's left of the shown result.
+            if pagedQuery != nil {
+                pagedQuery = nil
+                hasMoreRows = false
+                resultTruncated = true
+            }
+
+            let result = await Task.detached { client.query(query, maxRows: pageRows) }.value
+            if result.error != nil, !(await Task.detached { client.isConnected }.value) {
+                // Lost mid-statement (timeout, dropped tunnel): connect again.
+                // Only a read is run again; a write may already have applied.
+                nativeClient = nil
+                nativeClientKey = ""
+                if attempt == 1, Self.isReadOnly(query) { continue }
+            }
+            return QueryResult(columns: result.columns, rows: result.rows, error: result.error, moreRows: result.more)
+        }
+        return nil
+    }
+
+    private static func isReadOnly(_ query: String) -> Bool {
+        let verb = query.trimmingCharacters(in: .whitespacesAndNewlines)
+            .prefix(while: { $0.isLetter }).uppercased()
+        return ["SELECT", "SHOW", "DESCRIBE", "DESC", "EXPLAIN"].contains(verb)
+    }
+
     private func parseTSV(_ output: String) -> QueryResult {
         let lines = output.split(separator: "\n", omittingEmptySubsequences: false)
         guard !lines.isEmpty else {
@@ -151,8 +151,11 @@ class GitViewModel: ObservableObject {
     private var timer: AnyCancellable?
     private let graphPageSize = 500
     private var graphSkipCount = 0
-    private var mainChainJSON: String = "[]"
-    private var cachedCommitsJSON: String = "[]"  // raw commits JSON for incremental loadMore
+    private var graphLayout: GraphLayoutHandle?  // Rust-side incremental layout for loadMore
+    private var statusHandle: GitStatusHandle?   // warm libgit2 repo for status + diffs
+    private var statusCodes: [String: (index: Character, worktree: Character)] = [:]  // last reported status
+    private var blameEngine: GitBlameEngine?     // per-repo blame cache
+    private var blameJob: GitBlameJob?           // blame currently streaming into blameLines
     private var directoryObserver: AnyCancellable?
     private var statusDismissTask: Task<Void, Never>?
 
@@ -210,6 +213,8 @@ class GitViewModel: ObservableObject {
                 // Clear old state immediately to prevent stale data from previous repo
                 clearState()
                 repoPath = resolvedRoot
+                statusHandle = GitStatusHandle(repoPath: resolvedRoot)
+                blameEngine = GitBlameEngine(repoPath: resolvedRoot)
                 repoDisplayPath = abbreviatePath(resolvedRoot)
                 isGitRepo = true
                 startPeriodicRefresh()
@@ -218,6 +223,8 @@ class GitViewModel: ObservableObject {
                 repoPath = path
                 repoDisplayPath = abbreviatePath(path)
                 isGitRepo = false
+                statusHandle = nil
+                blameEngine = nil
                 stopPeriodicRefresh()
                 clearState()
             }
@@ -250,6 +257,7 @@ class GitViewModel: ObservableObject {
         behindCount = 0
         stagedFiles = []
         unstagedFiles = []
+        statusCodes = [:]
         commitHistory = []
         stashes = []
         graphNodes = []
@@ -302,32 +310,37 @@ class GitViewModel: ObservableObject {
 
     // MARK: - Status
 
+    /// Apply the status changes since the last call (via libgit2, no `git status` spawn).
     func loadStatus() async {
-        let result = await runGitFull(["status", "--porcelain=v1"])
-        // Even if output is empty (clean tree), we must clear the lists
-        let output = result.stdout
+        guard let handle = statusHandle else { return }
+        // Ask for everything when there's nothing to apply a delta to.
+        let full = statusCodes.isEmpty
+        let json = await Task.detached(priority: .utility) {
+            Self.callGitFFIStatic(pier_git_status(handle.raw, full))
+        }.value
+        guard handle === statusHandle, let json,
+              let update = try? JSONDecoder().decode(GitStatusUpdate.self, from: Data(json.utf8)) else { return }
+
+        if update.full { statusCodes = [:] }
+        for entry in update.entries {
+            let index = entry.index.first ?? " "
+            let worktree = entry.worktree.first ?? " "
+            if index == " " && worktree == " " {
+                statusCodes[entry.path] = nil
+            } else {
+                statusCodes[entry.path] = (index, worktree)
+            }
+        }
 
         var staged: [GitFileChange] = []
         var unstaged: [GitFileChange] = []
-
-        for line in output.split(separator: "\n", omittingEmptySubsequences: true) {
-            let lineStr = String(line)
-            guard lineStr.count >= 4 else { continue }
-            let indexStatus = lineStr[lineStr.startIndex]
-            let workStatus = lineStr[lineStr.index(lineStr.startIndex, offsetBy: 1)]
-            let filePath = String(lineStr[lineStr.index(lineStr.startIndex, offsetBy: 3)...])
-
+        for path in statusCodes.keys.sorted() {
+            let (indexStatus, workStatus) = statusCodes[path]!
             if indexStatus != " " && indexStatus != "?" {
-                staged.append(GitFileChange(
-                    path: filePath,
-                    status: parseStatus(indexStatus)
-                ))
+                staged.append(GitFileChange(path: path, status: parseStatus(indexStatus)))
             }
             if workStatus != " " {
-                unstaged.append(GitFileChange(
-                    path: filePath,
-                    status: parseStatus(workStatus == "?" ? "?" : workStatus)
-                ))
+                unstaged.append(GitFileChange(path: path, status: parseStatus(workStatus)))
             }
         }
 
@@ -452,7 +465,7 @@ class GitViewModel: ObservableObject {
 
     func showDiff(_ path: String) {
         Task {
-            if let diff = await runGit(["diff", path]) {
+            if let diff = await diffFile(path, staged: false) {
                 NotificationCenter.default.post(
                     name: .gitShowDiff,
                     object: ["diff": diff]
@@ -463,7 +476,7 @@ class GitViewModel: ObservableObject {
 
     func showDiffStaged(_ path: String) {
         Task {
-            if let diff = await runGit(["diff", "--cached", path]) {
+            if let diff = await diffFile(path, staged: true) {
                 NotificationCenter.default.post(
                     name: .gitShowDiff,
                     object: ["diff": diff]
@@ -472,6 +485,14 @@ class GitViewModel: ObservableObject {
         }
     }
 
+    /// Patch text for one file from libgit2, like `git diff [--cached] <path>`.
+    private func diffFile(_ path: String, staged: Bool) async -> String? {
+        guard let handle = statusHandle else { return nil }
+        return await Task.detached(priority: .userInitiated) {
+            Self.callGitFFIStatic(pier_git_diff_file(handle.raw, path, staged))
+        }.value
+    }
+
     func initRepo() {
         Task {
             let result = await runGitFull(["init"])
@@ -571,8 +592,7 @@ class GitViewModel: ObservableObject {
     func loadGraphHistory() async {
         graphSkipCount = 0
         hasMoreHistory = true
-        mainChainJSON = "[]"
-        cachedCommitsJSON = "[]"
+        graphLayout = nil
         guard !repoPath.isEmpty else { graphNodes = []; return }
 
         // Run branches + authors + git user + remote URL + unpushed hashes concurrently.
@@ -598,7 +618,7 @@ class GitViewModel: ObservableObject {
         let rh = BranchGraphView.rowH
 
         // Run heavy FFI on background thread
-        let result = await Task.detached(priority: .userInitiated) { () -> (String, String, String)? in
+        let result = await Task.detached(priority: .userInitiated) { () -> (GraphLayoutHandle, [(row: Int, node: CommitNode)])? in
             // Detect default branch
             let defaultBranch = Self.callGitFFIStatic(pier_git_detect_default_branch(path)) ?? "HEAD"
 
@@ -606,37 +626,36 @@ class GitViewModel: ObservableObject {
             let fpJSON = Self.callGitFFIStatic(pier_git_first_parent_chain(path, defaultBranch, UInt32(pageSize * 2))) ?? "[]"
 
             // Load commits
-            let logJSON = Self.callGitFFIStatic(pier_git_graph_log(
+            guard let log = pier_git_graph_log_buffer(
                 path, UInt32(pageSize), 0,
                 filterBranch, filterUser,
                 searchText.isEmpty ? nil : searchText,
                 afterTs, topoOrder, firstParent, noMerges, filterPath
-            ))
-            guard let json = logJSON else { return nil }
-
-            // Compute layout
-            let layoutJSON = Self.callGitFFIStatic(pier_git_compute_graph_layout(
-                json, fpJSON,
-                Float(lw), Float(rh),
-                longEdges
-            ))
-            guard let layout = layoutJSON else { return nil }
-            return (json, fpJSON, layout)
+            ) else { return nil }
+            defer { pier_result_free(log) }
+
+            // Compute layout straight from the commit buffer; the handle keeps it for later pages
+            guard let layout = GraphLayoutHandle(laneWidth: Float(lw), rowHeight: Float(rh), longEdges: longEdges),
+                  let rows = Self.takeGraphRows(pier_git_layout_append_buffer(
+                      layout.raw, log.pointee.items?.assumingMemoryBound(to: PierCommit.self), log.pointee.count, fpJSON
+                  )) else {
+                return nil
+            }
+            return (layout, rows)
         }.value
 
         _ = await (branchTask, authorTask, userTask, remoteTask, unpushedTask)
 
-        guard let (json, fpJSON, layoutResult) = result else { graphNodes = []; return }
-        mainChainJSON = fpJSON
-        cachedCommitsJSON = json
-        graphNodes = Self.parseLayoutNodesFromJSON(layoutResult)
+        guard let (layout, rows) = result else { graphNodes = []; return }
+        graphLayout = layout
+        graphNodes = rows.map(\.node)
         graphSkipCount = graphNodes.count
         hasMoreHistory = graphNodes.count >= graphPageSize
         graphGeneration += 1  // signal full reload to UI
     }
 
     func loadMoreGraphHistory() async {
-        guard hasMoreHistory, !isLoadingMoreHistory, !repoPath.isEmpty else { return }
+        guard hasMoreHistory, !isLoadingMoreHistory, !repoPath.isEmpty, let layout = graphLayout else { return }
         isLoadingMoreHistory = true
 
         // Capture values for background work
@@ -651,63 +670,44 @@ class GitViewModel: ObservableObject {
         let firstParent = graphFirstParentOnly
         let noMerges = graphNoMerges
         let filterPath = graphFilterPath
-        let longEdges = showLongEdges
-        let lw = BranchGraphView.laneW
-        let rh = BranchGraphView.rowH
-        let oldJSON = cachedCommitsJSON
-        let mainJSON = mainChainJSON
 
         // Run heavy FFI on background thread to avoid blocking UI
-        let result = await Task.detached(priority: .userInitiated) { () -> (String, String)? in
-            let logJSON = Self.callGitFFIStatic(pier_git_graph_log(
+        let result = await Task.detached(priority: .userInitiated) { () -> [(row: Int, node: CommitNode)]? in
+            guard let log = pier_git_graph_log_buffer(
                 path, UInt32(pageSize), UInt32(skipCount),
                 filterBranch, filterUser,
                 searchText.isEmpty ? nil : searchText,
                 afterTs, topoOrder, firstParent, noMerges, filterPath
-            ))
-            guard let json = logJSON else { return nil }
+            ) else { return nil }
+            defer { pier_result_free(log) }
 
-            let mergedJSON = Self.mergeJSONArrays(oldJSON, json)
-            let layoutJSON = Self.callGitFFIStatic(pier_git_compute_graph_layout(
-                mergedJSON, mainJSON,
-                Float(lw), Float(rh),
-                longEdges
+            // Only the new page and the rows its edges cross are laid out
+            return Self.takeGraphRows(pier_git_layout_append_buffer(
+                layout.raw, log.pointee.items?.assumingMemoryBound(to: PierCommit.self), log.pointee.count, nil
             ))
-            guard let layout = layoutJSON else { return nil }
-            return (mergedJSON, layout)
         }.value
 
-        guard let (mergedJSON, layoutResult) = result else {
+        // A full reload replaced the layout while this page was loading
+        guard layout === graphLayout, let rows = result else {
             isLoadingMoreHistory = false
             return
         }
 
-        cachedCommitsJSON = mergedJSON
         let previousCount = graphNodes.count
-        graphNodes = Self.parseLayoutNodesFromJSON(layoutResult)
+        var nodes = graphNodes
+        for (row, node) in rows {
+            if row < nodes.count {
+                nodes[row] = node
+            } else {
+                nodes.append(node)
+            }
+        }
+        graphNodes = nodes
         graphSkipCount = graphNodes.count
         hasMoreHistory = (graphNodes.count - previousCount) >= graphPageSize
         isLoadingMoreHistory = false
     }
 
-    /// Merge two JSON arrays by concatenating their elements.
-    /// Much faster than decoding/re-encoding: just string manipulation.
-    nonisolated private static func mergeJSONArrays(_ a: String, _ b: String) -> String {
-        let aT = a.trimmingCharacters(in: .whitespaces)
-        let bT = b.trimmingCharacters(in: .whitespaces)
-        // Handle empty cases
-        if aT == "[]" || aT.isEmpty { return bT }
-        if bT == "[]" || bT.isEmpty { return aT }
-        // Strip outer brackets and concatenate
-        guard aT.hasPrefix("[") && aT.hasSuffix("]"),
-              bT.hasPrefix("[") && bT.hasSuffix("]") else {
-            return aT  // fallback
-        }
-        let aInner = aT.dropFirst().dropLast()
-        let bInner = bT.dropFirst().dropLast()
-        return "[\(aInner),\(bInner)]"
-    }
-
     /// Fetch all local and remote branch names via FFI.
     private func fetchGraphBranches() async {
         guard !repoPath.isEmpty else { graphBranches = []; return }
@@ -843,13 +843,7 @@ class GitViewModel: ObservableObject {
     /// Fetch tracked files via FFI.
     func fetchRepoFiles() async {
         guard !repoPath.isEmpty else { graphRepoFiles = []; return }
-        if let json = callGitFFI(pier_git_list_tracked_files(repoPath)) {
-            if let files = try? JSONDecoder().decode([String].self, from: Data(json.utf8)) {
-                graphRepoFiles = files
-                return
-            }
-        }
-        graphRepoFiles = []
+        graphRepoFiles = PierBridge.takeResult(pier_git_list_tracked_files_buffer(repoPath), as: PierStr.self) { $0.string } ?? []
     }
 
     /// Parse commit nodes from JSON returned by pier_git_graph_log FFI.
@@ -931,41 +925,112 @@ class GitViewModel: ObservableObject {
         }
     }
 
-    /// Parse layout JSON from Rust (GraphRow array) into CommitNode array.
-    /// The Rust output includes pre-computed lane, colorIndex, segments, and arrows.
-    private static func parseLayoutNodesFromJSON(_ json: String) -> [CommitNode] {
-        struct FFISegment: Decodable {
-            let x_top: CGFloat
-            let y_top: CGFloat
-            let x_bottom: CGFloat
-            let y_bottom: CGFloat
-            let color_index: Int
-        }
-        struct FFIArrow: Decodable {
-            let x: CGFloat
-            let y: CGFloat
-            let color_index: Int
-            let is_down: Bool
-        }
-        struct FFIGraphRow: Decodable {
-            let hash: String
-            let short_hash: String
-            let message: String
-            let author: String
-            let date_timestamp: Int64
-            let refs: String
-            let parents: String
-            let node_column: Int
-            let color_index: Int
-            let segments: [FFISegment]
-            let arrows: [FFIArrow]
+    /// Owns a Rust incremental graph layout; destroyed with the last reference.
+    private final class GraphLayoutHandle: @unchecked Sendable {
+        let raw: OpaquePointer
+
+        init?(laneWidth: Float, rowHeight: Float, longEdges: Bool) {
+            guard let raw = pier_git_layout_create(laneWidth, rowHeight, longEdges) else { return nil }
+            self.raw = raw
         }
 
-        guard let data = json.data(using: .utf8),
-              let rows = try? JSONDecoder().decode([FFIGraphRow].self, from: data) else {
-            return []
+        deinit {
+            pier_git_layout_destroy(raw)
+        }
+    }
+
+    /// Owns a pier-core status handle (one open libgit2 repository).
+    private final class GitStatusHandle: @unchecked Sendable {
+        let raw: OpaquePointer
+
+        init?(repoPath: String) {
+            guard let raw = pier_git_status_open(repoPath) else { return nil }
+            self.raw = raw
+        }
+
+        deinit {
+            pier_git_status_close(raw)
+        }
+    }
+
+    /// Owns a pier-core blame cache for one repository.
+    private final class GitBlameEngine: @unchecked Sendable {
+        let raw: OpaquePointer
+
+        init?(repoPath: String) {
+            guard let raw = pier_git_blame_open(repoPath) else { return nil }
+            self.raw = raw
+        }
+
+        deinit {
+            pier_git_blame_close(raw)
+        }
+    }
+
+    /// A blame streaming from pier-core; no more lines arrive once it is stopped or released.
+    private final class GitBlameJob {
+        /// Called on the main queue with each batch, `done` on the last (complete) one.
+        let onLines: @MainActor ([BlameLine], Bool) -> Void
+        private var handle: OpaquePointer?
+
+        private static let dateFormatter: DateFormatter = {
+            let formatter = DateFormatter()
+            formatter.dateFormat = "yyyy-MM-dd"
+            return formatter
+        }()
+
+        init(engine: GitBlameEngine, path: String, visibleLines: ClosedRange<Int>,
+             onLines: @escaping @MainActor ([BlameLine], Bool) -> Void) {
+            self.onLines = onLines
+            let context = Unmanaged.passUnretained(self).toOpaque()
+            handle = pier_git_blame_start(engine.raw, path, UInt(visibleLines.lowerBound), UInt(visibleLines.upperBound), { userData, lines, count, done in
+                guard let userData else { return 1 }
+                let job = Unmanaged<GitBlameJob>.fromOpaque(userData).takeUnretainedValue()
+                let batch = UnsafeBufferPointer(start: lines, count: Int(count)).map { line -> BlameLine in
+                    let hash = line.commit.string
+                    return BlameLine(
+                        lineNumber: Int(line.line_number),
+                        commitHash: hash,
+                        shortHash: String(hash.prefix(7)),
+                        author: line.author.string,
+                        date: GitBlameJob.dateFormatter.string(from: Date(timeIntervalSince1970: TimeInterval(line.time))),
+                        content: line.content.string
+                    )
+                }
+                // The main queue keeps batches in order (first screen, then all).
+                DispatchQueue.main.async { [weak job] in
+                    MainActor.assumeIsolated { job?.onLines(batch, done) }
+                }
+                return 0
+            }, context)
         }
 
+        func stop() {
+            if let handle {
+                pier_git_blame_stop(handle)
+                self.handle = nil
+            }
+        }
+
+        deinit {
+            stop()
+        }
+    }
+
+    /// JSON shape of pier_git_status.
+    private struct GitStatusUpdate: Decodable {
+        struct Entry: Decodable {
+            let path: String
+            let index: String
+            let worktree: String
+        }
+        let full: Bool
+        let entries: [Entry]
+    }
+
+    /// Copy laid-out rows out of a PierGraphRow result buffer, then free it.
+    /// The Rust output includes pre-computed lane, colorIndex, segments, and arrows.
+    nonisolated private static func takeGraphRows(_ result: UnsafeMutablePointer<PierResult>?) -> [(row: Int, node: CommitNode)]? {
         let cal = Calendar.current
         let now = Date()
         let todayStart = cal.startOfDay(for: now)
@@ -975,10 +1040,13 @@ class GitViewModel: ObservableObject {
         let fullFmt = DateFormatter()
         fullFmt.dateFormat = "yyyy/M/d HH:mm"
 
-        return rows.map { r in
-            let parents = r.parents.isEmpty ? [] : r.parents.split(separator: " ").map(String.init)
+        return PierBridge.takeResult(result, as: PierGraphRow.self) { r -> (row: Int, node: CommitNode) in
+            let c = r.commit
+            let parentsRaw = c.parents.string
+            let parents = parentsRaw.isEmpty ? [] : parentsRaw.split(separator: " ").map(String.init)
+            let rawRefs = c.refs.string
             var refs: [String] = []
-            let decoRaw = r.refs.trimmingCharacters(in: .whitespaces)
+            let decoRaw = rawRefs.trimmingCharacters(in: .whitespaces)
             if decoRaw.hasPrefix("(") && decoRaw.hasSuffix(")") {
                 let inner = String(decoRaw.dropFirst().dropLast())
                 refs = inner.split(separator: ",").map {
@@ -986,7 +1054,7 @@ class GitViewModel: ObservableObject {
                         .replacingOccurrences(of: "HEAD -> ", with: "\u{2192} ")
                 }
             }
-            let commitDate = Date(timeIntervalSince1970: TimeInterval(r.date_timestamp))
+            let commitDate = Date(timeIntervalSince1970: TimeInterval(c.date_timestamp))
             let dateStr: String
             if commitDate >= todayStart {
                 dateStr = "今天 \(timeFmt.string(from: commitDate))"
@@ -997,25 +1065,27 @@ class GitViewModel: ObservableObject {
             }
 
             var node = CommitNode(
-                id: r.hash,
-                shortHash: r.short_hash,
-                message: r.message,
-                author: r.author,
+                id: c.hash.string,
+                shortHash: c.short_hash.string,
+                message: c.message.string,
+                author: c.author.string,
                 relativeDate: dateStr,
                 refs: refs,
                 parents: parents
             )
-            node.lane = r.node_column
-            node.colorIndex = r.color_index
-            node.segments = r.segments.map {
-                Segment(xTop: $0.x_top, yTop: $0.y_top, xBottom: $0.x_bottom, yBottom: $0.y_bottom, colorIndex: $0.color_index)
+            node.lane = Int(r.node_column)
+            node.colorIndex = Int(r.color_index)
+            node.segments = UnsafeBufferPointer(start: r.segments, count: Int(r.segment_count)).map {
+                Segment(xTop: CGFloat($0.x_top), yTop: CGFloat($0.y_top),
+                        xBottom: CGFloat($0.x_bottom), yBottom: CGFloat($0.y_bottom),
+                        colorIndex: Int($0.color_index))
             }
-            node.arrows = r.arrows.map {
-                ArrowIndicator(x: $0.x, y: $0.y, colorIndex: $0.color_index, isDown: $0.is_down)
+            node.arrows = UnsafeBufferPointer(start: r.arrows, count: Int(r.arrow_count)).map {
+                ArrowIndicator(x: CGFloat($0.x), y: CGFloat($0.y), colorIndex: Int($0.color_index), isDown: $0.is_down)
             }
-            node.dateTimestamp = r.date_timestamp
-            node.rawRefs = r.refs
-            return node
+            node.dateTimestamp = c.date_timestamp
+            node.rawRefs = rawRefs
+            return (Int(r.row), node)
         }
     }
 
@@ -1068,49 +1138,26 @@ class GitViewModel: ObservableObject {
 
     // MARK: - Blame
 
+    /// Lines blamed first, so the sheet paints before the whole file is done.
+    private static let blameFirstScreen = 1...80
+
     func blameFile(_ path: String) {
-        Task {
-            guard let output = await runGit(["blame", "--porcelain", path]) else { return }
-            var lines: [BlameLine] = []
-            var lineNum = 0
-            var currentHash = ""
-            var currentAuthor = ""
-            var currentDate = ""
-
-            let dateFormatter = DateFormatter()
-            dateFormatter.dateFormat = "yyyy-MM-dd"
-
-            for rawLine in output.split(separator: "\n", omittingEmptySubsequences: false) {
-                let line = String(rawLine)
-
-                if line.count >= 40, line.prefix(40).allSatisfy({ $0.isHexDigit }) {
-                    currentHash = String(line.prefix(40))
-                } else if line.hasPrefix("author ") {
-                    currentAuthor = String(line.dropFirst(7))
-                } else if line.hasPrefix("author-time ") {
-                    if let ts = TimeInterval(line.dropFirst(12)) {
-                        let date = Date(timeIntervalSince1970: ts)
-                        currentDate = dateFormatter.string(from: date)
-                    }
-                } else if line.hasPrefix("\t") {
-                    lineNum += 1
-                    lines.append(BlameLine(
-                        lineNumber: lineNum,
-                        commitHash: currentHash,
-                        shortHash: String(currentHash.prefix(7)),
-                        author: currentAuthor,
-                        date: currentDate,
-                        content: String(line.dropFirst(1))
-                    ))
-                }
+        blameJob?.stop()
+        guard let engine = blameEngine else { return }
+        var shown = false
+        blameJob = GitBlameJob(engine: engine, path: path, visibleLines: Self.blameFirstScreen) { [weak self] lines, done in
+            guard let self else { return }
+            // The first screen arrives first; the final batch has every line.
+            self.blameLines = lines
+            self.blameFilePath = path
+            if !shown {
+                shown = true
+                NotificationCenter.default.post(
+                    name: .gitShowBlame,
+                    object: ["path": path]
+                )
             }
-
-            blameLines = lines
-            blameFilePath = path
-            NotificationCenter.default.post(
-                name: .gitShowBlame,
-                object: ["path": path]
-            )
+            if done { self.blameJob = nil }
         }
     }
 
@@ -48,7 +48,7 @@ enum GraphHighlightMode: String, CaseIterable {
 //
 // The graph layout computation (DFS layoutIndex, active edges, column positioning,
 // segment/arrow generation) is now performed in Rust (pier-core/src/git_graph.rs)
-// via the pier_git_compute_graph_layout FFI function.
+// via the incremental pier_git_layout_* FFI (one page appended per load-more).
 //
 // Swift only handles rendering: the CommitNode's lane, colorIndex, segments,
 // and arrows fields are populated directly from the Rust-computed JSON.
@@ -399,10 +399,15 @@ struct DatabaseClientView: View {
                         .foregroundColor(.secondary)
                 }
                 if let count = viewModel.resultRowCount {
-                    Text("• \(count) " + LS("db.rows"))
+                    Text("• \(count)\(viewModel.hasMoreRows ? "+" : "") " + LS("db.rows"))
                         .font(.system(size: 9))
                         .foregroundColor(.secondary)
                 }
+                if viewModel.resultTruncated {
+                    Text("• " + LS("db.resultTruncated"))
+                        .font(.system(size: 9))
+                        .foregroundColor(.orange)
+                }
 
                 Spacer()
 
@@ -540,6 +545,19 @@ struct DatabaseClientView: View {
                                     ForEach(Array(viewModel.resultRows.enumerated()), id: \.offset) { index, row in
                                         dataRow(index: index, row: row, colWidths: colWidths, gutterWidth: gutterWidth, isEditable: isEditable)
                                     }
+                                    if viewModel.hasMoreRows {
+                                        // Reaching the end of the table reads the next page.
+                                        HStack(spacing: 4) {
+                                            ProgressView()
+                                                .controlSize(.mini)
+                                            Text(LS("db.loadingMoreRows"))
+                                                .font(.system(size: 9))
+                                                .foregroundColor(.secondary)
+                                        }
+                                        .frame(maxWidth: .infinity)
+                                        .padding(.vertical, 4)
+                                        .onAppear { viewModel.loadMoreRows() }
+                                    }
                                 }
                             }
                         }
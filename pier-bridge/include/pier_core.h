@@ -3,6 +3,164 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+/**
+ * Packed color tag (high byte of a packed color): terminal default color.
+ */
+#define PIER_COLOR_DEFAULT 0
+
+/**
+ * Packed color tag: 256-color palette index in the low byte.
+ */
+#define PIER_COLOR_INDEXED 16777216
+
+/**
+ * Packed color tag: 24-bit RGB in the low three bytes (0xRRGGBB).
+ */
+#define PIER_COLOR_RGB 33554432
+
+/**
+ * Cell attribute flag: bold.
+ */
+#define PIER_CELL_BOLD (1 << 0)
+
+/**
+ * Cell attribute flag: underline.
+ */
+#define PIER_CELL_UNDERLINE (1 << 1)
+
+/**
+ * Cell attribute flag: italic.
+ */
+#define PIER_CELL_ITALIC (1 << 2)
+
+/**
+ * Cell attribute flag: reverse video (swap fg/bg when drawing).
+ */
+#define PIER_CELL_INVERSE (1 << 3)
+
+/**
+ * Cell attribute flag: dim / faint.
+ */
+#define PIER_CELL_DIM (1 << 4)
+
+/**
+ * Cell attribute flag: strikethrough.
+ */
+#define PIER_CELL_STRIKETHROUGH (1 << 5)
+
+/**
+ * Request callback status: succeeded.
+ */
+#define PIER_REQUEST_OK 0
+
+/**
+ * Request callback status: failed or timed out (details are logged).
+ */
+#define PIER_REQUEST_FAILED -1
+
+/**
+ * Request callback status: cancelled with `pier_ssh_cancel`.
+ */
+#define PIER_REQUEST_CANCELLED -2
+
+/**
+ * Bytes a sealed message adds to its plaintext (nonce and tag).
+ */
+#define PIER_CIPHER_OVERHEAD 28
+
+/**
+ * Blame cache for one repository. Cheap to clone; clones share the cache.
+ */
+typedef struct BlameEngine BlameEngine;
+
+/**
+ * A blame running on a background thread.
+ *
+ * libgit2 can't interrupt a blame, so stopping doesn't wait for the
+ * thread: it only guarantees no callback is made after `stop` returns.
+ */
+typedef struct BlameJob BlameJob;
+
+/**
+ * An AES-256-GCM key expanded once, for any number of messages. Messages
+ * are `nonce || ciphertext || tag` with a random nonce, the same format as
+ * [`encrypt`]. Shareable across threads.
+ */
+typedef struct Cipher Cipher;
+
+/**
+ * A logged-in database connection. One statement's rows are read at a
+ * time; starting a new query discards what's left of the previous one.
+ * A call that fails mid-reply (or is dropped, as on a timeout) leaves the
+ * client unusable; every later call then fails until it's reconnected.
+ */
+typedef struct DbClient DbClient;
+
+/**
+ * A sorted snapshot of one directory.
+ */
+typedef struct DirListing DirListing;
+
+/**
+ * Reader handle for a streaming command.
+ * Dropping it cancels the command and closes its channel.
+ */
+typedef struct ExecStream ExecStream;
+
+/**
+ * A search running on a background thread.
+ * Dropping it cancels the walk and waits for the thread to exit, after
+ * which no further callbacks are made.
+ */
+typedef struct FileSearch FileSearch;
+
+/**
+ * A running follow: one remote channel feeding a bounded line ring.
+ * Dropping it stops the remote command.
+ */
+typedef struct Follower Follower;
+
+/**
+ * A live filename index for one root.
+ * Dropping it stops the watcher and saves the table to the cache file.
+ */
+typedef struct FsIndex FsIndex;
+
+/**
+ * A warm repository handle for status and diff queries. Safe to share
+ * between threads; calls are serialized.
+ */
+typedef struct GitStatus GitStatus;
+
+/**
+ * Graph layout that grows page by page.
+ *
+ * `compute_graph_layout` rebuilds everything from the full commit list;
+ * `GraphLayout` keeps its state between pages, so appending lays out only
+ * the new rows and the earlier rows crossed by edges into the new page.
+ * Rows already handed out keep their layout index and color: a first-parent
+ * chain cut off at a page boundary continues with the same index in the
+ * next page. For a single page the result matches `compute_graph_layout`.
+ */
+typedef struct GraphLayout GraphLayout;
+
+/**
+ * An open recording. Blocks are decompressed straight from the mapped
+ * file as they're needed.
+ */
+typedef struct Recording Recording;
+
+/**
+ * A running remote monitor. Dropping it stops the agent and waits for
+ * the reader thread, after which no further callbacks are made.
+ */
+typedef struct ServerMonitor ServerMonitor;
+
+/**
+ * SFTP operations wrapper.
+ */
+typedef struct SftpClient SftpClient;
+
 /**
  * SSH session manager.
  */
@@ -13,16 +171,413 @@ typedef struct SshSession SshSession;
  */
 typedef struct TerminalSession TerminalSession;
 
+/**
+ * A string inside a result buffer. NUL-terminated; `len` excludes the NUL.
+ */
+typedef struct PierStr {
+    const char *ptr;
+    uintptr_t len;
+} PierStr;
+
+/**
+ * Array result: `count` items of the returning function's item type.
+ * Free with pier_result_free.
+ */
+typedef struct PierResult {
+    const void *items;
+    uintptr_t count;
+} PierResult;
+
 /**
  * Opaque pointer to a TerminalSession.
  */
 typedef struct TerminalSession *PierTerminalHandle;
 
+/**
+ * Callback receiving coalesced PTY output on the reactor thread.
+ * `data`/`len` is valid only for the duration of the call; `data == NULL`
+ * means the PTY closed and no further calls will be made.
+ */
+typedef void (*PierTerminalOutputCallback)(void *user_data, const uint8_t *data, uintptr_t len);
+
+/**
+ * Frame header filled by `pier_terminal_snapshot_dirty`.
+ */
+typedef struct PierTerminalFrame {
+  uint16_t cols;
+  uint16_t rows;
+  uint16_t cursor_x;
+  uint16_t cursor_y;
+  /**
+   * Number of damaged rows written to the output arrays.
+   */
+  uint32_t dirty_rows;
+  /**
+   * Damaged rows that did not fit and remain queued for the next call.
+   */
+  uint32_t pending_rows;
+} PierTerminalFrame;
+
+/**
+ * A single rendered cell, as handed to the Swift renderer.
+ * `fg`/`bg` are packed colors (`PIER_COLOR_*` tag in the high byte),
+ * `flags` is a bitset of `PIER_CELL_*` attributes.
+ */
+typedef struct PierCell {
+  uint32_t ch;
+  uint32_t fg;
+  uint32_t bg;
+  uint32_t flags;
+} PierCell;
+
+/**
+ * A file or directory entry in a result buffer.
+ */
+typedef struct PierFileEntry {
+    PierStr path;
+    PierStr name;
+    uint64_t size;
+    bool is_dir;
+} PierFileEntry;
+
+/**
+ * Opaque handle to a sorted directory snapshot.
+ */
+typedef struct DirListing *PierDirListingHandle;
+
+/**
+ * A streamed filename search hit; valid only during the callback.
+ */
+typedef struct PierSearchHit {
+    PierStr path;
+    PierStr name;
+    bool is_dir;
+} PierSearchHit;
+
+/**
+ * Receives batches of search hits on a background thread; `hits` is valid
+ * only for the duration of the call. The last call has `done == true` and
+ * no hits. Return 0 to continue, non-zero to stop the search.
+ */
+typedef int32_t (*PierSearchCallback)(void *user_data,
+                                      const PierSearchHit *hits,
+                                      uintptr_t count,
+                                      bool done);
+
+/**
+ * Opaque handle to a running filename search.
+ */
+typedef struct FileSearch *PierFileSearchHandle;
+
+/**
+ * A streamed content search match; valid only during the callback.
+ */
+typedef struct PierContentMatch {
+    PierStr path;
+    /**
+     * The matching line, without its terminator (cut at 512 bytes).
+     */
+    PierStr line;
+    /**
+     * 1-based.
+     */
+    uint64_t line_number;
+    /**
+     * Byte range of the first match within `line`.
+     */
+    uintptr_t match_start;
+    uintptr_t match_end;
+} PierContentMatch;
+
+/**
+ * Receives batches of matching lines on a background thread; `matches` is
+ * valid only for the duration of the call. The last call has
+ * `done == true` and no matches. Return 0 to continue, non-zero to stop.
+ */
+typedef int32_t (*PierContentCallback)(void *user_data,
+                                       const PierContentMatch *matches,
+                                       uintptr_t count,
+                                       bool done);
+
+/**
+ * Opaque handle to a running content search.
+ */
+typedef struct FileSearch *PierContentSearchHandle;
+
+/**
+ * Opaque handle to a filename index for one root.
+ */
+typedef struct FsIndex *PierFsIndexHandle;
+
 /**
  * Opaque pointer to an SSH session.
  */
 typedef struct SshSession *PierSshHandle;
 
+/**
+ * Opaque pointer to a streaming remote command.
+ */
+typedef struct ExecStream *PierExecStreamHandle;
+
+/**
+ * Opaque pointer to a remote log follower.
+ */
+typedef struct Follower *PierFollowHandle;
+
+/**
+ * One fast sample, laid out for the FFI.
+ */
+typedef struct ServerSample {
+    /**
+     * Remote uptime in seconds, the sample's clock.
+     */
+    double uptime_secs;
+    /**
+     * Busy share of all CPUs since the previous sample, 0-100.
+     */
+    double cpu_percent;
+    double mem_total_mb;
+    /**
+     * Total minus available, like `free`'s "used".
+     */
+    double mem_used_mb;
+    double swap_total_mb;
+    double swap_used_mb;
+    /**
+     * Bytes summed over all interfaces since boot.
+     */
+    uint64_t net_rx_bytes;
+    uint64_t net_tx_bytes;
+    /**
+     * Bytes per second since the previous sample.
+     */
+    double net_rx_per_sec;
+    double net_tx_per_sec;
+    double load_1;
+    double load_5;
+    double load_15;
+    uint32_t process_count;
+} ServerSample;
+
+/**
+ * Receives server monitor events on a background thread. Each call has
+ * either a `sample` or a `details_json` ({"hostname", "kernel", "disks",
+ * "processes", "gpus"}); both are valid only for the duration of the call.
+ * A final call with both null means the agent exited.
+ */
+typedef void (*PierMonitorCallback)(void *user_data,
+                                    const ServerSample *sample,
+                                    const char *details_json);
+
+/**
+ * Opaque pointer to a running server monitor.
+ */
+typedef struct ServerMonitor *PierMonitorHandle;
+
+/**
+ * Opaque pointer to an SFTP session.
+ */
+typedef struct SftpClient *PierSftpHandle;
+
+/**
+ * Transfer progress callback: bytes done and total bytes. Runs on an
+ * internal worker thread. Return 0 to continue, non-zero to cancel.
+ */
+typedef int32_t (*PierTransferProgressCallback)(void *user_data, uint64_t done, uint64_t total);
+
+/**
+ * Completion of an async request, on a runtime worker thread. `status` is
+ * a `PIER_REQUEST_*` value; `result` is the JSON the blocking call returns,
+ * or null, and is valid only for the duration of the call.
+ */
+typedef void (*PierRequestCallback)(void *user_data,
+                                    uint64_t request_id,
+                                    int32_t status,
+                                    const char *result);
+
+/**
+ * Opaque pointer to a logged-in database connection.
+ */
+typedef struct DbClient *PierDbHandle;
+
+/**
+ * One column of a fetched page: `rows` cells, top to bottom. A NULL cell
+ * has a null `ptr`. Cells are the bytes the server sent: UTF-8 for text,
+ * anything for BLOB and binary columns.
+ */
+typedef struct PierDbColumn {
+    const PierStr *cells;
+    uintptr_t rows;
+} PierDbColumn;
+
+/**
+ * A commit in a result buffer; also the input to the layout `*_buffer` calls.
+ */
+typedef struct PierCommit {
+    PierStr hash;
+    PierStr parents;
+    PierStr short_hash;
+    PierStr refs;
+    PierStr message;
+    PierStr author;
+    int64_t date_timestamp;
+} PierCommit;
+
+/**
+ * A line segment within a single row (pixel coordinates relative to row origin).
+ */
+typedef struct PrintSegment {
+    float x_top;
+    float y_top;
+    float x_bottom;
+    float y_bottom;
+    int32_t color_index;
+} PrintSegment;
+
+/**
+ * Arrow indicator for long-span branch lines.
+ */
+typedef struct ArrowElement {
+    float x;
+    float y;
+    int32_t color_index;
+    bool is_down;
+} ArrowElement;
+
+/**
+ * A laid-out graph row in a result buffer. `segments` and `arrows` point
+ * into the same result.
+ */
+typedef struct PierGraphRow {
+    uintptr_t row;
+    int32_t node_column;
+    int32_t color_index;
+    PierCommit commit;
+    const PrintSegment *segments;
+    uintptr_t segment_count;
+    const ArrowElement *arrows;
+    uintptr_t arrow_count;
+} PierGraphRow;
+
+/**
+ * Opaque handle to an incremental graph layout.
+ */
+typedef struct GraphLayout *PierGraphLayoutHandle;
+
+/**
+ * Opaque handle to an open repository for status and diff queries.
+ */
+typedef struct GitStatus *PierGitStatusHandle;
+
+/**
+ * A blamed line; valid only during the callback.
+ */
+typedef struct PierBlameLine {
+    /**
+     * 1-based, in the working file.
+     */
+    uintptr_t line_number;
+    /**
+     * 40-digit hex commit id; all zeros for uncommitted lines.
+     */
+    PierStr commit;
+    PierStr author;
+    /**
+     * Author time, seconds since the epoch.
+     */
+    int64_t time;
+    PierStr content;
+} PierBlameLine;
+
+/**
+ * Receives blamed lines on a background thread; `lines` is valid only for
+ * the duration of the call. The last call has `done == true` and carries
+ * every line (or none, if the blame failed). Return 0 to continue,
+ * non-zero to stop.
+ */
+typedef int32_t (*PierBlameCallback)(void *user_data,
+                                     const PierBlameLine *lines,
+                                     uintptr_t count,
+                                     bool done);
+
+/**
+ * Opaque handle to a repository's blame cache.
+ */
+typedef struct BlameEngine *PierBlameEngineHandle;
+
+/**
+ * Opaque handle to a running blame.
+ */
+typedef struct BlameJob *PierBlameJobHandle;
+
+/**
+ * Opaque handle to an open recording.
+ */
+typedef struct Recording *PierRecordingHandle;
+
+/**
+ * A recorded frame. Output frames have `data`/`len` and zero size;
+ * resize frames have `cols`/`rows` and no data.
+ */
+typedef struct PierRecordingFrame {
+  uint64_t time_us;
+  const uint8_t *data;
+  uintptr_t len;
+  uint16_t cols;
+  uint16_t rows;
+} PierRecordingFrame;
+
+/**
+ * Opaque handle to an expanded AES-256-GCM key.
+ */
+typedef struct Cipher *PierCipherHandle;
+
+/**
+ * Summary of a histogram. Percentiles are bucket upper bounds, so they
+ * overestimate by at most 2x (and never exceed `max_us`).
+ */
+typedef struct LatencySummary {
+    uint64_t count;
+    uint64_t mean_us;
+    uint64_t p50_us;
+    uint64_t p99_us;
+    uint64_t max_us;
+} LatencySummary;
+
+typedef struct ConnectionSnapshot {
+    uint64_t channel_opens;
+    LatencySummary exec_wait;
+    LatencySummary exec_rtt;
+    uint64_t reconnects;
+} ConnectionSnapshot;
+
+/**
+ * Copy of the process-wide metrics.
+ */
+typedef struct MetricsSnapshot {
+    uint64_t pty_bytes_read;
+    uint64_t pty_reads;
+    LatencySummary vt_process;
+    ConnectionSnapshot ssh;
+    uint64_t forward_bytes_up;
+    uint64_t forward_bytes_down;
+    uint64_t sftp_bytes_down;
+    uint64_t sftp_bytes_up;
+    LatencySummary sftp_chunk;
+    LatencySummary graph_log;
+    LatencySummary graph_layout;
+} MetricsSnapshot;
+
+typedef struct TerminalSnapshot {
+    uint64_t bytes_processed;
+    LatencySummary vt_process;
+} TerminalSnapshot;
+
+/**
+ * Free a result returned by any `*_buffer` function.
+ */
+void pier_result_free(PierResult *result);
+
 /**
  * Create a new terminal session.
  * Returns null on failure.
@@ -53,8 +608,9 @@ int32_t pier_terminal_write(PierTerminalHandle handle, const uint8_t *data, uint
 
 /**
  * Read output from the terminal.
- * Writes data into the provided buffer and returns the number of bytes read.
- * Returns -1 on failure.
+ * Reads directly into the provided buffer (no intermediate copy) and returns
+ * the number of bytes read. Data that does not fit stays queued in the PTY
+ * for the next call, so nothing is truncated. Returns -1 on failure.
  */
 int64_t pier_terminal_read(PierTerminalHandle handle, uint8_t *buffer, uintptr_t buffer_len);
 
@@ -68,6 +624,82 @@ int32_t pier_terminal_resize(PierTerminalHandle handle, uint16_t cols, uint16_t
  */
 int32_t pier_terminal_fd(PierTerminalHandle handle);
 
+/**
+ * Deliver this terminal's output through the shared PTY reactor instead of
+ * polling `pier_terminal_read`. The callback is invoked at most once per
+ * frame interval with everything read in that frame (immediately for the
+ * first output after idle). It runs on the reactor thread and must not call
+ * `pier_terminal_watch`/`pier_terminal_unwatch`/`pier_terminal_destroy`;
+ * hop to another queue first. Do not mix with `pier_terminal_read`.
+ * Returns 0 on success, -1 on failure.
+ */
+int32_t pier_terminal_watch(PierTerminalHandle handle,
+                            PierTerminalOutputCallback callback,
+                            void *user_data);
+
+/**
+ * Stop reactor delivery for a terminal. After this returns the callback
+ * will not be invoked again. `pier_terminal_destroy` does this implicitly.
+ * Returns 0 if the terminal was being watched, -1 otherwise.
+ */
+int32_t pier_terminal_unwatch(PierTerminalHandle handle);
+
+/**
+ * Set the reactor's output coalescing interval in microseconds
+ * (default 16667, one 60 Hz frame). Applies to all watched terminals.
+ * Returns 0 on success, -1 if the reactor is unavailable.
+ */
+int32_t pier_terminal_set_frame_interval(uint32_t micros);
+
+/**
+ * Feed PTY output bytes through the core VT emulator.
+ * Returns 0 on success, -1 on invalid arguments.
+ */
+int32_t pier_terminal_process(PierTerminalHandle handle, const uint8_t *data, uintptr_t len);
+
+/**
+ * Copy the rows changed since the last call into caller-owned buffers.
+ *
+ * - frame: receives grid size, cursor position and row counts
+ * - row_indices: receives the screen row index of each damaged row
+ * - cells: receives `cols` cells per damaged row, packed row after row
+ * - max_rows: capacity of `row_indices` (rows) and `cells` (max_rows * cols)
+ *
+ * Rows that do not fit stay dirty for the next call.
+ * Returns the number of rows written, or -1 on invalid arguments.
+ */
+int32_t pier_terminal_snapshot_dirty(PierTerminalHandle handle,
+                                     struct PierTerminalFrame *frame,
+                                     uint16_t *row_indices,
+                                     struct PierCell *cells,
+                                     uintptr_t max_rows);
+
+/**
+ * Number of lines currently held in the terminal's scrollback.
+ * Index 0 is the oldest retained line. Returns 0 on invalid handle.
+ */
+uintptr_t pier_terminal_scrollback_len(PierTerminalHandle handle);
+
+/**
+ * Copy scrollback lines `[start, start + count)` into `cells`.
+ * Each line occupies exactly `cols` cells (truncated or blank-padded).
+ * Only the compressed blocks overlapping the range are decompressed.
+ * Returns the number of lines copied, or -1 on invalid arguments.
+ */
+int32_t pier_terminal_scrollback_lines(PierTerminalHandle handle,
+                                       uintptr_t start,
+                                       uintptr_t count,
+                                       struct PierCell *cells,
+                                       uint16_t cols);
+
+/**
+ * Set scrollback retention limits. `max_lines` = 0 disables scrollback.
+ * Returns 0 on success, -1 on invalid handle.
+ */
+int32_t pier_terminal_set_scrollback_limits(PierTerminalHandle handle,
+                                            uintptr_t max_lines,
+                                            uintptr_t max_bytes);
+
 /**
  * Search result returned via FFI as a JSON string.
  * Caller must free the returned string with pier_string_free.
@@ -80,8 +712,118 @@ char *pier_search_files(const char *root, const char *pattern, uintptr_t max_res
  */
 char *pier_list_directory(const char *path);
 
+/**
+ * Search files like pier_search_files, returning a buffer of PierFileEntry.
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_search_files_buffer(const char *root, const char *pattern, uintptr_t max_results);
+
+/**
+ * List a directory like pier_list_directory, returning a buffer of PierFileEntry.
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_list_directory_buffer(const char *path);
+
+/**
+ * Read and sort a directory for paging with pier_dir_listing_page.
+ * Entry types come from the directory itself; nothing is stat'ed yet.
+ * Free with pier_dir_listing_close. Returns null if it can't be read.
+ */
+PierDirListingHandle pier_dir_listing_open(const char *path);
+
+/**
+ * Number of entries in the listing, or -1 on a null handle.
+ */
+int64_t pier_dir_listing_count(PierDirListingHandle listing);
+
+/**
+ * Entries `offset..offset + limit` as a buffer of PierFileEntry, sizes
+ * included. Only this window is stat'ed. Not thread-safe per handle.
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_dir_listing_page(PierDirListingHandle listing, uintptr_t offset, uintptr_t limit);
+
+/**
+ * Free a directory listing.
+ */
+void pier_dir_listing_close(PierDirListingHandle listing);
+
+/**
+ * Search file names under `root` on all cores, streaming matches to
+ * `callback` in batches as they are found. Stop (or free, once done) with
+ * pier_search_files_stop; start a new search per query and stop the old one.
+ * Returns null on invalid arguments.
+ */
+PierFileSearchHandle pier_search_files_start(const char *root,
+                                             const char *pattern,
+                                             uintptr_t max_results,
+                                             PierSearchCallback callback,
+                                             void *user_data);
+
+/**
+ * Stop a filename search and free its handle. After this returns the
+ * callback will not be invoked again. Must not be called from the callback.
+ */
+void pier_search_files_stop(PierFileSearchHandle search);
+
+/**
+ * Search the contents of files under `root` on all cores, streaming
+ * matching lines to `callback` as they are found. `pattern` is literal
+ * text unless `regex` is set. Binary files are skipped, and .gitignore is
+ * respected like in pier_search_files_start. Stop (or free, once done)
+ * with pier_search_content_stop. Returns null on invalid arguments,
+ * including a pattern that is not a valid regex.
+ */
+PierContentSearchHandle pier_search_content_start(const char *root,
+                                                  const char *pattern,
+                                                  bool regex,
+                                                  bool case_sensitive,
+                                                  uintptr_t max_results,
+                                                  PierContentCallback callback,
+                                                  void *user_data);
+
+/**
+ * Stop a content search and free its handle. After this returns the
+ * callback will not be invoked again. Must not be called from the callback.
+ */
+void pier_search_content_stop(PierContentSearchHandle search);
+
+/**
+ * Start indexing `root` in the background. With a non-null `cache_dir`
+ * the index is loaded from (and saved back to) a file there, so queries
+ * work before the first crawl finishes. Free with pier_fs_index_close.
+ * Returns null on invalid arguments.
+ */
+PierFsIndexHandle pier_fs_index_open(const char *root, const char *cache_dir);
+
+/**
+ * 1 once the index holds a crawl (or a cached one), 0 while the first
+ * crawl is running, -1 on a null handle.
+ */
+int32_t pier_fs_index_is_ready(PierFsIndexHandle index);
+
+/**
+ * Search file names in the index like pier_search_files_buffer, without
+ * touching the disk. Caller must free with pier_result_free.
+ */
+PierResult *pier_fs_index_search(PierFsIndexHandle index, const char *pattern, uintptr_t max_results);
+
+/**
+ * List a directory like pier_list_directory_buffer, served from the
+ * index's listing cache while it is current.
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_fs_index_list_directory(PierFsIndexHandle index, const char *path);
+
+/**
+ * Stop watching, save the index to its cache file and free the handle.
+ */
+void pier_fs_index_close(PierFsIndexHandle index);
+
 /**
  * Connect to an SSH server.
+ * Joins the open connection with the same host, port, user and
+ * credentials if there is one, skipping the handshake.
  * auth_type: 0 = password, 1 = key file
  * credential: password string (auth_type=0) or key file path (auth_type=1)
  * Returns null on failure.
@@ -94,6 +836,8 @@ PierSshHandle pier_ssh_connect(const char *host,
 
 /**
  * Disconnect an SSH session and free the handle.
+ * Stops its forwards; the connection itself closes once no other handle
+ * uses it.
  */
 int32_t pier_ssh_disconnect(PierSshHandle handle);
 
@@ -117,6 +861,140 @@ char *pier_ssh_detect_services(PierSshHandle handle);
  */
 char *pier_ssh_exec(PierSshHandle handle, const char *command);
 
+/**
+ * Set how many `pier_ssh_exec` commands may run at once on this connection
+ * (default 5). Further commands queue in arrival order.
+ * Returns 0 on success, -1 on failure.
+ */
+int32_t pier_ssh_set_max_concurrent_execs(PierSshHandle handle, uint32_t max);
+
+/**
+ * Start a command and stream its output instead of buffering it.
+ * Read output with `pier_ssh_stream_read`; free with `pier_ssh_stream_close`.
+ * The stream stays valid after the SSH handle is disconnected (reads then
+ * report the end of output).
+ * Returns null on failure.
+ */
+PierExecStreamHandle pier_ssh_exec_stream(PierSshHandle handle, const char *command);
+
+/**
+ * Read the next chunk of output, waiting up to `timeout_ms`.
+ * Each call returns bytes from one stream; `*kind` is set to 1 (stdout)
+ * or 2 (stderr). Returns the byte count, 0 on timeout, -1 once the command
+ * has finished and all output was read, -2 on invalid arguments.
+ */
+int64_t pier_ssh_stream_read(PierExecStreamHandle stream,
+                             uint8_t *buffer,
+                             uintptr_t buffer_len,
+                             uint8_t *kind,
+                             uint32_t timeout_ms);
+
+/**
+ * Exit status of a streaming command, or -1 while it is still running
+ * (or if the server never reported one).
+ */
+int32_t pier_ssh_stream_exit_code(PierExecStreamHandle stream);
+
+/**
+ * Cancel a streaming command (if still running) and free the handle.
+ */
+void pier_ssh_stream_close(PierExecStreamHandle stream);
+
+/**
+ * Follow a remote log over one long-lived channel.
+ * `kind` is 0 for a file path, 1 for a Docker container ID/name.
+ * Starts with the last `backlog` lines; `capacity` bounds the lines kept
+ * for polling (0 = default). Free with `pier_ssh_follow_stop`.
+ * Returns null on failure.
+ */
+PierFollowHandle pier_ssh_follow_start(PierSshHandle handle,
+                                       uint8_t kind,
+                                       const char *target,
+                                       uint32_t backlog,
+                                       uint32_t capacity);
+
+/**
+ * Fetch up to `max` lines with sequence number >= `since`.
+ * Returns JSON: {"lines": [{"seq", "text", "timestamp", "level", "message"}],
+ * "next": N, "skipped": N, "finished": bool}. Pass `next` as `since` on the
+ * following call; `skipped` counts lines evicted before they were read.
+ * Caller must free with pier_string_free.
+ */
+char *pier_ssh_follow_poll(PierFollowHandle follow, uint64_t since, uint32_t max);
+
+/**
+ * Stop following (closes the remote channel) and free the handle.
+ */
+void pier_ssh_follow_stop(PierFollowHandle follow);
+
+/**
+ * Start monitoring the server over one long-lived channel: a sample every
+ * `interval_secs`, and details every `slow_every` samples (0 = defaults).
+ * Stop and free with `pier_ssh_monitor_stop`. Returns null on failure.
+ */
+PierMonitorHandle pier_ssh_monitor_start(PierSshHandle handle,
+                                         uint32_t interval_secs,
+                                         uint32_t slow_every,
+                                         PierMonitorCallback callback,
+                                         void *user_data);
+
+/**
+ * Stop the monitor (closes the remote channel) and free the handle.
+ * No callbacks are made after this returns.
+ */
+void pier_ssh_monitor_stop(PierMonitorHandle monitor);
+
+/**
+ * Open an SFTP session on an existing SSH connection.
+ * Returns null on failure. Free with `pier_sftp_close`.
+ */
+PierSftpHandle pier_sftp_open(PierSshHandle handle);
+
+/**
+ * Close an SFTP session.
+ */
+void pier_sftp_close(PierSftpHandle handle);
+
+/**
+ * Download a remote file with pipelined reads.
+ * With `resume`, a shorter existing local file is continued from its end.
+ * Returns 0 on success, 1 if cancelled by the callback, -1 on failure.
+ */
+int32_t pier_sftp_download(PierSftpHandle handle,
+                           const char *remote_path,
+                           const char *local_path,
+                           bool resume,
+                           PierTransferProgressCallback progress,
+                           void *user_data);
+
+/**
+ * Upload a local file with pipelined writes.
+ * With `resume`, an existing remote file is continued (the last few
+ * chunks are re-sent to cover writes that may have landed out of order).
+ * Returns 0 on success, 1 if cancelled by the callback, -1 on failure.
+ */
+int32_t pier_sftp_upload(PierSftpHandle handle,
+                         const char *local_path,
+                         const char *remote_path,
+                         bool resume,
+                         PierTransferProgressCallback progress,
+                         void *user_data);
+
+/**
+ * List a remote directory as a JSON array of entries (directories first).
+ * Served from the session's listing cache while fresh; subdirectories are
+ * then prefetched in the background. Returns null on failure.
+ * Caller must free with pier_string_free.
+ */
+char *pier_sftp_list_dir(PierSftpHandle handle, const char *path);
+
+/**
+ * Drop cached listings for `path` and everything below it, after the
+ * remote side was changed some other way (e.g. a shell command).
+ * Returns 0 on success, -1 on invalid arguments.
+ */
+int32_t pier_sftp_invalidate(PierSftpHandle handle, const char *path);
+
 /**
  * Start local port forwarding: 127.0.0.1:local_port → remote_host:remote_port.
  * Returns 0 on success, -1 on failure.
@@ -133,11 +1011,115 @@ int32_t pier_ssh_forward_port(PierSshHandle handle,
 int32_t pier_ssh_stop_forward(PierSshHandle handle, uint16_t local_port);
 
 /**
- * List active forward ports as a JSON array.
+ * List active forwards as a JSON array of objects with `local_port`,
+ * `remote_host`, `remote_port`, `bytes_up`, `bytes_down`, `up_per_sec`,
+ * `down_per_sec` (averaged since the previous call), `active_connections`,
+ * `total_connections` and `uptime_secs`.
  * Caller must free with pier_string_free.
  */
 char *pier_ssh_list_forwards(PierSshHandle handle);
 
+/**
+ * Create a session handle without connecting; connect it with
+ * `pier_ssh_connect_async`. Arguments are as for `pier_ssh_connect`.
+ * Free with `pier_ssh_disconnect`. Returns null on invalid arguments.
+ */
+PierSshHandle pier_ssh_session_new(const char *host,
+                                   uint16_t port,
+                                   const char *username,
+                                   int32_t auth_type,
+                                   const char *credential);
+
+/**
+ * Connect a handle from `pier_ssh_session_new`. The handle must not be
+ * used by other calls until the callback runs (with a null result).
+ * Returns the request id, or 0 on invalid arguments.
+ */
+uint64_t pier_ssh_connect_async(PierSshHandle handle,
+                                PierRequestCallback callback,
+                                void *user_data);
+
+/**
+ * Non-blocking `pier_ssh_exec`; the callback gets the same JSON.
+ * Returns the request id, or 0 on invalid arguments.
+ */
+uint64_t pier_ssh_exec_async(PierSshHandle handle,
+                             const char *command,
+                             PierRequestCallback callback,
+                             void *user_data);
+
+/**
+ * Non-blocking `pier_ssh_detect_services`; the callback gets the same
+ * JSON array. Returns the request id, or 0 on invalid arguments.
+ */
+uint64_t pier_ssh_detect_services_async(PierSshHandle handle,
+                                        PierRequestCallback callback,
+                                        void *user_data);
+
+/**
+ * Non-blocking `pier_ssh_forward_port`; the callback's result is null.
+ * The handle must not be used by other calls until the callback runs.
+ * Returns the request id, or 0 on invalid arguments.
+ */
+uint64_t pier_ssh_forward_port_async(PierSshHandle handle,
+                                     uint16_t local_port,
+                                     const char *remote_host,
+                                     uint16_t remote_port,
+                                     PierRequestCallback callback,
+                                     void *user_data);
+
+/**
+ * Cancel an async request. Its callback still runs, with
+ * `PIER_REQUEST_CANCELLED`, unless it had already completed.
+ * Returns 0 if the request was pending, -1 if it had already finished.
+ */
+int32_t pier_ssh_cancel(uint64_t request_id);
+
+/**
+ * Connect and log in. `kind`: 0 = MySQL, 1 = PostgreSQL, 2 = Redis.
+ * With an SSH handle, `host:port` is reached from the server over a
+ * direct-tcpip channel; with null, it's a local TCP connection (e.g. an
+ * existing tunnel). `user`, `password` and `database` may be null.
+ * Free with `pier_db_close`. Returns null on failure (details are logged).
+ */
+PierDbHandle pier_db_connect(uint8_t kind,
+                             PierSshHandle ssh,
+                             const char *host,
+                             uint16_t port,
+                             const char *user,
+                             const char *password,
+                             const char *database);
+
+/**
+ * Run a statement (a command line for Redis). Returns JSON
+ * {"columns": [{"name", "type_name"}], "affected_rows": N, "message": "..."}
+ * or {"error": "..."}; read rows with `pier_db_fetch_buffer`. Anything
+ * left of the previous result is discarded first.
+ * After a timeout or a broken connection every later call fails with
+ * "Connection lost, reconnect"; close the handle and connect again.
+ * Caller must free with pier_string_free.
+ */
+char *pier_db_query(PierDbHandle db, const char *sql);
+
+/**
+ * Read up to `max_rows` more rows of the last query's result, as an array
+ * of `PierDbColumn`. A page with fewer rows than asked for is the last;
+ * further calls return empty pages. Returns null on failure.
+ * Free with pier_result_free.
+ */
+PierResult *pier_db_fetch_buffer(PierDbHandle db, uint32_t max_rows);
+
+/**
+ * Check whether the connection is still usable.
+ * Returns 1 if it is, 0 once it's lost (reconnect), -1 on invalid handle.
+ */
+int32_t pier_db_is_connected(PierDbHandle db);
+
+/**
+ * Close the connection and free the handle.
+ */
+void pier_db_close(PierDbHandle db);
+
 /**
  * Load commit graph data. Returns JSON string.
  * Caller must free with pier_string_free.
@@ -167,6 +1149,24 @@ char *pier_git_graph_log(const char *repo_path,
                          bool no_merges,
                          const char *paths);
 
+/**
+ * Load commit graph data like pier_git_graph_log (same parameters),
+ * returning a buffer of PierCommit. The items can be passed straight to
+ * pier_git_layout_append_buffer.
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_git_graph_log_buffer(const char *repo_path,
+                                      uint32_t limit,
+                                      uint32_t skip,
+                                      const char *branch,
+                                      const char *author,
+                                      const char *search_text,
+                                      int64_t after_timestamp,
+                                      bool topo_order,
+                                      bool first_parent,
+                                      bool no_merges,
+                                      const char *paths);
+
 /**
  * Get first-parent chain hashes. Returns JSON array of strings.
  * Caller must free with pier_string_free.
@@ -191,6 +1191,12 @@ char *pier_git_list_authors(const char *repo_path, uint32_t limit);
  */
 char *pier_git_list_tracked_files(const char *repo_path);
 
+/**
+ * List tracked files like pier_git_list_tracked_files, returning a buffer
+ * of PierStr paths. Caller must free with pier_result_free.
+ */
+PierResult *pier_git_list_tracked_files_buffer(const char *repo_path);
+
 /**
  * Detect the default branch (main/master/HEAD). Returns the branch name as a C string.
  * Caller must free with pier_string_free.
@@ -214,6 +1220,249 @@ char *pier_git_compute_graph_layout(const char *commits_json,
                                     float row_height,
                                     bool show_long_edges);
 
+/**
+ * Compute the graph layout like pier_git_compute_graph_layout, taking and
+ * returning buffers instead of JSON. Rows come back as PierGraphRow.
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_git_compute_graph_layout_buffer(const PierCommit *commits,
+                                                 uintptr_t count,
+                                                 const char *main_chain_json,
+                                                 float lane_width,
+                                                 float row_height,
+                                                 bool show_long_edges);
+
+/**
+ * Create an incremental graph layout for paged history.
+ * Feed pages with pier_git_layout_append; free with pier_git_layout_destroy.
+ */
+PierGraphLayoutHandle pier_git_layout_create(float lane_width, float row_height, bool show_long_edges);
+
+/**
+ * Lay out the next page of commits.
+ * Returns JSON `{"total_rows": N, "rows": [{"row": i, ...GraphRow}]}` holding
+ * the new rows plus earlier rows whose segments changed.
+ * Caller must free with pier_string_free.
+ *
+ * Parameters:
+ * - commits_json: the next page from pier_git_graph_log
+ * - main_chain_json: JSON array of first-parent hashes (may be NULL)
+ */
+char *pier_git_layout_append(PierGraphLayoutHandle layout,
+                             const char *commits_json,
+                             const char *main_chain_json);
+
+/**
+ * Lay out the next page like pier_git_layout_append, taking the PierCommit
+ * items of pier_git_graph_log_buffer and returning PierGraphRow items
+ * (new rows plus earlier rows whose segments changed).
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_git_layout_append_buffer(PierGraphLayoutHandle layout,
+                                          const PierCommit *commits,
+                                          uintptr_t count,
+                                          const char *main_chain_json);
+
+/**
+ * Destroy a graph layout handle.
+ */
+void pier_git_layout_destroy(PierGraphLayoutHandle layout);
+
+/**
+ * Open a repository for pier_git_status / pier_git_diff_file.
+ * Returns null if `repo_path` isn't a repository root.
+ * Free with pier_git_status_close.
+ */
+PierGitStatusHandle pier_git_status_open(const char *repo_path);
+
+/**
+ * Working tree status as JSON `{"full": bool, "entries": [{"path", "index",
+ * "worktree"}]}` with porcelain v1 codes. Unless `full` is set (or this is
+ * the first call), only entries that changed since the previous call are
+ * returned; paths that became clean have both codes " ".
+ * Caller must free with pier_string_free.
+ */
+char *pier_git_status(PierGitStatusHandle handle, bool full);
+
+/**
+ * Patch text for one file (path relative to the repository root), as
+ * `git diff` prints it; `staged` diffs HEAD against the index, like
+ * `git diff --cached`. Returns null on failure.
+ * Caller must free with pier_string_free.
+ */
+char *pier_git_diff_file(PierGitStatusHandle handle, const char *path, bool staged);
+
+/**
+ * Close a repository opened with pier_git_status_open.
+ */
+void pier_git_status_close(PierGitStatusHandle handle);
+
+/**
+ * Open a blame cache for the repository at `repo_path`.
+ * Returns null if it isn't a repository. Free with pier_git_blame_close.
+ */
+PierBlameEngineHandle pier_git_blame_open(const char *repo_path);
+
+/**
+ * Blame `path` (relative to the repository root) on a background thread.
+ * If the file isn't cached and `first_visible..=last_visible` (1-based) is
+ * a non-empty range, those lines are delivered first; then every line,
+ * with `done == true`. Pass 0 for `first_visible` to skip that step.
+ * Stop (or free, once done) with pier_git_blame_stop.
+ */
+PierBlameJobHandle pier_git_blame_start(PierBlameEngineHandle engine,
+                                        const char *path,
+                                        uintptr_t first_visible,
+                                        uintptr_t last_visible,
+                                        PierBlameCallback callback,
+                                        void *user_data);
+
+/**
+ * Stop a blame and free its handle. Returns without waiting for the
+ * history walk; the callback will not be invoked after this returns.
+ * Must not be called from the callback.
+ */
+void pier_git_blame_stop(PierBlameJobHandle job);
+
+/**
+ * Free a blame cache. Running jobs keep their own reference.
+ */
+void pier_git_blame_close(PierBlameEngineHandle engine);
+
+/**
+ * Start recording a terminal's output to a new file at `path`, replacing
+ * any recording in progress. Keystrokes are not recorded (passwords are
+ * typed there), only what the terminal displays. Returns 0 on success,
+ * -1 on failure.
+ */
+int32_t pier_terminal_record_start(PierTerminalHandle handle, const char *path);
+
+/**
+ * Stop recording and wait until the file is complete. Returns 0 on
+ * success (or if nothing was being recorded), -1 if writing failed.
+ */
+int32_t pier_terminal_record_stop(PierTerminalHandle handle);
+
+/**
+ * Open a recording, finished or still being written.
+ * Returns null on failure. Free with pier_recording_close.
+ */
+PierRecordingHandle pier_recording_open(const char *path);
+
+/**
+ * Describe a recording as JSON {"start_unix_ms", "duration_us", "cols",
+ * "rows", "blocks"}. Times inside a recording are microseconds from
+ * its start.
+ * Caller must free with pier_string_free.
+ */
+char *pier_recording_info(PierRecordingHandle recording);
+
+/**
+ * Escape sequences that draw the screen as it was at `time_us` on a
+ * blank terminal, whose size is stored in `cols` / `rows`. Replays from
+ * the nearest keyframe rather than the start of the recording.
+ * Returns a buffer of bytes, or null on failure.
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_recording_screen_at(PierRecordingHandle recording,
+                                     uint64_t time_us,
+                                     uint16_t *cols,
+                                     uint16_t *rows);
+
+/**
+ * Frames recorded from `from_us` up to (not including) `to_us`, for
+ * playing on after pier_recording_screen_at(from_us).
+ * Returns a buffer of PierRecordingFrame, or null on failure.
+ * Caller must free with pier_result_free.
+ */
+PierResult *pier_recording_frames(PierRecordingHandle recording, uint64_t from_us, uint64_t to_us);
+
+/**
+ * Search recordings (newline-separated paths) for `query`, ignoring
+ * ASCII case. Only blocks whose text filter admits the query are
+ * decompressed. Returns a JSON array of {"path", "start_unix_ms",
+ * "time_us", "line"}, at most `max_hits` in all; unreadable files are
+ * skipped.
+ * Caller must free with pier_string_free.
+ */
+char *pier_recording_search(const char *paths, const char *query, uint32_t max_hits);
+
+/**
+ * Close a recording.
+ */
+void pier_recording_close(PierRecordingHandle recording);
+
+/**
+ * Expand a 32-byte key for repeated use. Returns null unless `key_len`
+ * is 32. Free with pier_cipher_free; safe to share across threads.
+ */
+PierCipherHandle pier_cipher_new(const uint8_t *key, uintptr_t key_len);
+
+/**
+ * Seal `input_len` bytes into `output` as nonce, ciphertext and tag.
+ * `output_len` must be at least `input_len + PIER_CIPHER_OVERHEAD`;
+ * `output` may be `input` itself (sealing in place) but must not
+ * otherwise overlap it. Returns the sealed length, or -1 on failure.
+ */
+int64_t pier_cipher_seal(PierCipherHandle cipher,
+                         const uint8_t *input,
+                         uintptr_t input_len,
+                         uint8_t *output,
+                         uintptr_t output_len);
+
+/**
+ * Open a sealed message into `output`, which must hold at least
+ * `input_len` bytes (the plaintext is decrypted where it lands) and may
+ * be `input` itself. Returns the plaintext length, or -1 if the message
+ * was tampered with or sealed with another key.
+ */
+int64_t pier_cipher_open(PierCipherHandle cipher,
+                         const uint8_t *input,
+                         uintptr_t input_len,
+                         uint8_t *output,
+                         uintptr_t output_len);
+
+/**
+ * Encrypt the file at `src` into `dst` in the chunked stream format,
+ * using every core and one chunk buffer per thread. `chunk_size` is
+ * plaintext bytes per chunk; 0 picks the default (64 KiB).
+ * Blocks until done; returns the plaintext length, or -1 on failure
+ * (`dst` is removed).
+ */
+int64_t pier_cipher_encrypt_file(PierCipherHandle cipher,
+                                 const char *src,
+                                 const char *dst,
+                                 uint32_t chunk_size);
+
+/**
+ * Decrypt a file written by pier_cipher_encrypt_file. Every chunk is
+ * verified; on failure `dst` is removed, so it never holds tampered
+ * plaintext. Returns the plaintext length, or -1 on failure.
+ */
+int64_t pier_cipher_decrypt_file(PierCipherHandle cipher, const char *src, const char *dst);
+
+/**
+ * Free a cipher handle.
+ */
+void pier_cipher_free(PierCipherHandle cipher);
+
+/**
+ * Process-wide totals since launch.
+ */
+MetricsSnapshot pier_metrics_snapshot(void);
+
+/**
+ * Metrics of the connection behind an SSH session, shared by every
+ * session on it. All zero if `handle` is null or not connected.
+ */
+ConnectionSnapshot pier_ssh_metrics(PierSshHandle handle);
+
+/**
+ * Output volume and VT parse time of one terminal. All zero if `handle`
+ * is null.
+ */
+TerminalSnapshot pier_terminal_metrics(PierTerminalHandle handle);
+
 /**
  * Free a string allocated by Rust.
  */
@@ -0,0 +1,327 @@
+//! Shared inputs for the benchmarks: a replay corpus of terminal output,
+//! synthetic commit histories and file trees.
+//!
+//! Everything is generated from fixed seeds, so numbers are comparable
+//! between runs and machines without checking captures into the repo.
+
+#![allow(dead_code)]
+
+use std::path::{Path, PathBuf};
+
+use pier_core::git_graph::LayoutInput;
+
+/// Small deterministic PRNG (64-bit LCG); the benches only need variety.
+pub struct Lcg(u64);
+
+impl Lcg {
+    pub fn new(seed: u64) -> Self {
+        Self(seed)
+    }
+
+    pub fn next(&mut self) -> u64 {
+        self.0 = self.0.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+        self.0 >> 33
+    }
+
+    pub fn below(&mut self, n: u64) -> u64 {
+        self.next() % n
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Terminal replay corpus
+// ═══════════════════════════════════════════════════════════
+
+/// Named PTY output streams, shaped like the programs they're named after.
+/// Recorded sessions (`script -q capture.log`) can be added by pointing
+/// `PIER_VT_CAPTURE` at a file or a directory of files.
+pub fn vt_corpus() -> Vec<(String, Vec<u8>)> {
+    let mut corpus = vec![
+        ("vim".to_string(), vim_session()),
+        ("htop".to_string(), htop_session()),
+        ("cat_log".to_string(), cat_log()),
+        ("ls_color".to_string(), ls_color()),
+        ("cargo_build".to_string(), cargo_build()),
+    ];
+    if let Some(path) = std::env::var_os("PIER_VT_CAPTURE").map(PathBuf::from) {
+        let files = if path.is_dir() {
+            let mut files: Vec<PathBuf> = std::fs::read_dir(&path)
+                .expect("read PIER_VT_CAPTURE")
+                .flatten()
+                .map(|e| e.path())
+                .filter(|p| p.is_file())
+                .collect();
+            files.sort();
+            files
+        } else {
+            vec![path]
+        };
+        for file in files {
+            let name = file.file_stem().map_or("capture".into(), |s| s.to_string_lossy().into_owned());
+            corpus.push((name, std::fs::read(&file).expect("read capture")));
+        }
+    }
+    corpus
+}
+
+/// Full-screen editing: alternate screen, syntax-coloured redraws, scroll
+/// regions and a status line, as when paging through a source file.
+fn vim_session() -> Vec<u8> {
+    let keywords = ["fn", "let", "match", "impl", "pub", "return", "if", "else"];
+    let mut rng = Lcg::new(1);
+    let mut out = b"\x1b[?1049h\x1b[22;0;0t\x1b[?1h\x1b=\x1b[H\x1b[2J\x1b[1;39r".to_vec();
+    for page in 0..400 {
+        for row in 1..=39 {
+            out.extend_from_slice(format!("\x1b[{};1H\x1b[33m{:>4} \x1b[m", row, page * 39 + row).as_bytes());
+            for _ in 0..6 {
+                match rng.below(4) {
+                    0 => out.extend_from_slice(format!("\x1b[38;5;176m{}\x1b[m ", keywords[rng.below(8) as usize]).as_bytes()),
+                    1 => out.extend_from_slice(format!("\x1b[32m\"str_{}\"\x1b[m ", rng.below(1000)).as_bytes()),
+                    _ => out.extend_from_slice(format!("ident_{} ", rng.below(10_000)).as_bytes()),
+                }
+            }
+            out.extend_from_slice(b"\x1b[K");
+        }
+        // Scroll a few lines with the region set, then repaint the status line.
+        for _ in 0..3 {
+            out.extend_from_slice(b"\x1b[39;1H\n\x1b[K");
+        }
+        out.extend_from_slice(
+            format!("\x1b[40;1H\x1b[7m src/lib.rs [+] {:>5},{:<3} {:>3}% \x1b[27m\x1b[K\x1b[{};{}H", page * 39, 1, page % 100, 1 + page % 39, 5).as_bytes(),
+        );
+    }
+    out.extend_from_slice(b"\x1b[r\x1b[?1049l");
+    out
+}
+
+/// A process monitor repainting in place: bars, 256-colour cells and many
+/// short cursor moves per frame.
+fn htop_session() -> Vec<u8> {
+    let mut rng = Lcg::new(2);
+    let mut out = b"\x1b[?1049h\x1b[?25l".to_vec();
+    for _frame in 0..600 {
+        out.extend_from_slice(b"\x1b[H");
+        for cpu in 0..8 {
+            let used = rng.below(40) as usize;
+            out.extend_from_slice(
+                format!("\x1b[{};3H\x1b[36m{:>2}\x1b[39m\x1b[1m[\x1b[32m{}\x1b[31m{}\x1b[39m{}\x1b[1m{:>5.1}%]\x1b[m", cpu + 1, cpu, "|".repeat(used / 2), "|".repeat(used / 4), " ".repeat(40 - used / 2 - used / 4), used as f64 * 2.5).as_bytes(),
+            );
+        }
+        out.extend_from_slice(b"\x1b[11;1H\x1b[30;42m  PID USER      PRI  NI  VIRT   RES   SHR S CPU% MEM%   TIME+  Command\x1b[K\x1b[m");
+        for row in 0..28 {
+            let pid = 1000 + rng.below(30_000);
+            out.extend_from_slice(
+                format!("\x1b[{};1H\x1b[38;5;{}m{:>5}\x1b[m deploy     20   0 {:>5}M {:>5}M  {:>4}M S {:>4.1} {:>4.1} {:>2}:{:02}.{:02} \x1b[1;38;5;75m/usr/bin/worker-{}\x1b[m --port {}\x1b[K", 12 + row, 16 + rng.below(216), pid, rng.below(9000), rng.below(900), rng.below(90), rng.below(1000) as f64 / 10.0, rng.below(100) as f64 / 10.0, rng.below(60), rng.below(60), rng.below(100), row, 8000 + row).as_bytes(),
+            );
+        }
+    }
+    out.extend_from_slice(b"\x1b[?25h\x1b[?1049l");
+    out
+}
+
+/// `cat` of a large plain-text log.
+fn cat_log() -> Vec<u8> {
+    let levels = ["INFO", "DEBUG", "WARN", "INFO", "ERROR"];
+    let mut rng = Lcg::new(3);
+    let mut out = Vec::new();
+    for i in 0..60_000 {
+        out.extend_from_slice(
+            format!("2026-10-14T08:{:02}:{:02}.{:03}Z {:<5} [worker-{}] request id={:08x} path=/api/v1/items/{} status=200 duration={}ms\r\n", (i / 60) % 60, i % 60, i % 1000, levels[rng.below(5) as usize], rng.below(16), rng.next(), rng.below(100_000), rng.below(500)).as_bytes(),
+        );
+    }
+    out
+}
+
+/// Coloured `ls` output, with some non-ASCII names.
+fn ls_color() -> Vec<u8> {
+    let mut out = Vec::new();
+    for i in 0..20_000 {
+        out.extend_from_slice(
+            format!("\x1b[1;34mdir{}\x1b[0m  \x1b[1;32mrun.sh\x1b[0m  notes-{}.txt  \x1b[38;5;208mimage.png\x1b[0m  résumé-{}.pdf\r\n", i, i, i).as_bytes(),
+        );
+    }
+    out
+}
+
+/// A compiler's build log: mostly text, with colour around warnings.
+fn cargo_build() -> Vec<u8> {
+    let mut out = Vec::new();
+    for i in 0..20_000 {
+        match i % 3 {
+            0 => out.extend_from_slice(
+                format!("   \x1b[1;32mCompiling\x1b[0m crate-{} v0.{}.{} (/home/user/src/crate-{})\r\n", i, i % 10, i % 7, i).as_bytes(),
+            ),
+            1 => out.extend_from_slice(
+                format!("\x1b[33mwarning\x1b[0m: unused variable `x{}` at src/lib.rs:{}:{}\r\n", i, i % 900, i % 80).as_bytes(),
+            ),
+            _ => out.extend_from_slice("test módulo::caso_ünïcode ─ ok\r\n".as_bytes()),
+        }
+    }
+    out
+}
+
+// ═══════════════════════════════════════════════════════════
+// Commit histories
+// ═══════════════════════════════════════════════════════════
+
+/// A generated commit; parents are indices of older commits.
+pub struct SynthCommit {
+    pub parents: Vec<usize>,
+}
+
+/// `n` commits, oldest first, on up to `max_lanes` concurrent branches
+/// that fork and merge often (about one commit in eight is a merge).
+pub fn synthetic_history(n: usize, max_lanes: usize, seed: u64) -> (Vec<SynthCommit>, usize) {
+    let mut rng = Lcg::new(seed);
+    let mut commits = vec![SynthCommit { parents: Vec::new() }];
+    // Tip commit of each live branch; lane 0 is the main branch.
+    let mut tips: Vec<usize> = vec![0];
+
+    for i in 1..n {
+        let roll = rng.below(100);
+        if roll < 12 && tips.len() < max_lanes {
+            let from = tips[rng.below(tips.len() as u64) as usize];
+            commits.push(SynthCommit { parents: vec![from] });
+            tips.push(i);
+        } else if roll < 28 && tips.len() > 1 {
+            let from = 1 + rng.below(tips.len() as u64 - 1) as usize;
+            let into = if rng.below(3) == 0 { rng.below(from as u64) as usize } else { 0 };
+            commits.push(SynthCommit { parents: vec![tips[into], tips[from]] });
+            tips[into] = i;
+            tips.remove(from);
+        } else {
+            let lane = rng.below(tips.len() as u64) as usize;
+            commits.push(SynthCommit { parents: vec![tips[lane]] });
+            tips[lane] = i;
+        }
+    }
+    (commits, tips[0])
+}
+
+pub fn commit_hash(index: usize) -> String {
+    format!("{:040x}", (index as u64 + 1).wrapping_mul(0x9E37_79B9_7F4A_7C15))
+}
+
+/// Layout input for a history, newest first (a valid topological order).
+pub fn layout_inputs(commits: &[SynthCommit]) -> Vec<LayoutInput> {
+    (0..commits.len())
+        .rev()
+        .map(|i| {
+            let hash = commit_hash(i);
+            LayoutInput {
+                short_hash: hash[..7].to_string(),
+                parents: commits[i].parents.iter().map(|&p| commit_hash(p)).collect::<Vec<_>>().join(" "),
+                refs: String::new(),
+                message: format!("Change {} in module {}", i, i % 37),
+                author: format!("dev{}", i % 23),
+                date_timestamp: 1_700_000_000 + i as i64 * 60,
+                hash,
+            }
+        })
+        .collect()
+}
+
+/// Hashes on the first-parent chain from `tip`.
+pub fn main_chain(commits: &[SynthCommit], tip: usize) -> std::collections::HashSet<String> {
+    let mut chain = std::collections::HashSet::new();
+    let mut at = Some(tip);
+    while let Some(i) = at {
+        chain.insert(commit_hash(i));
+        at = commits[i].parents.first().copied();
+    }
+    chain
+}
+
+/// Build a repository holding `commits` with `git fast-import`; returns its
+/// path. Trees are empty, so only history shape costs anything.
+pub fn git_repo(name: &str, commits: &[SynthCommit], main_tip: usize) -> PathBuf {
+    use std::io::Write;
+    use std::process::{Command, Stdio};
+
+    let root = bench_dir(name);
+    let _ = std::fs::remove_dir_all(&root);
+    std::fs::create_dir_all(&root).unwrap();
+    let status = Command::new("git").args(["init", "-q"]).current_dir(&root).status().expect("run git init");
+    assert!(status.success(), "git init failed");
+
+    let mut import = Command::new("git")
+        .args(["fast-import", "--quiet"])
+        .current_dir(&root)
+        .stdin(Stdio::piped())
+        .spawn()
+        .expect("run git fast-import");
+    let mut stream = std::io::BufWriter::new(import.stdin.take().unwrap());
+    for (i, commit) in commits.iter().enumerate() {
+        let message = format!("Change {} in module {}", i, i % 37);
+        writeln!(stream, "commit refs/heads/import\nmark :{}", i + 1).unwrap();
+        writeln!(stream, "committer dev{} <dev{}@example.com> {} +0000", i % 23, i % 23, 1_700_000_000 + i * 60).unwrap();
+        writeln!(stream, "data {}\n{}", message.len(), message).unwrap();
+        match commit.parents.as_slice() {
+            [] => {}
+            [first, rest @ ..] => {
+                writeln!(stream, "from :{}", first + 1).unwrap();
+                for parent in rest {
+                    writeln!(stream, "merge :{}", parent + 1).unwrap();
+                }
+            }
+        }
+        writeln!(stream).unwrap();
+    }
+    writeln!(stream, "reset refs/heads/main\nfrom :{}\n", main_tip + 1).unwrap();
+    drop(stream);
+    assert!(import.wait().unwrap().success(), "git fast-import failed");
+    let status = Command::new("git")
+        .args(["symbolic-ref", "HEAD", "refs/heads/main"])
+        .current_dir(&root)
+        .status()
+        .unwrap();
+    assert!(status.success());
+    root
+}
+
+// ═══════════════════════════════════════════════════════════
+// File trees
+// ═══════════════════════════════════════════════════════════
+
+/// Fresh scratch directory for one bench input.
+pub fn bench_dir(name: &str) -> PathBuf {
+    std::env::temp_dir().join(format!("pier-bench-{}-{}", name, std::process::id()))
+}
+
+/// A source-tree-like layout: `dirs` top-level directories, each with
+/// `dirs` subdirectories of `files` files. Returns the root.
+pub fn file_tree(name: &str, dirs: usize, files: usize) -> PathBuf {
+    let root = bench_dir(name);
+    let _ = std::fs::remove_dir_all(&root);
+    let extensions = ["rs", "swift", "md", "json", "txt"];
+    for d in 0..dirs {
+        for s in 0..dirs {
+            let dir = root.join(format!("module_{}", d)).join(format!("part_{}", s));
+            std::fs::create_dir_all(&dir).unwrap();
+            for f in 0..files {
+                let file = dir.join(format!("file_{}_{}.{}", s, f, extensions[f % extensions.len()]));
+                std::fs::write(file, b"x").unwrap();
+            }
+        }
+    }
+    root
+}
+
+/// One directory holding `entries` files and a few subdirectories.
+pub fn flat_dir(name: &str, entries: usize) -> PathBuf {
+    let root = bench_dir(name);
+    let _ = std::fs::remove_dir_all(&root);
+    std::fs::create_dir_all(&root).unwrap();
+    for i in 0..entries {
+        if i % 50 == 0 {
+            std::fs::create_dir(root.join(format!("Dir{:05}", i))).unwrap();
+        } else {
+            std::fs::write(root.join(format!("entry_{:05}.log", i)), b"").unwrap();
+        }
+    }
+    root
+}
+
+pub fn remove(path: &Path) {
+    let _ = std::fs::remove_dir_all(path);
+}
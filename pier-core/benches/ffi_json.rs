@@ -0,0 +1,77 @@
+//! JSON encoding and decoding of the payloads that cross the FFI, at the
+//! sizes the Swift side asks for.
+//!
+//!     cargo bench --bench ffi_json
+
+mod common;
+
+use std::hint::black_box;
+
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+
+use pier_core::git_graph::{self, CommitEntry, LayoutInput, LayoutParams};
+use pier_core::search::SearchResult;
+
+fn commit_page(n: usize) -> Vec<CommitEntry> {
+    let (history, _) = common::synthetic_history(n, 16, 3);
+    common::layout_inputs(&history)
+        .into_iter()
+        .map(|c| CommitEntry {
+            hash: c.hash,
+            parents: c.parents,
+            short_hash: c.short_hash,
+            refs: c.refs,
+            message: c.message,
+            author: c.author,
+            date_timestamp: c.date_timestamp,
+        })
+        .collect()
+}
+
+fn search_hits(n: usize) -> Vec<SearchResult> {
+    (0..n)
+        .map(|i| SearchResult {
+            path: format!("/Users/dev/src/project/module_{}/part_{}/file_{}.rs", i % 40, i % 13, i),
+            name: format!("file_{}.rs", i),
+            is_dir: i % 17 == 0,
+            size: (i * 131) as u64,
+        })
+        .collect()
+}
+
+fn ffi_json(c: &mut Criterion) {
+    let mut group = c.benchmark_group("ffi_json");
+
+    // pier_git_graph_log: one page out, then back in for the layout call.
+    let page = commit_page(500);
+    let page_json = serde_json::to_string(&page).unwrap();
+    group.throughput(Throughput::Bytes(page_json.len() as u64));
+    group.bench_function("graph_log_encode", |b| b.iter(|| black_box(serde_json::to_string(&page).unwrap())));
+    group.bench_function("layout_input_decode", |b| {
+        b.iter(|| black_box(serde_json::from_str::<Vec<LayoutInput>>(&page_json).unwrap()))
+    });
+
+    // pier_git_compute_graph_layout's result.
+    let (history, main_tip) = common::synthetic_history(2_000, 16, 5);
+    let params = LayoutParams { lane_width: 14.0, row_height: 24.0, show_long_edges: false };
+    let rows = git_graph::compute_graph_layout(
+        &common::layout_inputs(&history),
+        &common::main_chain(&history, main_tip),
+        &params,
+    );
+    group.throughput(Throughput::Bytes(serde_json::to_string(&rows).unwrap().len() as u64));
+    group.bench_function("graph_rows_encode", |b| b.iter(|| black_box(serde_json::to_string(&rows).unwrap())));
+
+    // Search and listing results.
+    let hits = search_hits(2_000);
+    let hits_json = serde_json::to_string(&hits).unwrap();
+    group.throughput(Throughput::Bytes(hits_json.len() as u64));
+    group.bench_function("search_results_encode", |b| b.iter(|| black_box(serde_json::to_string(&hits).unwrap())));
+    group.bench_function("search_results_decode", |b| {
+        b.iter(|| black_box(serde_json::from_str::<Vec<SearchResult>>(&hits_json).unwrap()))
+    });
+    group.finish();
+}
+
+criterion_group!(benches, ffi_json);
+criterion_main!(benches);
@@ -0,0 +1,82 @@
+//! Commit graph: layout of large, merge-heavy histories, and `graph_log`
+//! pages at increasing depth.
+//!
+//!     cargo bench --bench git_graph
+
+mod common;
+
+use std::hint::black_box;
+
+use criterion::{criterion_group, criterion_main, BatchSize, BenchmarkId, Criterion, Throughput};
+
+use pier_core::git_graph::{self, GraphFilter, LayoutParams};
+
+const PARAMS: LayoutParams = LayoutParams { lane_width: 14.0, row_height: 24.0, show_long_edges: false };
+
+fn all_branches() -> GraphFilter {
+    GraphFilter {
+        branch: None,
+        author: None,
+        search_text: None,
+        after_timestamp: 0,
+        topo_order: true,
+        first_parent_only: false,
+        no_merges: false,
+        paths: Vec::new(),
+    }
+}
+
+fn compute_graph_layout(c: &mut Criterion) {
+    let mut group = c.benchmark_group("compute_graph_layout");
+    group.sample_size(10);
+    for n in [10_000, 100_000] {
+        let (history, main_tip) = common::synthetic_history(n, 24, 7);
+        let inputs = common::layout_inputs(&history);
+        let main_chain = common::main_chain(&history, main_tip);
+        group.throughput(Throughput::Elements(n as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(n), &inputs, |b, inputs| {
+            b.iter(|| black_box(git_graph::compute_graph_layout(inputs, &main_chain, &PARAMS)));
+        });
+    }
+    group.finish();
+}
+
+fn graph_log_paging(c: &mut Criterion) {
+    const COMMITS: usize = 50_000;
+    const PAGE: usize = 200;
+
+    let (history, main_tip) = common::synthetic_history(COMMITS, 24, 11);
+    let repo = common::git_repo("graph-log", &history, main_tip);
+    let repo_path = repo.to_str().unwrap().to_string();
+    let filter = all_branches();
+
+    let mut group = c.benchmark_group("graph_log");
+    // Pages served from the warm commit index.
+    for skip in [0, 1_000, 10_000, 45_000] {
+        git_graph::graph_log(&repo_path, PAGE, skip, &filter).unwrap();
+        group.bench_with_input(BenchmarkId::new("page", skip), &skip, |b, &skip| {
+            b.iter(|| black_box(git_graph::graph_log(&repo_path, PAGE, skip, &filter).unwrap()));
+        });
+    }
+
+    // First page after a ref moved, which rebuilds the index.
+    group.sample_size(10);
+    let repository = git2::Repository::open(&repo).unwrap();
+    let head = repository.head().unwrap().target().unwrap();
+    let mut moves = 0u64;
+    group.bench_function("first_page_after_ref_move", |b| {
+        b.iter_batched(
+            || {
+                moves += 1;
+                repository.reference(&format!("refs/bench/{}", moves), head, true, "bench").unwrap();
+            },
+            |_| black_box(git_graph::graph_log(&repo_path, PAGE, 0, &filter).unwrap()),
+            BatchSize::PerIteration,
+        );
+    });
+    group.finish();
+    common::remove(&repo);
+}
+
+criterion_group!(benches, compute_graph_layout, graph_log_paging);
+criterion_main!(benches);
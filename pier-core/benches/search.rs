@@ -0,0 +1,42 @@
+//! File search and directory listing on large trees.
+//!
+//!     cargo bench --bench search
+
+mod common;
+
+use std::hint::black_box;
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+use pier_core::search;
+
+fn search_files(c: &mut Criterion) {
+    // 40 × 40 directories of 25 files: 40k files.
+    let root = common::file_tree("search", 40, 25);
+    let root_path = root.to_str().unwrap();
+
+    let mut group = c.benchmark_group("search_files");
+    group.sample_size(20);
+    for (name, pattern) in [("rare", "file_7_13.rs"), ("common", "file_1"), ("extension", ".swift")] {
+        group.bench_function(name, |b| b.iter(|| black_box(search::search_files(root_path, pattern, 500))));
+    }
+    group.finish();
+    common::remove(&root);
+}
+
+fn list_directory(c: &mut Criterion) {
+    let mut group = c.benchmark_group("list_directory");
+    for entries in [1_000, 50_000] {
+        let dir = common::flat_dir(&format!("listing-{}", entries), entries);
+        let dir_path = dir.to_str().unwrap().to_string();
+        group.throughput(Throughput::Elements(entries as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(entries), &dir_path, |b, path| {
+            b.iter(|| black_box(search::list_directory(path).unwrap()));
+        });
+        common::remove(&dir);
+    }
+    group.finish();
+}
+
+criterion_group!(benches, search_files, list_directory);
+criterion_main!(benches);
@@ -0,0 +1,36 @@
+//! VT parser throughput.
+//!
+//! Replays each capture of the corpus (see `common::vt_corpus`) through
+//! `VtEmulator::process` in PTY-sized chunks; criterion reports MB/s. Add
+//! recorded sessions with `script -q capture.log` and `PIER_VT_CAPTURE`
+//! (a file or a directory):
+//!
+//!     PIER_VT_CAPTURE=captures/ cargo bench --bench vt_throughput
+
+mod common;
+
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+
+use pier_core::terminal::emulator::VtEmulator;
+
+/// PTY reads are delivered in chunks of this size.
+const CHUNK: usize = 64 * 1024;
+
+fn vt_process(c: &mut Criterion) {
+    let mut group = c.benchmark_group("vt_process");
+    for (name, capture) in common::vt_corpus() {
+        group.throughput(Throughput::Bytes(capture.len() as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(&name), &capture, |b, capture| {
+            let mut emulator = VtEmulator::new(120, 40);
+            b.iter(|| {
+                for chunk in capture.chunks(CHUNK) {
+                    emulator.process(chunk);
+                }
+            });
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, vt_process);
+criterion_main!(benches);
@@ -1,53 +1,106 @@
-/// Crypto utilities for secure credential handling.
-/// In practice, macOS Keychain is used via Swift for most credential storage.
-/// This module provides additional encryption helpers.
+//! Crypto utilities for secure credential handling.
+//! In practice, macOS Keychain is used via Swift for most credential storage.
+//! This module provides additional encryption helpers: one-shot AES-256-GCM
+//! messages through a reusable [`Cipher`], and the chunked file format in
+//! [`stream`] for payloads too large to hold in memory.
+
+pub mod stream;
 
 use ring::aead;
 use ring::rand::{SecureRandom, SystemRandom};
 
-/// Encrypt data using AES-256-GCM.
-pub fn encrypt(key: &[u8; 32], plaintext: &[u8]) -> Result<Vec<u8>, anyhow::Error> {
-    let rng = SystemRandom::new();
-    let unbound_key = aead::UnboundKey::new(&aead::AES_256_GCM, key)
-        .map_err(|_| anyhow::anyhow!("Invalid key"))?;
-    let sealing_key = aead::LessSafeKey::new(unbound_key);
-
-    let mut nonce_bytes = [0u8; 12];
-    rng.fill(&mut nonce_bytes)
-        .map_err(|_| anyhow::anyhow!("RNG failed"))?;
-    let nonce = aead::Nonce::assume_unique_for_key(nonce_bytes);
-
-    let mut in_out = plaintext.to_vec();
-    sealing_key
-        .seal_in_place_append_tag(nonce, aead::Aad::empty(), &mut in_out)
-        .map_err(|_| anyhow::anyhow!("Encryption failed"))?;
-
-    // Prepend nonce to ciphertext
-    let mut result = nonce_bytes.to_vec();
-    result.extend(in_out);
-    Ok(result)
+/// Nonce bytes at the front of a sealed message.
+pub const NONCE_LEN: usize = aead::NONCE_LEN;
+
+/// Authentication tag bytes at the end of a sealed message (or chunk).
+pub const TAG_LEN: usize = 16;
+
+/// Bytes a sealed message adds to its plaintext.
+pub const OVERHEAD: usize = NONCE_LEN + TAG_LEN;
+
+/// An AES-256-GCM key expanded once, for any number of messages. Messages
+/// are `nonce || ciphertext || tag` with a random nonce, the same format as
+/// [`encrypt`]. Shareable across threads.
+pub struct Cipher {
+    key: aead::LessSafeKey,
+    rng: SystemRandom,
 }
 
-/// Decrypt AES-256-GCM encrypted data.
-pub fn decrypt(key: &[u8; 32], ciphertext: &[u8]) -> Result<Vec<u8>, anyhow::Error> {
-    if ciphertext.len() < 12 {
-        return Err(anyhow::anyhow!("Ciphertext too short"));
+impl Cipher {
+    pub fn new(key: &[u8; 32]) -> Result<Self, anyhow::Error> {
+        let unbound_key = aead::UnboundKey::new(&aead::AES_256_GCM, key)
+            .map_err(|_| anyhow::anyhow!("Invalid key"))?;
+        Ok(Self {
+            key: aead::LessSafeKey::new(unbound_key),
+            rng: SystemRandom::new(),
+        })
     }
 
-    let (nonce_bytes, encrypted) = ciphertext.split_at(12);
-    let nonce_bytes: [u8; 12] = nonce_bytes.try_into()?;
-    let nonce = aead::Nonce::assume_unique_for_key(nonce_bytes);
+    /// Seal `plaintext` into `out`, which needs `plaintext.len() + OVERHEAD`
+    /// bytes. Returns the sealed length.
+    pub fn seal_into(&self, plaintext: &[u8], out: &mut [u8]) -> Result<usize, anyhow::Error> {
+        let sealed_len = sealed_len(plaintext.len(), out.len())?;
+        out[NONCE_LEN..NONCE_LEN + plaintext.len()].copy_from_slice(plaintext);
+        self.seal_shifted(&mut out[..sealed_len])
+    }
 
-    let unbound_key = aead::UnboundKey::new(&aead::AES_256_GCM, key)
-        .map_err(|_| anyhow::anyhow!("Invalid key"))?;
-    let opening_key = aead::LessSafeKey::new(unbound_key);
+    /// Seal the plaintext in `buf[..len]` where it is. `buf` needs
+    /// `len + OVERHEAD` bytes. Returns the sealed length.
+    pub fn seal_in_place(&self, buf: &mut [u8], len: usize) -> Result<usize, anyhow::Error> {
+        let sealed_len = sealed_len(len, buf.len())?;
+        buf.copy_within(..len, NONCE_LEN);
+        self.seal_shifted(&mut buf[..sealed_len])
+    }
 
-    let mut in_out = encrypted.to_vec();
-    let plaintext = opening_key
-        .open_in_place(nonce, aead::Aad::empty(), &mut in_out)
-        .map_err(|_| anyhow::anyhow!("Decryption failed"))?;
+    /// Seal a message whose plaintext already sits after the nonce slot.
+    fn seal_shifted(&self, message: &mut [u8]) -> Result<usize, anyhow::Error> {
+        let mut nonce_bytes = [0u8; NONCE_LEN];
+        self.rng.fill(&mut nonce_bytes)
+            .map_err(|_| anyhow::anyhow!("RNG failed"))?;
+        let (nonce_slot, rest) = message.split_at_mut(NONCE_LEN);
+        let (in_out, tag_slot) = rest.split_at_mut(rest.len() - TAG_LEN);
+        let tag = self.key
+            .seal_in_place_separate_tag(aead::Nonce::assume_unique_for_key(nonce_bytes), aead::Aad::empty(), in_out)
+            .map_err(|_| anyhow::anyhow!("Encryption failed"))?;
+        nonce_slot.copy_from_slice(&nonce_bytes);
+        tag_slot.copy_from_slice(tag.as_ref());
+        Ok(message.len())
+    }
+
+    /// Open the sealed message that fills `buf`, leaving the plaintext at
+    /// the front. Returns the plaintext length.
+    pub fn open_in_place(&self, buf: &mut [u8]) -> Result<usize, anyhow::Error> {
+        if buf.len() < OVERHEAD {
+            return Err(anyhow::anyhow!("Ciphertext too short"));
+        }
+        let nonce_bytes: [u8; NONCE_LEN] = buf[..NONCE_LEN].try_into()?;
+        let plaintext = self.key
+            .open_within(aead::Nonce::assume_unique_for_key(nonce_bytes), aead::Aad::empty(), buf, NONCE_LEN..)
+            .map_err(|_| anyhow::anyhow!("Decryption failed"))?;
+        Ok(plaintext.len())
+    }
+}
 
-    Ok(plaintext.to_vec())
+fn sealed_len(plaintext_len: usize, capacity: usize) -> Result<usize, anyhow::Error> {
+    plaintext_len
+        .checked_add(OVERHEAD)
+        .filter(|&len| len <= capacity)
+        .ok_or_else(|| anyhow::anyhow!("Output buffer too small"))
+}
+
+/// Encrypt data using AES-256-GCM.
+pub fn encrypt(key: &[u8; 32], plaintext: &[u8]) -> Result<Vec<u8>, anyhow::Error> {
+    let mut sealed = vec![0u8; plaintext.len() + OVERHEAD];
+    Cipher::new(key)?.seal_into(plaintext, &mut sealed)?;
+    Ok(sealed)
+}
+
+/// Decrypt AES-256-GCM encrypted data.
+pub fn decrypt(key: &[u8; 32], ciphertext: &[u8]) -> Result<Vec<u8>, anyhow::Error> {
+    let mut buf = ciphertext.to_vec();
+    let len = Cipher::new(key)?.open_in_place(&mut buf)?;
+    buf.truncate(len);
+    Ok(buf)
 }
 
 #[cfg(test)]
@@ -72,4 +125,21 @@ mod tests {
         let result = decrypt(&key, b"short");
         assert!(result.is_err());
     }
+
+    #[test]
+    fn test_cipher_in_place() {
+        let cipher = Cipher::new(&[7u8; 32]).unwrap();
+        let plaintext = b"saved query history";
+        let mut buf = [0u8; 64];
+        buf[..plaintext.len()].copy_from_slice(plaintext);
+
+        let sealed = cipher.seal_in_place(&mut buf, plaintext.len()).unwrap();
+        assert_eq!(sealed, plaintext.len() + OVERHEAD);
+        // Same format as the one-shot helpers.
+        assert_eq!(decrypt(&[7u8; 32], &buf[..sealed]).unwrap(), plaintext);
+
+        let opened = cipher.open_in_place(&mut buf[..sealed]).unwrap();
+        assert_eq!(&buf[..opened], plaintext);
+        assert!(cipher.seal_in_place(&mut buf[..40], plaintext.len()).is_err());
+    }
 }
@@ -0,0 +1,348 @@
+//! Chunked AES-256-GCM for payloads too large to hold in memory.
+//!
+//! An encrypted stream is a 16-byte header followed by chunks:
+//!
+//! ```text
+//! header = "PIER" 0x01 | chunk size (u32 LE) | nonce prefix (7 random bytes)
+//! chunk  = ciphertext | tag (16)
+//! ```
+//!
+//! Every chunk holds exactly `chunk size` bytes of plaintext except the
+//! last, which holds fewer (possibly none), so the chunk boundaries follow
+//! from the length alone. A chunk's nonce is the prefix, its index (u32 BE)
+//! and a final flag, and the header is authenticated with each chunk: chunks
+//! can't be reordered, dropped, truncated away or moved between streams
+//! without failing to open. Because a chunk needs nothing from its
+//! neighbours, files are sealed and opened in parallel, one buffer per
+//! worker.
+
+use std::fs::File;
+use std::io::{Read, Write};
+use std::os::unix::fs::FileExt;
+use std::path::Path;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Mutex;
+
+use ring::aead;
+use ring::rand::SecureRandom;
+
+use super::{Cipher, TAG_LEN};
+
+const MAGIC: &[u8; 5] = b"PIER\x01";
+
+const PREFIX_LEN: usize = 7;
+
+pub const HEADER_LEN: usize = MAGIC.len() + 4 + PREFIX_LEN;
+
+/// Plaintext bytes per chunk unless the caller picks another size.
+pub const DEFAULT_CHUNK_SIZE: usize = 64 * 1024;
+
+/// Largest chunk a stream may declare, so a corrupt header can't make
+/// the reader allocate gigabytes.
+pub const MAX_CHUNK_SIZE: usize = 16 * 1024 * 1024;
+
+/// One stream's header and the nonces derived from it.
+struct Layout {
+    header: [u8; HEADER_LEN],
+    chunk_size: usize,
+}
+
+impl Layout {
+    fn new(cipher: &Cipher, chunk_size: usize) -> Result<Self, anyhow::Error> {
+        if chunk_size == 0 || chunk_size > MAX_CHUNK_SIZE {
+            return Err(anyhow::anyhow!("Chunk size must be 1..={} bytes", MAX_CHUNK_SIZE));
+        }
+        let mut header = [0u8; HEADER_LEN];
+        header[..MAGIC.len()].copy_from_slice(MAGIC);
+        header[MAGIC.len()..MAGIC.len() + 4].copy_from_slice(&(chunk_size as u32).to_le_bytes());
+        cipher.rng.fill(&mut header[MAGIC.len() + 4..])
+            .map_err(|_| anyhow::anyhow!("RNG failed"))?;
+        Ok(Self { header, chunk_size })
+    }
+
+    fn parse(header: [u8; HEADER_LEN]) -> Result<Self, anyhow::Error> {
+        if &header[..MAGIC.len()] != MAGIC {
+            return Err(anyhow::anyhow!("Not an encrypted stream"));
+        }
+        let chunk_size = u32::from_le_bytes(header[MAGIC.len()..MAGIC.len() + 4].try_into()?) as usize;
+        if chunk_size == 0 || chunk_size > MAX_CHUNK_SIZE {
+            return Err(anyhow::anyhow!("Invalid chunk size {}", chunk_size));
+        }
+        Ok(Self { header, chunk_size })
+    }
+
+    fn nonce(&self, index: u64, last: bool) -> Result<aead::Nonce, anyhow::Error> {
+        let index = u32::try_from(index).map_err(|_| anyhow::anyhow!("Stream too long"))?;
+        let mut nonce = [0u8; aead::NONCE_LEN];
+        nonce[..PREFIX_LEN].copy_from_slice(&self.header[MAGIC.len() + 4..]);
+        nonce[PREFIX_LEN..PREFIX_LEN + 4].copy_from_slice(&index.to_be_bytes());
+        nonce[PREFIX_LEN + 4] = last as u8;
+        Ok(aead::Nonce::assume_unique_for_key(nonce))
+    }
+
+    /// Bytes from one chunk's start to the next's.
+    fn stride(&self) -> u64 {
+        (self.chunk_size + TAG_LEN) as u64
+    }
+
+    /// Seal the `len` plaintext bytes at the front of `buf` (which has room
+    /// for the tag). Returns the chunk length.
+    fn seal(&self, cipher: &Cipher, index: u64, last: bool, buf: &mut [u8], len: usize) -> Result<usize, anyhow::Error> {
+        let tag = cipher.key
+            .seal_in_place_separate_tag(self.nonce(index, last)?, aead::Aad::from(&self.header), &mut buf[..len])
+            .map_err(|_| anyhow::anyhow!("Encryption failed"))?;
+        buf[len..len + TAG_LEN].copy_from_slice(tag.as_ref());
+        Ok(len + TAG_LEN)
+    }
+
+    /// Open the chunk that fills `chunk` in place. Returns the plaintext length.
+    fn open(&self, cipher: &Cipher, index: u64, last: bool, chunk: &mut [u8]) -> Result<usize, anyhow::Error> {
+        if chunk.len() < TAG_LEN {
+            return Err(anyhow::anyhow!("Encrypted stream is truncated"));
+        }
+        let plaintext = cipher.key
+            .open_in_place(self.nonce(index, last)?, aead::Aad::from(&self.header), chunk)
+            .map_err(|_| anyhow::anyhow!("Decryption failed at chunk {}", index))?;
+        Ok(plaintext.len())
+    }
+}
+
+/// Encrypt everything `reader` yields into `writer`, in constant memory.
+/// Returns the plaintext length.
+pub fn encrypt_stream<R: Read, W: Write>(
+    cipher: &Cipher,
+    mut reader: R,
+    mut writer: W,
+    chunk_size: usize,
+) -> Result<u64, anyhow::Error> {
+    let layout = Layout::new(cipher, chunk_size)?;
+    writer.write_all(&layout.header)?;
+
+    let mut buf = vec![0u8; chunk_size + TAG_LEN];
+    let mut total = 0u64;
+    for index in 0.. {
+        let len = read_full(&mut reader, &mut buf[..chunk_size])?;
+        let last = len < chunk_size;
+        let sealed = layout.seal(cipher, index, last, &mut buf, len)?;
+        writer.write_all(&buf[..sealed])?;
+        total += len as u64;
+        if last {
+            break;
+        }
+    }
+    writer.flush()?;
+    Ok(total)
+}
+
+/// Decrypt a stream from `reader` into `writer`, in constant memory.
+/// Plaintext is written as each chunk verifies, so on error `writer` may
+/// already hold a verified prefix. Returns the plaintext length.
+pub fn decrypt_stream<R: Read, W: Write>(
+    cipher: &Cipher,
+    mut reader: R,
+    mut writer: W,
+) -> Result<u64, anyhow::Error> {
+    let mut header = [0u8; HEADER_LEN];
+    reader.read_exact(&mut header)
+        .map_err(|_| anyhow::anyhow!("Not an encrypted stream"))?;
+    let layout = Layout::parse(header)?;
+
+    let mut buf = vec![0u8; layout.chunk_size + TAG_LEN];
+    let mut total = 0u64;
+    for index in 0.. {
+        let len = read_full(&mut reader, &mut buf)?;
+        // Only the final chunk is short.
+        let last = len < buf.len();
+        let plain = layout.open(cipher, index, last, &mut buf[..len])?;
+        writer.write_all(&buf[..plain])?;
+        total += plain as u64;
+        if last {
+            break;
+        }
+    }
+    writer.flush()?;
+    Ok(total)
+}
+
+/// Encrypt the file at `src` into `dst`, sealing chunks on every core.
+/// Returns the plaintext length. `dst` is removed on failure.
+pub fn encrypt_file(cipher: &Cipher, src: &Path, dst: &Path, chunk_size: usize) -> Result<u64, anyhow::Error> {
+    let layout = Layout::new(cipher, chunk_size)?;
+    let input = File::open(src)?;
+    let len = input.metadata()?.len();
+    let chunk = chunk_size as u64;
+    let chunks = len / chunk + 1;
+
+    let output = File::create(dst)?;
+    let result = (|| {
+        output.set_len(HEADER_LEN as u64 + len + chunks * TAG_LEN as u64)?;
+        output.write_all_at(&layout.header, 0)?;
+        for_each_chunk(chunks, layout.chunk_size + TAG_LEN, |index, buf| {
+            let offset = index * chunk;
+            let n = chunk.min(len - offset) as usize;
+            input.read_exact_at(&mut buf[..n], offset)?;
+            let sealed = layout.seal(cipher, index, index == chunks - 1, buf, n)?;
+            output.write_all_at(&buf[..sealed], HEADER_LEN as u64 + index * layout.stride())?;
+            Ok(())
+        })
+    })();
+    finish(result.map(|_| len), dst)
+}
+
+/// Decrypt the file at `src` into `dst`, opening chunks on every core.
+/// Returns the plaintext length. `dst` is removed on failure, so it never
+/// holds unverified plaintext.
+pub fn decrypt_file(cipher: &Cipher, src: &Path, dst: &Path) -> Result<u64, anyhow::Error> {
+    let input = File::open(src)?;
+    let mut header = [0u8; HEADER_LEN];
+    input.read_exact_at(&mut header, 0)
+        .map_err(|_| anyhow::anyhow!("Not an encrypted stream"))?;
+    let layout = Layout::parse(header)?;
+
+    let body = input.metadata()?.len() - HEADER_LEN as u64;
+    let stride = layout.stride();
+    let last_len = body % stride;
+    if last_len < TAG_LEN as u64 {
+        return Err(anyhow::anyhow!("Encrypted stream is truncated"));
+    }
+    let chunks = body / stride + 1;
+    let len = (chunks - 1) * layout.chunk_size as u64 + last_len - TAG_LEN as u64;
+
+    let output = File::create(dst)?;
+    let result = (|| {
+        output.set_len(len)?;
+        for_each_chunk(chunks, stride as usize, |index, buf| {
+            let last = index == chunks - 1;
+            let n = if last { last_len } else { stride } as usize;
+            input.read_exact_at(&mut buf[..n], HEADER_LEN as u64 + index * stride)?;
+            let plain = layout.open(cipher, index, last, &mut buf[..n])?;
+            output.write_all_at(&buf[..plain], index * layout.chunk_size as u64)?;
+            Ok(())
+        })
+    })();
+    finish(result.map(|_| len), dst)
+}
+
+fn finish(result: Result<u64, anyhow::Error>, dst: &Path) -> Result<u64, anyhow::Error> {
+    if result.is_err() {
+        let _ = std::fs::remove_file(dst);
+    }
+    result
+}
+
+/// Run `work` for chunks `0..chunks` on up to one thread per core, each
+/// with its own `buf_len` buffer. Stops at the first error.
+fn for_each_chunk<F>(chunks: u64, buf_len: usize, work: F) -> Result<(), anyhow::Error>
+where
+    F: Fn(u64, &mut [u8]) -> Result<(), anyhow::Error> + Sync,
+{
+    let cores = std::thread::available_parallelism().map_or(4, |n| n.get());
+    let threads = (cores as u64).min(chunks).max(1) as usize;
+    let next = AtomicU64::new(0);
+    let failed = AtomicBool::new(false);
+    let error = Mutex::new(None);
+    let worker = || {
+        let mut buf = vec![0u8; buf_len];
+        while !failed.load(Ordering::Relaxed) {
+            let index = next.fetch_add(1, Ordering::Relaxed);
+            if index >= chunks {
+                break;
+            }
+            if let Err(e) = work(index, &mut buf) {
+                failed.store(true, Ordering::Relaxed);
+                error.lock().unwrap().get_or_insert(e);
+            }
+        }
+    };
+
+    if threads == 1 {
+        worker();
+    } else {
+        std::thread::scope(|scope| {
+            for _ in 0..threads {
+                scope.spawn(&worker);
+            }
+        });
+    }
+    error.into_inner().unwrap().map_or(Ok(()), Err)
+}
+
+/// Fill `buf` unless the reader ends first. Returns the bytes read.
+fn read_full<R: Read>(reader: &mut R, buf: &mut [u8]) -> std::io::Result<usize> {
+    let mut filled = 0;
+    while filled < buf.len() {
+        match reader.read(&mut buf[filled..]) {
+            Ok(0) => break,
+            Ok(n) => filled += n,
+            Err(e) if e.kind() == std::io::ErrorKind::Interrupted => continue,
+            Err(e) => return Err(e),
+        }
+    }
+    Ok(filled)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn sample(len: usize) -> Vec<u8> {
+        (0..len).map(|i| (i * 31 % 251) as u8).collect()
+    }
+
+    #[test]
+    fn test_stream_roundtrip_and_tamper() {
+        let cipher = Cipher::new(&[9u8; 32]).unwrap();
+        // Empty, short, exactly two chunks (empty final chunk), and ragged.
+        for len in [0, 100, 2048, 5000] {
+            let plaintext = sample(len);
+            let mut sealed = Vec::new();
+            assert_eq!(encrypt_stream(&cipher, &plaintext[..], &mut sealed, 1024).unwrap(), len as u64);
+            assert_eq!(sealed.len(), HEADER_LEN + len + (len / 1024 + 1) * TAG_LEN);
+
+            let mut opened = Vec::new();
+            decrypt_stream(&cipher, &sealed[..], &mut opened).unwrap();
+            assert_eq!(opened, plaintext);
+        }
+
+        let mut sealed = Vec::new();
+        encrypt_stream(&cipher, &sample(3000)[..], &mut sealed, 1024).unwrap();
+        // Dropping the final chunk, or cutting at any chunk boundary, fails.
+        let stride = 1024 + TAG_LEN;
+        for cut in [HEADER_LEN + stride, HEADER_LEN + 2 * stride] {
+            assert!(decrypt_stream(&cipher, &sealed[..cut], &mut Vec::new()).is_err());
+        }
+        // So does swapping two chunks.
+        let mut swapped = sealed.clone();
+        let (first, second) = swapped[HEADER_LEN..].split_at_mut(stride);
+        first.swap_with_slice(&mut second[..stride]);
+        assert!(decrypt_stream(&cipher, &swapped[..], &mut Vec::new()).is_err());
+    }
+
+    #[test]
+    fn test_file_roundtrip_matches_stream() {
+        let dir = std::env::temp_dir().join(format!("pier-crypto-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let (plain, sealed, opened) = (dir.join("plain"), dir.join("sealed"), dir.join("opened"));
+        let data = sample(100_000);
+        std::fs::write(&plain, &data).unwrap();
+
+        let cipher = Cipher::new(&[3u8; 32]).unwrap();
+        assert_eq!(encrypt_file(&cipher, &plain, &sealed, 4096).unwrap(), data.len() as u64);
+        // Files written in parallel read back sequentially, and vice versa.
+        let mut streamed = Vec::new();
+        decrypt_stream(&cipher, File::open(&sealed).unwrap(), &mut streamed).unwrap();
+        assert_eq!(streamed, data);
+
+        encrypt_stream(&cipher, &data[..], File::create(&sealed).unwrap(), 4096).unwrap();
+        assert_eq!(decrypt_file(&cipher, &sealed, &opened).unwrap(), data.len() as u64);
+        assert_eq!(std::fs::read(&opened).unwrap(), data);
+
+        // A flipped bit fails the whole file and leaves no output behind.
+        let mut corrupt = std::fs::read(&sealed).unwrap();
+        corrupt[HEADER_LEN + 50_000] ^= 1;
+        std::fs::write(&sealed, &corrupt).unwrap();
+        assert!(decrypt_file(&cipher, &sealed, &opened).is_err());
+        assert!(!opened.exists());
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+}
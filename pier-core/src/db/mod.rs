@@ -0,0 +1,292 @@
+//! Database clients.
+//!
+//! Native MySQL, PostgreSQL and Redis protocol clients, replacing a CLI
+//! process (and a fresh login) per query. A `DbClient` holds one
+//! connection, usually through an SSH tunnel. A query returns its
+//! columns first; rows are then read from the socket a page at a time
+//! into a columnar `Page`. A large table is read only as far as it's
+//! viewed, and TCP flow control holds the rest back on the server.
+
+pub mod mysql;
+pub mod postgres;
+pub mod redis;
+
+use std::borrow::Cow;
+
+use serde::Serialize;
+use tokio::io::{AsyncRead, AsyncWrite, BufReader};
+
+/// Anything a client can run over: a TCP socket or an SSH channel.
+pub trait DbStream: AsyncRead + AsyncWrite + Unpin + Send {}
+impl<T: AsyncRead + AsyncWrite + Unpin + Send> DbStream for T {}
+
+/// Buffered connection I/O shared by the protocol modules.
+pub(crate) type Io = BufReader<Box<dyn DbStream>>;
+
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub enum DbKind {
+    Mysql,
+    Postgres,
+    Redis,
+}
+
+impl DbKind {
+    pub fn from_code(code: u8) -> Option<Self> {
+        match code {
+            0 => Some(DbKind::Mysql),
+            1 => Some(DbKind::Postgres),
+            2 => Some(DbKind::Redis),
+            _ => None,
+        }
+    }
+}
+
+/// Login details. `database` may be empty; for Redis it's the DB index.
+#[derive(Clone, Debug, Default)]
+pub struct ConnectOptions {
+    pub user: String,
+    pub password: String,
+    pub database: String,
+}
+
+#[derive(Clone, Debug, PartialEq, Serialize)]
+pub struct Column {
+    pub name: String,
+    /// Server type name ("INT", "varchar", ...).
+    pub type_name: String,
+}
+
+/// What a statement produced, known before any row is read.
+#[derive(Clone, Debug, PartialEq, Serialize)]
+pub struct QueryOutcome {
+    /// Empty for statements without a result set.
+    pub columns: Vec<Column>,
+    pub affected_rows: u64,
+    /// Command tag or server info ("INSERT 0 1", "Rows matched: 1 ...").
+    pub message: String,
+}
+
+/// One column of a page: cell bytes back to back, with NULLs marked.
+#[derive(Default)]
+pub struct ColumnData {
+    bytes: Vec<u8>,
+    /// End offset of each cell in `bytes`.
+    ends: Vec<usize>,
+    nulls: Vec<bool>,
+}
+
+/// A batch of rows stored by column, so a page costs a few allocations
+/// per column rather than one per cell.
+pub struct Page {
+    columns: Vec<ColumnData>,
+    rows: usize,
+}
+
+impl Page {
+    pub fn new(columns: usize) -> Self {
+        Self { columns: (0..columns).map(|_| ColumnData::default()).collect(), rows: 0 }
+    }
+
+    pub fn rows(&self) -> usize {
+        self.rows
+    }
+
+    pub fn column_count(&self) -> usize {
+        self.columns.len()
+    }
+
+    /// Append a row; missing trailing cells are NULL, extra ones dropped.
+    pub fn push_row<'a>(&mut self, cells: impl IntoIterator<Item = Option<&'a [u8]>>) {
+        let mut cells = cells.into_iter();
+        for column in &mut self.columns {
+            let cell = cells.next().flatten();
+            if let Some(bytes) = cell {
+                column.bytes.extend_from_slice(bytes);
+            }
+            column.ends.push(column.bytes.len());
+            column.nulls.push(cell.is_none());
+        }
+        self.rows += 1;
+    }
+
+    /// Cell bytes as sent, or None for NULL. Text is UTF-8; BLOB and
+    /// binary columns may be anything.
+    pub fn bytes(&self, column: usize, row: usize) -> Option<&[u8]> {
+        let data = &self.columns[column];
+        if data.nulls[row] {
+            return None;
+        }
+        let start = if row == 0 { 0 } else { data.ends[row - 1] };
+        Some(&data.bytes[start..data.ends[row]])
+    }
+
+    /// Cell text, or None for NULL. Invalid UTF-8 is replaced; use
+    /// `bytes` for binary columns.
+    pub fn value(&self, column: usize, row: usize) -> Option<Cow<'_, str>> {
+        self.bytes(column, row).map(String::from_utf8_lossy)
+    }
+
+    /// Total cell bytes, for sizing a caller's string storage.
+    pub fn byte_len(&self) -> usize {
+        self.columns.iter().map(|c| c.bytes.len()).sum()
+    }
+}
+
+enum Connection {
+    Mysql(mysql::MysqlConnection),
+    Postgres(postgres::PgConnection),
+    Redis(redis::RedisConnection),
+}
+
+/// A statement that failed while the connection stayed in step with the
+/// server: the server rejected it, or it was refused before being sent.
+/// Any other error (I/O, a malformed reply, a dropped future) may leave
+/// part of a reply unread, so the connection can't be used again.
+#[derive(Debug)]
+pub struct StatementError(pub String);
+
+impl std::fmt::Display for StatementError {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.write_str(&self.0)
+    }
+}
+
+impl std::error::Error for StatementError {}
+
+pub(crate) fn statement_error(message: String) -> anyhow::Error {
+    StatementError(message).into()
+}
+
+/// A logged-in database connection. One statement's rows are read at a
+/// time; starting a new query discards what's left of the previous one.
+/// A call that fails mid-reply (or is dropped, as on a timeout) leaves the
+/// client unusable; every later call then fails until it's reconnected.
+pub struct DbClient {
+    conn: Connection,
+    /// Set while a call is in flight and left set if it didn't finish
+    /// cleanly, e.g. it timed out and was dropped mid-packet.
+    broken: bool,
+}
+
+impl DbClient {
+    pub async fn connect(
+        kind: DbKind,
+        stream: Box<dyn DbStream>,
+        options: &ConnectOptions,
+    ) -> Result<Self, anyhow::Error> {
+        let io = BufReader::new(stream);
+        let conn = match kind {
+            DbKind::Mysql => Connection::Mysql(mysql::MysqlConnection::connect(io, options).await?),
+            DbKind::Postgres => Connection::Postgres(postgres::PgConnection::connect(io, options).await?),
+            DbKind::Redis => Connection::Redis(redis::RedisConnection::connect(io, options).await?),
+        };
+        Ok(Self { conn, broken: false })
+    }
+
+    /// Run `query` (a command line for Redis) and read its columns.
+    pub async fn query(&mut self, query: &str) -> Result<QueryOutcome, anyhow::Error> {
+        self.check_connected()?;
+        self.broken = true;
+        let result = match &mut self.conn {
+            Connection::Mysql(c) => c.query(query).await,
+            Connection::Postgres(c) => c.query(query).await,
+            Connection::Redis(c) => c.query(query).await,
+        };
+        self.broken = leaves_unread(&result);
+        result
+    }
+
+    /// Read up to `max_rows` more rows of the current result. A page with
+    /// fewer rows than asked for is the last one.
+    pub async fn fetch(&mut self, max_rows: usize) -> Result<Page, anyhow::Error> {
+        self.check_connected()?;
+        self.broken = true;
+        let result = match &mut self.conn {
+            Connection::Mysql(c) => c.fetch(max_rows).await,
+            Connection::Postgres(c) => c.fetch(max_rows).await,
+            Connection::Redis(c) => Ok(c.fetch(max_rows)),
+        };
+        self.broken = leaves_unread(&result);
+        result
+    }
+
+    /// False once a call failed in a way that leaves the protocol out of
+    /// step; every later call fails until the client reconnects.
+    pub fn is_connected(&self) -> bool {
+        !self.broken
+    }
+
+    fn check_connected(&self) -> Result<(), anyhow::Error> {
+        if self.broken {
+            return Err(anyhow::anyhow!("Connection lost, reconnect"));
+        }
+        Ok(())
+    }
+}
+
+fn leaves_unread<T>(result: &Result<T, anyhow::Error>) -> bool {
+    matches!(result, Err(e) if e.downcast_ref::<StatementError>().is_none())
+}
+
+/// Read a NUL-terminated string from the front of `buf`, advancing it.
+pub(crate) fn take_cstr<'a>(buf: &mut &'a [u8]) -> Result<&'a str, anyhow::Error> {
+    let end = buf.iter().position(|&b| b == 0).ok_or_else(|| anyhow::anyhow!("Unterminated string"))?;
+    let s = std::str::from_utf8(&buf[..end]).map_err(|_| anyhow::anyhow!("Invalid UTF-8 in reply"))?;
+    *buf = &buf[end + 1..];
+    Ok(s)
+}
+
+/// Split `n` bytes off the front of `buf`.
+pub(crate) fn take<'a>(buf: &mut &'a [u8], n: usize) -> Result<&'a [u8], anyhow::Error> {
+    if buf.len() < n {
+        return Err(anyhow::anyhow!("Truncated reply"));
+    }
+    let (head, rest) = buf.split_at(n);
+    *buf = rest;
+    Ok(head)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tokio::io::AsyncWriteExt;
+
+    #[test]
+    fn test_page_columnar_cells() {
+        let mut page = Page::new(2);
+        page.push_row([Some(&b"1"[..]), Some(&b"alice"[..])]);
+        page.push_row([Some(&b"2"[..]), None]);
+        page.push_row([Some(&b""[..])]);
+        page.push_row([Some(&b"\xff\x00"[..]), Some(&b"bob"[..])]);
+        assert_eq!(page.rows(), 4);
+        assert_eq!(page.value(1, 0).as_deref(), Some("alice"));
+        assert_eq!(page.value(1, 1), None);
+        assert_eq!(page.value(0, 2).as_deref(), Some(""));
+        assert_eq!(page.value(1, 2), None);
+        assert_eq!(page.bytes(0, 3), Some(&b"\xff\x00"[..]));
+        assert_eq!(page.value(0, 3).as_deref(), Some("\u{fffd}\0"));
+        assert_eq!(page.byte_len(), 12);
+    }
+
+    #[tokio::test]
+    async fn test_client_unusable_after_dropped_call() {
+        let (client, mut server) = tokio::io::duplex(64 * 1024);
+        server.write_all(b"-ERR unknown command 'NOPE'\r\n").await.unwrap();
+        let mut db = DbClient::connect(DbKind::Redis, Box::new(client), &ConnectOptions::default()).await.unwrap();
+
+        // Errors the server reported leave the connection usable.
+        assert!(db.query("NOPE").await.is_err());
+        assert!(db.query("GET \"open").await.is_err());
+        assert!(db.is_connected());
+
+        // A call abandoned mid-reply poisons it.
+        server.write_all(b"$10\r\nhal").await.unwrap();
+        let timed_out = tokio::time::timeout(std::time::Duration::from_millis(50), db.query("GET key")).await;
+        assert!(timed_out.is_err());
+        assert!(!db.is_connected());
+        server.write_all(b"f a value\r\n+OK\r\n").await.unwrap();
+        let err = db.query("PING").await.unwrap_err();
+        assert!(err.to_string().contains("reconnect"));
+        assert!(db.fetch(10).await.is_err());
+    }
+}
@@ -0,0 +1,512 @@
+//! MySQL client protocol (text protocol, protocol 4.1 handshake).
+//!
+//! Supports `mysql_native_password` and the `caching_sha2_password` fast
+//! path (the server already has the account's hash cached, the common case
+//! once anyone has logged in since the server started). Full
+//! `caching_sha2_password` authentication needs TLS or RSA and is reported
+//! as an error.
+
+use ring::digest;
+use tokio::io::{AsyncReadExt, AsyncWriteExt};
+
+use super::{statement_error, take, take_cstr, Column, ConnectOptions, Io, Page, QueryOutcome};
+
+const CLIENT_LONG_PASSWORD: u32 = 0x1;
+const CLIENT_CONNECT_WITH_DB: u32 = 0x8;
+const CLIENT_PROTOCOL_41: u32 = 0x200;
+const CLIENT_TRANSACTIONS: u32 = 0x2000;
+const CLIENT_SECURE_CONNECTION: u32 = 0x8000;
+const CLIENT_MULTI_RESULTS: u32 = 0x20000;
+const CLIENT_PLUGIN_AUTH: u32 = 0x80000;
+
+const SERVER_MORE_RESULTS_EXISTS: u16 = 0x8;
+
+/// utf8mb4_general_ci.
+const UTF8MB4: u8 = 45;
+
+const COM_QUERY: u8 = 0x03;
+
+/// Longest payload of a single packet; longer ones are split.
+const MAX_PAYLOAD: usize = 0xFF_FFFF;
+
+/// Rows read per step while skipping an abandoned result.
+const DISCARD_BATCH: usize = 1024;
+
+pub struct MysqlConnection {
+    io: Io,
+    seq: u8,
+    /// Columns of the result being read, or 0 when none is pending.
+    pending_columns: usize,
+}
+
+impl MysqlConnection {
+    pub async fn connect(io: Io, options: &ConnectOptions) -> Result<Self, anyhow::Error> {
+        let mut conn = Self { io, seq: 0, pending_columns: 0 };
+
+        let greeting = conn.read_packet().await?;
+        if greeting.first() == Some(&0xFF) {
+            return Err(server_error(&greeting));
+        }
+        let (scramble, plugin) = parse_handshake(&greeting)?;
+
+        let mut caps = CLIENT_LONG_PASSWORD
+            | CLIENT_PROTOCOL_41
+            | CLIENT_TRANSACTIONS
+            | CLIENT_SECURE_CONNECTION
+            | CLIENT_MULTI_RESULTS
+            | CLIENT_PLUGIN_AUTH;
+        if !options.database.is_empty() {
+            caps |= CLIENT_CONNECT_WITH_DB;
+        }
+        let auth = scramble_password(&plugin, options.password.as_bytes(), &scramble)?;
+
+        let mut response = Vec::with_capacity(64 + options.user.len() + auth.len());
+        response.extend_from_slice(&caps.to_le_bytes());
+        response.extend_from_slice(&(MAX_PAYLOAD as u32).to_le_bytes());
+        response.push(UTF8MB4);
+        response.extend_from_slice(&[0u8; 23]);
+        response.extend_from_slice(options.user.as_bytes());
+        response.push(0);
+        response.push(auth.len() as u8);
+        response.extend_from_slice(&auth);
+        if !options.database.is_empty() {
+            response.extend_from_slice(options.database.as_bytes());
+            response.push(0);
+        }
+        response.extend_from_slice(plugin.as_bytes());
+        response.push(0);
+        conn.write_packet(&response).await?;
+
+        conn.finish_auth(options.password.as_bytes()).await?;
+        Ok(conn)
+    }
+
+    /// Follow the server through plugin switches and extra rounds.
+    async fn finish_auth(&mut self, password: &[u8]) -> Result<(), anyhow::Error> {
+        loop {
+            let reply = self.read_packet().await?;
+            match reply.first() {
+                Some(0x00) => return Ok(()),
+                Some(0xFF) => return Err(server_error(&reply)),
+                // AuthSwitchRequest: redo the scramble with another plugin.
+                Some(0xFE) => {
+                    let mut rest = &reply[1..];
+                    let plugin = take_cstr(&mut rest)?;
+                    let scramble = rest.strip_suffix(&[0]).unwrap_or(rest);
+                    let auth = scramble_password(plugin, password, scramble)?;
+                    self.write_packet(&auth).await?;
+                }
+                // AuthMoreData from caching_sha2_password.
+                Some(0x01) => match reply.get(1) {
+                    // Fast auth succeeded; the OK packet follows.
+                    Some(3) => {}
+                    Some(4) => {
+                        return Err(anyhow::anyhow!(
+                            "MySQL requires full caching_sha2_password authentication, which needs TLS; \
+                             log in once with the mysql client or use mysql_native_password"
+                        ))
+                    }
+                    _ => return Err(anyhow::anyhow!("Unexpected MySQL auth data")),
+                },
+                _ => return Err(anyhow::anyhow!("Unexpected MySQL auth reply")),
+            }
+        }
+    }
+
+    pub async fn query(&mut self, sql: &str) -> Result<QueryOutcome, anyhow::Error> {
+        self.discard_pending().await?;
+
+        self.seq = 0;
+        let mut packet = Vec::with_capacity(sql.len() + 1);
+        packet.push(COM_QUERY);
+        packet.extend_from_slice(sql.as_bytes());
+        self.write_packet(&packet).await?;
+
+        let first = self.read_packet().await?;
+        match first.first() {
+            Some(0x00) => {
+                let (affected_rows, status, message) = parse_ok(&first)?;
+                if status & SERVER_MORE_RESULTS_EXISTS != 0 {
+                    self.skip_results().await?;
+                }
+                return Ok(QueryOutcome { columns: Vec::new(), affected_rows, message });
+            }
+            Some(0xFF) => return Err(server_error(&first)),
+            Some(0xFB) => return Err(anyhow::anyhow!("LOAD DATA LOCAL INFILE is not supported")),
+            _ => {}
+        }
+
+        let count = read_lenenc(&mut &first[..])? as usize;
+        let mut columns = Vec::with_capacity(count);
+        for _ in 0..count {
+            columns.push(parse_column(&self.read_packet().await?)?);
+        }
+        // EOF after the definitions.
+        self.read_packet().await?;
+        self.pending_columns = count;
+        Ok(QueryOutcome { columns, affected_rows: 0, message: String::new() })
+    }
+
+    pub async fn fetch(&mut self, max_rows: usize) -> Result<Page, anyhow::Error> {
+        let mut page = Page::new(self.pending_columns);
+        while self.pending_columns > 0 && page.rows() < max_rows {
+            let packet = self.read_packet().await?;
+            match packet.first() {
+                Some(0xFE) if packet.len() < 9 => {
+                    self.pending_columns = 0;
+                    if eof_status(&packet) & SERVER_MORE_RESULTS_EXISTS != 0 {
+                        self.skip_results().await?;
+                    }
+                }
+                Some(0xFF) => {
+                    self.pending_columns = 0;
+                    return Err(server_error(&packet));
+                }
+                _ => push_text_row(&mut page, &packet)?,
+            }
+        }
+        Ok(page)
+    }
+
+    /// Read and drop the rest of the current result.
+    async fn discard_pending(&mut self) -> Result<(), anyhow::Error> {
+        while self.pending_columns > 0 {
+            self.fetch(DISCARD_BATCH).await?;
+        }
+        Ok(())
+    }
+
+    /// Drop further result sets of a multi-statement query; only the first
+    /// is shown.
+    async fn skip_results(&mut self) -> Result<(), anyhow::Error> {
+        loop {
+            let first = self.read_packet().await?;
+            let more = match first.first() {
+                Some(0x00) => parse_ok(&first)?.1,
+                Some(0xFF) => return Err(server_error(&first)),
+                _ => {
+                    // Column definitions, then rows, up to the final EOF.
+                    let mut eofs = 0;
+                    let mut status = 0;
+                    while eofs < 2 {
+                        let packet = self.read_packet().await?;
+                        match packet.first() {
+                            Some(0xFE) if packet.len() < 9 => {
+                                eofs += 1;
+                                status = eof_status(&packet);
+                            }
+                            Some(0xFF) => return Err(server_error(&packet)),
+                            _ => {}
+                        }
+                    }
+                    status
+                }
+            };
+            if more & SERVER_MORE_RESULTS_EXISTS == 0 {
+                return Ok(());
+            }
+        }
+    }
+
+    async fn read_packet(&mut self) -> Result<Vec<u8>, anyhow::Error> {
+        let mut payload = Vec::new();
+        loop {
+            let mut header = [0u8; 4];
+            self.io.read_exact(&mut header).await?;
+            let len = u32::from_le_bytes([header[0], header[1], header[2], 0]) as usize;
+            self.seq = header[3].wrapping_add(1);
+            let start = payload.len();
+            payload.resize(start + len, 0);
+            self.io.read_exact(&mut payload[start..]).await?;
+            // A maximum-size packet continues in the next one.
+            if len < MAX_PAYLOAD {
+                return Ok(payload);
+            }
+        }
+    }
+
+    async fn write_packet(&mut self, payload: &[u8]) -> Result<(), anyhow::Error> {
+        let mut chunks = payload.chunks(MAX_PAYLOAD).peekable();
+        if chunks.peek().is_none() {
+            self.write_chunk(&[]).await?;
+        }
+        while let Some(chunk) = chunks.next() {
+            self.write_chunk(chunk).await?;
+            if chunk.len() == MAX_PAYLOAD && chunks.peek().is_none() {
+                self.write_chunk(&[]).await?;
+            }
+        }
+        self.io.flush().await?;
+        Ok(())
+    }
+
+    async fn write_chunk(&mut self, chunk: &[u8]) -> Result<(), anyhow::Error> {
+        let len = (chunk.len() as u32).to_le_bytes();
+        self.io.write_all(&[len[0], len[1], len[2], self.seq]).await?;
+        self.io.write_all(chunk).await?;
+        self.seq = self.seq.wrapping_add(1);
+        Ok(())
+    }
+}
+
+/// Scramble and auth plugin name from a v10 handshake.
+fn parse_handshake(packet: &[u8]) -> Result<(Vec<u8>, String), anyhow::Error> {
+    let mut buf = packet;
+    let protocol = take(&mut buf, 1)?[0];
+    if protocol != 10 {
+        return Err(anyhow::anyhow!("Unsupported MySQL protocol version {}", protocol));
+    }
+    take_cstr(&mut buf)?; // server version
+    take(&mut buf, 4)?; // connection id
+    let mut scramble = take(&mut buf, 8)?.to_vec();
+    take(&mut buf, 1)?; // filler
+    let caps_low = take(&mut buf, 2)?;
+    let caps_low = u16::from_le_bytes([caps_low[0], caps_low[1]]) as u32;
+    if caps_low & CLIENT_PROTOCOL_41 == 0 {
+        return Err(anyhow::anyhow!("MySQL server is too old (no protocol 4.1)"));
+    }
+    take(&mut buf, 1 + 2)?; // charset, status
+    let caps_high = take(&mut buf, 2)?;
+    let caps = caps_low | (u16::from_le_bytes([caps_high[0], caps_high[1]]) as u32) << 16;
+    let auth_len = take(&mut buf, 1)?[0] as usize;
+    take(&mut buf, 10)?; // reserved
+    if caps & CLIENT_SECURE_CONNECTION != 0 {
+        let part2 = take(&mut buf, auth_len.saturating_sub(8).max(13))?;
+        scramble.extend_from_slice(part2.strip_suffix(&[0]).unwrap_or(part2));
+    }
+    let plugin = if caps & CLIENT_PLUGIN_AUTH != 0 {
+        take_cstr(&mut buf).unwrap_or("mysql_native_password").to_string()
+    } else {
+        "mysql_native_password".to_string()
+    };
+    Ok((scramble, plugin))
+}
+
+/// Auth response for `plugin`. An empty password sends nothing.
+fn scramble_password(plugin: &str, password: &[u8], scramble: &[u8]) -> Result<Vec<u8>, anyhow::Error> {
+    if password.is_empty() {
+        return Ok(Vec::new());
+    }
+    let (algorithm, native) = match plugin {
+        "mysql_native_password" => (&digest::SHA1_FOR_LEGACY_USE_ONLY, true),
+        "caching_sha2_password" => (&digest::SHA256, false),
+        other => return Err(anyhow::anyhow!("Unsupported MySQL auth plugin {}", other)),
+    };
+    let hash = |parts: &[&[u8]]| {
+        let mut ctx = digest::Context::new(algorithm);
+        for part in parts {
+            ctx.update(part);
+        }
+        ctx.finish()
+    };
+    // native:  SHA1(pw) ^ SHA1(scramble + SHA1(SHA1(pw)))
+    // sha2:    SHA256(pw) ^ SHA256(SHA256(SHA256(pw)) + scramble)
+    let stage1 = hash(&[password]);
+    let stage2 = hash(&[stage1.as_ref()]);
+    let mix = if native {
+        hash(&[scramble, stage2.as_ref()])
+    } else {
+        hash(&[stage2.as_ref(), scramble])
+    };
+    Ok(stage1.as_ref().iter().zip(mix.as_ref()).map(|(a, b)| a ^ b).collect())
+}
+
+/// Affected rows, status flags and info text of an OK packet.
+fn parse_ok(packet: &[u8]) -> Result<(u64, u16, String), anyhow::Error> {
+    let mut buf = &packet[1..];
+    let affected_rows = read_lenenc(&mut buf)?;
+    read_lenenc(&mut buf)?; // last insert id
+    let status = take(&mut buf, 2)?;
+    let status = u16::from_le_bytes([status[0], status[1]]);
+    take(&mut buf, 2)?; // warnings
+    Ok((affected_rows, status, String::from_utf8_lossy(buf).into_owned()))
+}
+
+fn eof_status(packet: &[u8]) -> u16 {
+    match packet.get(3..5) {
+        Some(status) => u16::from_le_bytes([status[0], status[1]]),
+        None => 0,
+    }
+}
+
+fn server_error(packet: &[u8]) -> anyhow::Error {
+    let code = packet.get(1..3).map_or(0, |c| u16::from_le_bytes([c[0], c[1]]));
+    // Protocol 4.1 adds '#' and a 5-character SQL state.
+    let message = match packet.get(3) {
+        Some(b'#') => packet.get(9..).unwrap_or_default(),
+        _ => packet.get(3..).unwrap_or_default(),
+    };
+    statement_error(format!("ERROR {}: {}", code, String::from_utf8_lossy(message)))
+}
+
+fn parse_column(packet: &[u8]) -> Result<Column, anyhow::Error> {
+    let mut buf = packet;
+    for _ in 0..4 {
+        read_lenenc_bytes(&mut buf)?; // catalog, schema, table, org_table
+    }
+    let name = String::from_utf8_lossy(read_lenenc_bytes(&mut buf)?.unwrap_or_default()).into_owned();
+    read_lenenc_bytes(&mut buf)?; // org_name
+    take(&mut buf, 1 + 2 + 4)?; // fixed-length fields length, charset, column length
+    let type_code = take(&mut buf, 1)?[0];
+    Ok(Column { name, type_name: type_name(type_code).to_string() })
+}
+
+fn push_text_row(page: &mut Page, packet: &[u8]) -> Result<(), anyhow::Error> {
+    let mut buf = packet;
+    let mut cells = Vec::with_capacity(page.column_count());
+    for _ in 0..page.column_count() {
+        cells.push(read_lenenc_bytes(&mut buf)?);
+    }
+    page.push_row(cells);
+    Ok(())
+}
+
+/// Length-encoded integer.
+fn read_lenenc(buf: &mut &[u8]) -> Result<u64, anyhow::Error> {
+    let first = take(buf, 1)?[0];
+    let width = match first {
+        0xFC => 2,
+        0xFD => 3,
+        0xFE => 8,
+        _ => return Ok(first as u64),
+    };
+    let mut bytes = [0u8; 8];
+    bytes[..width].copy_from_slice(take(buf, width)?);
+    Ok(u64::from_le_bytes(bytes))
+}
+
+/// Length-encoded string; None for NULL (0xFB).
+fn read_lenenc_bytes<'a>(buf: &mut &'a [u8]) -> Result<Option<&'a [u8]>, anyhow::Error> {
+    if buf.first() == Some(&0xFB) {
+        *buf = &buf[1..];
+        return Ok(None);
+    }
+    let len = read_lenenc(buf)? as usize;
+    Ok(Some(take(buf, len)?))
+}
+
+fn type_name(code: u8) -> &'static str {
+    match code {
+        0 | 246 => "DECIMAL",
+        1 => "TINYINT",
+        2 => "SMALLINT",
+        3 => "INT",
+        4 => "FLOAT",
+        5 => "DOUBLE",
+        6 => "NULL",
+        7 => "TIMESTAMP",
+        8 => "BIGINT",
+        9 => "MEDIUMINT",
+        10 => "DATE",
+        11 => "TIME",
+        12 => "DATETIME",
+        13 => "YEAR",
+        16 => "BIT",
+        245 => "JSON",
+        247 => "ENUM",
+        248 => "SET",
+        249..=252 => "BLOB",
+        15 | 253 => "VARCHAR",
+        254 => "CHAR",
+        255 => "GEOMETRY",
+        _ => "UNKNOWN",
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tokio::io::{AsyncReadExt, AsyncWriteExt, BufReader};
+
+    fn packet(seq: u8, payload: &[u8]) -> Vec<u8> {
+        let len = (payload.len() as u32).to_le_bytes();
+        let mut p = vec![len[0], len[1], len[2], seq];
+        p.extend_from_slice(payload);
+        p
+    }
+
+    fn lenenc_str(s: &str) -> Vec<u8> {
+        let mut v = vec![s.len() as u8];
+        v.extend_from_slice(s.as_bytes());
+        v
+    }
+
+    fn column_def(name: &str, type_code: u8) -> Vec<u8> {
+        let mut v = Vec::new();
+        for part in ["def", "shop", "users", "users", name, name] {
+            v.extend(lenenc_str(part));
+        }
+        v.extend_from_slice(&[0x0c, 45, 0, 11, 0, 0, 0, type_code, 0, 0, 0, 0, 0]);
+        v
+    }
+
+    #[tokio::test]
+    async fn test_handshake_query_and_paging() {
+        let (client, mut server) = tokio::io::duplex(64 * 1024);
+        let server_task = tokio::spawn(async move {
+            let mut greeting = vec![10];
+            greeting.extend_from_slice(b"8.0.36\0");
+            greeting.extend_from_slice(&7u32.to_le_bytes());
+            greeting.extend_from_slice(b"abcdefgh\0");
+            greeting.extend_from_slice(&0xFFFFu16.to_le_bytes());
+            greeting.extend_from_slice(&[45, 2, 0]);
+            greeting.extend_from_slice(&0x000Fu16.to_le_bytes()); // high caps incl. PLUGIN_AUTH
+            greeting.push(21);
+            greeting.extend_from_slice(&[0; 10]);
+            greeting.extend_from_slice(b"ijklmnopqrst\0");
+            greeting.extend_from_slice(b"mysql_native_password\0");
+            server.write_all(&packet(0, &greeting)).await.unwrap();
+
+            let mut header = [0u8; 4];
+            server.read_exact(&mut header).await.unwrap();
+            let mut login = vec![0u8; u32::from_le_bytes([header[0], header[1], header[2], 0]) as usize];
+            server.read_exact(&mut login).await.unwrap();
+            server.write_all(&packet(2, &[0, 0, 0, 2, 0, 0, 0])).await.unwrap();
+
+            server.read_exact(&mut header).await.unwrap();
+            let mut query = vec![0u8; u32::from_le_bytes([header[0], header[1], header[2], 0]) as usize];
+            server.read_exact(&mut query).await.unwrap();
+            let mut reply = packet(1, &[2]);
+            reply.extend(packet(2, &column_def("id", 3)));
+            reply.extend(packet(3, &column_def("name", 253)));
+            reply.extend(packet(4, &[0xFE, 0, 0, 2, 0]));
+            let mut seq = 5;
+            for id in 1..=3 {
+                let mut row = lenenc_str(&id.to_string());
+                if id == 2 { row.push(0xFB) } else { row.extend(lenenc_str(&format!("user{}", id))) }
+                reply.extend(packet(seq, &row));
+                seq += 1;
+            }
+            reply.extend(packet(seq, &[0xFE, 0, 0, 2, 0]));
+            server.write_all(&reply).await.unwrap();
+            (login, query)
+        });
+
+        let options = ConnectOptions { user: "app".into(), password: "pw".into(), database: "shop".into() };
+        let io: Io = BufReader::new(Box::new(client));
+        let mut conn = MysqlConnection::connect(io, &options).await.unwrap();
+        let outcome = conn.query("SELECT id, name FROM users").await.unwrap();
+        assert_eq!(outcome.columns, vec![
+            Column { name: "id".into(), type_name: "INT".into() },
+            Column { name: "name".into(), type_name: "VARCHAR".into() },
+        ]);
+
+        let first = conn.fetch(2).await.unwrap();
+        assert_eq!(first.rows(), 2);
+        assert_eq!(first.value(1, 0).as_deref(), Some("user1"));
+        assert_eq!(first.value(1, 1), None);
+        let rest = conn.fetch(2).await.unwrap();
+        assert_eq!(rest.rows(), 1);
+        assert_eq!(rest.value(0, 0).as_deref(), Some("3"));
+        assert_eq!(conn.fetch(2).await.unwrap().rows(), 0);
+
+        let (login, query) = server_task.await.unwrap();
+        assert_eq!(&query[..], b"\x03SELECT id, name FROM users");
+        let user_at = 32;
+        assert_eq!(&login[user_at..user_at + 4], b"app\0");
+        assert_eq!(login[user_at + 4], 20, "SHA1-sized scramble");
+        let expected = scramble_password("mysql_native_password", b"pw", b"abcdefghijklmnopqrst").unwrap();
+        assert_eq!(&login[user_at + 5..user_at + 25], &expected[..]);
+        assert!(login.ends_with(b"shop\0mysql_native_password\0"));
+    }
+}
@@ -0,0 +1,471 @@
+//! PostgreSQL frontend/backend protocol 3.0, simple query flow.
+//!
+//! Authenticates with trust, cleartext or SCRAM-SHA-256 (the default since
+//! PostgreSQL 14). MD5 password hashes are not supported.
+
+use std::num::NonZeroU32;
+
+use ring::rand::{SecureRandom, SystemRandom};
+use ring::{digest, hmac, pbkdf2};
+use tokio::io::{AsyncReadExt, AsyncWriteExt};
+
+use super::{statement_error, take, take_cstr, Column, ConnectOptions, Io, Page, QueryOutcome};
+
+const PROTOCOL_3_0: i32 = 196_608;
+
+/// Rows read per step while skipping an abandoned result.
+const DISCARD_BATCH: usize = 1024;
+
+pub struct PgConnection {
+    io: Io,
+    /// Columns of the result being read, or None when none is pending.
+    pending_columns: Option<usize>,
+}
+
+impl PgConnection {
+    pub async fn connect(io: Io, options: &ConnectOptions) -> Result<Self, anyhow::Error> {
+        let mut conn = Self { io, pending_columns: None };
+
+        let database = if options.database.is_empty() { &options.user } else { &options.database };
+        let mut startup = Vec::new();
+        startup.extend_from_slice(&PROTOCOL_3_0.to_be_bytes());
+        for (key, value) in [("user", options.user.as_str()), ("database", database), ("client_encoding", "UTF8")] {
+            startup.extend_from_slice(key.as_bytes());
+            startup.push(0);
+            startup.extend_from_slice(value.as_bytes());
+            startup.push(0);
+        }
+        startup.push(0);
+        conn.io.write_all(&((startup.len() + 4) as i32).to_be_bytes()).await?;
+        conn.io.write_all(&startup).await?;
+        conn.io.flush().await?;
+
+        conn.authenticate(&options.password).await?;
+        // Parameter status and key data, up to the first ReadyForQuery.
+        conn.wait_ready().await?;
+        Ok(conn)
+    }
+
+    async fn authenticate(&mut self, password: &str) -> Result<(), anyhow::Error> {
+        let mut scram: Option<Scram> = None;
+        loop {
+            let (tag, body) = self.read_message().await?;
+            match tag {
+                b'E' => return Err(server_error(&body)),
+                b'R' => {}
+                _ => return Err(anyhow::anyhow!("Unexpected PostgreSQL auth message '{}'", tag as char)),
+            }
+            let mut buf = &body[..];
+            let code = read_i32(&mut buf)?;
+            match code {
+                0 => return Ok(()),
+                3 => {
+                    let mut msg = password.as_bytes().to_vec();
+                    msg.push(0);
+                    self.write_message(b'p', &msg).await?;
+                }
+                5 => return Err(anyhow::anyhow!("PostgreSQL MD5 password authentication is not supported; use scram-sha-256")),
+                10 => {
+                    let mut offered = Vec::new();
+                    while !buf.is_empty() && buf[0] != 0 {
+                        offered.push(take_cstr(&mut buf)?.to_string());
+                    }
+                    if !offered.iter().any(|m| m == "SCRAM-SHA-256") {
+                        return Err(anyhow::anyhow!("No supported SASL mechanism in {:?}", offered));
+                    }
+                    let state = Scram::new(password)?;
+                    let first = state.client_first();
+                    let mut msg = b"SCRAM-SHA-256\0".to_vec();
+                    msg.extend_from_slice(&(first.len() as i32).to_be_bytes());
+                    msg.extend_from_slice(first.as_bytes());
+                    self.write_message(b'p', &msg).await?;
+                    scram = Some(state);
+                }
+                11 => {
+                    let state = scram.as_mut().ok_or_else(|| anyhow::anyhow!("SASL continue before start"))?;
+                    let server_first = std::str::from_utf8(buf)?;
+                    let last = state.client_final(server_first)?;
+                    self.write_message(b'p', last.as_bytes()).await?;
+                }
+                12 => {
+                    let state = scram.as_ref().ok_or_else(|| anyhow::anyhow!("SASL final before start"))?;
+                    state.verify_server(std::str::from_utf8(buf)?)?;
+                }
+                other => return Err(anyhow::anyhow!("Unsupported PostgreSQL auth method {}", other)),
+            }
+        }
+    }
+
+    pub async fn query(&mut self, sql: &str) -> Result<QueryOutcome, anyhow::Error> {
+        self.discard_pending().await?;
+
+        let mut msg = sql.as_bytes().to_vec();
+        msg.push(0);
+        self.write_message(b'Q', &msg).await?;
+
+        let mut error = None;
+        loop {
+            let (tag, body) = self.read_message().await?;
+            match tag {
+                b'T' => {
+                    let columns = parse_row_description(&body)?;
+                    self.pending_columns = Some(columns.len());
+                    return Ok(QueryOutcome { columns, affected_rows: 0, message: String::new() });
+                }
+                b'C' => {
+                    let tag = take_cstr(&mut &body[..])?.to_string();
+                    // Later statements of a multi-statement query are run
+                    // but not shown.
+                    self.wait_ready().await?;
+                    return Ok(QueryOutcome { columns: Vec::new(), affected_rows: affected_rows(&tag), message: tag });
+                }
+                b'I' => {}
+                b'E' => error = Some(server_error(&body)),
+                b'Z' => {
+                    return match error {
+                        Some(e) => Err(e),
+                        None => Ok(QueryOutcome { columns: Vec::new(), affected_rows: 0, message: String::new() }),
+                    }
+                }
+                _ => {} // notices, parameter changes
+            }
+        }
+    }
+
+    pub async fn fetch(&mut self, max_rows: usize) -> Result<Page, anyhow::Error> {
+        let mut page = Page::new(self.pending_columns.unwrap_or(0));
+        while self.pending_columns.is_some() && page.rows() < max_rows {
+            let (tag, body) = self.read_message().await?;
+            match tag {
+                b'D' => push_data_row(&mut page, &body)?,
+                b'C' => {
+                    self.pending_columns = None;
+                    self.wait_ready().await?;
+                }
+                b'E' => {
+                    self.pending_columns = None;
+                    let error = server_error(&body);
+                    self.wait_ready().await?;
+                    return Err(error);
+                }
+                _ => {}
+            }
+        }
+        Ok(page)
+    }
+
+    async fn discard_pending(&mut self) -> Result<(), anyhow::Error> {
+        while self.pending_columns.is_some() {
+            self.fetch(DISCARD_BATCH).await?;
+        }
+        Ok(())
+    }
+
+    /// Skip to ReadyForQuery.
+    async fn wait_ready(&mut self) -> Result<(), anyhow::Error> {
+        loop {
+            let (tag, _) = self.read_message().await?;
+            if tag == b'Z' {
+                return Ok(());
+            }
+        }
+    }
+
+    async fn read_message(&mut self) -> Result<(u8, Vec<u8>), anyhow::Error> {
+        let tag = self.io.read_u8().await?;
+        let len = self.io.read_i32().await?;
+        if len < 4 {
+            return Err(anyhow::anyhow!("Invalid PostgreSQL message length {}", len));
+        }
+        let mut body = vec![0u8; len as usize - 4];
+        self.io.read_exact(&mut body).await?;
+        Ok((tag, body))
+    }
+
+    async fn write_message(&mut self, tag: u8, body: &[u8]) -> Result<(), anyhow::Error> {
+        self.io.write_u8(tag).await?;
+        self.io.write_i32(body.len() as i32 + 4).await?;
+        self.io.write_all(body).await?;
+        self.io.flush().await?;
+        Ok(())
+    }
+}
+
+/// Client side of a SCRAM-SHA-256 exchange (RFC 5802 / 7677). The user
+/// name is left empty; PostgreSQL uses the startup packet's.
+struct Scram {
+    password: String,
+    client_first_bare: String,
+    /// Server signature expected in the final message.
+    server_signature: Option<Vec<u8>>,
+}
+
+impl Scram {
+    fn new(password: &str) -> Result<Self, anyhow::Error> {
+        let mut nonce = [0u8; 18];
+        SystemRandom::new().fill(&mut nonce).map_err(|_| anyhow::anyhow!("RNG failed"))?;
+        Ok(Self::with_nonce(password, "", &base64_encode(&nonce)))
+    }
+
+    fn with_nonce(password: &str, user: &str, nonce: &str) -> Self {
+        Self {
+            password: password.to_string(),
+            client_first_bare: format!("n={},r={}", user, nonce),
+            server_signature: None,
+        }
+    }
+
+    fn client_first(&self) -> String {
+        format!("n,,{}", self.client_first_bare)
+    }
+
+    fn client_final(&mut self, server_first: &str) -> Result<String, anyhow::Error> {
+        let attr = |name: char| {
+            server_first
+                .split(',')
+                .find_map(|part| part.strip_prefix(name).and_then(|rest| rest.strip_prefix('=')))
+                .ok_or_else(|| anyhow::anyhow!("Malformed SCRAM server message"))
+        };
+        let nonce = attr('r')?;
+        let client_nonce = &self.client_first_bare[self.client_first_bare.find(",r=").map_or(0, |i| i + 3)..];
+        if !nonce.starts_with(client_nonce) {
+            return Err(anyhow::anyhow!("SCRAM server nonce mismatch"));
+        }
+        let salt = base64_decode(attr('s')?)?;
+        let iterations: u32 = attr('i')?.parse()?;
+        let iterations = NonZeroU32::new(iterations).ok_or_else(|| anyhow::anyhow!("Invalid SCRAM iteration count"))?;
+
+        let mut salted = [0u8; 32];
+        pbkdf2::derive(pbkdf2::PBKDF2_HMAC_SHA256, iterations, &salt, self.password.as_bytes(), &mut salted);
+        let salted_key = hmac::Key::new(hmac::HMAC_SHA256, &salted);
+        let client_key = hmac::sign(&salted_key, b"Client Key");
+        let stored_key = digest::digest(&digest::SHA256, client_key.as_ref());
+
+        let without_proof = format!("c=biws,r={}", nonce);
+        let auth_message = format!("{},{},{}", self.client_first_bare, server_first, without_proof);
+        let signature = hmac::sign(&hmac::Key::new(hmac::HMAC_SHA256, stored_key.as_ref()), auth_message.as_bytes());
+        let proof: Vec<u8> = client_key.as_ref().iter().zip(signature.as_ref()).map(|(a, b)| a ^ b).collect();
+
+        let server_key = hmac::sign(&salted_key, b"Server Key");
+        let server_signature = hmac::sign(&hmac::Key::new(hmac::HMAC_SHA256, server_key.as_ref()), auth_message.as_bytes());
+        self.server_signature = Some(server_signature.as_ref().to_vec());
+
+        Ok(format!("{},p={}", without_proof, base64_encode(&proof)))
+    }
+
+    fn verify_server(&self, server_final: &str) -> Result<(), anyhow::Error> {
+        let signature = server_final
+            .strip_prefix("v=")
+            .map(|v| v.split(',').next().unwrap_or(v))
+            .ok_or_else(|| anyhow::anyhow!("SCRAM authentication rejected: {}", server_final))?;
+        if self.server_signature.as_deref() != Some(&base64_decode(signature)?[..]) {
+            return Err(anyhow::anyhow!("SCRAM server signature mismatch"));
+        }
+        Ok(())
+    }
+}
+
+fn parse_row_description(body: &[u8]) -> Result<Vec<Column>, anyhow::Error> {
+    let mut buf = body;
+    let count = read_i16(&mut buf)?.max(0) as usize;
+    let mut columns = Vec::with_capacity(count);
+    for _ in 0..count {
+        let name = take_cstr(&mut buf)?.to_string();
+        take(&mut buf, 4 + 2)?; // table oid, column number
+        let type_oid = read_i32(&mut buf)? as u32;
+        take(&mut buf, 2 + 4 + 2)?; // type size, modifier, format
+        columns.push(Column { name, type_name: type_name(type_oid) });
+    }
+    Ok(columns)
+}
+
+fn push_data_row(page: &mut Page, body: &[u8]) -> Result<(), anyhow::Error> {
+    let mut buf = body;
+    let count = read_i16(&mut buf)?.max(0) as usize;
+    let mut cells = Vec::with_capacity(count);
+    for _ in 0..count {
+        let len = read_i32(&mut buf)?;
+        cells.push(if len < 0 { None } else { Some(take(&mut buf, len as usize)?) });
+    }
+    page.push_row(cells);
+    Ok(())
+}
+
+/// "UPDATE 3" → 3, "INSERT 0 1" → 1; 0 for tags without a count.
+fn affected_rows(tag: &str) -> u64 {
+    tag.rsplit(' ').next().and_then(|n| n.parse().ok()).unwrap_or(0)
+}
+
+fn server_error(body: &[u8]) -> anyhow::Error {
+    let mut buf = body;
+    let (mut severity, mut code, mut message) = ("ERROR", "", "");
+    while let Some((&field, rest)) = buf.split_first() {
+        if field == 0 {
+            break;
+        }
+        buf = rest;
+        let Ok(value) = take_cstr(&mut buf) else { break };
+        match field {
+            b'S' => severity = value,
+            b'C' => code = value,
+            b'M' => message = value,
+            _ => {}
+        }
+    }
+    statement_error(format!("{} {}: {}", severity, code, message))
+}
+
+fn read_i16(buf: &mut &[u8]) -> Result<i16, anyhow::Error> {
+    let b = take(buf, 2)?;
+    Ok(i16::from_be_bytes([b[0], b[1]]))
+}
+
+fn read_i32(buf: &mut &[u8]) -> Result<i32, anyhow::Error> {
+    let b = take(buf, 4)?;
+    Ok(i32::from_be_bytes([b[0], b[1], b[2], b[3]]))
+}
+
+fn type_name(oid: u32) -> String {
+    let name = match oid {
+        16 => "bool",
+        17 => "bytea",
+        18 => "char",
+        19 => "name",
+        20 => "int8",
+        21 => "int2",
+        23 => "int4",
+        25 => "text",
+        26 => "oid",
+        114 => "json",
+        700 => "float4",
+        701 => "float8",
+        869 => "inet",
+        1042 => "bpchar",
+        1043 => "varchar",
+        1082 => "date",
+        1083 => "time",
+        1114 => "timestamp",
+        1184 => "timestamptz",
+        1186 => "interval",
+        1700 => "numeric",
+        2950 => "uuid",
+        3802 => "jsonb",
+        _ => return format!("oid {}", oid),
+    };
+    name.to_string()
+}
+
+const BASE64: &[u8; 64] = b"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+fn base64_encode(data: &[u8]) -> String {
+    let mut out = String::with_capacity((data.len() + 2) / 3 * 4);
+    for chunk in data.chunks(3) {
+        let n = chunk.iter().enumerate().fold(0u32, |n, (i, &b)| n | (b as u32) << (16 - 8 * i));
+        for i in 0..4 {
+            if i <= chunk.len() {
+                out.push(BASE64[(n >> (18 - 6 * i) & 0x3F) as usize] as char);
+            } else {
+                out.push('=');
+            }
+        }
+    }
+    out
+}
+
+fn base64_decode(text: &str) -> Result<Vec<u8>, anyhow::Error> {
+    let mut out = Vec::with_capacity(text.len() / 4 * 3);
+    let (mut acc, mut bits) = (0u32, 0);
+    for c in text.bytes().filter(|&c| c != b'=') {
+        let v = BASE64.iter().position(|&b| b == c).ok_or_else(|| anyhow::anyhow!("Invalid base64"))?;
+        acc = acc << 6 | v as u32;
+        bits += 6;
+        if bits >= 8 {
+            bits -= 8;
+            out.push((acc >> bits) as u8);
+        }
+    }
+    Ok(out)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tokio::io::BufReader;
+
+    #[test]
+    fn test_scram_rfc7677_vector() {
+        let mut scram = Scram::with_nonce("pencil", "user", "rOprNGfwEbeRWgbNEkqO");
+        assert_eq!(scram.client_first(), "n,,n=user,r=rOprNGfwEbeRWgbNEkqO");
+        let last = scram
+            .client_final("r=rOprNGfwEbeRWgbNEkqO%hvYDpWUa2RaTCAfuxFIlj)hNlF$k0,s=W22ZaJ0SNY7soEsUEjb6gQ==,i=4096")
+            .unwrap();
+        assert_eq!(
+            last,
+            "c=biws,r=rOprNGfwEbeRWgbNEkqO%hvYDpWUa2RaTCAfuxFIlj)hNlF$k0,p=dHzbZapWIk4jUhN+Ute9ytag9zjfMHgsqmmiz7AndVQ="
+        );
+        scram.verify_server("v=6rriTRBi23WpRR/wtup+mMhUZUn/dB5nLTJRsjl95G4=").unwrap();
+        assert!(scram.verify_server("v=AAAA").is_err());
+    }
+
+    fn message(tag: u8, body: &[u8]) -> Vec<u8> {
+        let mut m = vec![tag];
+        m.extend_from_slice(&(body.len() as i32 + 4).to_be_bytes());
+        m.extend_from_slice(body);
+        m
+    }
+
+    #[tokio::test]
+    async fn test_trust_login_query_and_paging() {
+        let (client, mut server) = tokio::io::duplex(64 * 1024);
+        let mut script = message(b'R', &0i32.to_be_bytes());
+        script.extend(message(b'S', b"server_version\x0016.2\0"));
+        script.extend(message(b'Z', b"I"));
+        let mut fields = 2i16.to_be_bytes().to_vec();
+        for (name, oid) in [("id", 23i32), ("email", 1043)] {
+            fields.extend_from_slice(name.as_bytes());
+            fields.push(0);
+            fields.extend_from_slice(&[0; 6]);
+            fields.extend_from_slice(&oid.to_be_bytes());
+            fields.extend_from_slice(&[0; 8]);
+        }
+        script.extend(message(b'T', &fields));
+        for (id, email) in [("1", Some("a@x.io")), ("2", None), ("3", Some(""))] {
+            let mut row = 2i16.to_be_bytes().to_vec();
+            row.extend_from_slice(&(id.len() as i32).to_be_bytes());
+            row.extend_from_slice(id.as_bytes());
+            match email {
+                Some(e) => {
+                    row.extend_from_slice(&(e.len() as i32).to_be_bytes());
+                    row.extend_from_slice(e.as_bytes());
+                }
+                None => row.extend_from_slice(&(-1i32).to_be_bytes()),
+            }
+            script.extend(message(b'D', &row));
+        }
+        script.extend(message(b'C', b"SELECT 3\0"));
+        script.extend(message(b'Z', b"I"));
+        script.extend(message(b'C', b"UPDATE 2\0"));
+        script.extend(message(b'Z', b"I"));
+        server.write_all(&script).await.unwrap();
+
+        let options = ConnectOptions { user: "app".into(), password: String::new(), database: "shop".into() };
+        let io: Io = BufReader::new(Box::new(client));
+        let mut conn = PgConnection::connect(io, &options).await.unwrap();
+
+        let outcome = conn.query("SELECT id, email FROM users").await.unwrap();
+        assert_eq!(outcome.columns[1], Column { name: "email".into(), type_name: "varchar".into() });
+        let page = conn.fetch(2).await.unwrap();
+        assert_eq!((page.rows(), page.value(1, 0).as_deref(), page.value(1, 1)), (2, Some("a@x.io"), None));
+
+        // The rest of the SELECT is skipped before the next query.
+        let update = conn.query("UPDATE users SET active = true").await.unwrap();
+        assert_eq!((update.affected_rows, update.message.as_str()), (2, "UPDATE 2"));
+
+        let mut sent = vec![0u8; 4];
+        server.read_exact(&mut sent).await.unwrap();
+        let mut startup = vec![0u8; i32::from_be_bytes([sent[0], sent[1], sent[2], sent[3]]) as usize - 4];
+        server.read_exact(&mut startup).await.unwrap();
+        assert!(startup.windows(10).any(|w| w == b"database\0s"));
+        assert_eq!(base64_decode(&base64_encode(b"any carnal pleas")).unwrap(), b"any carnal pleas");
+    }
+}
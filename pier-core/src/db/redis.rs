@@ -0,0 +1,225 @@
+//! Redis RESP2 client.
+//!
+//! A query is a command line as typed in redis-cli. Replies are small
+//! next to SQL result sets, so each one is read whole and then served as
+//! pages of a single `value` column: an array's elements become rows, a
+//! nil becomes NULL.
+
+use tokio::io::{AsyncBufReadExt, AsyncReadExt, AsyncWriteExt};
+
+use super::{statement_error, Column, ConnectOptions, Io, Page, QueryOutcome};
+
+type BoxFuture<'a, T> = std::pin::Pin<Box<dyn std::future::Future<Output = T> + Send + 'a>>;
+
+/// Nested arrays deeper than this are rejected rather than recursed into.
+const MAX_DEPTH: usize = 8;
+
+pub struct RedisConnection {
+    io: Io,
+    /// Rows of the last reply not yet fetched.
+    rows: std::collections::VecDeque<Option<Vec<u8>>>,
+}
+
+#[derive(Debug, PartialEq)]
+enum Reply {
+    Status(String),
+    Error(String),
+    Integer(i64),
+    Bulk(Option<Vec<u8>>),
+    Array(Option<Vec<Reply>>),
+}
+
+impl RedisConnection {
+    pub async fn connect(io: Io, options: &ConnectOptions) -> Result<Self, anyhow::Error> {
+        let mut conn = Self { io, rows: Default::default() };
+        if !options.password.is_empty() {
+            let mut auth = vec!["AUTH".to_string()];
+            if !options.user.is_empty() {
+                auth.push(options.user.clone());
+            }
+            auth.push(options.password.clone());
+            conn.command(&auth).await?;
+        }
+        if let Ok(index) = options.database.parse::<u32>() {
+            conn.command(&["SELECT".to_string(), index.to_string()]).await?;
+        }
+        Ok(conn)
+    }
+
+    pub async fn query(&mut self, line: &str) -> Result<QueryOutcome, anyhow::Error> {
+        self.rows.clear();
+        let args = split_command_line(line)?;
+        if args.is_empty() {
+            return Err(statement_error("Empty command".into()));
+        }
+        let reply = self.command(&args).await?;
+        let message = match &reply {
+            Reply::Status(s) => s.clone(),
+            Reply::Integer(n) => format!("(integer) {}", n),
+            _ => String::new(),
+        };
+        flatten(reply, &mut self.rows);
+        Ok(QueryOutcome {
+            columns: vec![Column { name: "value".into(), type_name: "string".into() }],
+            affected_rows: 0,
+            message,
+        })
+    }
+
+    pub fn fetch(&mut self, max_rows: usize) -> Page {
+        let mut page = Page::new(1);
+        let n = max_rows.min(self.rows.len());
+        for row in self.rows.drain(..n) {
+            page.push_row([row.as_deref()]);
+        }
+        page
+    }
+
+    async fn command(&mut self, args: &[String]) -> Result<Reply, anyhow::Error> {
+        let mut msg = format!("*{}\r\n", args.len()).into_bytes();
+        for arg in args {
+            msg.extend_from_slice(format!("${}\r\n", arg.len()).as_bytes());
+            msg.extend_from_slice(arg.as_bytes());
+            msg.extend_from_slice(b"\r\n");
+        }
+        self.io.write_all(&msg).await?;
+        self.io.flush().await?;
+        match self.read_reply(0).await? {
+            Reply::Error(e) => Err(statement_error(e)),
+            reply => Ok(reply),
+        }
+    }
+
+    /// Boxed so array replies can recurse.
+    fn read_reply(&mut self, depth: usize) -> BoxFuture<'_, Result<Reply, anyhow::Error>> {
+        Box::pin(async move {
+            if depth > MAX_DEPTH {
+                return Err(anyhow::anyhow!("Redis reply nested too deeply"));
+            }
+            let mut line = String::new();
+            if self.io.read_line(&mut line).await? == 0 {
+                return Err(anyhow::anyhow!("Redis connection closed"));
+            }
+            let line = line.trim_end_matches(['\r', '\n']);
+            let (kind, rest) = line.split_at(line.len().min(1));
+            Ok(match kind {
+                "+" => Reply::Status(rest.to_string()),
+                "-" => Reply::Error(rest.to_string()),
+                ":" => Reply::Integer(rest.parse()?),
+                "$" => {
+                    let len: i64 = rest.parse()?;
+                    if len < 0 {
+                        Reply::Bulk(None)
+                    } else {
+                        let mut data = vec![0u8; len as usize + 2];
+                        self.io.read_exact(&mut data).await?;
+                        data.truncate(len as usize);
+                        Reply::Bulk(Some(data))
+                    }
+                }
+                "*" => {
+                    let len: i64 = rest.parse()?;
+                    if len < 0 {
+                        Reply::Array(None)
+                    } else {
+                        let mut items = Vec::with_capacity(len.min(1024) as usize);
+                        for _ in 0..len {
+                            items.push(self.read_reply(depth + 1).await?);
+                        }
+                        Reply::Array(Some(items))
+                    }
+                }
+                _ => return Err(anyhow::anyhow!("Unexpected Redis reply: {}", line)),
+            })
+        })
+    }
+}
+
+/// Turn a reply into rows, one per leaf value.
+fn flatten(reply: Reply, rows: &mut std::collections::VecDeque<Option<Vec<u8>>>) {
+    match reply {
+        Reply::Status(s) | Reply::Error(s) => rows.push_back(Some(s.into_bytes())),
+        Reply::Integer(n) => rows.push_back(Some(n.to_string().into_bytes())),
+        Reply::Bulk(data) => rows.push_back(data),
+        Reply::Array(None) => rows.push_back(None),
+        Reply::Array(Some(items)) => items.into_iter().for_each(|item| flatten(item, rows)),
+    }
+}
+
+/// Split a redis-cli style line into arguments, honouring single and
+/// double quotes and backslash escapes inside double quotes.
+fn split_command_line(line: &str) -> Result<Vec<String>, anyhow::Error> {
+    let mut args = Vec::new();
+    let mut chars = line.chars().peekable();
+    loop {
+        while chars.peek().is_some_and(|c| c.is_whitespace()) {
+            chars.next();
+        }
+        let Some(&first) = chars.peek() else { break };
+        let mut arg = String::new();
+        if first == '"' || first == '\'' {
+            chars.next();
+            loop {
+                match chars.next() {
+                    Some(c) if c == first => break,
+                    Some('\\') if first == '"' => match chars.next() {
+                        Some('n') => arg.push('\n'),
+                        Some('r') => arg.push('\r'),
+                        Some('t') => arg.push('\t'),
+                        Some(c) => arg.push(c),
+                        None => return Err(statement_error("Unbalanced quotes".into())),
+                    },
+                    Some(c) => arg.push(c),
+                    None => return Err(statement_error("Unbalanced quotes".into())),
+                }
+            }
+        } else {
+            while let Some(&c) = chars.peek() {
+                if c.is_whitespace() {
+                    break;
+                }
+                arg.push(c);
+                chars.next();
+            }
+        }
+        args.push(arg);
+    }
+    Ok(args)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use tokio::io::BufReader;
+
+    #[tokio::test]
+    async fn test_auth_select_and_paged_reply() {
+        assert_eq!(
+            split_command_line(r#"SET greeting "hello \"world\"" 'a b'"#).unwrap(),
+            ["SET", "greeting", "hello \"world\"", "a b"]
+        );
+
+        let (client, mut server) = tokio::io::duplex(64 * 1024);
+        server
+            .write_all(b"+OK\r\n+OK\r\n*3\r\n$5\r\nuser1\r\n$-1\r\n*1\r\n:7\r\n-ERR unknown command 'NOPE'\r\n")
+            .await
+            .unwrap();
+
+        let options = ConnectOptions { user: String::new(), password: "pw".into(), database: "2".into() };
+        let io: Io = BufReader::new(Box::new(client));
+        let mut conn = RedisConnection::connect(io, &options).await.unwrap();
+
+        conn.query("MGET user1 missing").await.unwrap();
+        let page = conn.fetch(2);
+        assert_eq!((page.rows(), page.value(0, 0).as_deref(), page.value(0, 1)), (2, Some("user1"), None));
+        let page = conn.fetch(2);
+        assert_eq!((page.rows(), page.value(0, 0).as_deref()), (1, Some("7")));
+
+        let err = conn.query("NOPE").await.unwrap_err();
+        assert!(err.to_string().contains("unknown command"));
+
+        let mut sent = vec![0u8; 64];
+        let n = server.read(&mut sent).await.unwrap();
+        assert!(String::from_utf8_lossy(&sent[..n]).starts_with("*2\r\n$4\r\nAUTH\r\n$2\r\npw\r\n"));
+    }
+}
@@ -7,7 +7,15 @@ use std::ffi::{CStr, CString};
 use std::os::raw::c_char;
 use crate::terminal::TerminalSession;
 use crate::search;
+use crate::search::content;
+use crate::search::index::FsIndex;
+use crate::search::listing::DirListing;
+use crate::search::parallel::FileSearch;
+use crate::ssh::exec_stream::{ExecStream, StreamRead};
+use crate::ssh::follow::{FollowSource, Follower, DEFAULT_RING_LINES};
+use crate::ssh::monitor::{self, MonitorEvent, ServerMonitor, ServerSample};
 use crate::ssh::session::SshSession;
+use crate::ssh::sftp::{SftpClient, TransferOutcome};
 use crate::ssh::{SshConfig, SshAuth};
 use crate::ssh::service_detector;
 use std::sync::OnceLock;
@@ -24,22 +32,30 @@ fn ssh_runtime() -> &'static tokio::runtime::Runtime {
     })
 }
 
-/// Run an async future on the global SSH runtime, safely from any thread.
+/// Run an async future on the global SSH runtime and wait for its result,
+/// safely from any thread.
 ///
-/// `Runtime::block_on()` panics if called from a thread that already has
-/// a Tokio reactor context (e.g. a Tokio worker thread, or any thread that
-/// previously ran `block_on` and retained the thread-local reactor).
-/// This helper spawns a **dedicated OS thread** via `std::thread::spawn`
-/// so `block_on()` always gets a clean thread-local environment.
+/// The future runs as a task on the runtime's workers while the caller
+/// waits on a channel, so a call costs no thread creation. `block_on()`
+/// is avoided because it panics on threads that already have a Tokio
+/// context; when called from such a thread (e.g. a completion callback on
+/// a runtime worker), a dedicated OS thread does the waiting instead, so
+/// the worker's own tasks aren't stalled behind it.
 fn ffi_block_on<F, T>(future: F) -> T
 where
     F: std::future::Future<Output = T> + Send + 'static,
     T: Send + 'static,
 {
     let rt = ssh_runtime();
-    // Spawn a fresh OS thread to guarantee no Tokio context leaks.
-    let handle = std::thread::spawn(move || rt.block_on(future));
-    handle.join().expect("FFI blocking thread panicked")
+    if tokio::runtime::Handle::try_current().is_ok() {
+        let handle = std::thread::spawn(move || rt.block_on(future));
+        return handle.join().expect("FFI blocking thread panicked");
+    }
+    let (tx, rx) = std::sync::mpsc::sync_channel(1);
+    rt.spawn(async move {
+        let _ = tx.send(future.await);
+    });
+    rx.recv().expect("FFI task panicked")
 }
 
 /// Wrapper to send raw pointers across thread boundaries.
@@ -52,6 +68,112 @@ unsafe impl<T> Sync for SendPtr<T> {}
 impl<T> SendPtr<T> {
     fn as_ref(&self) -> &T { unsafe { &*self.0 } }
     fn as_mut(&self) -> &mut T { unsafe { &mut *self.0 } }
+    fn as_ptr(&self) -> *mut T { self.0 }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Result Buffers
+// ═══════════════════════════════════════════════════════════
+//
+// The `*_buffer` functions return arrays of `#[repr(C)]` structs instead of
+// JSON. Every string and nested array of a result lives in the same
+// allocation, so the caller reads fields in place and releases everything
+// with one `pier_result_free`.
+
+/// A string inside a result buffer. NUL-terminated; `len` excludes the NUL.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct PierStr {
+    pub ptr: *const c_char,
+    pub len: usize,
+}
+
+impl PierStr {
+    /// View as `&str`; invalid UTF-8 reads as empty.
+    ///
+    /// Safety: `ptr` must point at `len` readable bytes (or be null).
+    unsafe fn as_str<'a>(&self) -> &'a str {
+        if self.ptr.is_null() {
+            return "";
+        }
+        std::str::from_utf8(std::slice::from_raw_parts(self.ptr as *const u8, self.len)).unwrap_or("")
+    }
+}
+
+/// Array result: `count` items of the returning function's item type.
+/// Free with pier_result_free.
+#[repr(C)]
+pub struct PierResult {
+    pub items: *const std::ffi::c_void,
+    pub count: usize,
+}
+
+/// What a `PierResult` pointer really points at; the header comes first.
+#[repr(C)]
+struct ResultOwner {
+    header: PierResult,
+    _storage: Box<dyn std::any::Any>,
+}
+
+/// String storage for a result. Strings are packed into fixed chunks that
+/// are never reallocated, so handed-out pointers stay valid as it grows.
+#[derive(Default)]
+struct StringArena {
+    chunks: Vec<Vec<u8>>,
+}
+
+impl StringArena {
+    const CHUNK: usize = 64 * 1024;
+
+    /// Arena whose first chunk holds `bytes` (string bytes plus NULs).
+    fn with_capacity(bytes: usize) -> Self {
+        Self { chunks: vec![Vec::with_capacity(bytes)] }
+    }
+
+    fn push(&mut self, s: &str) -> PierStr {
+        self.push_bytes(s.as_bytes())
+    }
+
+    /// Like `push`, for bytes that may not be UTF-8.
+    fn push_bytes(&mut self, s: &[u8]) -> PierStr {
+        let need = s.len() + 1;
+        if self.chunks.last().map_or(true, |c| c.capacity() - c.len() < need) {
+            self.chunks.push(Vec::with_capacity(need.max(Self::CHUNK)));
+        }
+        let chunk = self.chunks.last_mut().unwrap();
+        let start = chunk.len();
+        chunk.extend_from_slice(s);
+        chunk.push(0);
+        PierStr {
+            ptr: chunk[start..].as_ptr() as *const c_char,
+            len: s.len(),
+        }
+    }
+}
+
+/// Hand `items` to the caller. `storage` keeps whatever the items point
+/// into (string arena, nested arrays) alive until pier_result_free.
+fn into_result<T: 'static, S: 'static>(items: Vec<T>, storage: S) -> *mut PierResult {
+    let header = PierResult {
+        items: items.as_ptr() as *const std::ffi::c_void,
+        count: items.len(),
+    };
+    // Moving the Vecs into the box leaves their heap buffers in place.
+    let owner = Box::new(ResultOwner {
+        header,
+        _storage: Box::new((items, storage)),
+    });
+    Box::into_raw(owner) as *mut PierResult
+}
+
+/// Free a result returned by any `*_buffer` function.
+#[no_mangle]
+pub extern "C" fn pier_result_free(result: *mut PierResult) {
+    if !result.is_null() {
+        unsafe {
+            drop(Box::from_raw(result as *mut ResultOwner));
+        }
+    }
 }
 
 // ═══════════════════════════════════════════════════════════
@@ -158,8 +280,9 @@ pub extern "C" fn pier_terminal_write(
 }
 
 /// Read output from the terminal.
-/// Writes data into the provided buffer and returns the number of bytes read.
-/// Returns -1 on failure.
+/// Reads directly into the provided buffer (no intermediate copy) and returns
+/// the number of bytes read. Data that does not fit stays queued in the PTY
+/// for the next call, so nothing is truncated. Returns -1 on failure.
 #[no_mangle]
 pub extern "C" fn pier_terminal_read(
     handle: PierTerminalHandle,
@@ -171,15 +294,10 @@ pub extern "C" fn pier_terminal_read(
     }
 
     let session = unsafe { &mut *handle };
+    let buf = unsafe { std::slice::from_raw_parts_mut(buffer, buffer_len) };
 
-    match session.read() {
-        Ok(data) => {
-            let copy_len = data.len().min(buffer_len);
-            unsafe {
-                std::ptr::copy_nonoverlapping(data.as_ptr(), buffer, copy_len);
-            }
-            copy_len as i64
-        }
+    match session.read_into(buf) {
+        Ok(n) => n as i64,
         Err(_) => -1,
     }
 }
@@ -212,6 +330,237 @@ pub extern "C" fn pier_terminal_fd(handle: PierTerminalHandle) -> i32 {
     session.pty.raw_fd()
 }
 
+/// Callback receiving coalesced PTY output on the reactor thread.
+/// `data`/`len` is valid only for the duration of the call; `data == NULL`
+/// means the PTY closed and no further calls will be made.
+pub type PierTerminalOutputCallback =
+    extern "C" fn(user_data: *mut std::os::raw::c_void, data: *const u8, len: usize);
+
+/// Deliver this terminal's output through the shared PTY reactor instead of
+/// polling `pier_terminal_read`. The callback is invoked at most once per
+/// frame interval with everything read in that frame (immediately for the
+/// first output after idle). It runs on the reactor thread and must not call
+/// `pier_terminal_watch`/`pier_terminal_unwatch`/`pier_terminal_destroy`;
+/// hop to another queue first. Do not mix with `pier_terminal_read`.
+/// Returns 0 on success, -1 on failure.
+#[no_mangle]
+pub extern "C" fn pier_terminal_watch(
+    handle: PierTerminalHandle,
+    callback: Option<PierTerminalOutputCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> i32 {
+    let Some(callback) = callback else { return -1 };
+    if handle.is_null() {
+        return -1;
+    }
+
+    let session = unsafe { &mut *handle };
+    let user_data = SendPtr(user_data);
+    let sink = Box::new(move |data: Option<&[u8]>| match data {
+        Some(bytes) => callback(user_data.as_ptr(), bytes.as_ptr(), bytes.len()),
+        None => callback(user_data.as_ptr(), std::ptr::null(), 0),
+    });
+    match session.watch_output(sink) {
+        Ok(()) => 0,
+        Err(e) => {
+            log::error!("Failed to watch terminal output: {}", e);
+            -1
+        }
+    }
+}
+
+/// Stop reactor delivery for a terminal. After this returns the callback
+/// will not be invoked again. `pier_terminal_destroy` does this implicitly.
+/// Returns 0 if the terminal was being watched, -1 otherwise.
+#[no_mangle]
+pub extern "C" fn pier_terminal_unwatch(handle: PierTerminalHandle) -> i32 {
+    if handle.is_null() {
+        return -1;
+    }
+    let session = unsafe { &mut *handle };
+    if session.unwatch_output() { 0 } else { -1 }
+}
+
+/// Set the reactor's output coalescing interval in microseconds
+/// (default 16667, one 60 Hz frame). Applies to all watched terminals.
+/// Returns 0 on success, -1 if the reactor is unavailable.
+#[no_mangle]
+pub extern "C" fn pier_terminal_set_frame_interval(micros: u32) -> i32 {
+    match crate::terminal::reactor::global() {
+        Some(reactor) => {
+            reactor.set_frame_interval(std::time::Duration::from_micros(micros as u64));
+            0
+        }
+        None => -1,
+    }
+}
+
+/// A single rendered cell, as handed to the Swift renderer.
+/// `fg`/`bg` are packed colors (`PIER_COLOR_*` tag in the high byte),
+/// `flags` is a bitset of `PIER_CELL_*` attributes.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct PierCell {
+    pub ch: u32,
+    pub fg: u32,
+    pub bg: u32,
+    pub flags: u32,
+}
+
+/// Frame header filled by `pier_terminal_snapshot_dirty`.
+#[repr(C)]
+pub struct PierTerminalFrame {
+    pub cols: u16,
+    pub rows: u16,
+    pub cursor_x: u16,
+    pub cursor_y: u16,
+    /// Number of damaged rows written to the output arrays.
+    pub dirty_rows: u32,
+    /// Damaged rows that did not fit and remain queued for the next call.
+    pub pending_rows: u32,
+}
+
+/// Feed PTY output bytes through the core VT emulator.
+/// Returns 0 on success, -1 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_terminal_process(
+    handle: PierTerminalHandle,
+    data: *const u8,
+    len: usize,
+) -> i32 {
+    if handle.is_null() || (data.is_null() && len > 0) {
+        return -1;
+    }
+
+    let session = unsafe { &mut *handle };
+    if len > 0 {
+        let bytes = unsafe { std::slice::from_raw_parts(data, len) };
+        session.process(bytes);
+    }
+    0
+}
+
+/// Copy the rows changed since the last call into caller-owned buffers.
+///
+/// - frame: receives grid size, cursor position and row counts
+/// - row_indices: receives the screen row index of each damaged row
+/// - cells: receives `cols` cells per damaged row, packed row after row
+/// - max_rows: capacity of `row_indices` (rows) and `cells` (max_rows * cols)
+///
+/// Rows that do not fit stay dirty for the next call.
+/// Returns the number of rows written, or -1 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_terminal_snapshot_dirty(
+    handle: PierTerminalHandle,
+    frame: *mut PierTerminalFrame,
+    row_indices: *mut u16,
+    cells: *mut PierCell,
+    max_rows: usize,
+) -> i32 {
+    if handle.is_null() || frame.is_null() || (max_rows > 0 && (row_indices.is_null() || cells.is_null())) {
+        return -1;
+    }
+
+    let session = unsafe { &mut *handle };
+    let emu = &mut session.emulator;
+    let cols = emu.cols;
+
+    let mut written = 0usize;
+    emu.drain_dirty(max_rows, |row, src| {
+        unsafe {
+            *row_indices.add(written) = row as u16;
+            let dst = cells.add(written * cols);
+            for (x, cell) in src.iter().enumerate() {
+                *dst.add(x) = to_pier_cell(cell);
+            }
+        }
+        written += 1;
+    });
+
+    unsafe {
+        *frame = PierTerminalFrame {
+            cols: emu.cols as u16,
+            rows: emu.rows as u16,
+            cursor_x: emu.cursor_x as u16,
+            cursor_y: emu.cursor_y as u16,
+            dirty_rows: written as u32,
+            pending_rows: emu.dirty_count() as u32,
+        };
+    }
+    written as i32
+}
+
+/// Number of lines currently held in the terminal's scrollback.
+/// Index 0 is the oldest retained line. Returns 0 on invalid handle.
+#[no_mangle]
+pub extern "C" fn pier_terminal_scrollback_len(handle: PierTerminalHandle) -> usize {
+    if handle.is_null() {
+        return 0;
+    }
+    let session = unsafe { &*handle };
+    session.emulator.scrollback().len()
+}
+
+/// Copy scrollback lines `[start, start + count)` into `cells`.
+/// Each line occupies exactly `cols` cells (truncated or blank-padded).
+/// Only the compressed blocks overlapping the range are decompressed.
+/// Returns the number of lines copied, or -1 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_terminal_scrollback_lines(
+    handle: PierTerminalHandle,
+    start: usize,
+    count: usize,
+    cells: *mut PierCell,
+    cols: u16,
+) -> i32 {
+    if handle.is_null() || (count > 0 && cells.is_null()) {
+        return -1;
+    }
+
+    let session = unsafe { &mut *handle };
+    let cols = cols as usize;
+    let blank = to_pier_cell(&crate::terminal::emulator::Cell::BLANK);
+
+    session.emulator.scrollback_mut().read_lines(start, count, |line, src| {
+        let dst = unsafe { cells.add((line - start) * cols) };
+        for x in 0..cols {
+            let cell = src.get(x).map(to_pier_cell).unwrap_or(blank);
+            unsafe { *dst.add(x) = cell; }
+        }
+    }) as i32
+}
+
+/// Set scrollback retention limits. `max_lines` = 0 disables scrollback.
+/// Returns 0 on success, -1 on invalid handle.
+#[no_mangle]
+pub extern "C" fn pier_terminal_set_scrollback_limits(
+    handle: PierTerminalHandle,
+    max_lines: usize,
+    max_bytes: usize,
+) -> i32 {
+    if handle.is_null() {
+        return -1;
+    }
+    let session = unsafe { &mut *handle };
+    let scrollback = session.emulator.scrollback_mut();
+    let config = crate::terminal::scrollback::ScrollbackConfig {
+        max_lines,
+        max_bytes,
+        ..scrollback.config()
+    };
+    scrollback.set_config(config);
+    0
+}
+
+fn to_pier_cell(cell: &crate::terminal::emulator::Cell) -> PierCell {
+    PierCell {
+        ch: cell.ch() as u32,
+        fg: cell.fg.packed(),
+        bg: cell.bg.packed(),
+        flags: cell.flags(),
+    }
+}
+
 // ═══════════════════════════════════════════════════════════
 // File Search FFI
 // ═══════════════════════════════════════════════════════════
@@ -260,523 +609,2620 @@ pub extern "C" fn pier_list_directory(path: *const c_char) -> *mut c_char {
     }
 }
 
-// ═══════════════════════════════════════════════════════════
-// SSH FFI
-// ═══════════════════════════════════════════════════════════
+/// A file or directory entry in a result buffer.
+#[repr(C)]
+pub struct PierFileEntry {
+    pub path: PierStr,
+    pub name: PierStr,
+    pub size: u64,
+    pub is_dir: bool,
+}
 
-/// Opaque pointer to an SSH session.
-pub type PierSshHandle = *mut SshSession;
+fn file_entries_result(entries: &[search::SearchResult]) -> *mut PierResult {
+    let mut arena = StringArena::default();
+    let items: Vec<PierFileEntry> = entries
+        .iter()
+        .map(|e| PierFileEntry {
+            path: arena.push(&e.path),
+            name: arena.push(&e.name),
+            size: e.size,
+            is_dir: e.is_dir,
+        })
+        .collect();
+    into_result(items, arena)
+}
 
-/// Connect to an SSH server.
-/// auth_type: 0 = password, 1 = key file
-/// credential: password string (auth_type=0) or key file path (auth_type=1)
-/// Returns null on failure.
+/// Search files like pier_search_files, returning a buffer of PierFileEntry.
+/// Caller must free with pier_result_free.
 #[no_mangle]
-pub extern "C" fn pier_ssh_connect(
-    host: *const c_char,
-    port: u16,
-    username: *const c_char,
-    auth_type: i32,
-    credential: *const c_char,
-) -> PierSshHandle {
-    if host.is_null() || username.is_null() || credential.is_null() {
+pub extern "C" fn pier_search_files_buffer(
+    root: *const c_char,
+    pattern: *const c_char,
+    max_results: usize,
+) -> *mut PierResult {
+    if root.is_null() || pattern.is_null() {
         return std::ptr::null_mut();
     }
 
-    let host_str = unsafe { CStr::from_ptr(host).to_str().unwrap_or("") };
-    let username_str = unsafe { CStr::from_ptr(username).to_str().unwrap_or("") };
-    let credential_str = unsafe { CStr::from_ptr(credential).to_str().unwrap_or("") };
+    let root_str = unsafe { CStr::from_ptr(root).to_str().unwrap_or("") };
+    let pattern_str = unsafe { CStr::from_ptr(pattern).to_str().unwrap_or("") };
 
-    let auth = match auth_type {
-        0 => SshAuth::Password(credential_str.to_string()),
-        1 => SshAuth::KeyFile {
-            path: credential_str.to_string(),
-            passphrase: None,
-        },
-        _ => {
-            log::error!("Unknown SSH auth type: {}", auth_type);
-            return std::ptr::null_mut();
-        }
-    };
+    file_entries_result(&search::search_files(root_str, pattern_str, max_results))
+}
 
-    let config = SshConfig {
-        host: host_str.to_string(),
-        port,
-        username: username_str.to_string(),
-        auth,
-    };
+/// List a directory like pier_list_directory, returning a buffer of PierFileEntry.
+/// Caller must free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_list_directory_buffer(path: *const c_char) -> *mut PierResult {
+    if path.is_null() {
+        return std::ptr::null_mut();
+    }
 
-    let mut session = SshSession::new(config);
+    let path_str = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") };
 
-    // Use ffi_block_on to safely run async connect on a fresh thread
-    match ffi_block_on(async move { session.connect().await.map(|()| session) }) {
-        Ok(connected_session) => {
-            log::info!("SSH connected to {}:{}", host_str, port);
-            Box::into_raw(Box::new(connected_session))
-        }
-        Err(e) => {
-            log::error!("SSH connect failed: {}", e);
-            std::ptr::null_mut()
-        }
+    match search::list_directory(path_str) {
+        Ok(entries) => file_entries_result(&entries),
+        Err(_) => std::ptr::null_mut(),
     }
 }
 
-/// Disconnect an SSH session and free the handle.
+/// Opaque handle to a sorted directory snapshot.
+pub type PierDirListingHandle = *mut DirListing;
+
+/// Read and sort a directory for paging with pier_dir_listing_page.
+/// Entry types come from the directory itself; nothing is stat'ed yet.
+/// Free with pier_dir_listing_close. Returns null if it can't be read.
 #[no_mangle]
-pub extern "C" fn pier_ssh_disconnect(handle: PierSshHandle) -> i32 {
-    if handle.is_null() {
-        return -1;
+pub extern "C" fn pier_dir_listing_open(path: *const c_char) -> PierDirListingHandle {
+    if path.is_null() {
+        return std::ptr::null_mut();
     }
-
-    let mut session = unsafe { Box::from_raw(handle) };
-    match ffi_block_on(async move { session.disconnect().await }) {
-        Ok(()) => {
-            log::info!("SSH disconnected");
-            0
-        }
+    let path_str = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") };
+    match DirListing::open(path_str) {
+        Ok(listing) => Box::into_raw(Box::new(listing)),
         Err(e) => {
-            log::error!("SSH disconnect error: {}", e);
-            -1
+            log::error!("Failed to list {}: {}", path_str, e);
+            std::ptr::null_mut()
         }
     }
 }
 
-/// Check if SSH session is connected.
-/// Returns 1 if connected, 0 if not, -1 on invalid handle.
+/// Number of entries in the listing, or -1 on a null handle.
 #[no_mangle]
-pub extern "C" fn pier_ssh_is_connected(handle: PierSshHandle) -> i32 {
-    if handle.is_null() {
+pub extern "C" fn pier_dir_listing_count(listing: PierDirListingHandle) -> i64 {
+    if listing.is_null() {
         return -1;
     }
-    // Safety: we only read, handle is valid
-    let session = unsafe { &*handle };
-    if session.is_connected() { 1 } else { 0 }
+    let listing = unsafe { &*listing };
+    listing.len() as i64
 }
 
-/// Detect services installed on the remote server.
-/// Returns a JSON array of DetectedService.
-/// Caller must free with pier_string_free.
+/// Entries `offset..offset + limit` as a buffer of PierFileEntry, sizes
+/// included. Only this window is stat'ed. Not thread-safe per handle.
+/// Caller must free with pier_result_free.
 #[no_mangle]
-pub extern "C" fn pier_ssh_detect_services(handle: PierSshHandle) -> *mut c_char {
-    if handle.is_null() {
+pub extern "C" fn pier_dir_listing_page(
+    listing: PierDirListingHandle,
+    offset: usize,
+    limit: usize,
+) -> *mut PierResult {
+    if listing.is_null() {
         return std::ptr::null_mut();
     }
+    let listing = unsafe { &mut *listing };
+    file_entries_result(&listing.page(offset, limit))
+}
 
-    let session_ptr = SendPtr(handle);
-
-    // 30-second overall timeout for service detection to prevent blocking
-    // when the SSH connection is dead (e.g. network change).
-    let services = match ffi_block_on(async move {
-        let session = session_ptr.as_ref();
-        tokio::time::timeout(
-            std::time::Duration::from_secs(30),
-            service_detector::detect_all(session),
-        ).await
-    }) {
-        Ok(services) => services,
-        Err(_) => {
-            log::warn!("Service detection timed out after 30s");
-            Vec::new()
-        }
-    };
-
-    match serde_json::to_string(&services) {
-        Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
-        Err(e) => {
-            log::error!("Failed to serialize services: {}", e);
-            std::ptr::null_mut()
+/// Free a directory listing.
+#[no_mangle]
+pub extern "C" fn pier_dir_listing_close(listing: PierDirListingHandle) {
+    if !listing.is_null() {
+        unsafe {
+            drop(Box::from_raw(listing));
         }
     }
 }
 
-/// Execute a command on the remote server.
-/// Returns JSON: {"exit_code": N, "stdout": "..."}
-/// Caller must free with pier_string_free.
+/// A streamed filename search hit; valid only during the callback.
+#[repr(C)]
+pub struct PierSearchHit {
+    pub path: PierStr,
+    pub name: PierStr,
+    pub is_dir: bool,
+}
+
+/// Receives batches of search hits on a background thread; `hits` is valid
+/// only for the duration of the call. The last call has `done == true` and
+/// no hits. Return 0 to continue, non-zero to stop the search.
+pub type PierSearchCallback = extern "C" fn(
+    user_data: *mut std::os::raw::c_void,
+    hits: *const PierSearchHit,
+    count: usize,
+    done: bool,
+) -> i32;
+
+/// Opaque handle to a running filename search.
+pub type PierFileSearchHandle = *mut FileSearch;
+
+/// Search file names under `root` on all cores, streaming matches to
+/// `callback` in batches as they are found. Stop (or free, once done) with
+/// pier_search_files_stop; start a new search per query and stop the old one.
+/// Returns null on invalid arguments.
 #[no_mangle]
-pub extern "C" fn pier_ssh_exec(
-    handle: PierSshHandle,
-    command: *const c_char,
-) -> *mut c_char {
-    if handle.is_null() || command.is_null() {
+pub extern "C" fn pier_search_files_start(
+    root: *const c_char,
+    pattern: *const c_char,
+    max_results: usize,
+    callback: Option<PierSearchCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> PierFileSearchHandle {
+    let Some(callback) = callback else { return std::ptr::null_mut() };
+    if root.is_null() || pattern.is_null() {
         return std::ptr::null_mut();
     }
 
-    let cmd_str = unsafe { CStr::from_ptr(command).to_str().unwrap_or("") };
-    let session_ptr = SendPtr(handle as *mut SshSession);
-    let cmd_string = cmd_str.to_string();
+    let root_str = unsafe { CStr::from_ptr(root).to_str().unwrap_or("") }.to_string();
+    let pattern_str = unsafe { CStr::from_ptr(pattern).to_str().unwrap_or("") }.to_string();
+
+    let user_data = SendPtr(user_data);
+    let search = FileSearch::start(root_str, pattern_str, max_results, move |hits, done| {
+        // Hits own their paths as Strings; copy them into a NUL-terminated batch.
+        let bytes = hits.iter().map(|hit| hit.path.len() + hit.name().len() + 2).sum();
+        let mut arena = StringArena::with_capacity(bytes);
+        let items: Vec<PierSearchHit> = hits
+            .iter()
+            .map(|hit| PierSearchHit {
+                path: arena.push(&hit.path),
+                name: arena.push(hit.name()),
+                is_dir: hit.is_dir,
+            })
+            .collect();
+        callback(user_data.as_ptr(), items.as_ptr(), items.len(), done) == 0
+    });
+    Box::into_raw(Box::new(search))
+}
 
-    // 60-second overall timeout to prevent blocking the FFI thread indefinitely
-    // when the SSH connection is dead (e.g. network change).
-    match ffi_block_on(async move {
-        let session = session_ptr.as_ref();
-        tokio::time::timeout(
-            std::time::Duration::from_secs(60),
-            session.exec_command(&cmd_string),
-        ).await
-    }) {
-        Ok(Ok((exit_code, stdout))) => {
-            let result = serde_json::json!({
-                "exit_code": exit_code,
-                "stdout": stdout,
-            });
-            match CString::new(result.to_string()) {
-                Ok(cs) => cs.into_raw(),
-                Err(_) => std::ptr::null_mut(),
-            }
+/// Stop a filename search and free its handle. After this returns the
+/// callback will not be invoked again. Must not be called from the callback.
+#[no_mangle]
+pub extern "C" fn pier_search_files_stop(search: PierFileSearchHandle) {
+    if !search.is_null() {
+        unsafe {
+            drop(Box::from_raw(search));
         }
-        Ok(Err(e)) => {
-            log::error!("SSH exec failed: {}", e);
-            let err = serde_json::json!({
-                "exit_code": -1,
-                "stdout": format!("Error: {}", e),
-            });
-            CString::new(err.to_string()).unwrap_or_default().into_raw()
+    }
+}
+
+/// A streamed content search match; valid only during the callback.
+#[repr(C)]
+pub struct PierContentMatch {
+    pub path: PierStr,
+    /// The matching line, without its terminator (cut at 512 bytes).
+    pub line: PierStr,
+    /// 1-based.
+    pub line_number: u64,
+    /// Byte range of the first match within `line`.
+    pub match_start: usize,
+    pub match_end: usize,
+}
+
+/// Receives batches of matching lines on a background thread; `matches` is
+/// valid only for the duration of the call. The last call has
+/// `done == true` and no matches. Return 0 to continue, non-zero to stop.
+pub type PierContentCallback = extern "C" fn(
+    user_data: *mut std::os::raw::c_void,
+    matches: *const PierContentMatch,
+    count: usize,
+    done: bool,
+) -> i32;
+
+/// Opaque handle to a running content search.
+pub type PierContentSearchHandle = *mut FileSearch;
+
+/// Search the contents of files under `root` on all cores, streaming
+/// matching lines to `callback` as they are found. `pattern` is literal
+/// text unless `regex` is set. Binary files are skipped, and .gitignore is
+/// respected like in pier_search_files_start. Stop (or free, once done)
+/// with pier_search_content_stop. Returns null on invalid arguments,
+/// including a pattern that is not a valid regex.
+#[no_mangle]
+pub extern "C" fn pier_search_content_start(
+    root: *const c_char,
+    pattern: *const c_char,
+    regex: bool,
+    case_sensitive: bool,
+    max_results: usize,
+    callback: Option<PierContentCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> PierContentSearchHandle {
+    let Some(callback) = callback else { return std::ptr::null_mut() };
+    if root.is_null() || pattern.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let root_str = unsafe { CStr::from_ptr(root).to_str().unwrap_or("") }.to_string();
+    let pattern_str = unsafe { CStr::from_ptr(pattern).to_str().unwrap_or("") };
+    if pattern_str.is_empty() {
+        return std::ptr::null_mut();
+    }
+    let options = content::ContentOptions { regex, case_sensitive };
+    let matcher = match content::build_matcher(pattern_str, options) {
+        Ok(matcher) => matcher,
+        Err(e) => {
+            log::error!("Invalid content search pattern: {}", e);
+            return std::ptr::null_mut();
         }
-        Err(_) => {
-            log::warn!("SSH exec timed out after 60s for command: {}", cmd_str);
-            let err = serde_json::json!({
-                "exit_code": -1,
-                "stdout": "Error: command timed out after 60s",
-            });
-            CString::new(err.to_string()).unwrap_or_default().into_raw()
+    };
+
+    let user_data = SendPtr(user_data);
+    let search = content::start_content_search(root_str, matcher, max_results, move |hits, done| {
+        let bytes = hits.iter().map(|hit| hit.path.len() + hit.line.len() + 2).sum();
+        let mut arena = StringArena::with_capacity(bytes);
+        let mut last_path: Option<(&str, PierStr)> = None;
+        let items: Vec<PierContentMatch> = hits
+            .iter()
+            .map(|hit| {
+                // Matches arrive grouped by file; share the path string.
+                let path = match last_path {
+                    Some((p, s)) if p == hit.path => s,
+                    _ => arena.push(&hit.path),
+                };
+                last_path = Some((&hit.path, path));
+                PierContentMatch {
+                    path,
+                    line: arena.push(&hit.line),
+                    line_number: hit.line_number,
+                    match_start: hit.match_start,
+                    match_end: hit.match_end,
+                }
+            })
+            .collect();
+        callback(user_data.as_ptr(), items.as_ptr(), items.len(), done) == 0
+    });
+    Box::into_raw(Box::new(search))
+}
+
+/// Stop a content search and free its handle. After this returns the
+/// callback will not be invoked again. Must not be called from the callback.
+#[no_mangle]
+pub extern "C" fn pier_search_content_stop(search: PierContentSearchHandle) {
+    if !search.is_null() {
+        unsafe {
+            drop(Box::from_raw(search));
         }
     }
 }
 
-// ═══════════════════════════════════════════════════════════
-// SSH Port Forwarding FFI
-// ═══════════════════════════════════════════════════════════
+/// Opaque handle to a filename index for one root.
+pub type PierFsIndexHandle = *mut FsIndex;
 
-/// Start local port forwarding: 127.0.0.1:local_port → remote_host:remote_port.
-/// Returns 0 on success, -1 on failure.
+/// Start indexing `root` in the background. With a non-null `cache_dir`
+/// the index is loaded from (and saved back to) a file there, so queries
+/// work before the first crawl finishes. Free with pier_fs_index_close.
+/// Returns null on invalid arguments.
 #[no_mangle]
-pub extern "C" fn pier_ssh_forward_port(
-    handle: PierSshHandle,
-    local_port: u16,
-    remote_host: *const c_char,
-    remote_port: u16,
-) -> i32 {
-    if handle.is_null() || remote_host.is_null() {
+pub extern "C" fn pier_fs_index_open(root: *const c_char, cache_dir: *const c_char) -> PierFsIndexHandle {
+    if root.is_null() {
+        return std::ptr::null_mut();
+    }
+    let root_str = unsafe { CStr::from_ptr(root).to_str().unwrap_or("") };
+    if root_str.is_empty() {
+        return std::ptr::null_mut();
+    }
+    let cache_dir = (!cache_dir.is_null())
+        .then(|| unsafe { CStr::from_ptr(cache_dir).to_str().unwrap_or("") })
+        .filter(|dir| !dir.is_empty())
+        .map(std::path::Path::new);
+
+    Box::into_raw(Box::new(FsIndex::open(root_str, cache_dir)))
+}
+
+/// 1 once the index holds a crawl (or a cached one), 0 while the first
+/// crawl is running, -1 on a null handle.
+#[no_mangle]
+pub extern "C" fn pier_fs_index_is_ready(index: PierFsIndexHandle) -> i32 {
+    if index.is_null() {
         return -1;
     }
+    let index = unsafe { &*index };
+    index.is_ready() as i32
+}
 
-    let host_str = unsafe { CStr::from_ptr(remote_host).to_str().unwrap_or("") };
-    let session_ptr = SendPtr(handle);
-    let host_string = host_str.to_string();
+/// Search file names in the index like pier_search_files_buffer, without
+/// touching the disk. Caller must free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_fs_index_search(
+    index: PierFsIndexHandle,
+    pattern: *const c_char,
+    max_results: usize,
+) -> *mut PierResult {
+    if index.is_null() || pattern.is_null() {
+        return std::ptr::null_mut();
+    }
+    let index = unsafe { &*index };
+    let pattern_str = unsafe { CStr::from_ptr(pattern).to_str().unwrap_or("") };
+    file_entries_result(&index.search(pattern_str, max_results))
+}
 
-    // 10-second timeout: TcpListener::bind + SSH channel setup
-    match ffi_block_on(async move {
-        let session = session_ptr.as_mut();
-        tokio::time::timeout(
-            std::time::Duration::from_secs(10),
-            session.start_port_forward(local_port, &host_string, remote_port),
-        ).await
-    }) {
-        Ok(Ok(())) => 0,
-        Ok(Err(e)) => {
-            log::error!("Port forward failed: {}", e);
-            -1
+/// List a directory like pier_list_directory_buffer, served from the
+/// index's listing cache while it is current.
+/// Caller must free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_fs_index_list_directory(index: PierFsIndexHandle, path: *const c_char) -> *mut PierResult {
+    if index.is_null() || path.is_null() {
+        return std::ptr::null_mut();
+    }
+    let index = unsafe { &*index };
+    let path_str = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") };
+    match index.list_directory(path_str) {
+        Ok(entries) => file_entries_result(&entries),
+        Err(_) => std::ptr::null_mut(),
+    }
+}
+
+/// Stop watching, save the index to its cache file and free the handle.
+#[no_mangle]
+pub extern "C" fn pier_fs_index_close(index: PierFsIndexHandle) {
+    if !index.is_null() {
+        unsafe {
+            drop(Box::from_raw(index));
         }
-        Err(_) => {
-            log::warn!("Port forward timed out after 10s for port {}", local_port);
-            -1
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// SSH FFI
+// ═══════════════════════════════════════════════════════════
+
+/// Opaque pointer to an SSH session.
+pub type PierSshHandle = *mut SshSession;
+
+/// Connect to an SSH server.
+/// Joins the open connection with the same host, port, user and
+/// credentials if there is one, skipping the handshake.
+/// auth_type: 0 = password, 1 = key file
+/// credential: password string (auth_type=0) or key file path (auth_type=1)
+/// Returns null on failure.
+#[no_mangle]
+pub extern "C" fn pier_ssh_connect(
+    host: *const c_char,
+    port: u16,
+    username: *const c_char,
+    auth_type: i32,
+    credential: *const c_char,
+) -> PierSshHandle {
+    let Some(config) = ssh_config_from_c(host, port, username, auth_type, credential) else {
+        return std::ptr::null_mut();
+    };
+
+    let mut session = SshSession::new(config);
+    match ffi_block_on(async move { connect_session(&mut session).await.map(|()| session) }) {
+        Ok(connected_session) => Box::into_raw(Box::new(connected_session)),
+        Err(_) => std::ptr::null_mut(),
+    }
+}
+
+/// Parse `pier_ssh_connect`'s arguments; None (logged) if they're invalid.
+fn ssh_config_from_c(
+    host: *const c_char,
+    port: u16,
+    username: *const c_char,
+    auth_type: i32,
+    credential: *const c_char,
+) -> Option<SshConfig> {
+    if host.is_null() || username.is_null() || credential.is_null() {
+        return None;
+    }
+
+    let host_str = unsafe { CStr::from_ptr(host).to_str().unwrap_or("") };
+    let username_str = unsafe { CStr::from_ptr(username).to_str().unwrap_or("") };
+    let credential_str = unsafe { CStr::from_ptr(credential).to_str().unwrap_or("") };
+
+    let auth = match auth_type {
+        0 => SshAuth::Password(credential_str.to_string()),
+        1 => SshAuth::KeyFile {
+            path: credential_str.to_string(),
+            passphrase: None,
+        },
+        _ => {
+            log::error!("Unknown SSH auth type: {}", auth_type);
+            return None;
         }
+    };
+
+    Some(SshConfig {
+        host: host_str.to_string(),
+        port,
+        username: username_str.to_string(),
+        auth,
+    })
+}
+
+async fn connect_session(session: &mut SshSession) -> Result<(), anyhow::Error> {
+    let result = session.connect().await;
+    match &result {
+        Ok(()) => log::info!("SSH connected to {}:{}", session.config().host, session.config().port),
+        Err(e) => log::error!("SSH connect failed: {}", e),
     }
+    result
 }
 
-/// Stop a local port forward.
-/// Returns 0 on success, -1 if no such forward.
+/// Disconnect an SSH session and free the handle.
+/// Stops its forwards; the connection itself closes once no other handle
+/// uses it.
 #[no_mangle]
-pub extern "C" fn pier_ssh_stop_forward(handle: PierSshHandle, local_port: u16) -> i32 {
+pub extern "C" fn pier_ssh_disconnect(handle: PierSshHandle) -> i32 {
     if handle.is_null() {
         return -1;
     }
 
-    let session = unsafe { &mut *handle };
-    match session.stop_port_forward(local_port) {
-        Ok(()) => 0,
+    let mut session = unsafe { Box::from_raw(handle) };
+    match ffi_block_on(async move { session.disconnect().await }) {
+        Ok(()) => {
+            log::info!("SSH disconnected");
+            0
+        }
         Err(e) => {
-            log::error!("Stop forward failed: {}", e);
+            log::error!("SSH disconnect error: {}", e);
             -1
         }
     }
 }
 
-/// List active forward ports as a JSON array.
+/// Check if SSH session is connected.
+/// Returns 1 if connected, 0 if not, -1 on invalid handle.
+#[no_mangle]
+pub extern "C" fn pier_ssh_is_connected(handle: PierSshHandle) -> i32 {
+    if handle.is_null() {
+        return -1;
+    }
+    // Safety: we only read, handle is valid
+    let session = unsafe { &*handle };
+    if session.is_connected() { 1 } else { 0 }
+}
+
+/// Detect services installed on the remote server.
+/// Returns a JSON array of DetectedService.
 /// Caller must free with pier_string_free.
 #[no_mangle]
-pub extern "C" fn pier_ssh_list_forwards(handle: PierSshHandle) -> *mut c_char {
+pub extern "C" fn pier_ssh_detect_services(handle: PierSshHandle) -> *mut c_char {
     if handle.is_null() {
         return std::ptr::null_mut();
     }
 
-    let session = unsafe { &*handle };
-    let ports = session.active_forwards();
-
-    match serde_json::to_string(&ports) {
-        Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
-        Err(_) => std::ptr::null_mut(),
+    let session_ptr = SendPtr(handle);
+    match ffi_block_on(async move { detect_services_json(session_ptr.as_ref()).await }) {
+        Some(json) => CString::new(json).unwrap_or_default().into_raw(),
+        None => std::ptr::null_mut(),
     }
 }
 
-// ═══════════════════════════════════════════════════════════
-// Git Graph FFI — direct .git access via libgit2
-// ═══════════════════════════════════════════════════════════
+async fn detect_services_json(session: &SshSession) -> Option<String> {
+    // 30-second overall timeout for service detection to prevent blocking
+    // when the SSH connection is dead (e.g. network change).
+    let services = match tokio::time::timeout(
+        std::time::Duration::from_secs(30),
+        service_detector::detect_all(session),
+    ).await {
+        Ok(services) => services,
+        Err(_) => {
+            log::warn!("Service detection timed out after 30s");
+            Vec::new()
+        }
+    };
 
-use crate::git_graph;
+    match serde_json::to_string(&services) {
+        Ok(json) => Some(json),
+        Err(e) => {
+            log::error!("Failed to serialize services: {}", e);
+            None
+        }
+    }
+}
 
-/// Load commit graph data. Returns JSON string.
+/// Execute a command on the remote server.
+/// Returns JSON: {"exit_code": N, "stdout": "..."}
 /// Caller must free with pier_string_free.
-///
-/// Parameters:
-/// - repo_path: path to the Git repository
-/// - limit: max commits to return
-/// - skip: number of commits to skip (for pagination)
-/// - branch: branch name filter (null = all branches)
-/// - author: author name filter (null = no filter)
-/// - search_text: text to grep in commit messages (null = no filter)
-/// - after_timestamp: unix timestamp for date filter (0 = no filter)
-/// - topo_order: true for topological sort
-/// - first_parent: true for first-parent only
-/// - no_merges: true to exclude merge commits
-/// - paths: newline-separated list of paths to filter by (null = no filter)
 #[no_mangle]
-pub extern "C" fn pier_git_graph_log(
-    repo_path: *const c_char,
-    limit: u32,
-    skip: u32,
-    branch: *const c_char,
-    author: *const c_char,
-    search_text: *const c_char,
-    after_timestamp: i64,
-    topo_order: bool,
-    first_parent: bool,
-    no_merges: bool,
-    paths: *const c_char,
+pub extern "C" fn pier_ssh_exec(
+    handle: PierSshHandle,
+    command: *const c_char,
 ) -> *mut c_char {
-    if repo_path.is_null() {
+    if handle.is_null() || command.is_null() {
         return std::ptr::null_mut();
     }
 
-    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
-    let branch_opt = if branch.is_null() { None } else {
-        unsafe { CStr::from_ptr(branch).to_str().ok().map(|s| s.to_string()) }
-    };
-    let author_opt = if author.is_null() { None } else {
-        unsafe { CStr::from_ptr(author).to_str().ok().map(|s| s.to_string()) }
+    let cmd_string = unsafe { CStr::from_ptr(command).to_str().unwrap_or("") }.to_string();
+    let session_ptr = SendPtr(handle as *mut SshSession);
+    let _signpost = crate::metrics::signpost!("ssh_exec");
+    let (_, json) = ffi_block_on(async move { exec_json(session_ptr.as_ref(), &cmd_string).await });
+    CString::new(json).unwrap_or_default().into_raw()
+}
+
+/// Run `command` and describe the outcome as `pier_ssh_exec` JSON, with
+/// `PIER_REQUEST_OK` if the command ran (whatever its exit code).
+async fn exec_json(session: &SshSession, command: &str) -> (i32, String) {
+    // 60-second overall timeout to prevent blocking the FFI thread indefinitely
+    // when the SSH connection is dead (e.g. network change).
+    match tokio::time::timeout(
+        std::time::Duration::from_secs(60),
+        session.exec_command(command),
+    ).await {
+        Ok(Ok((exit_code, stdout))) => {
+            let result = serde_json::json!({
+                "exit_code": exit_code,
+                "stdout": stdout,
+            });
+            (PIER_REQUEST_OK, result.to_string())
+        }
+        Ok(Err(e)) => {
+            log::error!("SSH exec failed: {}", e);
+            let err = serde_json::json!({
+                "exit_code": -1,
+                "stdout": format!("Error: {}", e),
+            });
+            (PIER_REQUEST_FAILED, err.to_string())
+        }
+        Err(_) => {
+            log::warn!("SSH exec timed out after 60s for command: {}", command);
+            let err = serde_json::json!({
+                "exit_code": -1,
+                "stdout": "Error: command timed out after 60s",
+            });
+            (PIER_REQUEST_FAILED, err.to_string())
+        }
+    }
+}
+
+/// Set how many `pier_ssh_exec` commands may run at once on this connection
+/// (default 5). Further commands queue in arrival order.
+/// Returns 0 on success, -1 on failure.
+#[no_mangle]
+pub extern "C" fn pier_ssh_set_max_concurrent_execs(handle: PierSshHandle, max: u32) -> i32 {
+    if handle.is_null() || max == 0 {
+        return -1;
+    }
+    let session = unsafe { &mut *handle };
+    session.set_max_concurrent_execs(max as usize);
+    0
+}
+
+/// Opaque pointer to a streaming remote command.
+pub type PierExecStreamHandle = *mut ExecStream;
+
+/// Start a command and stream its output instead of buffering it.
+/// Read output with `pier_ssh_stream_read`; free with `pier_ssh_stream_close`.
+/// The stream stays valid after the SSH handle is disconnected (reads then
+/// report the end of output).
+/// Returns null on failure.
+#[no_mangle]
+pub extern "C" fn pier_ssh_exec_stream(
+    handle: PierSshHandle,
+    command: *const c_char,
+) -> PierExecStreamHandle {
+    if handle.is_null() || command.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let cmd_string = unsafe { CStr::from_ptr(command).to_str().unwrap_or("") }.to_string();
+    let session_ptr = SendPtr(handle as *mut SshSession);
+
+    match ffi_block_on(async move {
+        let session = session_ptr.as_ref();
+        tokio::time::timeout(
+            std::time::Duration::from_secs(30),
+            session.exec_stream(&cmd_string),
+        ).await
+    }) {
+        Ok(Ok(stream)) => Box::into_raw(Box::new(stream)),
+        Ok(Err(e)) => {
+            log::error!("SSH exec stream failed: {}", e);
+            std::ptr::null_mut()
+        }
+        Err(_) => {
+            log::warn!("SSH exec stream timed out waiting for a channel");
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Read the next chunk of output, waiting up to `timeout_ms`.
+/// Each call returns bytes from one stream; `*kind` is set to 1 (stdout)
+/// or 2 (stderr). Returns the byte count, 0 on timeout, -1 once the command
+/// has finished and all output was read, -2 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_ssh_stream_read(
+    stream: PierExecStreamHandle,
+    buffer: *mut u8,
+    buffer_len: usize,
+    kind: *mut u8,
+    timeout_ms: u32,
+) -> i64 {
+    if stream.is_null() || buffer.is_null() || buffer_len == 0 {
+        return -2;
+    }
+
+    let stream = unsafe { &*stream };
+    let buf = unsafe { std::slice::from_raw_parts_mut(buffer, buffer_len) };
+
+    match stream.read(buf, std::time::Duration::from_millis(timeout_ms as u64)) {
+        StreamRead::Data(k, n) => {
+            if !kind.is_null() {
+                unsafe { *kind = k as u8 };
+            }
+            n as i64
+        }
+        StreamRead::TimedOut => 0,
+        StreamRead::Finished => -1,
+    }
+}
+
+/// Exit status of a streaming command, or -1 while it is still running
+/// (or if the server never reported one).
+#[no_mangle]
+pub extern "C" fn pier_ssh_stream_exit_code(stream: PierExecStreamHandle) -> i32 {
+    if stream.is_null() {
+        return -1;
+    }
+    let stream = unsafe { &*stream };
+    stream.exit_code().unwrap_or(-1)
+}
+
+/// Cancel a streaming command (if still running) and free the handle.
+#[no_mangle]
+pub extern "C" fn pier_ssh_stream_close(stream: PierExecStreamHandle) {
+    if !stream.is_null() {
+        unsafe {
+            drop(Box::from_raw(stream));
+        }
+    }
+}
+
+/// Opaque pointer to a remote log follower.
+pub type PierFollowHandle = *mut Follower;
+
+/// Follow a remote log over one long-lived channel.
+/// `kind` is 0 for a file path, 1 for a Docker container ID/name.
+/// Starts with the last `backlog` lines; `capacity` bounds the lines kept
+/// for polling (0 = default). Free with `pier_ssh_follow_stop`.
+/// Returns null on failure.
+#[no_mangle]
+pub extern "C" fn pier_ssh_follow_start(
+    handle: PierSshHandle,
+    kind: u8,
+    target: *const c_char,
+    backlog: u32,
+    capacity: u32,
+) -> PierFollowHandle {
+    if handle.is_null() || target.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let target_str = unsafe { CStr::from_ptr(target).to_str().unwrap_or("") }.to_string();
+    let source = match kind {
+        0 => FollowSource::File(target_str),
+        1 => FollowSource::Docker(target_str),
+        _ => return std::ptr::null_mut(),
+    };
+    let capacity = if capacity == 0 { DEFAULT_RING_LINES } else { capacity as usize };
+    let session_ptr = SendPtr(handle as *mut SshSession);
+
+    match ffi_block_on(async move {
+        let session = session_ptr.as_ref();
+        tokio::time::timeout(
+            std::time::Duration::from_secs(30),
+            session.follow(&source, backlog as usize, capacity),
+        ).await
+    }) {
+        Ok(Ok(follower)) => Box::into_raw(Box::new(follower)),
+        Ok(Err(e)) => {
+            log::error!("SSH follow failed: {}", e);
+            std::ptr::null_mut()
+        }
+        Err(_) => {
+            log::warn!("SSH follow timed out waiting for a channel");
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Fetch up to `max` lines with sequence number >= `since`.
+/// Returns JSON: {"lines": [{"seq", "text", "timestamp", "level", "message"}],
+/// "next": N, "skipped": N, "finished": bool}. Pass `next` as `since` on the
+/// following call; `skipped` counts lines evicted before they were read.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_ssh_follow_poll(
+    follow: PierFollowHandle,
+    since: u64,
+    max: u32,
+) -> *mut c_char {
+    if follow.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let follower = unsafe { &*follow };
+    let batch = follower.lines_since(since, max as usize);
+    match serde_json::to_string(&batch) {
+        Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+        Err(e) => {
+            log::error!("Failed to serialize follow batch: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Stop following (closes the remote channel) and free the handle.
+#[no_mangle]
+pub extern "C" fn pier_ssh_follow_stop(follow: PierFollowHandle) {
+    if !follow.is_null() {
+        unsafe {
+            drop(Box::from_raw(follow));
+        }
+    }
+}
+
+/// Receives server monitor events on a background thread. Each call has
+/// either a `sample` or a `details_json` ({"hostname", "kernel", "disks",
+/// "processes", "gpus"}); both are valid only for the duration of the call.
+/// A final call with both null means the agent exited.
+pub type PierMonitorCallback = extern "C" fn(
+    user_data: *mut std::os::raw::c_void,
+    sample: *const ServerSample,
+    details_json: *const c_char,
+);
+
+/// Opaque pointer to a running server monitor.
+pub type PierMonitorHandle = *mut ServerMonitor;
+
+/// Start monitoring the server over one long-lived channel: a sample every
+/// `interval_secs`, and details every `slow_every` samples (0 = defaults).
+/// Stop and free with `pier_ssh_monitor_stop`. Returns null on failure.
+#[no_mangle]
+pub extern "C" fn pier_ssh_monitor_start(
+    handle: PierSshHandle,
+    interval_secs: u32,
+    slow_every: u32,
+    callback: Option<PierMonitorCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> PierMonitorHandle {
+    let Some(callback) = callback else { return std::ptr::null_mut() };
+    if handle.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let interval_secs = if interval_secs == 0 { monitor::DEFAULT_INTERVAL_SECS } else { interval_secs };
+    let slow_every = if slow_every == 0 { monitor::DEFAULT_SLOW_EVERY } else { slow_every };
+    let session_ptr = SendPtr(handle as *mut SshSession);
+    let user_data = SendPtr(user_data);
+    let on_event = move |event: Option<MonitorEvent>| match event {
+        Some(MonitorEvent::Sample(sample)) => callback(user_data.as_ptr(), &sample, std::ptr::null()),
+        Some(MonitorEvent::Details(details)) => {
+            let json = serde_json::to_string(&details).unwrap_or_default();
+            let json = CString::new(json).unwrap_or_default();
+            callback(user_data.as_ptr(), std::ptr::null(), json.as_ptr());
+        }
+        None => callback(user_data.as_ptr(), std::ptr::null(), std::ptr::null()),
+    };
+
+    match ffi_block_on(async move {
+        let session = session_ptr.as_ref();
+        tokio::time::timeout(
+            std::time::Duration::from_secs(30),
+            session.monitor(interval_secs, slow_every, on_event),
+        ).await
+    }) {
+        Ok(Ok(monitor)) => Box::into_raw(Box::new(monitor)),
+        Ok(Err(e)) => {
+            log::error!("SSH monitor failed: {}", e);
+            std::ptr::null_mut()
+        }
+        Err(_) => {
+            log::warn!("SSH monitor timed out waiting for a channel");
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Stop the monitor (closes the remote channel) and free the handle.
+/// No callbacks are made after this returns.
+#[no_mangle]
+pub extern "C" fn pier_ssh_monitor_stop(monitor: PierMonitorHandle) {
+    if !monitor.is_null() {
+        unsafe {
+            drop(Box::from_raw(monitor));
+        }
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// SFTP FFI
+// ═══════════════════════════════════════════════════════════
+
+/// Opaque pointer to an SFTP session.
+pub type PierSftpHandle = *mut SftpClient;
+
+/// Transfer progress callback: bytes done and total bytes. Runs on an
+/// internal worker thread. Return 0 to continue, non-zero to cancel.
+pub type PierTransferProgressCallback =
+    extern "C" fn(user_data: *mut std::os::raw::c_void, done: u64, total: u64) -> i32;
+
+/// Open an SFTP session on an existing SSH connection.
+/// Returns null on failure. Free with `pier_sftp_close`.
+#[no_mangle]
+pub extern "C" fn pier_sftp_open(handle: PierSshHandle) -> PierSftpHandle {
+    if handle.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let session_ptr = SendPtr(handle as *mut SshSession);
+    match ffi_block_on(async move {
+        let session = session_ptr.as_ref();
+        tokio::time::timeout(std::time::Duration::from_secs(30), session.open_sftp()).await
+    }) {
+        Ok(Ok(client)) => Box::into_raw(Box::new(client)),
+        Ok(Err(e)) => {
+            log::error!("SFTP open failed: {}", e);
+            std::ptr::null_mut()
+        }
+        Err(_) => {
+            log::warn!("SFTP open timed out");
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Close an SFTP session.
+#[no_mangle]
+pub extern "C" fn pier_sftp_close(handle: PierSftpHandle) {
+    if !handle.is_null() {
+        unsafe {
+            drop(Box::from_raw(handle));
+        }
+    }
+}
+
+/// Wrap an optional C progress callback as a Rust closure.
+fn transfer_progress(
+    callback: Option<PierTransferProgressCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> impl FnMut(u64, u64) -> bool + Send + 'static {
+    let user_data = SendPtr(user_data);
+    move |done, total| match callback {
+        Some(cb) => cb(user_data.as_ptr(), done, total) == 0,
+        None => true,
+    }
+}
+
+/// Download a remote file with pipelined reads.
+/// With `resume`, a shorter existing local file is continued from its end.
+/// Returns 0 on success, 1 if cancelled by the callback, -1 on failure.
+#[no_mangle]
+pub extern "C" fn pier_sftp_download(
+    handle: PierSftpHandle,
+    remote_path: *const c_char,
+    local_path: *const c_char,
+    resume: bool,
+    progress: Option<PierTransferProgressCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> i32 {
+    if handle.is_null() || remote_path.is_null() || local_path.is_null() {
+        return -1;
+    }
+
+    let remote = unsafe { CStr::from_ptr(remote_path).to_str().unwrap_or("") }.to_string();
+    let local = unsafe { CStr::from_ptr(local_path).to_str().unwrap_or("") }.to_string();
+    let client_ptr = SendPtr(handle);
+    let on_progress = transfer_progress(progress, user_data);
+
+    match ffi_block_on(async move {
+        let client = client_ptr.as_ref();
+        client.download_with_progress(&remote, std::path::Path::new(&local), resume, on_progress).await
+    }) {
+        Ok(TransferOutcome::Completed) => 0,
+        Ok(TransferOutcome::Cancelled) => 1,
+        Err(e) => {
+            log::error!("SFTP download failed: {}", e);
+            -1
+        }
+    }
+}
+
+/// Upload a local file with pipelined writes.
+/// With `resume`, an existing remote file is continued (the last few
+/// chunks are re-sent to cover writes that may have landed out of order).
+/// Returns 0 on success, 1 if cancelled by the callback, -1 on failure.
+#[no_mangle]
+pub extern "C" fn pier_sftp_upload(
+    handle: PierSftpHandle,
+    local_path: *const c_char,
+    remote_path: *const c_char,
+    resume: bool,
+    progress: Option<PierTransferProgressCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> i32 {
+    if handle.is_null() || remote_path.is_null() || local_path.is_null() {
+        return -1;
+    }
+
+    let local = unsafe { CStr::from_ptr(local_path).to_str().unwrap_or("") }.to_string();
+    let remote = unsafe { CStr::from_ptr(remote_path).to_str().unwrap_or("") }.to_string();
+    let client_ptr = SendPtr(handle);
+    let on_progress = transfer_progress(progress, user_data);
+
+    match ffi_block_on(async move {
+        let client = client_ptr.as_ref();
+        client.upload_with_progress(std::path::Path::new(&local), &remote, resume, on_progress).await
+    }) {
+        Ok(TransferOutcome::Completed) => 0,
+        Ok(TransferOutcome::Cancelled) => 1,
+        Err(e) => {
+            log::error!("SFTP upload failed: {}", e);
+            -1
+        }
+    }
+}
+
+/// List a remote directory as a JSON array of entries (directories first).
+/// Served from the session's listing cache while fresh; subdirectories are
+/// then prefetched in the background. Returns null on failure.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_sftp_list_dir(handle: PierSftpHandle, path: *const c_char) -> *mut c_char {
+    if handle.is_null() || path.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let path_str = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") }.to_string();
+    let client_ptr = SendPtr(handle);
+    match ffi_block_on(async move {
+        let client = client_ptr.as_ref();
+        tokio::time::timeout(std::time::Duration::from_secs(30), client.list_dir(&path_str)).await
+    }) {
+        Ok(Ok(entries)) => match serde_json::to_string(&entries) {
+            Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+            Err(_) => std::ptr::null_mut(),
+        },
+        Ok(Err(e)) => {
+            log::error!("SFTP list failed: {}", e);
+            std::ptr::null_mut()
+        }
+        Err(_) => {
+            log::warn!("SFTP list timed out");
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Drop cached listings for `path` and everything below it, after the
+/// remote side was changed some other way (e.g. a shell command).
+/// Returns 0 on success, -1 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_sftp_invalidate(handle: PierSftpHandle, path: *const c_char) -> i32 {
+    if handle.is_null() || path.is_null() {
+        return -1;
+    }
+    let client = unsafe { &*handle };
+    let path_str = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") };
+    client.invalidate(path_str);
+    0
+}
+
+// ═══════════════════════════════════════════════════════════
+// SSH Port Forwarding FFI
+// ═══════════════════════════════════════════════════════════
+
+/// Start local port forwarding: 127.0.0.1:local_port → remote_host:remote_port.
+/// Returns 0 on success, -1 on failure.
+#[no_mangle]
+pub extern "C" fn pier_ssh_forward_port(
+    handle: PierSshHandle,
+    local_port: u16,
+    remote_host: *const c_char,
+    remote_port: u16,
+) -> i32 {
+    if handle.is_null() || remote_host.is_null() {
+        return -1;
+    }
+
+    let host_string = unsafe { CStr::from_ptr(remote_host).to_str().unwrap_or("") }.to_string();
+    let session_ptr = SendPtr(handle);
+    ffi_block_on(async move {
+        forward_port(session_ptr.as_mut(), local_port, &host_string, remote_port).await
+    })
+}
+
+/// Start a forward; 0 on success, -1 on failure (logged).
+async fn forward_port(session: &mut SshSession, local_port: u16, remote_host: &str, remote_port: u16) -> i32 {
+    // 10-second timeout: TcpListener::bind + SSH channel setup
+    match tokio::time::timeout(
+        std::time::Duration::from_secs(10),
+        session.start_port_forward(local_port, remote_host, remote_port),
+    ).await {
+        Ok(Ok(())) => 0,
+        Ok(Err(e)) => {
+            log::error!("Port forward failed: {}", e);
+            -1
+        }
+        Err(_) => {
+            log::warn!("Port forward timed out after 10s for port {}", local_port);
+            -1
+        }
+    }
+}
+
+/// Stop a local port forward.
+/// Returns 0 on success, -1 if no such forward.
+#[no_mangle]
+pub extern "C" fn pier_ssh_stop_forward(handle: PierSshHandle, local_port: u16) -> i32 {
+    if handle.is_null() {
+        return -1;
+    }
+
+    let session = unsafe { &mut *handle };
+    match session.stop_port_forward(local_port) {
+        Ok(()) => 0,
+        Err(e) => {
+            log::error!("Stop forward failed: {}", e);
+            -1
+        }
+    }
+}
+
+/// List active forwards as a JSON array of objects with `local_port`,
+/// `remote_host`, `remote_port`, `bytes_up`, `bytes_down`, `up_per_sec`,
+/// `down_per_sec` (averaged since the previous call), `active_connections`,
+/// `total_connections` and `uptime_secs`.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_ssh_list_forwards(handle: PierSshHandle) -> *mut c_char {
+    if handle.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let session = unsafe { &*handle };
+    let forwards = session.forward_stats();
+
+    match serde_json::to_string(&forwards) {
+        Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+        Err(_) => std::ptr::null_mut(),
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Async SSH FFI — non-blocking requests with completion callbacks
+// ═══════════════════════════════════════════════════════════
+//
+// The `*_async` variants return a request id at once and run on the SSH
+// runtime's workers; the blocking calls above tie up the calling thread
+// until the remote side answers. Each request's callback is called exactly
+// once, on completion, failure or cancellation. The session handle must
+// stay valid until then: cancel outstanding requests and wait for their
+// callbacks before `pier_ssh_disconnect`.
+
+/// Request callback status: succeeded.
+pub const PIER_REQUEST_OK: i32 = 0;
+
+/// Request callback status: failed or timed out (details are logged).
+pub const PIER_REQUEST_FAILED: i32 = -1;
+
+/// Request callback status: cancelled with `pier_ssh_cancel`.
+pub const PIER_REQUEST_CANCELLED: i32 = -2;
+
+/// Completion of an async request, on a runtime worker thread. `status` is
+/// a `PIER_REQUEST_*` value; `result` is the JSON the blocking call returns,
+/// or null, and is valid only for the duration of the call.
+pub type PierRequestCallback = extern "C" fn(
+    user_data: *mut std::os::raw::c_void,
+    request_id: u64,
+    status: i32,
+    result: *const c_char,
+);
+
+static NEXT_REQUEST_ID: std::sync::atomic::AtomicU64 = std::sync::atomic::AtomicU64::new(1);
+
+/// Cancel signals of the requests still running, by id.
+fn pending_requests() -> &'static std::sync::Mutex<std::collections::HashMap<u64, tokio::sync::oneshot::Sender<()>>> {
+    static PENDING: OnceLock<std::sync::Mutex<std::collections::HashMap<u64, tokio::sync::oneshot::Sender<()>>>> =
+        OnceLock::new();
+    PENDING.get_or_init(Default::default)
+}
+
+/// Spawn `work` on the SSH runtime and report its (status, JSON) result to
+/// `callback`. Returns the request id.
+fn submit_request<F>(callback: PierRequestCallback, user_data: *mut std::os::raw::c_void, work: F) -> u64
+where
+    F: std::future::Future<Output = (i32, Option<String>)> + Send + 'static,
+{
+    let id = NEXT_REQUEST_ID.fetch_add(1, std::sync::atomic::Ordering::Relaxed);
+    let (cancel_tx, cancel_rx) = tokio::sync::oneshot::channel();
+    pending_requests().lock().unwrap().insert(id, cancel_tx);
+    let user_data = SendPtr(user_data);
+
+    ssh_runtime().spawn(async move {
+        // Dropping `work` on cancel closes its channels and timers.
+        let (status, result) = tokio::select! {
+            outcome = work => outcome,
+            _ = cancel_rx => (PIER_REQUEST_CANCELLED, None),
+        };
+        pending_requests().lock().unwrap().remove(&id);
+        let result = result.and_then(|json| CString::new(json).ok());
+        callback(user_data.as_ptr(), id, status, result.as_ref().map_or(std::ptr::null(), |json| json.as_ptr()));
+    });
+    id
+}
+
+/// Create a session handle without connecting; connect it with
+/// `pier_ssh_connect_async`. Arguments are as for `pier_ssh_connect`.
+/// Free with `pier_ssh_disconnect`. Returns null on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_ssh_session_new(
+    host: *const c_char,
+    port: u16,
+    username: *const c_char,
+    auth_type: i32,
+    credential: *const c_char,
+) -> PierSshHandle {
+    match ssh_config_from_c(host, port, username, auth_type, credential) {
+        Some(config) => Box::into_raw(Box::new(SshSession::new(config))),
+        None => std::ptr::null_mut(),
+    }
+}
+
+/// Connect a handle from `pier_ssh_session_new`. The handle must not be
+/// used by other calls until the callback runs (with a null result).
+/// Returns the request id, or 0 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_ssh_connect_async(
+    handle: PierSshHandle,
+    callback: Option<PierRequestCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> u64 {
+    let Some(callback) = callback else { return 0 };
+    if handle.is_null() {
+        return 0;
+    }
+
+    let session_ptr = SendPtr(handle);
+    submit_request(callback, user_data, async move {
+        match connect_session(session_ptr.as_mut()).await {
+            Ok(()) => (PIER_REQUEST_OK, None),
+            Err(_) => (PIER_REQUEST_FAILED, None),
+        }
+    })
+}
+
+/// Non-blocking `pier_ssh_exec`; the callback gets the same JSON.
+/// Returns the request id, or 0 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_ssh_exec_async(
+    handle: PierSshHandle,
+    command: *const c_char,
+    callback: Option<PierRequestCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> u64 {
+    let Some(callback) = callback else { return 0 };
+    if handle.is_null() || command.is_null() {
+        return 0;
+    }
+
+    let cmd_string = unsafe { CStr::from_ptr(command).to_str().unwrap_or("") }.to_string();
+    let session_ptr = SendPtr(handle);
+    submit_request(callback, user_data, async move {
+        let (status, json) = exec_json(session_ptr.as_ref(), &cmd_string).await;
+        (status, Some(json))
+    })
+}
+
+/// Non-blocking `pier_ssh_detect_services`; the callback gets the same
+/// JSON array. Returns the request id, or 0 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_ssh_detect_services_async(
+    handle: PierSshHandle,
+    callback: Option<PierRequestCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> u64 {
+    let Some(callback) = callback else { return 0 };
+    if handle.is_null() {
+        return 0;
+    }
+
+    let session_ptr = SendPtr(handle);
+    submit_request(callback, user_data, async move {
+        match detect_services_json(session_ptr.as_ref()).await {
+            Some(json) => (PIER_REQUEST_OK, Some(json)),
+            None => (PIER_REQUEST_FAILED, None),
+        }
+    })
+}
+
+/// Non-blocking `pier_ssh_forward_port`; the callback's result is null.
+/// The handle must not be used by other calls until the callback runs.
+/// Returns the request id, or 0 on invalid arguments.
+#[no_mangle]
+pub extern "C" fn pier_ssh_forward_port_async(
+    handle: PierSshHandle,
+    local_port: u16,
+    remote_host: *const c_char,
+    remote_port: u16,
+    callback: Option<PierRequestCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> u64 {
+    let Some(callback) = callback else { return 0 };
+    if handle.is_null() || remote_host.is_null() {
+        return 0;
+    }
+
+    let host_string = unsafe { CStr::from_ptr(remote_host).to_str().unwrap_or("") }.to_string();
+    let session_ptr = SendPtr(handle);
+    submit_request(callback, user_data, async move {
+        match forward_port(session_ptr.as_mut(), local_port, &host_string, remote_port).await {
+            0 => (PIER_REQUEST_OK, None),
+            _ => (PIER_REQUEST_FAILED, None),
+        }
+    })
+}
+
+/// Cancel an async request. Its callback still runs, with
+/// `PIER_REQUEST_CANCELLED`, unless it had already completed.
+/// Returns 0 if the request was pending, -1 if it had already finished.
+#[no_mangle]
+pub extern "C" fn pier_ssh_cancel(request_id: u64) -> i32 {
+    match pending_requests().lock().unwrap().remove(&request_id) {
+        Some(cancel) => {
+            let _ = cancel.send(());
+            0
+        }
+        None => -1,
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Database FFI — native MySQL / PostgreSQL / Redis clients
+// ═══════════════════════════════════════════════════════════
+
+use crate::db::{ConnectOptions, DbClient, DbKind, DbStream, Page};
+
+/// Opaque pointer to a logged-in database connection.
+pub type PierDbHandle = *mut DbClient;
+
+/// Connect and log in. `kind`: 0 = MySQL, 1 = PostgreSQL, 2 = Redis.
+/// With an SSH handle, `host:port` is reached from the server over a
+/// direct-tcpip channel; with null, it's a local TCP connection (e.g. an
+/// existing tunnel). `user`, `password` and `database` may be null.
+/// Free with `pier_db_close`. Returns null on failure (details are logged).
+#[no_mangle]
+pub extern "C" fn pier_db_connect(
+    kind: u8,
+    ssh: PierSshHandle,
+    host: *const c_char,
+    port: u16,
+    user: *const c_char,
+    password: *const c_char,
+    database: *const c_char,
+) -> PierDbHandle {
+    let Some(kind) = DbKind::from_code(kind) else {
+        log::error!("Unknown database kind: {}", kind);
+        return std::ptr::null_mut();
+    };
+    if host.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let text = |s: *const c_char| {
+        if s.is_null() {
+            String::new()
+        } else {
+            unsafe { CStr::from_ptr(s).to_str().unwrap_or("") }.to_string()
+        }
+    };
+    let host_string = text(host);
+    let options = ConnectOptions { user: text(user), password: text(password), database: text(database) };
+    let session_ptr = SendPtr(ssh);
+
+    match ffi_block_on(async move {
+        tokio::time::timeout(std::time::Duration::from_secs(30), async {
+            let stream: Box<dyn DbStream> = if session_ptr.as_ptr().is_null() {
+                Box::new(tokio::net::TcpStream::connect((host_string.as_str(), port)).await?)
+            } else {
+                Box::new(session_ptr.as_ref().open_direct_tcpip(&host_string, port).await?)
+            };
+            DbClient::connect(kind, stream, &options).await
+        }).await
+    }) {
+        Ok(Ok(client)) => Box::into_raw(Box::new(client)),
+        Ok(Err(e)) => {
+            log::error!("Database connect failed: {}", e);
+            std::ptr::null_mut()
+        }
+        Err(_) => {
+            log::warn!("Database connect timed out after 30s");
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Run a statement (a command line for Redis). Returns JSON
+/// {"columns": [{"name", "type_name"}], "affected_rows": N, "message": "..."}
+/// or {"error": "..."}; read rows with `pier_db_fetch_buffer`. Anything
+/// left of the previous result is discarded first.
+/// After a timeout or a broken connection every later call fails with
+/// "Connection lost, reconnect"; close the handle and connect again.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_db_query(db: PierDbHandle, sql: *const c_char) -> *mut c_char {
+    if db.is_null() || sql.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let sql_string = unsafe { CStr::from_ptr(sql).to_str().unwrap_or("") }.to_string();
+    let client_ptr = SendPtr(db);
+    let result = ffi_block_on(async move {
+        tokio::time::timeout(std::time::Duration::from_secs(60), client_ptr.as_mut().query(&sql_string)).await
+    });
+
+    let json = match result {
+        Ok(Ok(outcome)) => serde_json::to_string(&outcome).unwrap_or_default(),
+        Ok(Err(e)) => serde_json::json!({ "error": e.to_string() }).to_string(),
+        Err(_) => serde_json::json!({ "error": "Query timed out after 60s; connection lost, reconnect" }).to_string(),
+    };
+    CString::new(json).unwrap_or_default().into_raw()
+}
+
+/// One column of a fetched page: `rows` cells, top to bottom. A NULL cell
+/// has a null `ptr`. Cells are the bytes the server sent: UTF-8 for text,
+/// anything for BLOB and binary columns.
+#[repr(C)]
+pub struct PierDbColumn {
+    pub cells: *const PierStr,
+    pub rows: usize,
+}
+
+fn db_page_result(page: &Page) -> *mut PierResult {
+    let mut arena = StringArena::with_capacity(page.byte_len() + page.rows() * page.column_count());
+    let mut cells: Vec<PierStr> = Vec::with_capacity(page.rows() * page.column_count());
+    for column in 0..page.column_count() {
+        for row in 0..page.rows() {
+            cells.push(match page.bytes(column, row) {
+                Some(value) => arena.push_bytes(value),
+                None => PierStr { ptr: std::ptr::null(), len: 0 },
+            });
+        }
+    }
+    let items: Vec<PierDbColumn> = (0..page.column_count())
+        .map(|column| PierDbColumn { cells: cells[column * page.rows()..].as_ptr(), rows: page.rows() })
+        .collect();
+    into_result(items, (arena, cells))
+}
+
+/// Read up to `max_rows` more rows of the last query's result, as an array
+/// of `PierDbColumn`. A page with fewer rows than asked for is the last;
+/// further calls return empty pages. Returns null on failure.
+/// Free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_db_fetch_buffer(db: PierDbHandle, max_rows: u32) -> *mut PierResult {
+    if db.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let client_ptr = SendPtr(db);
+    let result = ffi_block_on(async move {
+        tokio::time::timeout(std::time::Duration::from_secs(60), client_ptr.as_mut().fetch(max_rows as usize)).await
+    });
+    match result {
+        Ok(Ok(page)) => db_page_result(&page),
+        Ok(Err(e)) => {
+            log::error!("Database fetch failed: {}", e);
+            std::ptr::null_mut()
+        }
+        Err(_) => {
+            log::warn!("Database fetch timed out after 60s; the connection must be reopened");
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Check whether the connection is still usable.
+/// Returns 1 if it is, 0 once it's lost (reconnect), -1 on invalid handle.
+#[no_mangle]
+pub extern "C" fn pier_db_is_connected(db: PierDbHandle) -> i32 {
+    if db.is_null() {
+        return -1;
+    }
+    // Safety: we only read, handle is valid
+    let client = unsafe { &*db };
+    if client.is_connected() { 1 } else { 0 }
+}
+
+/// Close the connection and free the handle.
+#[no_mangle]
+pub extern "C" fn pier_db_close(db: PierDbHandle) {
+    if !db.is_null() {
+        unsafe {
+            drop(Box::from_raw(db));
+        }
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Git Graph FFI — direct .git access via libgit2
+// ═══════════════════════════════════════════════════════════
+
+use crate::git_graph;
+
+/// Load commit graph data. Returns JSON string.
+/// Caller must free with pier_string_free.
+///
+/// Parameters:
+/// - repo_path: path to the Git repository
+/// - limit: max commits to return
+/// - skip: number of commits to skip (for pagination)
+/// - branch: branch name filter (null = all branches)
+/// - author: author name filter (null = no filter)
+/// - search_text: text to grep in commit messages (null = no filter)
+/// - after_timestamp: unix timestamp for date filter (0 = no filter)
+/// - topo_order: true for topological sort
+/// - first_parent: true for first-parent only
+/// - no_merges: true to exclude merge commits
+/// - paths: newline-separated list of paths to filter by (null = no filter)
+#[no_mangle]
+pub extern "C" fn pier_git_graph_log(
+    repo_path: *const c_char,
+    limit: u32,
+    skip: u32,
+    branch: *const c_char,
+    author: *const c_char,
+    search_text: *const c_char,
+    after_timestamp: i64,
+    topo_order: bool,
+    first_parent: bool,
+    no_merges: bool,
+    paths: *const c_char,
+) -> *mut c_char {
+    let commits = match graph_log_from_ffi(
+        repo_path, limit, skip, branch, author, search_text,
+        after_timestamp, topo_order, first_parent, no_merges, paths,
+    ) {
+        Some(commits) => commits,
+        None => return std::ptr::null_mut(),
+    };
+
+    match serde_json::to_string(&commits) {
+        Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+        Err(_) => std::ptr::null_mut(),
+    }
+}
+
+/// A commit in a result buffer; also the input to the layout `*_buffer` calls.
+#[repr(C)]
+pub struct PierCommit {
+    pub hash: PierStr,
+    pub parents: PierStr,
+    pub short_hash: PierStr,
+    pub refs: PierStr,
+    pub message: PierStr,
+    pub author: PierStr,
+    pub date_timestamp: i64,
+}
+
+/// Load commit graph data like pier_git_graph_log (same parameters),
+/// returning a buffer of PierCommit. The items can be passed straight to
+/// pier_git_layout_append_buffer.
+/// Caller must free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_git_graph_log_buffer(
+    repo_path: *const c_char,
+    limit: u32,
+    skip: u32,
+    branch: *const c_char,
+    author: *const c_char,
+    search_text: *const c_char,
+    after_timestamp: i64,
+    topo_order: bool,
+    first_parent: bool,
+    no_merges: bool,
+    paths: *const c_char,
+) -> *mut PierResult {
+    let commits = match graph_log_from_ffi(
+        repo_path, limit, skip, branch, author, search_text,
+        after_timestamp, topo_order, first_parent, no_merges, paths,
+    ) {
+        Some(commits) => commits,
+        None => return std::ptr::null_mut(),
+    };
+
+    let mut arena = StringArena::default();
+    let items: Vec<PierCommit> = commits
+        .iter()
+        .map(|c| PierCommit {
+            hash: arena.push(&c.hash),
+            parents: arena.push(&c.parents),
+            short_hash: arena.push(&c.short_hash),
+            refs: arena.push(&c.refs),
+            message: arena.push(&c.message),
+            author: arena.push(&c.author),
+            date_timestamp: c.date_timestamp,
+        })
+        .collect();
+    into_result(items, arena)
+}
+
+/// Shared argument handling for the graph log entry points.
+#[allow(clippy::too_many_arguments)]
+fn graph_log_from_ffi(
+    repo_path: *const c_char,
+    limit: u32,
+    skip: u32,
+    branch: *const c_char,
+    author: *const c_char,
+    search_text: *const c_char,
+    after_timestamp: i64,
+    topo_order: bool,
+    first_parent: bool,
+    no_merges: bool,
+    paths: *const c_char,
+) -> Option<Vec<git_graph::CommitEntry>> {
+    if repo_path.is_null() {
+        return None;
+    }
+
+    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+    let branch_opt = if branch.is_null() { None } else {
+        unsafe { CStr::from_ptr(branch).to_str().ok().map(|s| s.to_string()) }
+    };
+    let author_opt = if author.is_null() { None } else {
+        unsafe { CStr::from_ptr(author).to_str().ok().map(|s| s.to_string()) }
+    };
+    let search_opt = if search_text.is_null() { None } else {
+        unsafe { CStr::from_ptr(search_text).to_str().ok().map(|s| s.to_string()) }
+    };
+    let path_list = if paths.is_null() { Vec::new() } else {
+        unsafe { CStr::from_ptr(paths).to_str().unwrap_or("") }
+            .split('\n')
+            .map(|s| s.trim().to_string())
+            .filter(|s| !s.is_empty())
+            .collect()
+    };
+
+    let filter = git_graph::GraphFilter {
+        branch: branch_opt,
+        author: author_opt,
+        search_text: search_opt,
+        after_timestamp,
+        topo_order,
+        first_parent_only: first_parent,
+        no_merges,
+        paths: path_list,
+    };
+
+    match git_graph::graph_log(repo_str, limit as usize, skip as usize, &filter) {
+        Ok(commits) => Some(commits),
+        Err(e) => {
+            log::error!("pier_git_graph_log failed: {}", e);
+            None
+        }
+    }
+}
+
+/// Get first-parent chain hashes. Returns JSON array of strings.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_git_first_parent_chain(
+    repo_path: *const c_char,
+    ref_name: *const c_char,
+    limit: u32,
+) -> *mut c_char {
+    if repo_path.is_null() || ref_name.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+    let ref_str = unsafe { CStr::from_ptr(ref_name).to_str().unwrap_or("HEAD") };
+
+    match git_graph::first_parent_chain(repo_str, ref_str, limit as usize) {
+        Ok(hashes) => {
+            match serde_json::to_string(&hashes) {
+                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+                Err(_) => std::ptr::null_mut(),
+            }
+        }
+        Err(e) => {
+            log::error!("pier_git_first_parent_chain failed: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// List all branches (local + remote). Returns JSON array of strings.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_git_list_branches(repo_path: *const c_char) -> *mut c_char {
+    if repo_path.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+
+    match git_graph::list_branches(repo_str) {
+        Ok(branches) => {
+            match serde_json::to_string(&branches) {
+                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+                Err(_) => std::ptr::null_mut(),
+            }
+        }
+        Err(e) => {
+            log::error!("pier_git_list_branches failed: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// List unique commit authors. Returns JSON array of strings.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_git_list_authors(repo_path: *const c_char, limit: u32) -> *mut c_char {
+    if repo_path.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+
+    match git_graph::list_authors(repo_str, limit as usize) {
+        Ok(authors) => {
+            match serde_json::to_string(&authors) {
+                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+                Err(_) => std::ptr::null_mut(),
+            }
+        }
+        Err(e) => {
+            log::error!("pier_git_list_authors failed: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// List tracked files (git ls-files equivalent). Returns JSON array of strings.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_git_list_tracked_files(repo_path: *const c_char) -> *mut c_char {
+    if repo_path.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+
+    match git_graph::list_tracked_files(repo_str) {
+        Ok(files) => {
+            match serde_json::to_string(&files) {
+                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+                Err(_) => std::ptr::null_mut(),
+            }
+        }
+        Err(e) => {
+            log::error!("pier_git_list_tracked_files failed: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// List tracked files like pier_git_list_tracked_files, returning a buffer
+/// of PierStr paths. Caller must free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_git_list_tracked_files_buffer(repo_path: *const c_char) -> *mut PierResult {
+    if repo_path.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+
+    match git_graph::list_tracked_files(repo_str) {
+        Ok(files) => {
+            let mut arena = StringArena::default();
+            let items: Vec<PierStr> = files.iter().map(|f| arena.push(f)).collect();
+            into_result(items, arena)
+        }
+        Err(e) => {
+            log::error!("pier_git_list_tracked_files failed: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Detect the default branch (main/master/HEAD). Returns the branch name as a C string.
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_git_detect_default_branch(repo_path: *const c_char) -> *mut c_char {
+    if repo_path.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+
+    match git_graph::detect_default_branch(repo_str) {
+        Ok(branch) => CString::new(branch).unwrap_or_default().into_raw(),
+        Err(e) => {
+            log::error!("pier_git_detect_default_branch failed: {}", e);
+            CString::new("HEAD").unwrap_or_default().into_raw()
+        }
+    }
+}
+
+/// Compute IDEA-style graph layout. Returns JSON array of GraphRow.
+/// Caller must free with pier_string_free.
+///
+/// Parameters:
+/// - commits_json: JSON from pier_git_graph_log
+/// - main_chain_json: JSON from pier_git_first_parent_chain
+/// - lane_width: pixel width of each lane column
+/// - row_height: pixel height of each row
+/// - show_long_edges: true for expanded mode, false for collapsed
+#[no_mangle]
+pub extern "C" fn pier_git_compute_graph_layout(
+    commits_json: *const c_char,
+    main_chain_json: *const c_char,
+    lane_width: f32,
+    row_height: f32,
+    show_long_edges: bool,
+) -> *mut c_char {
+    if commits_json.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let commits_str = unsafe { CStr::from_ptr(commits_json).to_str().unwrap_or("[]") };
+    let main_chain_str = if main_chain_json.is_null() {
+        "[]"
+    } else {
+        unsafe { CStr::from_ptr(main_chain_json).to_str().unwrap_or("[]") }
     };
-    let search_opt = if search_text.is_null() { None } else {
-        unsafe { CStr::from_ptr(search_text).to_str().ok().map(|s| s.to_string()) }
+
+    // Deserialize inputs
+    let commits: Vec<git_graph::LayoutInput> = match serde_json::from_str(commits_str) {
+        Ok(c) => c,
+        Err(e) => {
+            log::error!("pier_git_compute_graph_layout: failed to parse commits: {}", e);
+            return std::ptr::null_mut();
+        }
     };
-    let path_list = if paths.is_null() { Vec::new() } else {
-        unsafe { CStr::from_ptr(paths).to_str().unwrap_or("") }
-            .split('\n')
-            .map(|s| s.trim().to_string())
-            .filter(|s| !s.is_empty())
-            .collect()
+    let main_chain_hashes: Vec<String> = serde_json::from_str(main_chain_str).unwrap_or_default();
+    let main_chain: std::collections::HashSet<String> = main_chain_hashes.into_iter().collect();
+
+    let params = git_graph::LayoutParams {
+        lane_width,
+        row_height,
+        show_long_edges,
     };
 
-    let filter = git_graph::GraphFilter {
-        branch: branch_opt,
-        author: author_opt,
-        search_text: search_opt,
-        after_timestamp,
-        topo_order,
-        first_parent_only: first_parent,
-        no_merges,
-        paths: path_list,
+    let rows = git_graph::compute_graph_layout(&commits, &main_chain, &params);
+
+    match serde_json::to_string(&rows) {
+        Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+        Err(e) => {
+            log::error!("pier_git_compute_graph_layout: serialization failed: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// A laid-out graph row in a result buffer. `segments` and `arrows` point
+/// into the same result.
+#[repr(C)]
+pub struct PierGraphRow {
+    pub row: usize,
+    pub node_column: i32,
+    pub color_index: i32,
+    pub commit: PierCommit,
+    pub segments: *const git_graph::PrintSegment,
+    pub segment_count: usize,
+    pub arrows: *const git_graph::ArrowElement,
+    pub arrow_count: usize,
+}
+
+fn graph_rows_result(rows: Vec<(usize, git_graph::GraphRow)>) -> *mut PierResult {
+    let mut arena = StringArena::default();
+    let mut segments: Vec<git_graph::PrintSegment> = Vec::new();
+    let mut arrows: Vec<git_graph::ArrowElement> = Vec::new();
+    let mut items: Vec<PierGraphRow> = Vec::with_capacity(rows.len());
+
+    for (row, r) in rows {
+        items.push(PierGraphRow {
+            row,
+            node_column: r.node_column,
+            color_index: r.color_index,
+            commit: PierCommit {
+                hash: arena.push(&r.hash),
+                parents: arena.push(&r.parents),
+                short_hash: arena.push(&r.short_hash),
+                refs: arena.push(&r.refs),
+                message: arena.push(&r.message),
+                author: arena.push(&r.author),
+                date_timestamp: r.date_timestamp,
+            },
+            segments: std::ptr::null(),
+            segment_count: r.segments.len(),
+            arrows: std::ptr::null(),
+            arrow_count: r.arrows.len(),
+        });
+        segments.extend(r.segments);
+        arrows.extend(r.arrows);
+    }
+
+    // Segment and arrow storage is final now; point each row at its slice.
+    let (mut seg_at, mut arrow_at) = (0, 0);
+    for item in &mut items {
+        item.segments = segments[seg_at..].as_ptr();
+        item.arrows = arrows[arrow_at..].as_ptr();
+        seg_at += item.segment_count;
+        arrow_at += item.arrow_count;
+    }
+    into_result(items, (arena, segments, arrows))
+}
+
+/// Copy a PierCommit array (e.g. from pier_git_graph_log_buffer) into layout input.
+///
+/// Safety: `commits` must point at `count` valid items (or `count` be 0).
+unsafe fn layout_inputs(commits: *const PierCommit, count: usize) -> Vec<git_graph::LayoutInput> {
+    if commits.is_null() || count == 0 {
+        return Vec::new();
+    }
+    std::slice::from_raw_parts(commits, count)
+        .iter()
+        .map(|c| git_graph::LayoutInput {
+            hash: c.hash.as_str().to_string(),
+            parents: c.parents.as_str().to_string(),
+            short_hash: c.short_hash.as_str().to_string(),
+            refs: c.refs.as_str().to_string(),
+            message: c.message.as_str().to_string(),
+            author: c.author.as_str().to_string(),
+            date_timestamp: c.date_timestamp,
+        })
+        .collect()
+}
+
+fn main_chain_from_ffi(main_chain_json: *const c_char) -> Vec<String> {
+    if main_chain_json.is_null() {
+        return Vec::new();
+    }
+    let main_chain_str = unsafe { CStr::from_ptr(main_chain_json).to_str().unwrap_or("[]") };
+    serde_json::from_str(main_chain_str).unwrap_or_default()
+}
+
+/// Compute the graph layout like pier_git_compute_graph_layout, taking and
+/// returning buffers instead of JSON. Rows come back as PierGraphRow.
+/// Caller must free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_git_compute_graph_layout_buffer(
+    commits: *const PierCommit,
+    count: usize,
+    main_chain_json: *const c_char,
+    lane_width: f32,
+    row_height: f32,
+    show_long_edges: bool,
+) -> *mut PierResult {
+    let inputs = unsafe { layout_inputs(commits, count) };
+    let main_chain: std::collections::HashSet<String> = main_chain_from_ffi(main_chain_json).into_iter().collect();
+    let params = git_graph::LayoutParams {
+        lane_width,
+        row_height,
+        show_long_edges,
+    };
+
+    let rows = git_graph::compute_graph_layout(&inputs, &main_chain, &params);
+    graph_rows_result(rows.into_iter().enumerate().collect())
+}
+
+/// Opaque handle to an incremental graph layout.
+pub type PierGraphLayoutHandle = *mut git_graph::GraphLayout;
+
+/// Create an incremental graph layout for paged history.
+/// Feed pages with pier_git_layout_append; free with pier_git_layout_destroy.
+#[no_mangle]
+pub extern "C" fn pier_git_layout_create(
+    lane_width: f32,
+    row_height: f32,
+    show_long_edges: bool,
+) -> PierGraphLayoutHandle {
+    let params = git_graph::LayoutParams {
+        lane_width,
+        row_height,
+        show_long_edges,
+    };
+    Box::into_raw(Box::new(git_graph::GraphLayout::new(params)))
+}
+
+/// Lay out the next page of commits.
+/// Returns JSON `{"total_rows": N, "rows": [{"row": i, ...GraphRow}]}` holding
+/// the new rows plus earlier rows whose segments changed.
+/// Caller must free with pier_string_free.
+///
+/// Parameters:
+/// - commits_json: the next page from pier_git_graph_log
+/// - main_chain_json: JSON array of first-parent hashes (may be NULL)
+#[no_mangle]
+pub extern "C" fn pier_git_layout_append(
+    layout: PierGraphLayoutHandle,
+    commits_json: *const c_char,
+    main_chain_json: *const c_char,
+) -> *mut c_char {
+    if layout.is_null() || commits_json.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let layout = unsafe { &mut *layout };
+    let commits_str = unsafe { CStr::from_ptr(commits_json).to_str().unwrap_or("[]") };
+    let main_chain_str = if main_chain_json.is_null() {
+        "[]"
+    } else {
+        unsafe { CStr::from_ptr(main_chain_json).to_str().unwrap_or("[]") }
     };
 
-    match git_graph::graph_log(repo_str, limit as usize, skip as usize, &filter) {
-        Ok(commits) => {
-            match serde_json::to_string(&commits) {
-                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
-                Err(_) => std::ptr::null_mut(),
-            }
-        }
+    let commits: Vec<git_graph::LayoutInput> = match serde_json::from_str(commits_str) {
+        Ok(c) => c,
+        Err(e) => {
+            log::error!("pier_git_layout_append: failed to parse commits: {}", e);
+            return std::ptr::null_mut();
+        }
+    };
+    let main_chain: Vec<String> = serde_json::from_str(main_chain_str).unwrap_or_default();
+
+    let update = layout.append(commits, main_chain);
+    match serde_json::to_string(&update) {
+        Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+        Err(e) => {
+            log::error!("pier_git_layout_append: serialization failed: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Lay out the next page like pier_git_layout_append, taking the PierCommit
+/// items of pier_git_graph_log_buffer and returning PierGraphRow items
+/// (new rows plus earlier rows whose segments changed).
+/// Caller must free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_git_layout_append_buffer(
+    layout: PierGraphLayoutHandle,
+    commits: *const PierCommit,
+    count: usize,
+    main_chain_json: *const c_char,
+) -> *mut PierResult {
+    if layout.is_null() || (commits.is_null() && count > 0) {
+        return std::ptr::null_mut();
+    }
+
+    let layout = unsafe { &mut *layout };
+    let inputs = unsafe { layout_inputs(commits, count) };
+    let update = layout.append(inputs, main_chain_from_ffi(main_chain_json));
+    graph_rows_result(update.rows.into_iter().map(|r| (r.row, r.data)).collect())
+}
+
+/// Destroy a graph layout handle.
+#[no_mangle]
+pub extern "C" fn pier_git_layout_destroy(layout: PierGraphLayoutHandle) {
+    if !layout.is_null() {
+        unsafe {
+            drop(Box::from_raw(layout));
+        }
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Git Status FFI — working tree status and diffs via libgit2
+// ═══════════════════════════════════════════════════════════
+
+use crate::git_status;
+
+/// Opaque handle to an open repository for status and diff queries.
+pub type PierGitStatusHandle = *mut git_status::GitStatus;
+
+/// Open a repository for pier_git_status / pier_git_diff_file.
+/// Returns null if `repo_path` isn't a repository root.
+/// Free with pier_git_status_close.
+#[no_mangle]
+pub extern "C" fn pier_git_status_open(repo_path: *const c_char) -> PierGitStatusHandle {
+    if repo_path.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+
+    match git_status::GitStatus::open(repo_str) {
+        Ok(status) => Box::into_raw(Box::new(status)),
+        Err(e) => {
+            log::error!("pier_git_status_open failed: {}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Working tree status as JSON `{"full": bool, "entries": [{"path", "index",
+/// "worktree"}]}` with porcelain v1 codes. Unless `full` is set (or this is
+/// the first call), only entries that changed since the previous call are
+/// returned; paths that became clean have both codes " ".
+/// Caller must free with pier_string_free.
+#[no_mangle]
+pub extern "C" fn pier_git_status(handle: PierGitStatusHandle, full: bool) -> *mut c_char {
+    if handle.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let status = unsafe { &*handle };
+    match status.refresh(full) {
+        Ok(update) => match serde_json::to_string(&update) {
+            Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+            Err(_) => std::ptr::null_mut(),
+        },
         Err(e) => {
-            log::error!("pier_git_graph_log failed: {}", e);
+            log::error!("pier_git_status failed: {}", e);
             std::ptr::null_mut()
         }
     }
 }
 
-/// Get first-parent chain hashes. Returns JSON array of strings.
+/// Patch text for one file (path relative to the repository root), as
+/// `git diff` prints it; `staged` diffs HEAD against the index, like
+/// `git diff --cached`. Returns null on failure.
 /// Caller must free with pier_string_free.
 #[no_mangle]
-pub extern "C" fn pier_git_first_parent_chain(
-    repo_path: *const c_char,
-    ref_name: *const c_char,
-    limit: u32,
+pub extern "C" fn pier_git_diff_file(
+    handle: PierGitStatusHandle,
+    path: *const c_char,
+    staged: bool,
 ) -> *mut c_char {
-    if repo_path.is_null() || ref_name.is_null() {
+    if handle.is_null() || path.is_null() {
         return std::ptr::null_mut();
     }
 
-    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
-    let ref_str = unsafe { CStr::from_ptr(ref_name).to_str().unwrap_or("HEAD") };
+    let status = unsafe { &*handle };
+    let path_str = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") };
 
-    match git_graph::first_parent_chain(repo_str, ref_str, limit as usize) {
-        Ok(hashes) => {
-            match serde_json::to_string(&hashes) {
-                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
-                Err(_) => std::ptr::null_mut(),
-            }
-        }
+    match status.diff_file(path_str, staged) {
+        Ok(patch) => CString::new(patch).unwrap_or_default().into_raw(),
         Err(e) => {
-            log::error!("pier_git_first_parent_chain failed: {}", e);
+            log::error!("pier_git_diff_file failed: {}", e);
             std::ptr::null_mut()
         }
     }
 }
 
-/// List all branches (local + remote). Returns JSON array of strings.
-/// Caller must free with pier_string_free.
+/// Close a repository opened with pier_git_status_open.
 #[no_mangle]
-pub extern "C" fn pier_git_list_branches(repo_path: *const c_char) -> *mut c_char {
+pub extern "C" fn pier_git_status_close(handle: PierGitStatusHandle) {
+    if !handle.is_null() {
+        unsafe {
+            drop(Box::from_raw(handle));
+        }
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Git Blame FFI — cached, progressive blame via libgit2
+// ═══════════════════════════════════════════════════════════
+
+use crate::git_blame;
+
+/// A blamed line; valid only during the callback.
+#[repr(C)]
+pub struct PierBlameLine {
+    /// 1-based, in the working file.
+    pub line_number: usize,
+    /// 40-digit hex commit id; all zeros for uncommitted lines.
+    pub commit: PierStr,
+    pub author: PierStr,
+    /// Author time, seconds since the epoch.
+    pub time: i64,
+    pub content: PierStr,
+}
+
+/// Receives blamed lines on a background thread; `lines` is valid only for
+/// the duration of the call. The last call has `done == true` and carries
+/// every line (or none, if the blame failed). Return 0 to continue,
+/// non-zero to stop.
+pub type PierBlameCallback = extern "C" fn(
+    user_data: *mut std::os::raw::c_void,
+    lines: *const PierBlameLine,
+    count: usize,
+    done: bool,
+) -> i32;
+
+/// Opaque handle to a repository's blame cache.
+pub type PierBlameEngineHandle = *mut git_blame::BlameEngine;
+
+/// Opaque handle to a running blame.
+pub type PierBlameJobHandle = *mut git_blame::BlameJob;
+
+/// Open a blame cache for the repository at `repo_path`.
+/// Returns null if it isn't a repository. Free with pier_git_blame_close.
+#[no_mangle]
+pub extern "C" fn pier_git_blame_open(repo_path: *const c_char) -> PierBlameEngineHandle {
     if repo_path.is_null() {
         return std::ptr::null_mut();
     }
 
     let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
 
-    match git_graph::list_branches(repo_str) {
-        Ok(branches) => {
-            match serde_json::to_string(&branches) {
-                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
-                Err(_) => std::ptr::null_mut(),
-            }
-        }
+    match git_blame::BlameEngine::open(repo_str) {
+        Ok(engine) => Box::into_raw(Box::new(engine)),
         Err(e) => {
-            log::error!("pier_git_list_branches failed: {}", e);
+            log::error!("pier_git_blame_open failed: {}", e);
             std::ptr::null_mut()
         }
     }
 }
 
-/// List unique commit authors. Returns JSON array of strings.
-/// Caller must free with pier_string_free.
+/// Blame `path` (relative to the repository root) on a background thread.
+/// If the file isn't cached and `first_visible..=last_visible` (1-based) is
+/// a non-empty range, those lines are delivered first; then every line,
+/// with `done == true`. Pass 0 for `first_visible` to skip that step.
+/// Stop (or free, once done) with pier_git_blame_stop.
 #[no_mangle]
-pub extern "C" fn pier_git_list_authors(repo_path: *const c_char, limit: u32) -> *mut c_char {
-    if repo_path.is_null() {
+pub extern "C" fn pier_git_blame_start(
+    engine: PierBlameEngineHandle,
+    path: *const c_char,
+    first_visible: usize,
+    last_visible: usize,
+    callback: Option<PierBlameCallback>,
+    user_data: *mut std::os::raw::c_void,
+) -> PierBlameJobHandle {
+    let Some(callback) = callback else { return std::ptr::null_mut() };
+    if engine.is_null() || path.is_null() {
         return std::ptr::null_mut();
     }
 
-    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
+    let engine = unsafe { &*engine };
+    let path_str = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") }.to_string();
+    let visible = (first_visible > 0 && last_visible >= first_visible).then_some((first_visible, last_visible));
+
+    let user_data = SendPtr(user_data);
+    let job = git_blame::BlameJob::start(engine, path_str, visible, move |lines, done| {
+        let bytes = lines.iter().map(|l| l.content.len() + 1).sum::<usize>() + 64;
+        let mut arena = StringArena::with_capacity(bytes);
+        // Lines from the same commit share its id and author strings.
+        let mut commits: std::collections::HashMap<git2::Oid, (PierStr, PierStr)> = std::collections::HashMap::new();
+        let items: Vec<PierBlameLine> = lines
+            .iter()
+            .map(|line| {
+                let (commit, author) = *commits.entry(line.origin.commit).or_insert_with(|| {
+                    (arena.push(&line.origin.commit.to_string()), arena.push(&line.origin.author))
+                });
+                PierBlameLine {
+                    line_number: line.line_number,
+                    commit,
+                    author,
+                    time: line.origin.time,
+                    content: arena.push(&line.content),
+                }
+            })
+            .collect();
+        callback(user_data.as_ptr(), items.as_ptr(), items.len(), done) == 0
+    });
+    Box::into_raw(Box::new(job))
+}
 
-    match git_graph::list_authors(repo_str, limit as usize) {
-        Ok(authors) => {
-            match serde_json::to_string(&authors) {
-                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
-                Err(_) => std::ptr::null_mut(),
-            }
+/// Stop a blame and free its handle. Returns without waiting for the
+/// history walk; the callback will not be invoked after this returns.
+/// Must not be called from the callback.
+#[no_mangle]
+pub extern "C" fn pier_git_blame_stop(job: PierBlameJobHandle) {
+    if !job.is_null() {
+        unsafe {
+            drop(Box::from_raw(job));
+        }
+    }
+}
+
+/// Free a blame cache. Running jobs keep their own reference.
+#[no_mangle]
+pub extern "C" fn pier_git_blame_close(engine: PierBlameEngineHandle) {
+    if !engine.is_null() {
+        unsafe {
+            drop(Box::from_raw(engine));
+        }
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Session Recording FFI — record terminal output, replay and search it
+// ═══════════════════════════════════════════════════════════
+
+use crate::terminal::recording::{Frame, Recording};
+
+/// Start recording a terminal's output to a new file at `path`, replacing
+/// any recording in progress. Keystrokes are not recorded (passwords are
+/// typed there), only what the terminal displays. Returns 0 on success,
+/// -1 on failure.
+#[no_mangle]
+pub extern "C" fn pier_terminal_record_start(handle: PierTerminalHandle, path: *const c_char) -> i32 {
+    if handle.is_null() || path.is_null() {
+        return -1;
+    }
+    let session = unsafe { &*handle };
+    let path = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") };
+    match session.recording.start(std::path::Path::new(path), session.cols, session.rows) {
+        Ok(()) => 0,
+        Err(e) => {
+            log::error!("Failed to start recording to {}: {}", path, e);
+            -1
         }
+    }
+}
+
+/// Stop recording and wait until the file is complete. Returns 0 on
+/// success (or if nothing was being recorded), -1 if writing failed.
+#[no_mangle]
+pub extern "C" fn pier_terminal_record_stop(handle: PierTerminalHandle) -> i32 {
+    if handle.is_null() {
+        return -1;
+    }
+    let session = unsafe { &*handle };
+    match session.recording.stop() {
+        Ok(_) => 0,
         Err(e) => {
-            log::error!("pier_git_list_authors failed: {}", e);
+            log::error!("Recording failed: {}", e);
+            -1
+        }
+    }
+}
+
+/// Opaque handle to an open recording.
+pub type PierRecordingHandle = *mut Recording;
+
+/// Open a recording, finished or still being written.
+/// Returns null on failure. Free with pier_recording_close.
+#[no_mangle]
+pub extern "C" fn pier_recording_open(path: *const c_char) -> PierRecordingHandle {
+    if path.is_null() {
+        return std::ptr::null_mut();
+    }
+    let path = unsafe { CStr::from_ptr(path).to_str().unwrap_or("") };
+    match Recording::open(std::path::Path::new(path)) {
+        Ok(recording) => Box::into_raw(Box::new(recording)),
+        Err(e) => {
+            log::error!("Failed to open recording {}: {}", path, e);
             std::ptr::null_mut()
         }
     }
 }
 
-/// List tracked files (git ls-files equivalent). Returns JSON array of strings.
+/// Describe a recording as JSON {"start_unix_ms", "duration_us", "cols",
+/// "rows", "blocks"}. Times inside a recording are microseconds from
+/// its start.
 /// Caller must free with pier_string_free.
 #[no_mangle]
-pub extern "C" fn pier_git_list_tracked_files(repo_path: *const c_char) -> *mut c_char {
-    if repo_path.is_null() {
+pub extern "C" fn pier_recording_info(recording: PierRecordingHandle) -> *mut c_char {
+    if recording.is_null() {
         return std::ptr::null_mut();
     }
+    let recording = unsafe { &*recording };
+    let info = serde_json::json!({
+        "start_unix_ms": recording.start_unix_ms,
+        "duration_us": recording.duration_us(),
+        "cols": recording.cols,
+        "rows": recording.rows,
+        "blocks": recording.block_count(),
+    });
+    CString::new(info.to_string()).unwrap_or_default().into_raw()
+}
 
-    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
-
-    match git_graph::list_tracked_files(repo_str) {
-        Ok(files) => {
-            match serde_json::to_string(&files) {
-                Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
-                Err(_) => std::ptr::null_mut(),
+/// Escape sequences that draw the screen as it was at `time_us` on a
+/// blank terminal, whose size is stored in `cols` / `rows`. Replays from
+/// the nearest keyframe rather than the start of the recording.
+/// Returns a buffer of bytes, or null on failure.
+/// Caller must free with pier_result_free.
+#[no_mangle]
+pub extern "C" fn pier_recording_screen_at(
+    recording: PierRecordingHandle,
+    time_us: u64,
+    cols: *mut u16,
+    rows: *mut u16,
+) -> *mut PierResult {
+    if recording.is_null() {
+        return std::ptr::null_mut();
+    }
+    let recording = unsafe { &*recording };
+    match recording.screen_at(time_us) {
+        Ok(emulator) => {
+            unsafe {
+                if !cols.is_null() { *cols = emulator.cols as u16; }
+                if !rows.is_null() { *rows = emulator.rows as u16; }
             }
+            let mut screen = Vec::new();
+            emulator.write_screen(&mut screen);
+            into_result(screen, ())
         }
         Err(e) => {
-            log::error!("pier_git_list_tracked_files failed: {}", e);
+            log::error!("Failed to replay recording: {}", e);
             std::ptr::null_mut()
         }
     }
 }
 
-/// Detect the default branch (main/master/HEAD). Returns the branch name as a C string.
-/// Caller must free with pier_string_free.
+/// A recorded frame. Output frames have `data`/`len` and zero size;
+/// resize frames have `cols`/`rows` and no data.
+#[repr(C)]
+pub struct PierRecordingFrame {
+    pub time_us: u64,
+    pub data: *const u8,
+    pub len: usize,
+    pub cols: u16,
+    pub rows: u16,
+}
+
+/// Frames recorded from `from_us` up to (not including) `to_us`, for
+/// playing on after pier_recording_screen_at(from_us).
+/// Returns a buffer of PierRecordingFrame, or null on failure.
+/// Caller must free with pier_result_free.
 #[no_mangle]
-pub extern "C" fn pier_git_detect_default_branch(repo_path: *const c_char) -> *mut c_char {
-    if repo_path.is_null() {
+pub extern "C" fn pier_recording_frames(
+    recording: PierRecordingHandle,
+    from_us: u64,
+    to_us: u64,
+) -> *mut PierResult {
+    if recording.is_null() {
         return std::ptr::null_mut();
     }
-
-    let repo_str = unsafe { CStr::from_ptr(repo_path).to_str().unwrap_or("") };
-
-    match git_graph::detect_default_branch(repo_str) {
-        Ok(branch) => CString::new(branch).unwrap_or_default().into_raw(),
-        Err(e) => {
-            log::error!("pier_git_detect_default_branch failed: {}", e);
-            CString::new("HEAD").unwrap_or_default().into_raw()
+    let recording = unsafe { &*recording };
+    // (time, offset into `data`, len, cols, rows); pointers are taken once
+    // `data` has stopped growing.
+    let mut frames = Vec::new();
+    let mut data = Vec::new();
+    let result = recording.frames_between(from_us, to_us, |time_us, frame| match frame {
+        Frame::Output(bytes) => {
+            frames.push((time_us, data.len(), bytes.len(), 0, 0));
+            data.extend_from_slice(bytes);
         }
+        Frame::Resize { cols, rows } => frames.push((time_us, 0, 0, cols, rows)),
+    });
+    if let Err(e) = result {
+        log::error!("Failed to read recording: {}", e);
+        return std::ptr::null_mut();
     }
+    let items: Vec<PierRecordingFrame> = frames
+        .into_iter()
+        .map(|(time_us, offset, len, cols, rows)| PierRecordingFrame {
+            time_us,
+            data: if len == 0 { std::ptr::null() } else { data[offset..].as_ptr() },
+            len,
+            cols,
+            rows,
+        })
+        .collect();
+    into_result(items, data)
 }
 
-/// Compute IDEA-style graph layout. Returns JSON array of GraphRow.
+/// Search recordings (newline-separated paths) for `query`, ignoring
+/// ASCII case. Only blocks whose text filter admits the query are
+/// decompressed. Returns a JSON array of {"path", "start_unix_ms",
+/// "time_us", "line"}, at most `max_hits` in all; unreadable files are
+/// skipped.
 /// Caller must free with pier_string_free.
-///
-/// Parameters:
-/// - commits_json: JSON from pier_git_graph_log
-/// - main_chain_json: JSON from pier_git_first_parent_chain
-/// - lane_width: pixel width of each lane column
-/// - row_height: pixel height of each row
-/// - show_long_edges: true for expanded mode, false for collapsed
 #[no_mangle]
-pub extern "C" fn pier_git_compute_graph_layout(
-    commits_json: *const c_char,
-    main_chain_json: *const c_char,
-    lane_width: f32,
-    row_height: f32,
-    show_long_edges: bool,
+pub extern "C" fn pier_recording_search(
+    paths: *const c_char,
+    query: *const c_char,
+    max_hits: u32,
 ) -> *mut c_char {
-    if commits_json.is_null() {
+    if paths.is_null() || query.is_null() {
         return std::ptr::null_mut();
     }
+    let paths = unsafe { CStr::from_ptr(paths).to_str().unwrap_or("") };
+    let query = unsafe { CStr::from_ptr(query).to_str().unwrap_or("") };
+    let mut hits = Vec::new();
+    for path in paths.lines().filter(|p| !p.is_empty()) {
+        let remaining = (max_hits as usize).saturating_sub(hits.len());
+        if remaining == 0 {
+            break;
+        }
+        let found = Recording::open(std::path::Path::new(path))
+            .and_then(|recording| Ok((recording.start_unix_ms, recording.search(query, remaining)?)));
+        match found {
+            Ok((start_unix_ms, found)) => hits.extend(found.into_iter().map(|hit| serde_json::json!({
+                "path": path,
+                "start_unix_ms": start_unix_ms,
+                "time_us": hit.time_us,
+                "line": hit.line,
+            }))),
+            Err(e) => log::warn!("Skipping recording {}: {}", path, e),
+        }
+    }
+    CString::new(serde_json::Value::Array(hits).to_string()).unwrap_or_default().into_raw()
+}
 
-    let commits_str = unsafe { CStr::from_ptr(commits_json).to_str().unwrap_or("[]") };
-    let main_chain_str = if main_chain_json.is_null() {
-        "[]"
-    } else {
-        unsafe { CStr::from_ptr(main_chain_json).to_str().unwrap_or("[]") }
-    };
+/// Close a recording.
+#[no_mangle]
+pub extern "C" fn pier_recording_close(recording: PierRecordingHandle) {
+    if !recording.is_null() {
+        unsafe {
+            drop(Box::from_raw(recording));
+        }
+    }
+}
 
-    // Deserialize inputs
-    let commits: Vec<git_graph::LayoutInput> = match serde_json::from_str(commits_str) {
-        Ok(c) => c,
+// ═══════════════════════════════════════════════════════════
+// Crypto FFI — AES-256-GCM with a reusable key
+// ═══════════════════════════════════════════════════════════
+
+use crate::crypto;
+
+/// Bytes a sealed message adds to its plaintext (nonce and tag).
+pub const PIER_CIPHER_OVERHEAD: usize = 28;
+
+const _: () = assert!(PIER_CIPHER_OVERHEAD == crypto::OVERHEAD);
+
+/// Opaque handle to an expanded AES-256-GCM key.
+pub type PierCipherHandle = *mut crypto::Cipher;
+
+/// Expand a 32-byte key for repeated use. Returns null unless `key_len`
+/// is 32. Free with pier_cipher_free; safe to share across threads.
+#[no_mangle]
+pub extern "C" fn pier_cipher_new(key: *const u8, key_len: usize) -> PierCipherHandle {
+    if key.is_null() || key_len != 32 {
+        return std::ptr::null_mut();
+    }
+    let key: &[u8; 32] = unsafe { &*(key as *const [u8; 32]) };
+    match crypto::Cipher::new(key) {
+        Ok(cipher) => Box::into_raw(Box::new(cipher)),
         Err(e) => {
-            log::error!("pier_git_compute_graph_layout: failed to parse commits: {}", e);
-            return std::ptr::null_mut();
+            log::error!("Failed to create cipher: {}", e);
+            std::ptr::null_mut()
         }
-    };
-    let main_chain_hashes: Vec<String> = serde_json::from_str(main_chain_str).unwrap_or_default();
-    let main_chain: std::collections::HashSet<String> = main_chain_hashes.into_iter().collect();
+    }
+}
 
-    let params = git_graph::LayoutParams {
-        lane_width,
-        row_height,
-        show_long_edges,
+/// Seal `input_len` bytes into `output` as nonce, ciphertext and tag.
+/// `output_len` must be at least `input_len + PIER_CIPHER_OVERHEAD`;
+/// `output` may be `input` itself (sealing in place) but must not
+/// otherwise overlap it. Returns the sealed length, or -1 on failure.
+#[no_mangle]
+pub extern "C" fn pier_cipher_seal(
+    cipher: PierCipherHandle,
+    input: *const u8,
+    input_len: usize,
+    output: *mut u8,
+    output_len: usize,
+) -> i64 {
+    if cipher.is_null() || (input.is_null() && input_len > 0) || output.is_null() {
+        return -1;
+    }
+    let cipher = unsafe { &*cipher };
+    let out = unsafe { std::slice::from_raw_parts_mut(output, output_len) };
+    let result = if input == output as *const u8 {
+        cipher.seal_in_place(out, input_len)
+    } else {
+        let plaintext = if input_len == 0 { &[][..] } else { unsafe { std::slice::from_raw_parts(input, input_len) } };
+        cipher.seal_into(plaintext, out)
     };
+    match result {
+        Ok(n) => n as i64,
+        Err(e) => {
+            log::error!("Failed to seal: {}", e);
+            -1
+        }
+    }
+}
 
-    let rows = git_graph::compute_graph_layout(&commits, &main_chain, &params);
+/// Open a sealed message into `output`, which must hold at least
+/// `input_len` bytes (the plaintext is decrypted where it lands) and may
+/// be `input` itself. Returns the plaintext length, or -1 if the message
+/// was tampered with or sealed with another key.
+#[no_mangle]
+pub extern "C" fn pier_cipher_open(
+    cipher: PierCipherHandle,
+    input: *const u8,
+    input_len: usize,
+    output: *mut u8,
+    output_len: usize,
+) -> i64 {
+    if cipher.is_null() || input.is_null() || output.is_null() || output_len < input_len {
+        return -1;
+    }
+    let cipher = unsafe { &*cipher };
+    if input != output as *const u8 {
+        unsafe { std::ptr::copy(input, output, input_len) };
+    }
+    let buf = unsafe { std::slice::from_raw_parts_mut(output, input_len) };
+    cipher.open_in_place(buf).map_or(-1, |n| n as i64)
+}
 
-    match serde_json::to_string(&rows) {
-        Ok(json) => CString::new(json).unwrap_or_default().into_raw(),
+/// Encrypt the file at `src` into `dst` in the chunked stream format,
+/// using every core and one chunk buffer per thread. `chunk_size` is
+/// plaintext bytes per chunk; 0 picks the default (64 KiB).
+/// Blocks until done; returns the plaintext length, or -1 on failure
+/// (`dst` is removed).
+#[no_mangle]
+pub extern "C" fn pier_cipher_encrypt_file(
+    cipher: PierCipherHandle,
+    src: *const c_char,
+    dst: *const c_char,
+    chunk_size: u32,
+) -> i64 {
+    if cipher.is_null() || src.is_null() || dst.is_null() {
+        return -1;
+    }
+    let cipher = unsafe { &*cipher };
+    let src = unsafe { CStr::from_ptr(src).to_str().unwrap_or("") };
+    let dst = unsafe { CStr::from_ptr(dst).to_str().unwrap_or("") };
+    let chunk_size = if chunk_size == 0 { crypto::stream::DEFAULT_CHUNK_SIZE } else { chunk_size as usize };
+    match crypto::stream::encrypt_file(cipher, std::path::Path::new(src), std::path::Path::new(dst), chunk_size) {
+        Ok(len) => len as i64,
         Err(e) => {
-            log::error!("pier_git_compute_graph_layout: serialization failed: {}", e);
-            std::ptr::null_mut()
+            log::error!("Failed to encrypt {}: {}", src, e);
+            -1
+        }
+    }
+}
+
+/// Decrypt a file written by pier_cipher_encrypt_file. Every chunk is
+/// verified; on failure `dst` is removed, so it never holds tampered
+/// plaintext. Returns the plaintext length, or -1 on failure.
+#[no_mangle]
+pub extern "C" fn pier_cipher_decrypt_file(
+    cipher: PierCipherHandle,
+    src: *const c_char,
+    dst: *const c_char,
+) -> i64 {
+    if cipher.is_null() || src.is_null() || dst.is_null() {
+        return -1;
+    }
+    let cipher = unsafe { &*cipher };
+    let src = unsafe { CStr::from_ptr(src).to_str().unwrap_or("") };
+    let dst = unsafe { CStr::from_ptr(dst).to_str().unwrap_or("") };
+    match crypto::stream::decrypt_file(cipher, std::path::Path::new(src), std::path::Path::new(dst)) {
+        Ok(len) => len as i64,
+        Err(e) => {
+            log::error!("Failed to decrypt {}: {}", src, e);
+            -1
+        }
+    }
+}
+
+/// Free a cipher handle.
+#[no_mangle]
+pub extern "C" fn pier_cipher_free(cipher: PierCipherHandle) {
+    if !cipher.is_null() {
+        unsafe {
+            drop(Box::from_raw(cipher));
         }
     }
 }
 
+// ═══════════════════════════════════════════════════════════
+// Metrics FFI — hot-path counters and latency summaries
+// ═══════════════════════════════════════════════════════════
+//
+// Snapshots are returned by value and cost a few hundred atomic loads, so
+// a debug overlay can poll them every frame. Per-forward byte counts are
+// in pier_ssh_list_forwards.
+
+use crate::metrics::{self, ConnectionSnapshot, MetricsSnapshot, TerminalSnapshot};
+
+/// Process-wide totals since launch.
+#[no_mangle]
+pub extern "C" fn pier_metrics_snapshot() -> MetricsSnapshot {
+    metrics::global().snapshot()
+}
+
+/// Metrics of the connection behind an SSH session, shared by every
+/// session on it. All zero if `handle` is null or not connected.
+#[no_mangle]
+pub extern "C" fn pier_ssh_metrics(handle: PierSshHandle) -> ConnectionSnapshot {
+    if handle.is_null() {
+        return ConnectionSnapshot::default();
+    }
+    let session = unsafe { &*handle };
+    session.metrics().unwrap_or_default()
+}
+
+/// Output volume and VT parse time of one terminal. All zero if `handle`
+/// is null.
+#[no_mangle]
+pub extern "C" fn pier_terminal_metrics(handle: PierTerminalHandle) -> TerminalSnapshot {
+    if handle.is_null() {
+        return TerminalSnapshot::default();
+    }
+    let session = unsafe { &*handle };
+    session.metrics.snapshot()
+}
+
 // ═══════════════════════════════════════════════════════════
 // Utility FFI
 // ═══════════════════════════════════════════════════════════
@@ -795,5 +3241,13 @@ pub extern "C" fn pier_string_free(s: *mut c_char) {
 #[no_mangle]
 pub extern "C" fn pier_init() {
     let _ = env_logger::try_init();
+    // Timed sections go to the unified log as spans, for Instruments.
+    #[cfg(all(feature = "signposts", target_os = "macos"))]
+    {
+        use tracing_subscriber::layer::SubscriberExt;
+        let subscriber = tracing_subscriber::registry()
+            .with(tracing_oslog::OsLogger::new("com.kkape.pier", "core"));
+        let _ = tracing::subscriber::set_global_default(subscriber);
+    }
     log::info!("Pier Core initialized");
 }
@@ -0,0 +1,439 @@
+//! Git Blame — per-line attribution via libgit2, cached per file version.
+//!
+//! Replaces `git blame --porcelain` for the blame view. Results are cached
+//! by (path, blob oid) of the file at HEAD, so reopening a file costs
+//! nothing until the file itself changes. When HEAD advances past a cached
+//! version, only the new commits are walked (`oldest_commit` = the cached
+//! HEAD) and lines that predate them keep their cached attribution.
+//! Uncommitted edits are layered on top by diffing HEAD's blob against the
+//! working file, like `git blame <path>` does.
+//!
+//! A cold blame first resolves just the visible line range, which stops
+//! the history walk as soon as those lines are attributed, then the rest.
+
+use git2::{BlameOptions, DiffOptions, Oid, Patch, Repository};
+use std::collections::{HashMap, VecDeque};
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex};
+
+/// File versions whose blame is kept in memory.
+const MAX_CACHED_FILES: usize = 64;
+
+/// Author shown for lines that only exist in the working tree.
+pub const NOT_COMMITTED: &str = "Not Committed Yet";
+
+/// Who last changed a line.
+#[derive(Clone, Debug, PartialEq)]
+pub struct LineOrigin {
+    /// Zero for uncommitted lines.
+    pub commit: Oid,
+    pub author: Arc<str>,
+    /// Author time, seconds since the epoch.
+    pub time: i64,
+}
+
+/// One line of blame output.
+#[derive(Clone, Debug)]
+pub struct BlameLine {
+    /// 1-based, in the working file.
+    pub line_number: usize,
+    pub origin: LineOrigin,
+    pub content: String,
+}
+
+/// Attribution of every line of one blob, as of some HEAD commit.
+struct FileBlame {
+    /// HEAD when this was computed; the base for incremental updates.
+    head: Oid,
+    lines: Vec<LineOrigin>,
+}
+
+#[derive(Default)]
+struct Cache {
+    files: HashMap<(String, Oid), Arc<FileBlame>>,
+    /// Insertion order of `files`, for eviction.
+    order: VecDeque<(String, Oid)>,
+    /// Last blob blamed per path, to find a base when the file changes.
+    latest: HashMap<String, Oid>,
+}
+
+impl Cache {
+    fn insert(&mut self, path: &str, blob: Oid, blame: Arc<FileBlame>) {
+        let key = (path.to_string(), blob);
+        if self.files.insert(key.clone(), blame).is_none() {
+            self.order.push_back(key);
+            if self.order.len() > MAX_CACHED_FILES {
+                if let Some(old) = self.order.pop_front() {
+                    self.files.remove(&old);
+                }
+            }
+        }
+        self.latest.insert(path.to_string(), blob);
+    }
+
+    /// The last cached blame of `path`, for any blob.
+    fn base(&self, path: &str) -> Option<Arc<FileBlame>> {
+        let blob = self.latest.get(path)?;
+        self.files.get(&(path.to_string(), *blob)).cloned()
+    }
+}
+
+/// Blame cache for one repository. Cheap to clone; clones share the cache.
+#[derive(Clone)]
+pub struct BlameEngine {
+    repo_path: PathBuf,
+    cache: Arc<Mutex<Cache>>,
+}
+
+impl BlameEngine {
+    pub fn open(repo_path: &str) -> Result<Self, String> {
+        // Fail early on a bad path; jobs open their own handle.
+        Repository::open(repo_path).map_err(|e| format!("Failed to open repo: {}", e))?;
+        Ok(Self { repo_path: PathBuf::from(repo_path), cache: Arc::new(Mutex::new(Cache::default())) })
+    }
+
+    /// Blame `path` (relative to the repository root). When `visible` lines
+    /// (1-based, inclusive) are given and the file isn't cached, those are
+    /// delivered first with `done == false`; the final delivery has every
+    /// line and `done == true`. Stops early if `deliver` returns false.
+    pub fn blame<F>(&self, path: &str, visible: Option<(usize, usize)>, mut deliver: F) -> Result<(), String>
+    where
+        F: FnMut(&[BlameLine], bool) -> bool,
+    {
+        let repo = Repository::open(&self.repo_path).map_err(|e| format!("Failed to open repo: {}", e))?;
+        let workdir = repo.workdir().ok_or("Bare repository")?.to_path_buf();
+        let head = repo.head().ok().and_then(|head| head.peel_to_commit().ok());
+        let committed = head.as_ref().and_then(|commit| {
+            let blob = commit.tree().ok()?.get_path(Path::new(path)).ok()?.id();
+            Some((commit.id(), blob))
+        });
+
+        let head_content = match committed {
+            Some((_, blob)) => repo.find_blob(blob).map_err(|e| format!("Failed to read blob: {}", e))?.content().to_vec(),
+            None => Vec::new(),
+        };
+        // A file deleted in the worktree is blamed as committed.
+        let content = std::fs::read(workdir.join(path)).unwrap_or_else(|_| head_content.clone());
+        let texts = split_lines(&content);
+        let to_head = map_to_head(&head_content, &content, texts.len())?;
+        let uncommitted = LineOrigin { commit: Oid::zero(), author: Arc::from(NOT_COMMITTED), time: now() };
+
+        let Some((head_id, blob)) = committed else {
+            deliver(&assemble(&texts, &to_head, &[], &lines_all(texts.len()), &uncommitted), true);
+            return Ok(());
+        };
+        let head_line_count = split_lines(&head_content).len();
+
+        let cached = self.cache.lock().unwrap().files.get(&(path.to_string(), blob)).cloned();
+        let blame = match cached {
+            Some(blame) => blame,
+            None => {
+                let base = self.cache.lock().unwrap().base(path);
+                let incremental = base.and_then(|base| {
+                    let ahead = repo.graph_descendant_of(head_id, base.head).unwrap_or(false);
+                    if !ahead {
+                        return None;
+                    }
+                    blame_since(&repo, path, head_id, &base).ok().filter(|lines| lines.len() == head_line_count)
+                });
+                let lines = match incremental {
+                    Some(lines) => lines,
+                    None => {
+                        if let Some((first, last)) = visible {
+                            let window = lines_in(first, last, texts.len());
+                            if window.len() < texts.len() {
+                                let range = window.iter().filter_map(|&i| to_head[i]).fold(None, |range, l| {
+                                    let (lo, hi) = range.unwrap_or((l, l));
+                                    Some((lo.min(l), hi.max(l)))
+                                });
+                                let partial = match range {
+                                    Some((lo, hi)) => blame_range(&repo, path, head_id, Some((lo + 1, hi + 1)))?,
+                                    None => Vec::new(),
+                                };
+                                let batch = assemble(&texts, &to_head, &partial, &window, &uncommitted);
+                                if !deliver(&batch, false) {
+                                    return Ok(());
+                                }
+                            }
+                        }
+                        blame_range(&repo, path, head_id, None)?
+                    }
+                };
+                let blame = Arc::new(FileBlame { head: head_id, lines });
+                self.cache.lock().unwrap().insert(path, blob, Arc::clone(&blame));
+                blame
+            }
+        };
+
+        deliver(&assemble(&texts, &to_head, &blame.lines, &lines_all(texts.len()), &uncommitted), true);
+        Ok(())
+    }
+}
+
+/// Attribution of HEAD's lines, or (with `range`, 1-based inclusive) of
+/// just those lines; entries outside the range are left as the default.
+fn blame_range(repo: &Repository, path: &str, head: Oid, range: Option<(usize, usize)>) -> Result<Vec<LineOrigin>, String> {
+    let mut opts = BlameOptions::new();
+    opts.newest_commit(head);
+    if let Some((first, last)) = range {
+        opts.min_line(first).max_line(last);
+    }
+    let blame = repo
+        .blame_file(Path::new(path), Some(&mut opts))
+        .map_err(|e| format!("Failed to blame {}: {}", path, e))?;
+
+    let mut authors: HashMap<String, Arc<str>> = HashMap::new();
+    let mut lines = Vec::new();
+    for hunk in blame.iter() {
+        let signature = hunk.final_signature();
+        let name = signature.name().unwrap_or("").to_string();
+        let author = Arc::clone(authors.entry(name).or_insert_with_key(|n| Arc::from(n.as_str())));
+        let origin = LineOrigin { commit: hunk.final_commit_id(), author, time: signature.when().seconds() };
+        let start = hunk.final_start_line() - 1;
+        let end = start + hunk.lines_in_hunk();
+        if lines.len() < end {
+            lines.resize(end, LineOrigin { commit: Oid::zero(), author: Arc::from(""), time: 0 });
+        }
+        for line in &mut lines[start..end] {
+            *line = origin.clone();
+        }
+    }
+    Ok(lines)
+}
+
+/// Blame HEAD walking only the commits since `base.head`; lines that are
+/// unchanged since then keep the attribution in `base`.
+fn blame_since(repo: &Repository, path: &str, head: Oid, base: &FileBlame) -> Result<Vec<LineOrigin>, String> {
+    let mut opts = BlameOptions::new();
+    opts.newest_commit(head).oldest_commit(base.head);
+    let blame = repo
+        .blame_file(Path::new(path), Some(&mut opts))
+        .map_err(|e| format!("Failed to blame {}: {}", path, e))?;
+
+    let mut lines = Vec::new();
+    for hunk in blame.iter() {
+        let count = hunk.lines_in_hunk();
+        if hunk.final_commit_id() == base.head {
+            // Unchanged since the base: look the lines up there. A rename
+            // means the base doesn't describe them; start over.
+            if hunk.path().map_or(false, |p| p != Path::new(path)) {
+                return Err("renamed".into());
+            }
+            let start = hunk.orig_start_line() - 1;
+            let old = base.lines.get(start..start + count).ok_or("base out of range")?;
+            lines.extend_from_slice(old);
+        } else {
+            let signature = hunk.final_signature();
+            let origin = LineOrigin {
+                commit: hunk.final_commit_id(),
+                author: Arc::from(signature.name().unwrap_or("")),
+                time: signature.when().seconds(),
+            };
+            lines.extend(std::iter::repeat(origin).take(count));
+        }
+    }
+    Ok(lines)
+}
+
+/// For each line of `new` (0-based), the 0-based line of `old` it is an
+/// unchanged copy of, if any.
+fn map_to_head(old: &[u8], new: &[u8], new_lines: usize) -> Result<Vec<Option<usize>>, String> {
+    if old == new {
+        return Ok((0..new_lines).map(Some).collect());
+    }
+    let mut opts = DiffOptions::new();
+    opts.context_lines(0);
+    let patch = Patch::from_buffers(old, None, new, None, Some(&mut opts))
+        .map_err(|e| format!("Failed to diff worktree: {}", e))?;
+
+    let mut map = Vec::with_capacity(new_lines);
+    // `old - new` line offset in the unchanged stretch being copied.
+    let mut offset: isize = 0;
+    for i in 0..patch.num_hunks() {
+        let (hunk, _) = patch.hunk(i).map_err(|e| format!("Failed to read diff: {}", e))?;
+        let (old_start, old_count) = (hunk.old_start() as usize, hunk.old_lines() as usize);
+        let (new_start, new_count) = (hunk.new_start() as usize, hunk.new_lines() as usize);
+        // Hunk headers name the line *before* an empty side.
+        let changed_from = if new_count == 0 { new_start + 1 } else { new_start };
+        while map.len() + 1 < changed_from {
+            map.push(Some((map.len() as isize + offset) as usize));
+        }
+        map.extend(std::iter::repeat(None).take(new_count));
+        let next_old = old_start + old_count + usize::from(old_count == 0);
+        let next_new = new_start + new_count + usize::from(new_count == 0);
+        offset = next_old as isize - next_new as isize;
+    }
+    while map.len() < new_lines {
+        map.push(Some((map.len() as isize + offset) as usize));
+    }
+    map.truncate(new_lines);
+    Ok(map)
+}
+
+/// Output lines for `which` (0-based working-file lines). Lines that
+/// aren't in HEAD get `uncommitted`; lines `head_lines` doesn't cover (an
+/// unblamed part of a partial result) are skipped.
+fn assemble(
+    texts: &[String],
+    to_head: &[Option<usize>],
+    head_lines: &[LineOrigin],
+    which: &[usize],
+    uncommitted: &LineOrigin,
+) -> Vec<BlameLine> {
+    which
+        .iter()
+        .filter_map(|&i| {
+            let origin = match to_head[i] {
+                Some(h) => head_lines.get(h).filter(|o| !o.commit.is_zero())?.clone(),
+                None => uncommitted.clone(),
+            };
+            Some(BlameLine { line_number: i + 1, origin, content: texts[i].clone() })
+        })
+        .collect()
+}
+
+fn split_lines(content: &[u8]) -> Vec<String> {
+    let content = content.strip_suffix(b"\n").unwrap_or(content);
+    if content.is_empty() {
+        return Vec::new();
+    }
+    content
+        .split(|&b| b == b'\n')
+        .map(|line| String::from_utf8_lossy(line.strip_suffix(b"\r").unwrap_or(line)).into_owned())
+        .collect()
+}
+
+fn lines_all(count: usize) -> Vec<usize> {
+    (0..count).collect()
+}
+
+/// 0-based indices of the 1-based inclusive range, clamped to the file.
+fn lines_in(first: usize, last: usize, count: usize) -> Vec<usize> {
+    (first.max(1) - 1..last.min(count)).collect()
+}
+
+fn now() -> i64 {
+    std::time::SystemTime::now()
+        .duration_since(std::time::UNIX_EPOCH)
+        .map_or(0, |d| d.as_secs() as i64)
+}
+
+/// A blame running on a background thread.
+///
+/// libgit2 can't interrupt a blame, so stopping doesn't wait for the
+/// thread: it only guarantees no callback is made after `stop` returns.
+pub struct BlameJob {
+    stopped: Arc<Mutex<bool>>,
+}
+
+impl BlameJob {
+    /// Blame `path` on a new thread, calling `on_event` like
+    /// `BlameEngine::blame` does.
+    pub fn start<F>(engine: &BlameEngine, path: String, visible: Option<(usize, usize)>, mut on_event: F) -> Self
+    where
+        F: FnMut(&[BlameLine], bool) -> bool + Send + 'static,
+    {
+        let stopped = Arc::new(Mutex::new(false));
+        let thread_stopped = Arc::clone(&stopped);
+        let engine = engine.clone();
+        let spawned = std::thread::Builder::new().name("pier-git-blame".into()).spawn(move || {
+            let mut deliver = |lines: &[BlameLine], done: bool| {
+                // Held across the callback, so `stop` waits for it.
+                let stopped = thread_stopped.lock().unwrap();
+                !*stopped && on_event(lines, done)
+            };
+            if let Err(e) = engine.blame(&path, visible, &mut deliver) {
+                log::error!("Blame of {} failed: {}", path, e);
+                deliver(&[], true);
+            }
+        });
+        if let Err(e) = spawned {
+            log::error!("Failed to start blame thread: {}", e);
+        }
+        Self { stopped }
+    }
+
+    /// Stop delivering results. Must not be called from the callback.
+    pub fn stop(&self) {
+        *self.stopped.lock().unwrap() = true;
+    }
+}
+
+impl Drop for BlameJob {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn commit(repo: &Repository, content: &str, author: &str) -> Oid {
+        std::fs::write(repo.workdir().unwrap().join("notes.txt"), content).unwrap();
+        let mut index = repo.index().unwrap();
+        index.add_path(Path::new("notes.txt")).unwrap();
+        index.write().unwrap();
+        let tree = repo.find_tree(index.write_tree().unwrap()).unwrap();
+        let signature = git2::Signature::new(author, "dev@example.com", &git2::Time::new(1_700_000_000, 0)).unwrap();
+        let parent = repo.head().ok().and_then(|head| head.peel_to_commit().ok());
+        let parents: Vec<&git2::Commit> = parent.iter().collect();
+        repo.commit(Some("HEAD"), &signature, &signature, author, &tree, &parents).unwrap()
+    }
+
+    fn authors(engine: &BlameEngine, visible: Option<(usize, usize)>) -> Vec<(Vec<(usize, String)>, bool)> {
+        let mut deliveries = Vec::new();
+        engine
+            .blame("notes.txt", visible, |lines, done| {
+                let lines = lines.iter().map(|l| (l.line_number, l.origin.author.to_string())).collect();
+                deliveries.push((lines, done));
+                true
+            })
+            .unwrap();
+        deliveries
+    }
+
+    #[test]
+    fn test_map_to_head() {
+        assert_eq!(map_to_head(b"a\nb\n", b"a\nb\n", 2).unwrap(), vec![Some(0), Some(1)]);
+        // Insert at the top, change the middle, delete the end.
+        let old = b"a\nb\nc\nd\n";
+        let new = b"new\na\nB\nc\n";
+        assert_eq!(map_to_head(old, new, 4).unwrap(), vec![None, Some(0), None, Some(2)]);
+        assert_eq!(split_lines(b"x\r\ny"), vec!["x", "y"]);
+        assert!(split_lines(b"").is_empty());
+    }
+
+    #[test]
+    fn test_blame_cache_incremental_and_worktree() {
+        let root = std::env::temp_dir().join(format!("pier-git-blame-{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&root);
+        let repo = Repository::init(&root).unwrap();
+        commit(&repo, "one\ntwo\nthree\n", "alice");
+
+        let engine = BlameEngine::open(root.to_str().unwrap()).unwrap();
+        let cold = authors(&engine, Some((2, 2)));
+        assert_eq!(cold[0], (vec![(2, "alice".to_string())], false), "visible range first");
+        assert_eq!(cold[1].0.len(), 3);
+        assert!(cold[1].1);
+        // Cached: one delivery.
+        assert_eq!(authors(&engine, Some((2, 2))).len(), 1);
+
+        // HEAD advances; the new blame builds on the cached one.
+        commit(&repo, "one\ntwo\nthree\nfour\n", "bob");
+        let after = authors(&engine, None);
+        assert_eq!(after, vec![(vec![
+            (1, "alice".to_string()),
+            (2, "alice".to_string()),
+            (3, "alice".to_string()),
+            (4, "bob".to_string()),
+        ], true)]);
+
+        std::fs::write(root.join("notes.txt"), "zero\none\ntwo\nthree\nfour\n").unwrap();
+        let edited = authors(&engine, None);
+        assert_eq!(edited[0].0[0], (1, NOT_COMMITTED.to_string()));
+        assert_eq!(edited[0].0[4], (5, "bob".to_string()));
+
+        std::fs::remove_dir_all(&root).unwrap();
+    }
+}
@@ -5,9 +5,11 @@
 
 use git2::{BranchType, Repository, Sort};
 use serde::{Deserialize, Serialize};
-use std::collections::{HashMap, HashSet};
+use std::collections::{BTreeSet, HashMap, HashSet};
 use std::path::Path;
 
+use crate::metrics;
+
 // ═══════════════════════════════════════════════════════════
 // Data types
 // ═══════════════════════════════════════════════════════════
@@ -38,48 +40,41 @@ pub struct CommitEntry {
 
 
 // ═══════════════════════════════════════════════════════════
-// Helper: build ref decoration string for a commit
+// Helper: ref decorations for every decorated commit
 // ═══════════════════════════════════════════════════════════
 
-fn build_ref_decoration(repo: &Repository, commit_id: git2::Oid) -> String {
-    let mut decorations = Vec::new();
+/// Build the ` (HEAD -> main, origin/main, tag: v1)` decoration for every
+/// commit a ref points at, in one pass over HEAD, branches and tags.
+fn build_decoration_map(repo: &Repository) -> HashMap<String, String> {
+    let mut decorations: HashMap<git2::Oid, Vec<String>> = HashMap::new();
 
-    // Check HEAD
+    // HEAD
     if let Ok(head) = repo.head() {
         if let Some(target) = head.target() {
-            if target == commit_id {
-                if head.is_branch() {
-                    if let Some(name) = head.shorthand() {
-                        decorations.push(format!("HEAD -> {}", name));
-                    } else {
-                        decorations.push("HEAD".to_string());
-                    }
-                } else {
-                    decorations.push("HEAD".to_string());
-                }
-            }
+            let label = match head.shorthand() {
+                Some(name) if head.is_branch() => format!("HEAD -> {}", name),
+                _ => "HEAD".to_string(),
+            };
+            decorations.entry(target).or_default().push(label);
         }
     }
 
-    // Check branches
+    // Branches
     if let Ok(branches) = repo.branches(None) {
-        for branch_result in branches {
-            if let Ok((branch, _btype)) = branch_result {
-                if let Ok(Some(reference)) = branch.get().resolve().map(|r| r.target()) {
-                    if reference == commit_id {
-                        if let Ok(Some(name)) = branch.name() {
-                            // Skip if already added as HEAD ->
-                            if !decorations.iter().any(|d| d.contains(name)) {
-                                decorations.push(name.to_string());
-                            }
-                        }
+        for (branch, _btype) in branches.flatten() {
+            if let Ok(Some(target)) = branch.get().resolve().map(|r| r.target()) {
+                if let Ok(Some(name)) = branch.name() {
+                    let labels = decorations.entry(target).or_default();
+                    // Skip if already added as HEAD ->
+                    if !labels.iter().any(|d| d.contains(name)) {
+                        labels.push(name.to_string());
                     }
                 }
             }
         }
     }
 
-    // Check tags
+    // Tags
     if let Ok(tags) = repo.tag_names(None) {
         for tag_name in tags.iter().flatten() {
             if let Ok(reference) = repo.find_reference(&format!("refs/tags/{}", tag_name)) {
@@ -90,41 +85,257 @@ fn build_ref_decoration(repo: &Repository, commit_id: git2::Oid) -> String {
                 } else {
                     continue;
                 };
-                if target == commit_id {
-                    decorations.push(format!("tag: {}", tag_name));
-                }
+                decorations.entry(target).or_default().push(format!("tag: {}", tag_name));
             }
         }
     }
 
-    if decorations.is_empty() {
-        String::new()
-    } else {
-        format!(" ({})", decorations.join(", "))
+    decorations
+        .into_iter()
+        .map(|(oid, labels)| (oid.to_string(), format!(" ({})", labels.join(", "))))
+        .collect()
+}
+
+/// Hash of HEAD and every ref target. Changes whenever a branch moves, a
+/// ref is created or deleted, or HEAD is switched.
+fn ref_fingerprint(repo: &Repository) -> u64 {
+    use std::hash::{Hash, Hasher};
+
+    let mut hasher = std::collections::hash_map::DefaultHasher::new();
+    if let Ok(head) = repo.head() {
+        head.name().hash(&mut hasher);
+        head.target().hash(&mut hasher);
+    }
+    if let Ok(references) = repo.references() {
+        for reference in references.flatten() {
+            reference.name_bytes().hash(&mut hasher);
+            reference.target().hash(&mut hasher);
+            reference.symbolic_target_bytes().hash(&mut hasher);
+        }
     }
+    hasher.finish()
+}
+
+// ═══════════════════════════════════════════════════════════
+// Commit-graph index
+// ═══════════════════════════════════════════════════════════
+
+/// Commit indexes kept warm across `graph_log` calls (one per repo + filter).
+const MAX_CACHED_INDEXES: usize = 8;
+
+/// One row of the index; ref decorations are joined in at page time.
+struct IndexedCommit {
+    hash: String,
+    parents: String,
+    message: String,
+    author: String,
+    date_timestamp: i64,
+}
+
+#[derive(Default)]
+struct IndexState {
+    commits: Vec<IndexedCommit>,
+    done: bool,
+    error: Option<String>,
+}
+
+/// Full, ordered commit list for one repo + filter, filled by a single
+/// streaming `git log` run in the background so the first pages are served
+/// before the walk finishes. Pages are O(limit) slices.
+struct CommitIndex {
+    fingerprint: u64,
+    decorations: HashMap<String, String>,
+    state: std::sync::Mutex<IndexState>,
+    grown: std::sync::Condvar,
+    cancelled: std::sync::atomic::AtomicBool,
+}
+
+impl CommitIndex {
+    fn start(repo: &Repository, mut cmd: std::process::Command, fingerprint: u64) -> Result<std::sync::Arc<Self>, String> {
+        use std::io::{BufRead, Read};
+        use std::process::Stdio;
+        use std::sync::atomic::Ordering;
+
+        let index = std::sync::Arc::new(CommitIndex {
+            fingerprint,
+            decorations: build_decoration_map(repo),
+            state: std::sync::Mutex::new(IndexState::default()),
+            grown: std::sync::Condvar::new(),
+            cancelled: std::sync::atomic::AtomicBool::new(false),
+        });
+
+        let mut child = cmd
+            .stdout(Stdio::piped())
+            .stderr(Stdio::piped())
+            .spawn()
+            .map_err(|e| format!("Failed to run git log: {}", e))?;
+        let stdout = child.stdout.take().expect("piped stdout");
+        let mut stderr = child.stderr.take().expect("piped stderr");
+
+        let builder = std::sync::Arc::clone(&index);
+        std::thread::Builder::new()
+            .name("pier-git-index".into())
+            .spawn(move || {
+                // Drained alongside stdout: enough warnings to fill the pipe
+                // would otherwise stall git before stdout reaches EOF.
+                let stderr_reader = std::thread::spawn(move || {
+                    let mut message = Vec::new();
+                    let _ = (&mut stderr).take(64 * 1024).read_to_end(&mut message);
+                    let _ = std::io::copy(&mut stderr, &mut std::io::sink());
+                    message
+                });
+
+                const BATCH: usize = 1024;
+                let mut batch = Vec::with_capacity(BATCH);
+                let publish = |batch: &mut Vec<IndexedCommit>| {
+                    builder.state.lock().unwrap().commits.append(batch);
+                    builder.grown.notify_all();
+                };
+
+                for line in std::io::BufReader::new(stdout).split(b'\n') {
+                    if builder.cancelled.load(Ordering::Relaxed) {
+                        let _ = child.kill();
+                        break;
+                    }
+                    let Ok(line) = line else { break };
+                    let line = String::from_utf8_lossy(&line);
+                    if let Some(commit) = parse_log_line(&line) {
+                        batch.push(commit);
+                        if batch.len() >= BATCH {
+                            publish(&mut batch);
+                        }
+                    }
+                }
+                publish(&mut batch);
+
+                let status = child.wait();
+                let stderr = stderr_reader.join().unwrap_or_default();
+                let error = match status {
+                    Ok(status) if !status.success() && !builder.cancelled.load(Ordering::Relaxed) => {
+                        Some(format!("git log failed: {}", String::from_utf8_lossy(&stderr)))
+                    }
+                    Err(e) => Some(format!("Failed to run git log: {}", e)),
+                    _ => None,
+                };
+                let mut state = builder.state.lock().unwrap();
+                state.done = true;
+                state.error = error;
+                drop(state);
+                builder.grown.notify_all();
+            })
+            .map_err(|e| format!("Failed to start git index thread: {}", e))?;
+
+        Ok(index)
+    }
+
+    fn failed(&self) -> bool {
+        self.state.lock().unwrap().error.is_some()
+    }
+
+    /// Rows `[skip, skip + limit)`, waiting only until that range is indexed.
+    fn page(&self, skip: usize, limit: usize) -> Result<Vec<CommitEntry>, String> {
+        let want = skip.saturating_add(limit);
+        let mut state = self.state.lock().unwrap();
+        while state.commits.len() < want && !state.done {
+            state = self.grown.wait(state).unwrap();
+        }
+        if let (Some(error), true) = (&state.error, state.commits.is_empty()) {
+            return Err(error.clone());
+        }
+
+        let end = want.min(state.commits.len());
+        let start = skip.min(end);
+        Ok(state.commits[start..end]
+            .iter()
+            .map(|c| CommitEntry {
+                hash: c.hash.clone(),
+                parents: c.parents.clone(),
+                short_hash: c.hash[..8.min(c.hash.len())].to_string(),
+                refs: self.decorations.get(&c.hash).cloned().unwrap_or_default(),
+                message: c.message.clone(),
+                author: c.author.clone(),
+                date_timestamp: c.date_timestamp,
+            })
+            .collect())
+    }
+
+    /// Stop the background walk (the index is being replaced or evicted).
+    fn cancel(&self) {
+        self.cancelled.store(true, std::sync::atomic::Ordering::Relaxed);
+    }
+}
+
+/// Parse one `%H<US>%P<US>%s<US>%an<US>%ct` line.
+fn parse_log_line(line: &str) -> Option<IndexedCommit> {
+    let parts: Vec<&str> = line.splitn(5, '\x1f').collect();
+    if parts.len() < 5 {
+        return None;
+    }
+    Some(IndexedCommit {
+        hash: parts[0].to_string(),
+        parents: parts[1].to_string(),
+        message: parts[2].to_string(),
+        author: parts[3].to_string(),
+        date_timestamp: parts[4].parse().unwrap_or(0),
+    })
+}
+
+/// Cache key covering everything that changes the commit list.
+fn index_key(repo_path: &str, filter: &GraphFilter) -> String {
+    format!(
+        "{}\x1f{:?}\x1f{:?}\x1f{:?}\x1f{}\x1f{}\x1f{}\x1f{}\x1f{:?}",
+        repo_path,
+        filter.branch,
+        filter.author,
+        filter.search_text,
+        filter.after_timestamp,
+        filter.topo_order,
+        filter.first_parent_only,
+        filter.no_merges,
+        filter.paths,
+    )
+}
+
+/// Fetch the warm index for `repo_path` + `filter`, rebuilding it if any
+/// ref moved since it was built.
+fn commit_index(repo_path: &str, filter: &GraphFilter) -> Result<std::sync::Arc<CommitIndex>, String> {
+    use std::sync::{Arc, Mutex, OnceLock};
+    static INDEXES: OnceLock<Mutex<Vec<(String, Arc<CommitIndex>)>>> = OnceLock::new();
+
+    let repo = Repository::open(repo_path).map_err(|e| format!("Failed to open repo: {}", e))?;
+    let fingerprint = ref_fingerprint(&repo);
+    let key = index_key(repo_path, filter);
+
+    // Most recently used last.
+    let mut cache = INDEXES.get_or_init(|| Mutex::new(Vec::new())).lock().unwrap();
+    if let Some(pos) = cache.iter().position(|(k, _)| *k == key) {
+        let (key, index) = cache.remove(pos);
+        if index.fingerprint == fingerprint && !index.failed() {
+            cache.push((key, Arc::clone(&index)));
+            return Ok(index);
+        }
+        index.cancel();
+    }
+
+    let index = CommitIndex::start(&repo, git_log_command(repo_path, filter), fingerprint)?;
+    cache.push((key, Arc::clone(&index)));
+    if cache.len() > MAX_CACHED_INDEXES {
+        cache.remove(0).1.cancel();
+    }
+    Ok(index)
 }
 
 // ═══════════════════════════════════════════════════════════
 // Core functions
 // ═══════════════════════════════════════════════════════════
 
-/// Load commit graph data with filters. Returns a list of CommitEntry.
+/// Build the unpaginated `git log` used to fill a commit index.
 ///
-/// Uses `git log --topo-order --date-order` subprocess to ensure commit
-/// ordering matches IntelliJ IDEA exactly. Ref decorations are enriched
-/// via libgit2.
-pub fn graph_log(
-    repo_path: &str,
-    limit: usize,
-    skip: usize,
-    filter: &GraphFilter,
-) -> Result<Vec<CommitEntry>, String> {
+/// Uses `git log --topo-order --date-order` so commit ordering matches
+/// IntelliJ IDEA exactly.
+fn git_log_command(repo_path: &str, filter: &GraphFilter) -> std::process::Command {
     use std::process::Command;
 
-    // Open repo with libgit2 only for ref decoration
-    let repo = Repository::open(repo_path).map_err(|e| format!("Failed to open repo: {}", e))?;
-
-    // Build git log command
     // Format: hash<SEP>parents<SEP>message<SEP>author<SEP>timestamp
     let separator = "\x1f"; // ASCII Unit Separator
     let format_str = format!(
@@ -137,10 +348,6 @@ pub fn graph_log(
     cmd.args(["log", "--topo-order", "--date-order"]);
     cmd.args([&format!("--format={}", format_str)]);
 
-    // Limit & skip
-    cmd.arg(format!("-n{}", limit + skip)); // fetch enough to skip + limit
-    // We handle skip ourselves after parsing to support path-filter skipping
-
     // First-parent only
     if filter.first_parent_only {
         cmd.arg("--first-parent");
@@ -182,64 +389,24 @@ pub fn graph_log(
         }
     }
 
-    let output = cmd
-        .output()
-        .map_err(|e| format!("Failed to run git log: {}", e))?;
-
-    if !output.status.success() {
-        let stderr = String::from_utf8_lossy(&output.stderr);
-        return Err(format!("git log failed: {}", stderr));
-    }
-
-    let stdout = String::from_utf8_lossy(&output.stdout);
-
-    let mut results = Vec::with_capacity(limit);
-    let mut skipped = 0;
-
-    for line in stdout.lines() {
-        if line.is_empty() {
-            continue;
-        }
-
-        let parts: Vec<&str> = line.splitn(5, '\x1f').collect();
-        if parts.len() < 5 {
-            continue;
-        }
-
-        let hash = parts[0].to_string();
-        let parents = parts[1].to_string();
-        let message = parts[2].to_string();
-        let author = parts[3].to_string();
-        let date_timestamp: i64 = parts[4].parse().unwrap_or(0);
-
-        // Skip N commits
-        if skipped < skip {
-            skipped += 1;
-            continue;
-        }
-
-        let short_hash = hash[..8.min(hash.len())].to_string();
-        let commit_oid = git2::Oid::from_str(&hash).ok();
-        let refs_str = commit_oid
-            .map(|oid| build_ref_decoration(&repo, oid))
-            .unwrap_or_default();
-
-        results.push(CommitEntry {
-            hash,
-            parents,
-            short_hash,
-            refs: refs_str,
-            message,
-            author,
-            date_timestamp,
-        });
-
-        if results.len() >= limit {
-            break;
-        }
-    }
+    cmd
+}
 
-    Ok(results)
+/// Load commit graph data with filters. Returns a list of CommitEntry.
+///
+/// Pages are sliced from a per-repo commit index that is filled once by a
+/// single streaming `git log --topo-order --date-order` run and kept warm
+/// until a ref changes. Ref decorations come from a precomputed
+/// oid → refs map rather than being looked up per commit.
+pub fn graph_log(
+    repo_path: &str,
+    limit: usize,
+    skip: usize,
+    filter: &GraphFilter,
+) -> Result<Vec<CommitEntry>, String> {
+    let _signpost = metrics::signpost!("graph_log");
+    let _timer = metrics::global().graph_log.start();
+    commit_index(repo_path, filter)?.page(skip, limit)
 }
 
 
@@ -443,6 +610,7 @@ pub fn detect_default_branch(repo_path: &str) -> Result<String, String> {
 // ═══════════════════════════════════════════════════════════
 
 /// A line segment within a single row (pixel coordinates relative to row origin).
+#[repr(C)]
 #[derive(Serialize, Clone)]
 pub struct PrintSegment {
     pub x_top: f32,
@@ -453,6 +621,7 @@ pub struct PrintSegment {
 }
 
 /// Arrow indicator for long-span branch lines.
+#[repr(C)]
 #[derive(Serialize, Clone)]
 pub struct ArrowElement {
     pub x: f32,
@@ -505,6 +674,8 @@ pub fn compute_graph_layout(
     main_chain: &HashSet<String>,
     params: &LayoutParams,
 ) -> Vec<GraphRow> {
+    let _signpost = metrics::signpost!("graph_layout");
+    let _timer = metrics::global().graph_layout.start();
     if commits.is_empty() {
         return Vec::new();
     }
@@ -633,68 +804,6 @@ pub fn compute_graph_layout(
             }
         }
 
-        // Build sorted elements for this row using IDEA's comparator
-        #[derive(Clone)]
-        struct RowElement {
-            is_node: bool,
-            edge_index: usize,
-            up_li: i32,
-            down_li: i32,
-            up_row: i32,
-            down_row: i32,
-        }
-
-        // IDEA's compare2(edge, node): positive means edge goes RIGHT of node
-        fn compare2(e: &RowElement, n_elem: &RowElement) -> i32 {
-            let max_edge_li = e.up_li.max(e.down_li);
-            let node_li = n_elem.up_li;
-            if max_edge_li != node_li {
-                return max_edge_li - node_li;
-            }
-            e.up_row - n_elem.up_row
-        }
-
-        fn compare_elements(lhs: &RowElement, rhs: &RowElement) -> i32 {
-            if !lhs.is_node && !rhs.is_node {
-                // Edge vs Edge
-                if lhs.up_row == rhs.up_row {
-                    if lhs.down_row < rhs.down_row {
-                        let vn = RowElement {
-                            is_node: true, edge_index: 0, up_li: lhs.down_li,
-                            down_li: lhs.down_li, up_row: lhs.down_row, down_row: lhs.down_row,
-                        };
-                        return -compare2(rhs, &vn);
-                    } else {
-                        let vn = RowElement {
-                            is_node: true, edge_index: 0, up_li: rhs.down_li,
-                            down_li: rhs.down_li, up_row: rhs.down_row, down_row: rhs.down_row,
-                        };
-                        return compare2(lhs, &vn);
-                    }
-                }
-                if lhs.up_row < rhs.up_row {
-                    let vn = RowElement {
-                        is_node: true, edge_index: 0, up_li: rhs.up_li,
-                        down_li: rhs.up_li, up_row: rhs.up_row, down_row: rhs.up_row,
-                    };
-                    return compare2(lhs, &vn);
-                } else {
-                    let vn = RowElement {
-                        is_node: true, edge_index: 0, up_li: lhs.up_li,
-                        down_li: lhs.up_li, up_row: lhs.up_row, down_row: lhs.up_row,
-                    };
-                    return -compare2(rhs, &vn);
-                }
-            }
-            if !lhs.is_node && rhs.is_node {
-                return compare2(lhs, rhs);
-            }
-            if lhs.is_node && !rhs.is_node {
-                return -compare2(rhs, lhs);
-            }
-            0
-        }
-
         let node_li = layout_index[row];
         let mut elements: Vec<RowElement> = Vec::new();
         elements.push(RowElement {
@@ -987,6 +1096,69 @@ fn assign_layout_indices(
     layout_index
 }
 
+// ── Phase 2 helper: IDEA's row element comparator ──
+
+#[derive(Clone)]
+struct RowElement {
+    is_node: bool,
+    edge_index: usize,
+    up_li: i32,
+    down_li: i32,
+    up_row: i32,
+    down_row: i32,
+}
+
+// IDEA's compare2(edge, node): positive means edge goes RIGHT of node
+fn compare2(e: &RowElement, n_elem: &RowElement) -> i32 {
+    let max_edge_li = e.up_li.max(e.down_li);
+    let node_li = n_elem.up_li;
+    if max_edge_li != node_li {
+        return max_edge_li - node_li;
+    }
+    e.up_row - n_elem.up_row
+}
+
+fn compare_elements(lhs: &RowElement, rhs: &RowElement) -> i32 {
+    if !lhs.is_node && !rhs.is_node {
+        // Edge vs Edge
+        if lhs.up_row == rhs.up_row {
+            if lhs.down_row < rhs.down_row {
+                let vn = RowElement {
+                    is_node: true, edge_index: 0, up_li: lhs.down_li,
+                    down_li: lhs.down_li, up_row: lhs.down_row, down_row: lhs.down_row,
+                };
+                return -compare2(rhs, &vn);
+            } else {
+                let vn = RowElement {
+                    is_node: true, edge_index: 0, up_li: rhs.down_li,
+                    down_li: rhs.down_li, up_row: rhs.down_row, down_row: rhs.down_row,
+                };
+                return compare2(lhs, &vn);
+            }
+        }
+        if lhs.up_row < rhs.up_row {
+            let vn = RowElement {
+                is_node: true, edge_index: 0, up_li: rhs.up_li,
+                down_li: rhs.up_li, up_row: rhs.up_row, down_row: rhs.up_row,
+            };
+            return compare2(lhs, &vn);
+        } else {
+            let vn = RowElement {
+                is_node: true, edge_index: 0, up_li: lhs.up_li,
+                down_li: lhs.up_li, up_row: lhs.up_row, down_row: lhs.up_row,
+            };
+            return -compare2(rhs, &vn);
+        }
+    }
+    if !lhs.is_node && rhs.is_node {
+        return compare2(lhs, rhs);
+    }
+    if lhs.is_node && !rhs.is_node {
+        return -compare2(rhs, lhs);
+    }
+    0
+}
+
 // ── Visibility helpers ──
 
 fn is_edge_visible_in_row(
@@ -1006,3 +1178,717 @@ fn is_edge_visible_in_row(
     }
     true
 }
+
+// ═══════════════════════════════════════════════════════════
+// Incremental Graph Layout
+// ═══════════════════════════════════════════════════════════
+
+/// A laid-out row together with its row index.
+#[derive(Serialize)]
+pub struct RowUpdate {
+    pub row: usize,
+    #[serde(flatten)]
+    pub data: GraphRow,
+}
+
+/// Result of `GraphLayout::append`.
+#[derive(Serialize)]
+pub struct LayoutUpdate {
+    /// Rows laid out so far, including this page.
+    pub total_rows: usize,
+    /// The new rows plus any earlier rows whose segments changed, in row order.
+    pub rows: Vec<RowUpdate>,
+}
+
+struct LayoutEdge {
+    child_row: usize,
+    parent_row: usize,
+    up_li: i32,
+    down_li: i32,
+    color_index: i32,
+}
+
+/// Graph layout that grows page by page.
+///
+/// `compute_graph_layout` rebuilds everything from the full commit list;
+/// `GraphLayout` keeps its state between pages, so appending lays out only
+/// the new rows and the earlier rows crossed by edges into the new page.
+/// Rows already handed out keep their layout index and color: a first-parent
+/// chain cut off at a page boundary continues with the same index in the
+/// next page. For a single page the result matches `compute_graph_layout`.
+pub struct GraphLayout {
+    params: LayoutParams,
+    long_edge_size: i32,
+    visible_part_size: i32,
+    edge_with_arrow_size: i32,
+    main_chain: HashSet<String>,
+
+    commits: Vec<LayoutInput>,
+    parent_lists: Vec<Vec<String>>,
+    hash_to_row: HashMap<String, usize>,
+    layout_index: Vec<i32>,
+    next_layout_index: i32,
+    /// Not-yet-loaded first parents whose chain continues with this index.
+    pending_chains: HashMap<String, i32>,
+    li_to_color: HashMap<i32, i32>,
+    next_color: i32,
+    node_colors: Vec<i32>,
+
+    edges: Vec<LayoutEdge>,
+    /// Not-yet-loaded parent hash → (child row, parent index) referencing it.
+    unresolved: HashMap<String, Vec<(usize, usize)>>,
+    /// Edges drawn in each row (endpoints and visible pass-throughs), ascending.
+    row_edges: Vec<Vec<usize>>,
+    node_columns: Vec<i32>,
+    edge_column_at_row: Vec<HashMap<usize, i32>>,
+}
+
+impl GraphLayout {
+    pub fn new(params: LayoutParams) -> Self {
+        // Same mode-specific constants as `compute_graph_layout`
+        Self {
+            long_edge_size: if params.show_long_edges { 1000 } else { 30 },
+            visible_part_size: if params.show_long_edges { 250 } else { 1 },
+            edge_with_arrow_size: if params.show_long_edges { 30 } else { i32::MAX },
+            params,
+            main_chain: HashSet::new(),
+            commits: Vec::new(),
+            parent_lists: Vec::new(),
+            hash_to_row: HashMap::new(),
+            layout_index: Vec::new(),
+            next_layout_index: 1,
+            pending_chains: HashMap::new(),
+            li_to_color: HashMap::new(),
+            next_color: 1,
+            node_colors: Vec::new(),
+            edges: Vec::new(),
+            unresolved: HashMap::new(),
+            row_edges: Vec::new(),
+            node_columns: Vec::new(),
+            edge_column_at_row: Vec::new(),
+        }
+    }
+
+    /// Number of rows laid out so far.
+    pub fn len(&self) -> usize {
+        self.commits.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.commits.is_empty()
+    }
+
+    /// Lay out the next page of commits, which must directly follow the
+    /// previous page in `graph_log` order. `main_chain` adds first-parent
+    /// hashes drawn in color 0.
+    pub fn append(
+        &mut self,
+        commits: Vec<LayoutInput>,
+        main_chain: impl IntoIterator<Item = String>,
+    ) -> LayoutUpdate {
+        self.main_chain.extend(main_chain);
+        let start = self.commits.len();
+        if commits.is_empty() {
+            return LayoutUpdate { total_rows: start, rows: Vec::new() };
+        }
+
+        for (i, c) in commits.iter().enumerate() {
+            self.hash_to_row.entry(c.hash.clone()).or_insert(start + i);
+            self.parent_lists.push(if c.parents.is_empty() {
+                Vec::new()
+            } else {
+                c.parents.split(' ').map(|s| s.to_string()).collect()
+            });
+        }
+        self.commits.extend(commits);
+        let n = self.commits.len();
+        self.layout_index.resize(n, 0);
+        self.node_columns.resize(n, 0);
+        self.edge_column_at_row.resize_with(n, HashMap::new);
+        self.row_edges.resize_with(n, Vec::new);
+
+        self.assign_layout_indices(start);
+        self.assign_colors(start);
+        let first_new_edge = self.edges.len();
+        self.add_edges(start);
+
+        // Rows whose element order may change: the new rows, plus earlier
+        // rows that a new edge passes through. Segments additionally change
+        // in the rows next to those and at the new edges' endpoints.
+        let mut relayout: BTreeSet<usize> = (start..n).collect();
+        let mut dirty: BTreeSet<usize> = BTreeSet::new();
+        for ei in first_new_edge..self.edges.len() {
+            let (child_row, parent_row) = (self.edges[ei].child_row, self.edges[ei].parent_row);
+            self.row_edges[child_row].push(ei);
+            self.row_edges[parent_row].push(ei);
+            for r in self.visible_rows(child_row, parent_row) {
+                self.row_edges[r].push(ei);
+                relayout.insert(r);
+            }
+            dirty.insert(child_row);
+            dirty.insert(parent_row);
+        }
+        for &row in &relayout {
+            self.layout_row(row);
+            dirty.extend(row.saturating_sub(1)..=(row + 1).min(n - 1));
+        }
+
+        LayoutUpdate {
+            total_rows: n,
+            rows: dirty
+                .into_iter()
+                .map(|row| RowUpdate { row, data: self.build_row(row) })
+                .collect(),
+        }
+    }
+
+    // ── Phase 1: layout indices for rows start.. ──
+    // Chains cut off at the previous page boundary continue first, then new
+    // heads, then anything left — the same walk as `assign_layout_indices`.
+    fn assign_layout_indices(&mut self, start: usize) {
+        let n = self.commits.len();
+        let mut referenced: Vec<bool> = self.commits[start..]
+            .iter()
+            .map(|c| self.unresolved.contains_key(&c.hash))
+            .collect();
+        for parents in &self.parent_lists[start..] {
+            for p in parents {
+                if let Some(&pr) = self.hash_to_row.get(p) {
+                    if pr >= start {
+                        referenced[pr - start] = true;
+                    }
+                }
+            }
+        }
+
+        let continued: Vec<(usize, i32)> = (start..n)
+            .filter_map(|row| self.pending_chains.remove(&self.commits[row].hash).map(|li| (row, li)))
+            .collect();
+        for (row, li) in continued {
+            self.walk(row, Some(li));
+        }
+        for row in start..n {
+            if !referenced[row - start] {
+                self.walk(row, None);
+            }
+        }
+        for row in start..n {
+            self.walk(row, None);
+        }
+    }
+
+    /// DFS from `root`. With `chain`, the first chain reuses that index
+    /// instead of taking a fresh one.
+    fn walk(&mut self, root: usize, mut chain: Option<i32>) {
+        if self.layout_index[root] != 0 {
+            return;
+        }
+        let mut stack = vec![root];
+        while let Some(&cur) = stack.last() {
+            let first_visit = self.layout_index[cur] == 0;
+            if first_visit {
+                self.layout_index[cur] = chain.unwrap_or(self.next_layout_index);
+            }
+            let next_node = self.parent_lists[cur]
+                .iter()
+                .filter_map(|p| self.hash_to_row.get(p).copied())
+                .find(|&pr| self.layout_index[pr] == 0);
+            if let Some(next) = next_node {
+                stack.push(next);
+                continue;
+            }
+            if first_visit {
+                // The chain would have continued into a parent that is not
+                // loaded yet; remember its index for the next page.
+                let missing = self.parent_lists[cur]
+                    .iter()
+                    .find(|p| !self.hash_to_row.contains_key(*p))
+                    .cloned();
+                if let Some(missing) = missing {
+                    self.pending_chains.entry(missing).or_insert(self.layout_index[cur]);
+                }
+                if chain.take().is_none() {
+                    self.next_layout_index += 1;
+                }
+            }
+            stack.pop();
+        }
+    }
+
+    fn assign_colors(&mut self, start: usize) {
+        for row in start..self.commits.len() {
+            let li = self.layout_index[row];
+            let ci = if self.main_chain.contains(&self.commits[row].hash) {
+                0
+            } else if let Some(&c) = self.li_to_color.get(&li) {
+                c
+            } else {
+                let c = self.next_color;
+                self.next_color += 1;
+                self.li_to_color.insert(li, c);
+                c
+            };
+            self.node_colors.push(ci);
+        }
+    }
+
+    fn add_edges(&mut self, start: usize) {
+        let n = self.commits.len();
+
+        // Earlier rows whose parents arrived with this page
+        let mut resolved: Vec<(usize, usize, usize)> = Vec::new();
+        for row in start..n {
+            if let Some(children) = self.unresolved.remove(&self.commits[row].hash) {
+                resolved.extend(children.into_iter().map(|(child, pi)| (child, pi, row)));
+            }
+        }
+        resolved.sort_unstable();
+        for (child, pi, parent) in resolved {
+            self.push_edge(child, pi, parent);
+        }
+
+        for child in start..n {
+            for pi in 0..self.parent_lists[child].len() {
+                let parent = self.hash_to_row.get(&self.parent_lists[child][pi]).copied();
+                match parent {
+                    Some(parent) if parent > child => self.push_edge(child, pi, parent),
+                    Some(_) => {}
+                    None => {
+                        let hash = self.parent_lists[child][pi].clone();
+                        self.unresolved.entry(hash).or_default().push((child, pi));
+                    }
+                }
+            }
+        }
+    }
+
+    fn push_edge(&mut self, child_row: usize, parent_index: usize, parent_row: usize) {
+        // First-parent edges inherit child color; merge edges use parent color
+        let color_index = if parent_index == 0 {
+            self.node_colors[child_row]
+        } else {
+            self.node_colors[parent_row]
+        };
+        self.edges.push(LayoutEdge {
+            child_row,
+            parent_row,
+            up_li: self.layout_index[child_row],
+            down_li: self.layout_index[parent_row],
+            color_index,
+        });
+    }
+
+    /// Intermediate rows in which an edge is visible, without walking the
+    /// hidden middle of long edges.
+    fn visible_rows(
+        &self,
+        child_row: usize,
+        parent_row: usize,
+    ) -> std::iter::Chain<std::ops::Range<usize>, std::ops::Range<usize>> {
+        let span = (parent_row - child_row) as i32;
+        let reach = if span >= self.long_edge_size {
+            self.visible_part_size
+        } else if span >= self.edge_with_arrow_size {
+            1
+        } else {
+            span
+        } as usize;
+        let head = (child_row + 1)..(child_row + 1 + reach).min(parent_row);
+        let tail = parent_row.saturating_sub(reach).max(head.end)..parent_row;
+        head.chain(tail)
+    }
+
+    // ── Phase 2: column positions for one row ──
+    fn layout_row(&mut self, row: usize) {
+        let node_li = self.layout_index[row];
+        let mut elements: Vec<RowElement> = vec![RowElement {
+            is_node: true,
+            edge_index: 0,
+            up_li: node_li,
+            down_li: node_li,
+            up_row: row as i32,
+            down_row: row as i32,
+        }];
+        for &ei in &self.row_edges[row] {
+            let e = &self.edges[ei];
+            if e.child_row < row && row < e.parent_row {
+                elements.push(RowElement {
+                    is_node: false,
+                    edge_index: ei,
+                    up_li: e.up_li,
+                    down_li: e.down_li,
+                    up_row: e.child_row as i32,
+                    down_row: e.parent_row as i32,
+                });
+            }
+        }
+        elements.sort_by(|a, b| compare_elements(a, b).cmp(&0));
+
+        let edge_columns = &mut self.edge_column_at_row[row];
+        edge_columns.clear();
+        for (col, elem) in elements.iter().enumerate() {
+            if elem.is_node {
+                self.node_columns[row] = col as i32;
+            } else {
+                edge_columns.insert(elem.edge_index, col as i32);
+            }
+        }
+    }
+
+    // ── Phase 3: segments and arrows for one row ──
+    // Produces the same per-row output as the per-edge pass in
+    // `compute_graph_layout`, so any single row can be regenerated.
+    fn build_row(&self, row: usize) -> GraphRow {
+        let lw = self.params.lane_width;
+        let rh = self.params.row_height;
+        let x_pos = |col: i32| -> f32 { col as f32 * lw + lw / 2.0 + 4.0 };
+        let approach_len: f32 = 8.0;
+        let vps = self.visible_part_size as usize;
+
+        let mut segments: Vec<PrintSegment> = Vec::new();
+        let mut arrows: Vec<ArrowElement> = Vec::new();
+
+        for &ei in &self.row_edges[row] {
+            let edge = &self.edges[ei];
+            let (child, parent, ci) = (edge.child_row, edge.parent_row, edge.color_index);
+            let span = parent as i32 - child as i32;
+            let column_at = |r: usize, fallback: usize| {
+                self.edge_column_at_row[r].get(&ei).copied().unwrap_or(self.node_columns[fallback])
+            };
+            let anchor = |r: usize| -> Option<f32> {
+                if r == child || r == parent {
+                    Some(x_pos(self.node_columns[r]))
+                } else if child < r && r < parent && is_edge_visible_in_row(
+                    child as i32, parent as i32, r as i32,
+                    self.long_edge_size, self.visible_part_size, self.edge_with_arrow_size,
+                ) {
+                    Some(x_pos(column_at(r, child)))
+                } else {
+                    None
+                }
+            };
+            let long = span >= self.long_edge_size;
+            let arrowed = span >= self.edge_with_arrow_size;
+            let down_arrow_row = (long && row == child + vps) || (arrowed && row == child + 1);
+            let up_arrow_row = (long && parent >= vps && row == parent - vps) || (arrowed && row + 1 == parent);
+
+            // Top half of this row, coming from the row above
+            if row > child {
+                if let (Some(x_a), Some(x_b)) = (anchor(row - 1), anchor(row)) {
+                    let x_mid = (x_a + x_b) / 2.0;
+                    let is_diagonal = (x_a - x_b).abs() > 0.5;
+                    if down_arrow_row && is_diagonal {
+                        segments.push(PrintSegment {
+                            x_top: x_mid, y_top: 0.0, x_bottom: x_b, y_bottom: rh - approach_len, color_index: ci,
+                        });
+                        segments.push(PrintSegment {
+                            x_top: x_b, y_top: rh - approach_len, x_bottom: x_b, y_bottom: rh, color_index: ci,
+                        });
+                    } else if down_arrow_row {
+                        segments.push(PrintSegment {
+                            x_top: x_mid, y_top: 0.0, x_bottom: x_b, y_bottom: rh, color_index: ci,
+                        });
+                    } else {
+                        segments.push(PrintSegment {
+                            x_top: x_mid, y_top: 0.0, x_bottom: x_b, y_bottom: rh / 2.0, color_index: ci,
+                        });
+                    }
+                }
+            }
+
+            // Bottom half of this row, heading to the row below
+            if row < parent {
+                if let (Some(x_a), Some(x_b)) = (anchor(row), anchor(row + 1)) {
+                    let x_mid = (x_a + x_b) / 2.0;
+                    let is_diagonal = (x_a - x_b).abs() > 0.5;
+                    if up_arrow_row && is_diagonal {
+                        segments.push(PrintSegment {
+                            x_top: x_a, y_top: 0.0, x_bottom: x_a, y_bottom: approach_len, color_index: ci,
+                        });
+                        segments.push(PrintSegment {
+                            x_top: x_a, y_top: approach_len, x_bottom: x_mid, y_bottom: rh, color_index: ci,
+                        });
+                    } else if up_arrow_row {
+                        segments.push(PrintSegment {
+                            x_top: x_a, y_top: 0.0, x_bottom: x_mid, y_bottom: rh, color_index: ci,
+                        });
+                    } else {
+                        segments.push(PrintSegment {
+                            x_top: x_a, y_top: rh / 2.0, x_bottom: x_mid, y_bottom: rh, color_index: ci,
+                        });
+                    }
+                }
+            }
+
+            // Arrow indicators — same dual-rule system
+            let mut push_arrow = |is_down: bool| {
+                let col = if is_down { column_at(row, child) } else { column_at(row, parent) };
+                arrows.push(ArrowElement {
+                    x: x_pos(col), y: if is_down { rh } else { 0.0 }, color_index: ci, is_down,
+                });
+            };
+            if long {
+                if row == child + vps {
+                    push_arrow(true);
+                }
+                if parent >= vps && row == parent - vps {
+                    push_arrow(false);
+                }
+            }
+            if arrowed {
+                if row == child + 1 {
+                    push_arrow(true);
+                }
+                if row + 1 == parent {
+                    push_arrow(false);
+                }
+            }
+        }
+
+        let c = &self.commits[row];
+        GraphRow {
+            hash: c.hash.clone(),
+            short_hash: c.short_hash.clone(),
+            message: c.message.clone(),
+            author: c.author.clone(),
+            date_timestamp: c.date_timestamp,
+            refs: c.refs.clone(),
+            parents: c.parents.clone(),
+            node_column: self.node_columns[row],
+            color_index: self.node_colors[row],
+            segments,
+            arrows,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// `git` in `dir` with a fixed identity and no signing.
+    fn git_command(dir: &Path) -> std::process::Command {
+        let mut cmd = std::process::Command::new("git");
+        cmd.current_dir(dir).args([
+            "-c", "user.name=Dev",
+            "-c", "user.email=dev@example.com",
+            "-c", "commit.gpgsign=false",
+            "-c", "tag.gpgsign=false",
+        ]);
+        cmd
+    }
+
+    fn git(dir: &Path, args: &[&str]) -> String {
+        let output = git_command(dir).args(args).output().unwrap();
+        assert!(output.status.success(), "git {:?}: {}", args, String::from_utf8_lossy(&output.stderr));
+        String::from_utf8_lossy(&output.stdout).trim().to_string()
+    }
+
+    fn commit(dir: &Path, message: &str, time: i64) -> String {
+        let date = format!("@{} +0000", time);
+        let status = git_command(dir)
+            .args(["commit", "-q", "--allow-empty", "-m", message])
+            .env("GIT_AUTHOR_DATE", &date)
+            .env("GIT_COMMITTER_DATE", &date)
+            .status()
+            .unwrap();
+        assert!(status.success());
+        git(dir, &["rev-parse", "HEAD"])
+    }
+
+    #[test]
+    fn test_parse_log_line() {
+        let commit = parse_log_line("abc\x1fdef 123\x1ffix: paging, again\x1fDev Name\x1f1700000000").unwrap();
+        assert_eq!((commit.hash.as_str(), commit.parents.as_str()), ("abc", "def 123"));
+        assert_eq!((commit.message.as_str(), commit.author.as_str()), ("fix: paging, again", "Dev Name"));
+        assert_eq!(commit.date_timestamp, 1_700_000_000);
+        assert!(parse_log_line("abc\x1f\x1fmessage").is_none());
+    }
+
+    #[test]
+    fn test_commit_index_pages_and_decorations() {
+        let dir = std::env::temp_dir().join(format!("pier-git-index-{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        std::fs::create_dir_all(&dir).unwrap();
+        git(&dir, &["init", "-q", "-b", "main"]);
+        let first = commit(&dir, "first", 1_700_000_000);
+        let second = commit(&dir, "second", 1_700_000_100);
+        let third = commit(&dir, "third", 1_700_000_200);
+        git(&dir, &["tag", "v1", &second]);
+        git(&dir, &["tag", "-a", "-m", "release", "v2", &third]);
+        git(&dir, &["branch", "feature", &first]);
+
+        let repo = dir.to_str().unwrap();
+        let filter = GraphFilter {
+            branch: None,
+            author: None,
+            search_text: None,
+            after_timestamp: 0,
+            topo_order: true,
+            first_parent_only: false,
+            no_merges: false,
+            paths: Vec::new(),
+        };
+        let page = graph_log(repo, 10, 0, &filter).unwrap();
+        let summary: Vec<(&str, &str)> = page.iter().map(|c| (c.message.as_str(), c.refs.as_str())).collect();
+        assert_eq!(summary, vec![
+            ("third", " (HEAD -> main, tag: v2)"),
+            ("second", " (tag: v1)"),
+            ("first", " (feature)"),
+        ]);
+        assert_eq!(page[0].hash, third);
+        assert_eq!(page[0].short_hash, &third[..8]);
+        assert_eq!(page[0].parents, second);
+        assert_eq!(page[0].author, "Dev");
+        assert_eq!(page[0].date_timestamp, 1_700_000_200);
+        assert!(page[2].parents.is_empty());
+
+        let hashes = |skip, limit| -> Vec<String> {
+            graph_log(repo, limit, skip, &filter).unwrap().into_iter().map(|c| c.hash).collect()
+        };
+        assert_eq!(hashes(1, 1), vec![second.clone()]);
+        assert_eq!(hashes(2, 5), vec![first.clone()]);
+        assert!(hashes(3, 5).is_empty());
+        assert!(hashes(100, 5).is_empty());
+
+        // Moving a ref invalidates the warm index.
+        git(&dir, &["branch", "-f", "feature", &second]);
+        let page = graph_log(repo, 10, 0, &filter).unwrap();
+        assert_eq!(page[1].refs, " (feature, tag: v1)");
+        assert_eq!(page[2].refs, "");
+        commit(&dir, "fourth", 1_700_000_300);
+        let page = graph_log(repo, 1, 0, &filter).unwrap();
+        assert_eq!((page[0].message.as_str(), page[0].refs.as_str()), ("fourth", " (HEAD -> main)"));
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    fn input(hash: &str, parents: &str) -> LayoutInput {
+        LayoutInput {
+            hash: hash.to_string(),
+            parents: parents.to_string(),
+            short_hash: hash.to_string(),
+            refs: String::new(),
+            message: format!("commit {}", hash),
+            author: "dev".to_string(),
+            date_timestamp: 0,
+        }
+    }
+
+    /// A main line with a short side branch merged every 7 commits and a
+    /// few long-lived branches, newest first.
+    fn history(n: usize) -> Vec<(String, String)> {
+        let mut commits = Vec::new();
+        for i in 0..n {
+            let mut parents = if i + 1 < n { format!("m{}", i + 1) } else { String::new() };
+            let side = i % 7 == 0 && i + 3 < n;
+            if side {
+                parents.push_str(&format!(" s{}", i));
+            }
+            commits.push((format!("m{}", i), parents));
+            if side {
+                commits.push((format!("s{}", i), format!("m{}", i + 3)));
+            }
+            if i % 97 == 0 && i + 1100 < n {
+                commits.push((format!("l{}", i), format!("m{} m{}", i + 60, i + 1100)));
+            }
+        }
+        commits
+    }
+
+    fn params(show_long_edges: bool) -> LayoutParams {
+        LayoutParams { lane_width: 16.0, row_height: 24.0, show_long_edges }
+    }
+
+    fn segments(row: &GraphRow) -> Vec<(f32, f32, f32, f32, i32)> {
+        row.segments.iter().map(|s| (s.x_top, s.y_top, s.x_bottom, s.y_bottom, s.color_index)).collect()
+    }
+
+    fn arrows(row: &GraphRow) -> Vec<(f32, f32, i32, bool)> {
+        row.arrows.iter().map(|a| (a.x, a.y, a.color_index, a.is_down)).collect()
+    }
+
+    fn same_row(a: &GraphRow, b: &GraphRow) -> bool {
+        a.hash == b.hash
+            && a.node_column == b.node_column
+            && a.color_index == b.color_index
+            && segments(a) == segments(b)
+            && arrows(a) == arrows(b)
+    }
+
+    #[test]
+    fn test_single_page_matches_full_layout() {
+        let commits = history(1500);
+        let main_chain: HashSet<String> = (0..1500).step_by(2).map(|i| format!("m{}", i)).collect();
+        for show_long_edges in [false, true] {
+            let inputs = || commits.iter().map(|(h, p)| input(h, p)).collect::<Vec<_>>();
+            let full = compute_graph_layout(&inputs(), &main_chain, &params(show_long_edges));
+            let mut layout = GraphLayout::new(params(show_long_edges));
+            let update = layout.append(inputs(), main_chain.iter().cloned());
+
+            assert_eq!(update.total_rows, full.len());
+            assert_eq!(update.rows.len(), full.len());
+            for (i, (paged, expected)) in update.rows.iter().zip(&full).enumerate() {
+                assert_eq!(paged.row, i);
+                let row = &paged.data;
+                assert_eq!(row.hash, expected.hash);
+                assert_eq!(row.short_hash, expected.short_hash);
+                assert_eq!(row.message, expected.message);
+                assert_eq!(row.author, expected.author);
+                assert_eq!(row.date_timestamp, expected.date_timestamp);
+                assert_eq!(row.refs, expected.refs);
+                assert_eq!(row.parents, expected.parents);
+                assert_eq!(row.node_column, expected.node_column, "row {}", i);
+                assert_eq!(row.color_index, expected.color_index, "row {}", i);
+                assert_eq!(segments(row), segments(expected), "row {}", i);
+                assert_eq!(arrows(row), arrows(expected), "row {}", i);
+            }
+        }
+    }
+
+    #[test]
+    fn test_append_resends_crossed_rows() {
+        // a0 merges b_x, which only arrives in the second page; the merge
+        // edge passes through b ... f.
+        let page1 = [
+            ("t0", "t1"), ("t1", "t2"), ("t2", "a0"),
+            ("a0", "b b_x"), ("b", "c"), ("c", "d"), ("d", "e"), ("e", "f"),
+        ];
+        let page2 = [("f", "b_x"), ("b_x", "g"), ("g", "")];
+        let mut layout = GraphLayout::new(params(false));
+
+        let first = layout.append(page1.iter().map(|(h, p)| input(h, p)).collect(), Vec::new());
+        assert_eq!(first.total_rows, page1.len());
+        assert_eq!(first.rows.iter().map(|r| r.row).collect::<Vec<_>>(), (0..page1.len()).collect::<Vec<_>>());
+        let a0 = layout.hash_to_row["a0"];
+        let chain = layout.layout_index[a0];
+
+        let second = layout.append(page2.iter().map(|(h, p)| input(h, p)).collect(), Vec::new());
+        assert_eq!(second.total_rows, page1.len() + 3);
+
+        let resent: HashMap<usize, &GraphRow> = second.rows.iter().map(|r| (r.row, &r.data)).collect();
+        for row in page1.len()..second.total_rows {
+            assert!(resent.contains_key(&row), "new row {} missing", row);
+        }
+        // The merge edge a0 -> b_x now passes through b, c, d, e and f.
+        let merge_row = layout.hash_to_row["b_x"];
+        for row in a0 + 1..merge_row {
+            let update = resent.get(&row).unwrap_or_else(|| panic!("crossed row {} not re-sent", row));
+            if row < page1.len() {
+                assert!(update.segments.len() > first.rows[row].data.segments.len(), "row {} gained no segment", row);
+            }
+        }
+        // Everything else is exactly as first returned.
+        for (row, earlier) in first.rows.iter().map(|r| (r.row, &r.data)) {
+            let now = layout.build_row(row);
+            if !resent.contains_key(&row) {
+                assert!(same_row(&now, earlier), "row {} changed without being re-sent", row);
+            } else if row < a0 {
+                assert!(same_row(&now, earlier), "row {} re-sent with a different layout", row);
+            }
+        }
+        // The first-parent chain cut at the page boundary keeps its index.
+        assert_eq!(layout.layout_index[layout.hash_to_row["f"]], chain);
+        assert_eq!(layout.layout_index[layout.hash_to_row["g"]], chain);
+    }
+}
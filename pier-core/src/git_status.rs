@@ -0,0 +1,253 @@
+//! Git Status — working tree status and per-file diffs via libgit2.
+//!
+//! Replaces the Git panel's periodic `git status --porcelain` and per-file
+//! `git diff` subprocesses. A `GitStatus` keeps its `Repository` open, so
+//! the index is only re-read when it changed on disk, and asks libgit2 to
+//! write refreshed stat data back to the index: files touched but not
+//! modified are hashed once, and later refreshes are a stat per tracked
+//! file. Each refresh reports only the entries that changed since the
+//! previous one.
+
+use git2::{DiffFormat, DiffOptions, Repository, Status, StatusOptions};
+use serde::Serialize;
+use std::collections::HashMap;
+use std::sync::Mutex;
+
+/// One path's status, with porcelain v1 codes (`' '` = unchanged).
+#[derive(Serialize, Clone, Debug, PartialEq)]
+pub struct StatusEntry {
+    pub path: String,
+    /// Index (staged) column: 'M', 'A', 'D', 'R', 'T', 'U', '?' or ' '.
+    pub index: char,
+    /// Worktree (unstaged) column, same codes.
+    pub worktree: char,
+}
+
+/// Result of `GitStatus::refresh`.
+#[derive(Serialize, Debug)]
+pub struct StatusUpdate {
+    /// True when `entries` is the complete status rather than a delta.
+    pub full: bool,
+    /// Changed entries. In a delta, paths that became clean are listed with
+    /// both codes `' '`.
+    pub entries: Vec<StatusEntry>,
+}
+
+/// A warm repository handle for status and diff queries. Safe to share
+/// between threads; calls are serialized.
+pub struct GitStatus {
+    inner: Mutex<Inner>,
+}
+
+struct Inner {
+    repo: Repository,
+    /// Codes reported by the previous refresh, by path.
+    last: Option<HashMap<String, (char, char)>>,
+}
+
+impl GitStatus {
+    pub fn open(repo_path: &str) -> Result<Self, String> {
+        let repo = Repository::open(repo_path).map_err(|e| format!("Failed to open repo: {}", e))?;
+        Ok(Self { inner: Mutex::new(Inner { repo, last: None }) })
+    }
+
+    /// Compute the status. Returns every entry when `full` is set or on the
+    /// first call, otherwise only what changed since the previous call.
+    pub fn refresh(&self, full: bool) -> Result<StatusUpdate, String> {
+        let mut inner = self.inner.lock().unwrap();
+        let current = current_status(&inner.repo)?;
+
+        let previous = if full { None } else { inner.last.take() };
+        let update = match previous {
+            None => {
+                let mut entries: Vec<StatusEntry> = current
+                    .iter()
+                    .map(|(path, &(index, worktree))| StatusEntry { path: path.clone(), index, worktree })
+                    .collect();
+                entries.sort_by(|a, b| a.path.cmp(&b.path));
+                StatusUpdate { full: true, entries }
+            }
+            Some(previous) => {
+                let mut entries: Vec<StatusEntry> = current
+                    .iter()
+                    .filter(|(path, codes)| previous.get(*path) != Some(*codes))
+                    .map(|(path, &(index, worktree))| StatusEntry { path: path.clone(), index, worktree })
+                    .collect();
+                entries.extend(
+                    previous
+                        .keys()
+                        .filter(|path| !current.contains_key(*path))
+                        .map(|path| StatusEntry { path: path.clone(), index: ' ', worktree: ' ' }),
+                );
+                entries.sort_by(|a, b| a.path.cmp(&b.path));
+                StatusUpdate { full: false, entries }
+            }
+        };
+
+        inner.last = Some(current);
+        Ok(update)
+    }
+
+    /// Patch text for one file, as `git diff [--cached] -- <path>` prints it.
+    /// `staged` diffs HEAD against the index, otherwise the index against the
+    /// worktree. Empty if the file has no such changes.
+    pub fn diff_file(&self, path: &str, staged: bool) -> Result<String, String> {
+        let inner = self.inner.lock().unwrap();
+        let repo = &inner.repo;
+
+        let mut opts = DiffOptions::new();
+        opts.pathspec(path).disable_pathspec_match(true);
+        let diff = if staged {
+            // No HEAD yet (fresh repo): everything staged is new.
+            let head_tree = repo.head().ok().and_then(|head| head.peel_to_tree().ok());
+            repo.diff_tree_to_index(head_tree.as_ref(), None, Some(&mut opts))
+        } else {
+            repo.diff_index_to_workdir(None, Some(&mut opts))
+        }
+        .map_err(|e| format!("Failed to diff {}: {}", path, e))?;
+
+        let mut patch = Vec::new();
+        diff.print(DiffFormat::Patch, |_delta, _hunk, line| {
+            if matches!(line.origin(), '+' | '-' | ' ') {
+                patch.push(line.origin() as u8);
+            }
+            patch.extend_from_slice(line.content());
+            true
+        })
+        .map_err(|e| format!("Failed to print diff: {}", e))?;
+        Ok(String::from_utf8_lossy(&patch).into_owned())
+    }
+}
+
+/// Porcelain codes of every non-clean path.
+fn current_status(repo: &Repository) -> Result<HashMap<String, (char, char)>, String> {
+    // Writing refreshed stat data back fails while another git holds
+    // index.lock (the panel's own commit, the user's terminal). Like
+    // `git status`, carry on without the write.
+    let statuses = repo
+        .statuses(Some(&mut status_options(true)))
+        .or_else(|_| repo.statuses(Some(&mut status_options(false))))
+        .map_err(|e| format!("Failed to read status: {}", e))?;
+    let mut current = HashMap::with_capacity(statuses.len());
+    for entry in statuses.iter() {
+        let status = entry.status();
+        // A rename is reported under its old path; show the new one.
+        let renamed = entry
+            .head_to_index()
+            .filter(|_| status.contains(Status::INDEX_RENAMED))
+            .and_then(|delta| delta.new_file().path().map(|p| p.to_string_lossy().into_owned()));
+        let path = match renamed.or_else(|| entry.path().map(str::to_string)) {
+            Some(path) => path,
+            None => continue,
+        };
+        current.insert(path, porcelain_codes(status));
+    }
+    Ok(current)
+}
+
+fn status_options(update_index: bool) -> StatusOptions {
+    let mut opts = StatusOptions::new();
+    opts.include_untracked(true)
+        // Like `git status`: an untracked directory is one `dir/` entry,
+        // and its contents aren't walked.
+        .recurse_untracked_dirs(false)
+        .include_ignored(false)
+        .renames_head_to_index(true)
+        // Write refreshed stat data back, so unchanged files aren't
+        // re-hashed on the next refresh.
+        .update_index(update_index);
+    opts
+}
+
+/// Map libgit2 status flags to porcelain v1's two columns.
+fn porcelain_codes(status: Status) -> (char, char) {
+    if status.is_conflicted() {
+        return ('U', 'U');
+    }
+    if status.is_wt_new() {
+        return ('?', '?');
+    }
+    let index = if status.is_index_new() {
+        'A'
+    } else if status.is_index_modified() {
+        'M'
+    } else if status.is_index_deleted() {
+        'D'
+    } else if status.is_index_renamed() {
+        'R'
+    } else if status.is_index_typechange() {
+        'T'
+    } else {
+        ' '
+    };
+    let worktree = if status.is_wt_modified() {
+        'M'
+    } else if status.is_wt_deleted() {
+        'D'
+    } else if status.is_wt_renamed() {
+        'R'
+    } else if status.is_wt_typechange() {
+        'T'
+    } else {
+        ' '
+    };
+    (index, worktree)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::path::Path;
+
+    #[test]
+    fn test_porcelain_codes() {
+        assert_eq!(porcelain_codes(Status::WT_NEW), ('?', '?'));
+        assert_eq!(porcelain_codes(Status::INDEX_MODIFIED | Status::WT_MODIFIED), ('M', 'M'));
+        assert_eq!(porcelain_codes(Status::INDEX_NEW | Status::WT_DELETED), ('A', 'D'));
+        assert_eq!(porcelain_codes(Status::CONFLICTED | Status::INDEX_NEW), ('U', 'U'));
+    }
+
+    #[test]
+    fn test_status_deltas_and_diff() {
+        let root = std::env::temp_dir().join(format!("pier-git-status-{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&root);
+        let repo = Repository::init(&root).unwrap();
+        std::fs::write(root.join("a.txt"), "one\n").unwrap();
+        std::fs::write(root.join("b.txt"), "two\n").unwrap();
+
+        let status = GitStatus::open(root.to_str().unwrap()).unwrap();
+        let first = status.refresh(false).unwrap();
+        assert!(first.full);
+        assert_eq!(first.entries.len(), 2);
+        assert_eq!((first.entries[0].index, first.entries[0].worktree), ('?', '?'));
+
+        // Nothing changed: empty delta.
+        assert!(status.refresh(false).unwrap().entries.is_empty());
+
+        let mut index = repo.index().unwrap();
+        index.add_path(Path::new("a.txt")).unwrap();
+        index.write().unwrap();
+        std::fs::remove_file(root.join("b.txt")).unwrap();
+        let delta = status.refresh(false).unwrap();
+        assert!(!delta.full);
+        assert_eq!(delta.entries, vec![
+            StatusEntry { path: "a.txt".into(), index: 'A', worktree: ' ' },
+            StatusEntry { path: "b.txt".into(), index: ' ', worktree: ' ' },
+        ]);
+
+        std::fs::write(root.join("a.txt"), "one\nmore\n").unwrap();
+        let unstaged = status.diff_file("a.txt", false).unwrap();
+        assert!(unstaged.contains("+more\n"), "{}", unstaged);
+        let staged = status.diff_file("a.txt", true).unwrap();
+        assert!(staged.contains("+one\n") && !staged.contains("+more"), "{}", staged);
+
+        // Another git holding the index lock doesn't break a refresh.
+        std::fs::write(root.join(".git/index.lock"), "").unwrap();
+        std::fs::write(root.join("c.txt"), "three\n").unwrap();
+        let locked = status.refresh(false).unwrap();
+        assert!(locked.entries.contains(&StatusEntry { path: "c.txt".into(), index: '?', worktree: '?' }));
+        assert!(root.join(".git/index.lock").exists());
+
+        std::fs::remove_dir_all(&root).unwrap();
+    }
+}
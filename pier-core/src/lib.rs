@@ -1,11 +1,16 @@
 //! Pier Core — high-performance engine for Pier Terminal
 //!
-//! Provides terminal emulation, SSH/SFTP, file search, git graph, and crypto
-//! through a C FFI interface consumed by Swift.
+//! Provides terminal emulation, SSH/SFTP, file search, git graph, status and blame, database
+//! clients and crypto through a C FFI interface consumed by Swift, plus runtime metrics for the
+//! hot paths.
 
 pub mod ffi;
 pub mod terminal;
 pub mod ssh;
 pub mod search;
 pub mod crypto;
+pub mod db;
+pub mod git_blame;
 pub mod git_graph;
+pub mod git_status;
+pub mod metrics;
@@ -0,0 +1,345 @@
+//! Runtime metrics.
+//!
+//! Counters and latency histograms on the hot paths, cheap enough to leave
+//! on: an update is a few relaxed atomic adds. Process-wide totals live in
+//! [`global`]; SSH connections and terminals also keep their own, so a slow
+//! link, a contended exec slot and a busy VT parser can be told apart.
+//! Snapshots are plain `#[repr(C)]` structs for the FFI.
+//!
+//! With the `signposts` feature, timed sections also open `tracing` spans
+//! (see [`signpost!`]), which `pier_init` routes to the macOS unified log
+//! (subsystem `com.kkape.pier`) so Instruments can line them up with the
+//! app's own intervals.
+
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+
+/// A monotonically increasing count.
+pub struct Counter(AtomicU64);
+
+impl Counter {
+    pub const fn new() -> Self {
+        Self(AtomicU64::new(0))
+    }
+
+    pub fn add(&self, n: u64) {
+        self.0.fetch_add(n, Ordering::Relaxed);
+    }
+
+    pub fn get(&self) -> u64 {
+        self.0.load(Ordering::Relaxed)
+    }
+}
+
+impl Default for Counter {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+const BUCKETS: usize = 32;
+
+/// Latency histogram with power-of-two buckets: bucket `i` counts samples
+/// under 2^i µs; the last one takes everything longer.
+pub struct Histogram {
+    buckets: [AtomicU64; BUCKETS],
+    sum_us: AtomicU64,
+    max_us: AtomicU64,
+}
+
+/// Summary of a histogram. Percentiles are bucket upper bounds, so they
+/// overestimate by at most 2x (and never exceed `max_us`).
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct LatencySummary {
+    pub count: u64,
+    pub mean_us: u64,
+    pub p50_us: u64,
+    pub p99_us: u64,
+    pub max_us: u64,
+}
+
+impl Histogram {
+    pub const fn new() -> Self {
+        #[allow(clippy::declare_interior_mutable_const)]
+        const ZERO: AtomicU64 = AtomicU64::new(0);
+        Self { buckets: [ZERO; BUCKETS], sum_us: ZERO, max_us: ZERO }
+    }
+
+    pub fn record(&self, elapsed: Duration) {
+        let us = elapsed.as_micros().min(u64::MAX as u128) as u64;
+        let bucket = ((u64::BITS - us.leading_zeros()) as usize).min(BUCKETS - 1);
+        self.buckets[bucket].fetch_add(1, Ordering::Relaxed);
+        self.sum_us.fetch_add(us, Ordering::Relaxed);
+        self.max_us.fetch_max(us, Ordering::Relaxed);
+    }
+
+    /// Time from now until the returned guard is dropped.
+    pub fn start(&self) -> Timer<'_> {
+        Timer { histograms: [Some(self), None], start: Instant::now() }
+    }
+
+    pub fn summary(&self) -> LatencySummary {
+        let counts: Vec<u64> = self.buckets.iter().map(|b| b.load(Ordering::Relaxed)).collect();
+        let count: u64 = counts.iter().sum();
+        if count == 0 {
+            return LatencySummary::default();
+        }
+        let max_us = self.max_us.load(Ordering::Relaxed);
+        let percentile = |q: f64| {
+            let rank = ((count as f64 * q).ceil() as u64).max(1);
+            let mut seen = 0;
+            for (i, n) in counts.iter().enumerate() {
+                seen += n;
+                if seen >= rank {
+                    return (1u64 << i).min(max_us);
+                }
+            }
+            max_us
+        };
+        LatencySummary {
+            count,
+            mean_us: self.sum_us.load(Ordering::Relaxed) / count,
+            p50_us: percentile(0.50),
+            p99_us: percentile(0.99),
+            max_us,
+        }
+    }
+}
+
+impl Default for Histogram {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Records the time since it was started into one or two histograms
+/// (usually a per-connection one and the global one) when dropped.
+pub struct Timer<'a> {
+    histograms: [Option<&'a Histogram>; 2],
+    start: Instant,
+}
+
+impl<'a> Timer<'a> {
+    /// Also record into `other`.
+    pub fn and(mut self, other: &'a Histogram) -> Self {
+        self.histograms[1] = Some(other);
+        self
+    }
+}
+
+impl Drop for Timer<'_> {
+    fn drop(&mut self) {
+        let elapsed = self.start.elapsed();
+        for histogram in self.histograms.iter().flatten() {
+            histogram.record(elapsed);
+        }
+    }
+}
+
+/// Open a `tracing` span for the rest of the enclosing (synchronous)
+/// scope when built with `signposts`; a no-op otherwise.
+///
+///     let _signpost = metrics::signpost!("graph_layout");
+#[cfg(feature = "signposts")]
+macro_rules! signpost {
+    ($name:literal) => {
+        tracing::info_span!($name).entered()
+    };
+}
+
+#[cfg(not(feature = "signposts"))]
+macro_rules! signpost {
+    ($name:literal) => {
+        $crate::metrics::NoSignpost
+    };
+}
+
+pub(crate) use signpost;
+
+/// What [`signpost!`] returns without the `signposts` feature.
+#[cfg(not(feature = "signposts"))]
+pub struct NoSignpost;
+
+// ═══════════════════════════════════════════════════════════
+// Process-wide metrics
+// ═══════════════════════════════════════════════════════════
+
+pub struct Metrics {
+    /// PTY output read, by both the reactor and `pier_terminal_read`.
+    pub pty_bytes_read: Counter,
+    /// `read(2)` calls on PTY masters, including ones that found nothing.
+    pub pty_reads: Counter,
+    /// Time spent in `TerminalSession::process` per call.
+    pub vt_process: Histogram,
+    pub ssh: ConnectionMetrics,
+    /// Bytes relayed by port forwards, local → remote and back.
+    pub forward_bytes_up: Counter,
+    pub forward_bytes_down: Counter,
+    pub sftp_bytes_down: Counter,
+    pub sftp_bytes_up: Counter,
+    /// Round trip of one pipelined SFTP read or write.
+    pub sftp_chunk: Histogram,
+    /// `graph_log` page time, including waiting for the index to fill.
+    pub graph_log: Histogram,
+    pub graph_layout: Histogram,
+}
+
+static GLOBAL: Metrics = Metrics {
+    pty_bytes_read: Counter::new(),
+    pty_reads: Counter::new(),
+    vt_process: Histogram::new(),
+    ssh: ConnectionMetrics::new(),
+    forward_bytes_up: Counter::new(),
+    forward_bytes_down: Counter::new(),
+    sftp_bytes_down: Counter::new(),
+    sftp_bytes_up: Counter::new(),
+    sftp_chunk: Histogram::new(),
+    graph_log: Histogram::new(),
+    graph_layout: Histogram::new(),
+};
+
+pub fn global() -> &'static Metrics {
+    &GLOBAL
+}
+
+/// Copy of the process-wide metrics.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct MetricsSnapshot {
+    pub pty_bytes_read: u64,
+    pub pty_reads: u64,
+    pub vt_process: LatencySummary,
+    pub ssh: ConnectionSnapshot,
+    pub forward_bytes_up: u64,
+    pub forward_bytes_down: u64,
+    pub sftp_bytes_down: u64,
+    pub sftp_bytes_up: u64,
+    pub sftp_chunk: LatencySummary,
+    pub graph_log: LatencySummary,
+    pub graph_layout: LatencySummary,
+}
+
+impl Metrics {
+    pub fn snapshot(&self) -> MetricsSnapshot {
+        MetricsSnapshot {
+            pty_bytes_read: self.pty_bytes_read.get(),
+            pty_reads: self.pty_reads.get(),
+            vt_process: self.vt_process.summary(),
+            ssh: self.ssh.snapshot(),
+            forward_bytes_up: self.forward_bytes_up.get(),
+            forward_bytes_down: self.forward_bytes_down.get(),
+            sftp_bytes_down: self.sftp_bytes_down.get(),
+            sftp_bytes_up: self.sftp_bytes_up.get(),
+            sftp_chunk: self.sftp_chunk.summary(),
+            graph_log: self.graph_log.summary(),
+            graph_layout: self.graph_layout.summary(),
+        }
+    }
+}
+
+// ═══════════════════════════════════════════════════════════
+// Per-connection and per-terminal metrics
+// ═══════════════════════════════════════════════════════════
+
+/// One SSH connection's activity (and, in [`Metrics::ssh`], everyone's).
+pub struct ConnectionMetrics {
+    pub channel_opens: Counter,
+    /// Waiting for an exec slot: high when too many commands share a link.
+    pub exec_wait: Histogram,
+    /// From the exec request to the exit status, for `exec_command`.
+    pub exec_rtt: Histogram,
+    /// Transport reconnects after the link dropped.
+    pub reconnects: Counter,
+}
+
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ConnectionSnapshot {
+    pub channel_opens: u64,
+    pub exec_wait: LatencySummary,
+    pub exec_rtt: LatencySummary,
+    pub reconnects: u64,
+}
+
+impl ConnectionMetrics {
+    pub const fn new() -> Self {
+        Self {
+            channel_opens: Counter::new(),
+            exec_wait: Histogram::new(),
+            exec_rtt: Histogram::new(),
+            reconnects: Counter::new(),
+        }
+    }
+
+    /// Count a channel open here and globally.
+    pub fn channel_opened(&self) {
+        self.channel_opens.add(1);
+        GLOBAL.ssh.channel_opens.add(1);
+    }
+
+    pub fn reconnected(&self) {
+        self.reconnects.add(1);
+        GLOBAL.ssh.reconnects.add(1);
+    }
+
+    pub fn snapshot(&self) -> ConnectionSnapshot {
+        ConnectionSnapshot {
+            channel_opens: self.channel_opens.get(),
+            exec_wait: self.exec_wait.summary(),
+            exec_rtt: self.exec_rtt.summary(),
+            reconnects: self.reconnects.get(),
+        }
+    }
+}
+
+impl Default for ConnectionMetrics {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// One terminal's output volume and parse time.
+#[derive(Default)]
+pub struct TerminalMetrics {
+    pub bytes_processed: Counter,
+    pub vt_process: Histogram,
+}
+
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct TerminalSnapshot {
+    pub bytes_processed: u64,
+    pub vt_process: LatencySummary,
+}
+
+impl TerminalMetrics {
+    pub fn snapshot(&self) -> TerminalSnapshot {
+        TerminalSnapshot { bytes_processed: self.bytes_processed.get(), vt_process: self.vt_process.summary() }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_histogram_summary() {
+        let histogram = Histogram::new();
+        assert_eq!(histogram.summary(), LatencySummary::default());
+        for us in [3, 5, 6, 7, 100, 120, 130, 140, 150, 40_000] {
+            histogram.record(Duration::from_micros(us));
+        }
+        let summary = histogram.summary();
+        assert_eq!(summary.count, 10);
+        assert_eq!(summary.mean_us, 40_661 / 10);
+        // Median falls in the [64, 128) µs bucket.
+        assert_eq!(summary.p50_us, 128);
+        assert_eq!(summary.p99_us, 40_000);
+        assert_eq!(summary.max_us, 40_000);
+
+        let other = Histogram::new();
+        drop(histogram.start().and(&other));
+        assert_eq!((histogram.summary().count, other.summary().count), (11, 1));
+    }
+}
@@ -0,0 +1,252 @@
+//! Parallel content (grep) search.
+//!
+//! Same walker and batching as the filename search, with ripgrep's own
+//! searcher on each file: the regex engine's literal prefilters (memchr /
+//! Teddy) skip to candidate lines, large files are memory-mapped, and a file
+//! is abandoned as binary at its first NUL byte. Matching lines with their
+//! line numbers are streamed to the caller while the walk is still running.
+
+use std::path::Path;
+use std::sync::atomic::{AtomicBool, Ordering};
+
+use grep_matcher::Matcher;
+use grep_regex::{RegexMatcher, RegexMatcherBuilder};
+use grep_searcher::{BinaryDetection, MmapChoice, Searcher, SearcherBuilder, Sink, SinkMatch};
+use ignore::{DirEntry, ParallelVisitor, ParallelVisitorBuilder, WalkState};
+
+use super::parallel::{walker_threads, Batch, Delivery, FileSearch};
+
+/// Longest line text handed out; the rest of a long line is cut.
+pub const MAX_LINE_BYTES: usize = 512;
+
+/// How to interpret the search pattern.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ContentOptions {
+    /// Treat the pattern as a regular expression instead of literal text.
+    pub regex: bool,
+    pub case_sensitive: bool,
+}
+
+/// A matching line.
+#[derive(Clone, Debug)]
+pub struct ContentMatch {
+    pub path: String,
+    /// 1-based.
+    pub line_number: u64,
+    /// The line without its terminator, at most `MAX_LINE_BYTES` long.
+    pub line: String,
+    /// Byte range of the first match within `line`.
+    pub match_start: usize,
+    pub match_end: usize,
+}
+
+/// Build the matcher for `pattern`. Fails on an invalid regex.
+pub fn build_matcher(pattern: &str, options: ContentOptions) -> Result<RegexMatcher, grep_regex::Error> {
+    RegexMatcherBuilder::new()
+        .fixed_strings(!options.regex)
+        .case_insensitive(!options.case_sensitive)
+        .line_terminator(Some(b'\n'))
+        .build(pattern)
+}
+
+/// Search the contents of every file under `root` for `matcher`, calling
+/// `on_batch` with each batch of matching lines. Stops after `max_results`
+/// lines, when `on_batch` returns false, or when `cancel` is set. Blocks
+/// until all walker threads have finished; `on_batch` is never called
+/// concurrently.
+pub fn search_content(
+    root: &str,
+    matcher: &RegexMatcher,
+    max_results: usize,
+    cancel: &AtomicBool,
+    on_batch: &mut (dyn FnMut(&[ContentMatch]) -> bool + Send),
+) {
+    let root_path = Path::new(root);
+    if !root_path.exists() || max_results == 0 {
+        return;
+    }
+
+    let delivery = Delivery::new(max_results, cancel, on_batch);
+    super::walk_builder(root_path)
+        .threads(walker_threads())
+        .build_parallel()
+        .visit(&mut VisitorBuilder { matcher, delivery: &delivery });
+}
+
+/// Start a content search on a background thread. `on_event` receives each
+/// batch with `done == false` (return false to stop), then a final empty
+/// call with `done == true` unless the search was cancelled.
+pub fn start_content_search<F>(
+    root: String,
+    matcher: RegexMatcher,
+    max_results: usize,
+    mut on_event: F,
+) -> FileSearch
+where
+    F: FnMut(&[ContentMatch], bool) -> bool + Send + 'static,
+{
+    FileSearch::spawn(move |cancel| {
+        search_content(&root, &matcher, max_results, cancel, &mut |hits| on_event(hits, false));
+        if !cancel.load(Ordering::Relaxed) {
+            on_event(&[], true);
+        }
+    })
+}
+
+struct VisitorBuilder<'s, 'a> {
+    matcher: &'s RegexMatcher,
+    delivery: &'s Delivery<'a, ContentMatch>,
+}
+
+impl<'s, 'a: 's> ParallelVisitorBuilder<'s> for VisitorBuilder<'s, 'a> {
+    fn build(&mut self) -> Box<dyn ParallelVisitor + 's> {
+        let searcher = SearcherBuilder::new()
+            .line_number(true)
+            .binary_detection(BinaryDetection::quit(b'\x00'))
+            // SAFETY: a file truncated while mapped can fault; ripgrep
+            // accepts the same risk, and `auto` only maps where it pays off.
+            .memory_map(unsafe { MmapChoice::auto() })
+            .build();
+        Box::new(Visitor {
+            matcher: self.matcher,
+            delivery: self.delivery,
+            searcher,
+            batch: Batch::new(),
+        })
+    }
+}
+
+/// One per walker thread; owns its searcher (and its read buffer).
+struct Visitor<'s, 'a> {
+    matcher: &'s RegexMatcher,
+    delivery: &'s Delivery<'a, ContentMatch>,
+    searcher: Searcher,
+    batch: Batch<ContentMatch>,
+}
+
+impl ParallelVisitor for Visitor<'_, '_> {
+    fn visit(&mut self, entry: Result<DirEntry, ignore::Error>) -> WalkState {
+        if self.delivery.stopped() {
+            return WalkState::Quit;
+        }
+        let Ok(entry) = entry else { return WalkState::Continue };
+        if !entry.file_type().is_some_and(|ft| ft.is_file()) {
+            return WalkState::Continue;
+        }
+
+        let mut sink = LineSink {
+            path: entry.path().to_string_lossy().into_owned(),
+            matcher: self.matcher,
+            delivery: self.delivery,
+            batch: &mut self.batch,
+            open: true,
+        };
+        // Unreadable files are skipped like binaries.
+        let _ = self.searcher.search_path(self.matcher, entry.path(), &mut sink);
+        if !sink.open || (self.batch.is_due() && !self.batch.flush(self.delivery)) {
+            return WalkState::Quit;
+        }
+        WalkState::Continue
+    }
+}
+
+impl Drop for Visitor<'_, '_> {
+    fn drop(&mut self) {
+        self.batch.flush(self.delivery);
+    }
+}
+
+/// Collects one file's matching lines into the thread's batch.
+struct LineSink<'v, 's, 'a> {
+    path: String,
+    matcher: &'s RegexMatcher,
+    delivery: &'s Delivery<'a, ContentMatch>,
+    batch: &'v mut Batch<ContentMatch>,
+    /// Cleared once the search is over, so the walk can quit.
+    open: bool,
+}
+
+impl Sink for LineSink<'_, '_, '_> {
+    type Error = std::io::Error;
+
+    fn matched(&mut self, _searcher: &Searcher, mat: &SinkMatch<'_>) -> Result<bool, Self::Error> {
+        let mut bytes = mat.bytes();
+        while let [rest @ .., b'\n' | b'\r'] = bytes {
+            bytes = rest;
+        }
+        let (start, end) = match self.matcher.find(bytes) {
+            Ok(Some(m)) => (m.start(), m.end()),
+            _ => (0, 0),
+        };
+        let line = truncate_line(bytes);
+        self.batch.push(ContentMatch {
+            path: self.path.clone(),
+            line_number: mat.line_number().unwrap_or(0),
+            match_start: start.min(line.len()),
+            match_end: end.min(line.len()),
+            line,
+        });
+
+        if self.batch.is_due() && !self.batch.flush(self.delivery) {
+            self.open = false;
+        }
+        Ok(self.open && !self.delivery.stopped())
+    }
+}
+
+/// Decode at most `MAX_LINE_BYTES` of a line, never splitting a character.
+fn truncate_line(bytes: &[u8]) -> String {
+    let mut line = String::from_utf8_lossy(&bytes[..bytes.len().min(MAX_LINE_BYTES)]).into_owned();
+    if bytes.len() > MAX_LINE_BYTES {
+        // A cut multi-byte character decodes to U+FFFD; drop it.
+        while line.len() > MAX_LINE_BYTES || line.ends_with('\u{FFFD}') {
+            line.pop();
+        }
+    }
+    line
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_search_content_lines_and_binaries() {
+        let root = std::env::temp_dir().join(format!("pier-grep-{}", std::process::id()));
+        std::fs::create_dir_all(root.join("src")).unwrap();
+        std::fs::write(root.join("src/main.rs"), "fn main() {\n    let needle = 1;\n}\n// NEEDLE again\n").unwrap();
+        std::fs::write(root.join("blob.bin"), b"needle\x00\x01\x02").unwrap();
+
+        let matcher = build_matcher("needle", ContentOptions::default()).unwrap();
+        let mut hits: Vec<ContentMatch> = Vec::new();
+        let cancel = AtomicBool::new(false);
+        search_content(root.to_str().unwrap(), &matcher, 100, &cancel, &mut |batch| {
+            hits.extend_from_slice(batch);
+            true
+        });
+        hits.sort_by_key(|h| h.line_number);
+        let lines: Vec<(u64, &str)> = hits.iter().map(|h| (h.line_number, h.line.as_str())).collect();
+        assert_eq!(lines, vec![(2, "    let needle = 1;"), (4, "// NEEDLE again")]);
+        assert_eq!(&hits[0].line[hits[0].match_start..hits[0].match_end], "needle");
+
+        let sensitive = ContentOptions { regex: true, case_sensitive: true };
+        let matcher = build_matcher("NEE+DLE", sensitive).unwrap();
+        let mut count = 0;
+        search_content(root.to_str().unwrap(), &matcher, 100, &cancel, &mut |batch| {
+            count += batch.len();
+            true
+        });
+        assert_eq!(count, 1);
+        assert!(build_matcher("(", sensitive).is_err());
+
+        std::fs::remove_dir_all(&root).unwrap();
+    }
+
+    #[test]
+    fn test_truncate_line() {
+        assert_eq!(truncate_line(b"short"), "short");
+        let long = "é".repeat(MAX_LINE_BYTES);
+        let cut = truncate_line(long.as_bytes());
+        assert!(cut.len() <= MAX_LINE_BYTES && cut.chars().all(|c| c == 'é'));
+    }
+}
@@ -0,0 +1,739 @@
+//! Persistent filename index for an opened root.
+//!
+//! `FsIndex` crawls the root once in the background into a compact path
+//! table: one node per entry holding its parent, an interned name and its
+//! children sorted by name, so a path resolves with a binary search per
+//! component. Filename queries match each distinct name once and never touch
+//! the disk. A filesystem watcher (FSEvents on macOS, inotify on Linux) keeps
+//! the table current, and the table is written to a cache file so the next
+//! open serves queries immediately while a fresh crawl runs.
+//!
+//! The index follows the same ignore rules as `search_files`; a path the
+//! watcher reports is checked against them on its own, from ignore files
+//! read once per directory, so a burst of new files lists nothing. Directory
+//! listings are a separate cache of real `read_dir` results for the
+//! directories that were listed, dropped as soon as the watcher reports a
+//! change inside them.
+
+use std::collections::HashMap;
+use std::fs::File;
+use std::io::{BufReader, BufWriter, Read, Write};
+use std::path::{Component, Path, PathBuf};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex, RwLock};
+use std::time::Duration;
+
+use ignore::gitignore::{Gitignore, GitignoreBuilder};
+use ignore::Match;
+use notify::{RecommendedWatcher, RecursiveMode, Watcher};
+
+use super::parallel::NameMatcher;
+use super::SearchResult;
+
+/// Cache file format marker and version.
+const MAGIC: &[u8; 4] = b"PIX1";
+
+/// Directory listings kept before the listing cache is cleared.
+const MAX_CACHED_LISTINGS: usize = 256;
+
+/// Directories' ignore rules kept before that cache is cleared.
+const MAX_CACHED_RULES: usize = 256;
+
+const NO_PARENT: u32 = u32::MAX;
+
+struct Node {
+    parent: u32,
+    name: u32,
+    size: u64,
+    is_dir: bool,
+    live: bool,
+    /// Sorted by name bytes.
+    children: Vec<u32>,
+}
+
+/// Interned path components.
+#[derive(Default)]
+struct Names {
+    names: Vec<Box<str>>,
+    ids: HashMap<Box<str>, u32>,
+}
+
+impl Names {
+    fn intern(&mut self, name: &str) -> u32 {
+        if let Some(&id) = self.ids.get(name) {
+            return id;
+        }
+        let id = self.names.len() as u32;
+        self.names.push(name.into());
+        self.ids.insert(name.into(), id);
+        id
+    }
+
+    fn get(&self, id: u32) -> &str {
+        &self.names[id as usize]
+    }
+}
+
+/// The in-memory index: node 0 is the root.
+struct PathTable {
+    root: PathBuf,
+    names: Names,
+    nodes: Vec<Node>,
+    free: Vec<u32>,
+}
+
+impl PathTable {
+    fn new(root: &Path) -> Self {
+        let mut table = Self { root: root.to_path_buf(), names: Names::default(), nodes: Vec::new(), free: Vec::new() };
+        let name = table.names.intern("");
+        table.nodes.push(Node { parent: NO_PARENT, name, size: 0, is_dir: true, live: true, children: Vec::new() });
+        table
+    }
+
+    fn name(&self, id: u32) -> &str {
+        self.names.get(self.nodes[id as usize].name)
+    }
+
+    fn child(&self, parent: u32, name: &str) -> Option<u32> {
+        let children = &self.nodes[parent as usize].children;
+        children
+            .binary_search_by(|&c| self.name(c).cmp(name))
+            .ok()
+            .map(|i| children[i])
+    }
+
+    /// Node for a path relative to the root.
+    fn lookup(&self, rel: &Path) -> Option<u32> {
+        let mut id = 0;
+        for component in rel.components() {
+            match component {
+                Component::Normal(name) => id = self.child(id, name.to_str()?)?,
+                Component::CurDir => {}
+                _ => return None,
+            }
+        }
+        Some(id)
+    }
+
+    /// Add a child, keeping the children sorted. Returns the existing node
+    /// if there is one.
+    fn insert(&mut self, parent: u32, name: &str, is_dir: bool, size: u64) -> u32 {
+        let pos = {
+            let children = &self.nodes[parent as usize].children;
+            match children.binary_search_by(|&c| self.name(c).cmp(name)) {
+                Ok(i) => return children[i],
+                Err(i) => i,
+            }
+        };
+        let id = self.push_node(parent, name, is_dir, size);
+        self.nodes[parent as usize].children.insert(pos, id);
+        id
+    }
+
+    /// Append a child without keeping order; call `sort_children` once the
+    /// directory is complete.
+    fn append(&mut self, parent: u32, name: &str, is_dir: bool, size: u64) -> u32 {
+        let id = self.push_node(parent, name, is_dir, size);
+        self.nodes[parent as usize].children.push(id);
+        id
+    }
+
+    fn push_node(&mut self, parent: u32, name: &str, is_dir: bool, size: u64) -> u32 {
+        let node = Node { parent, name: self.names.intern(name), size, is_dir, live: true, children: Vec::new() };
+        match self.free.pop() {
+            Some(id) => {
+                self.nodes[id as usize] = node;
+                id
+            }
+            None => {
+                self.nodes.push(node);
+                (self.nodes.len() - 1) as u32
+            }
+        }
+    }
+
+    fn sort_children(&mut self, dir: u32) {
+        let mut children = std::mem::take(&mut self.nodes[dir as usize].children);
+        children.sort_unstable_by(|&a, &b| self.name(a).cmp(self.name(b)));
+        self.nodes[dir as usize].children = children;
+    }
+
+    /// Detach a node and free it with its subtree.
+    fn remove(&mut self, id: u32) {
+        let parent = self.nodes[id as usize].parent;
+        if parent == NO_PARENT {
+            return;
+        }
+        self.nodes[parent as usize].children.retain(|&c| c != id);
+        let mut stack = vec![id];
+        while let Some(id) = stack.pop() {
+            let node = &mut self.nodes[id as usize];
+            node.live = false;
+            stack.append(&mut node.children);
+            self.free.push(id);
+        }
+    }
+
+    fn path(&self, id: u32) -> PathBuf {
+        let mut parts = Vec::new();
+        let mut at = id;
+        while at != 0 {
+            parts.push(self.name(at));
+            at = self.nodes[at as usize].parent;
+        }
+        let mut path = self.root.clone();
+        path.extend(parts.iter().rev());
+        path
+    }
+
+    /// Crawl `dir` (already node `id`) with the shared walker settings.
+    fn crawl_into(&mut self, id: u32, dir: &Path, stop: &AtomicBool) {
+        // The walk is depth-first, so an entry's parent is the last
+        // directory seen one level up.
+        let mut stack = vec![id];
+        let mut dirs = vec![id];
+        for entry in super::walk_builder(dir).build().flatten() {
+            if stop.load(Ordering::Relaxed) {
+                break;
+            }
+            let depth = entry.depth();
+            if depth == 0 {
+                continue;
+            }
+            stack.truncate(depth);
+            let Some(&parent) = stack.last() else { continue };
+            let is_dir = entry.file_type().is_some_and(|ft| ft.is_dir());
+            let size = if is_dir { 0 } else { entry.metadata().map(|m| m.len()).unwrap_or(0) };
+            let child = self.append(parent, &entry.file_name().to_string_lossy(), is_dir, size);
+            if is_dir {
+                stack.push(child);
+                dirs.push(child);
+            }
+        }
+        for dir in dirs {
+            self.sort_children(dir);
+        }
+    }
+
+    /// Bring `path` in line with the disk after a change notification.
+    /// `ignored` says whether the crawl would have skipped it.
+    fn refresh(&mut self, path: &Path, ignored: bool, stop: &AtomicBool) {
+        let Ok(rel) = path.strip_prefix(&self.root) else { return };
+        let Some(name) = rel.file_name().and_then(|n| n.to_str()) else { return };
+        // Not indexed: ignored, or deeper than the walker goes.
+        let Some(parent) = rel.parent().and_then(|p| self.lookup(p)) else { return };
+
+        let existing = self.child(parent, name);
+        let Ok(meta) = std::fs::symlink_metadata(path) else {
+            if let Some(id) = existing {
+                self.remove(id);
+            }
+            return;
+        };
+        let is_dir = meta.is_dir();
+        if let Some(id) = existing {
+            if self.nodes[id as usize].is_dir == is_dir {
+                self.nodes[id as usize].size = if is_dir { 0 } else { meta.len() };
+                return;
+            }
+            self.remove(id);
+        }
+        if ignored {
+            return;
+        }
+        let id = self.insert(parent, name, is_dir, if is_dir { 0 } else { meta.len() });
+        if is_dir {
+            self.crawl_into(id, path, stop);
+        }
+    }
+
+    fn search(&self, pattern: &str, max_results: usize) -> Vec<SearchResult> {
+        let matcher = NameMatcher::new(pattern);
+        let matched: Vec<bool> = self.names.names.iter().map(|n| matcher.is_match(n)).collect();
+        self.nodes
+            .iter()
+            .enumerate()
+            .skip(1)
+            .filter(|(_, node)| node.live && matched[node.name as usize])
+            .take(max_results)
+            .map(|(id, node)| SearchResult {
+                path: self.path(id as u32).to_string_lossy().into_owned(),
+                name: self.names.get(node.name).to_string(),
+                is_dir: node.is_dir,
+                size: node.size,
+            })
+            .collect()
+    }
+
+    fn live_count(&self) -> usize {
+        self.nodes.len() - self.free.len()
+    }
+
+    /// Write the live nodes depth-first, so every parent precedes its
+    /// children and ids can be reassigned densely on load.
+    fn save(&self, out: &mut impl Write) -> std::io::Result<()> {
+        let root = self.root.to_string_lossy();
+        out.write_all(MAGIC)?;
+        out.write_all(&(root.len() as u32).to_le_bytes())?;
+        out.write_all(root.as_bytes())?;
+        out.write_all(&(self.live_count() as u32 - 1).to_le_bytes())?;
+
+        let mut new_ids = vec![0u32; self.nodes.len()];
+        let mut next = 1u32;
+        let mut stack: Vec<u32> = self.nodes[0].children.iter().rev().copied().collect();
+        while let Some(id) = stack.pop() {
+            let node = &self.nodes[id as usize];
+            new_ids[id as usize] = next;
+            next += 1;
+            let name = self.names.get(node.name);
+            out.write_all(&new_ids[node.parent as usize].to_le_bytes())?;
+            out.write_all(&[node.is_dir as u8])?;
+            out.write_all(&node.size.to_le_bytes())?;
+            out.write_all(&(name.len() as u32).to_le_bytes())?;
+            out.write_all(name.as_bytes())?;
+            stack.extend(node.children.iter().rev());
+        }
+        Ok(())
+    }
+
+    /// Read a table written by `save`. Fails if it was saved for another root.
+    fn load(root: &Path, input: &mut impl Read) -> std::io::Result<Self> {
+        let invalid = || std::io::Error::new(std::io::ErrorKind::InvalidData, "bad index file");
+        let mut magic = [0u8; 4];
+        input.read_exact(&mut magic)?;
+        if &magic != MAGIC || read_string(input)? != root.to_string_lossy() {
+            return Err(invalid());
+        }
+
+        let count = read_u32(input)?;
+        let mut table = Self::new(root);
+        for id in 1..=count {
+            let parent = read_u32(input)?;
+            let mut flag = [0u8; 1];
+            input.read_exact(&mut flag)?;
+            let mut size = [0u8; 8];
+            input.read_exact(&mut size)?;
+            let name = read_string(input)?;
+            if parent >= id || !table.nodes[parent as usize].is_dir {
+                return Err(invalid());
+            }
+            table.append(parent, &name, flag[0] != 0, u64::from_le_bytes(size));
+        }
+        // Children were written in order already.
+        Ok(table)
+    }
+}
+
+/// The walker's ignore rules, checked one path at a time: the crawl
+/// filters entries while listing their directory, which a single change
+/// shouldn't have to repeat. Each directory's ignore files are read once
+/// and kept until one of them changes.
+struct IgnoreRules {
+    dirs: HashMap<PathBuf, Arc<DirRules>>,
+    global: Gitignore,
+}
+
+/// One directory's ignore files.
+struct DirRules {
+    ignore: Gitignore,
+    git_ignore: Gitignore,
+    git_exclude: Gitignore,
+    has_git: bool,
+}
+
+impl IgnoreRules {
+    fn new() -> Self {
+        Self { dirs: HashMap::new(), global: Gitignore::global().0 }
+    }
+
+    /// Whether the crawl would have skipped `path`, whose parent it kept.
+    /// As in `walk_builder`: `.ignore` beats `.gitignore`, which beats
+    /// `.git/info/exclude` and the global excludes; within each the
+    /// deepest directory decides, and git rules only apply inside a
+    /// repository, up to its root.
+    fn is_ignored(&mut self, path: &Path) -> bool {
+        let Some(parent) = path.parent() else { return true };
+        let is_dir = std::fs::symlink_metadata(path).is_ok_and(|meta| meta.is_dir());
+        let chain: Vec<Arc<DirRules>> = parent.ancestors().map(|dir| self.dir(dir)).collect();
+        let in_repo = chain.iter().any(|rules| rules.has_git);
+
+        let mut ignore = Match::None;
+        let mut git_ignore = Match::None;
+        let mut git_exclude = Match::None;
+        let mut above_repo = false;
+        for rules in &chain {
+            if ignore.is_none() {
+                ignore = rules.ignore.matched(path, is_dir);
+            }
+            if in_repo && !above_repo {
+                if git_ignore.is_none() {
+                    git_ignore = rules.git_ignore.matched(path, is_dir);
+                }
+                if git_exclude.is_none() {
+                    git_exclude = rules.git_exclude.matched(path, is_dir);
+                }
+            }
+            above_repo |= rules.has_git;
+        }
+        let global = if in_repo { self.global.matched(path, is_dir) } else { Match::None };
+
+        let decided = [ignore, git_ignore, git_exclude, global].into_iter().find(|m| !m.is_none());
+        decided.is_some_and(|m| m.is_ignore())
+    }
+
+    fn dir(&mut self, dir: &Path) -> Arc<DirRules> {
+        if let Some(rules) = self.dirs.get(dir) {
+            return Arc::clone(rules);
+        }
+        if self.dirs.len() >= MAX_CACHED_RULES {
+            self.dirs.clear();
+        }
+        let rules = Arc::new(DirRules {
+            ignore: read_ignore_file(dir, ".ignore"),
+            git_ignore: read_ignore_file(dir, ".gitignore"),
+            git_exclude: read_ignore_file(dir, ".git/info/exclude"),
+            has_git: dir.join(".git").exists(),
+        });
+        self.dirs.insert(dir.to_path_buf(), Arc::clone(&rules));
+        rules
+    }
+
+    /// Drop the rules of directories whose ignore files are in `paths`.
+    fn forget_changed(&mut self, paths: &[PathBuf]) {
+        for path in paths {
+            let dir = match path.file_name().and_then(|n| n.to_str()) {
+                Some(".ignore" | ".gitignore" | ".git") => path.parent(),
+                _ if path.ends_with(".git/info/exclude") => path.ancestors().nth(3),
+                _ => None,
+            };
+            if let Some(dir) = dir {
+                self.dirs.remove(dir);
+            }
+        }
+    }
+}
+
+/// Rules of `dir`'s ignore file `name`; none when it doesn't exist.
+fn read_ignore_file(dir: &Path, name: &str) -> Gitignore {
+    let mut builder = GitignoreBuilder::new(dir);
+    builder.add(dir.join(name));
+    builder.build().unwrap_or_else(|_| Gitignore::empty())
+}
+
+fn read_u32(input: &mut impl Read) -> std::io::Result<u32> {
+    let mut buf = [0u8; 4];
+    input.read_exact(&mut buf)?;
+    Ok(u32::from_le_bytes(buf))
+}
+
+fn read_string(input: &mut impl Read) -> std::io::Result<String> {
+    let len = read_u32(input)? as usize;
+    let mut buf = vec![0u8; len];
+    input.read_exact(&mut buf)?;
+    String::from_utf8(buf).map_err(|_| std::io::Error::new(std::io::ErrorKind::InvalidData, "bad index file"))
+}
+
+struct Shared {
+    table: RwLock<PathTable>,
+    /// Changes seen while a crawl is building a replacement table; replayed
+    /// onto it before it is swapped in.
+    pending: Mutex<Option<Vec<PathBuf>>>,
+    rules: Mutex<IgnoreRules>,
+    /// Real `read_dir` results, invalidated by the watcher.
+    listings: Mutex<HashMap<PathBuf, Vec<SearchResult>>>,
+    ready: AtomicBool,
+    /// The watcher lost events; crawl again.
+    rescan: AtomicBool,
+    stop: AtomicBool,
+}
+
+impl Shared {
+    fn on_change(&self, paths: &[PathBuf]) {
+        {
+            let mut listings = self.listings.lock().unwrap();
+            for path in paths {
+                listings.remove(path);
+                if let Some(parent) = path.parent() {
+                    listings.remove(parent);
+                }
+            }
+        }
+        let mut pending = self.pending.lock().unwrap();
+        if let Some(queue) = pending.as_mut() {
+            queue.extend_from_slice(paths);
+        }
+        // Before taking the table, so searches aren't held up by the check.
+        let ignored: Vec<bool> = {
+            let mut rules = self.rules.lock().unwrap();
+            rules.forget_changed(paths);
+            paths.iter().map(|path| rules.is_ignored(path)).collect()
+        };
+        let mut table = self.table.write().unwrap();
+        for (path, &ignored) in paths.iter().zip(&ignored) {
+            table.refresh(path, ignored, &self.stop);
+        }
+    }
+
+    /// Build a fresh table and swap it in.
+    fn crawl(&self, root: &Path) {
+        *self.pending.lock().unwrap() = Some(Vec::new());
+        let mut fresh = PathTable::new(root);
+        fresh.crawl_into(0, root, &self.stop);
+        if self.stop.load(Ordering::Relaxed) {
+            return;
+        }
+
+        let mut pending = self.pending.lock().unwrap();
+        let mut rules = self.rules.lock().unwrap();
+        for path in pending.take().unwrap_or_default() {
+            fresh.refresh(&path, rules.is_ignored(&path), &self.stop);
+        }
+        drop(rules);
+        *self.table.write().unwrap() = fresh;
+        self.ready.store(true, Ordering::Relaxed);
+    }
+}
+
+/// A live filename index for one root.
+/// Dropping it stops the watcher and saves the table to the cache file.
+pub struct FsIndex {
+    shared: Arc<Shared>,
+    root: PathBuf,
+    cache_file: Option<PathBuf>,
+    watcher: Option<RecommendedWatcher>,
+    thread: Option<std::thread::JoinHandle<()>>,
+}
+
+impl FsIndex {
+    /// Start indexing `root`. With a `cache_dir`, a previous table is loaded
+    /// from there (queries work at once) and the new one saved on close.
+    pub fn open(root: &str, cache_dir: Option<&Path>) -> Self {
+        let root = PathBuf::from(root);
+        let cache_file = cache_dir.map(|dir| dir.join(cache_file_name(&root)));
+        let cached = cache_file
+            .as_ref()
+            .and_then(|path| File::open(path).ok())
+            .and_then(|file| PathTable::load(&root, &mut BufReader::new(file)).ok());
+
+        let shared = Arc::new(Shared {
+            ready: AtomicBool::new(cached.is_some()),
+            table: RwLock::new(cached.unwrap_or_else(|| PathTable::new(&root))),
+            pending: Mutex::new(None),
+            rules: Mutex::new(IgnoreRules::new()),
+            listings: Mutex::new(HashMap::new()),
+            rescan: AtomicBool::new(false),
+            stop: AtomicBool::new(false),
+        });
+
+        let watcher = {
+            let shared = Arc::clone(&shared);
+            notify::recommended_watcher(move |res: notify::Result<notify::Event>| match res {
+                Ok(event) if event.need_rescan() => shared.rescan.store(true, Ordering::Relaxed),
+                Ok(event) => shared.on_change(&event.paths),
+                Err(_) => shared.rescan.store(true, Ordering::Relaxed),
+            })
+            .and_then(|mut watcher| watcher.watch(&root, RecursiveMode::Recursive).map(|_| watcher))
+        };
+        let watcher = match watcher {
+            Ok(watcher) => Some(watcher),
+            Err(e) => {
+                log::warn!("No file watcher for {}: {}", root.display(), e);
+                None
+            }
+        };
+
+        let thread_shared = Arc::clone(&shared);
+        let thread_root = root.clone();
+        let thread_cache = cache_file.clone();
+        let thread = std::thread::Builder::new()
+            .name("pier-fs-index".into())
+            .spawn(move || {
+                let shared = thread_shared;
+                loop {
+                    shared.crawl(&thread_root);
+                    if let Some(path) = &thread_cache {
+                        let _ = save_table(&shared.table.read().unwrap(), path);
+                    }
+                    while !shared.stop.load(Ordering::Relaxed) && !shared.rescan.swap(false, Ordering::Relaxed) {
+                        std::thread::sleep(Duration::from_millis(250));
+                    }
+                    if shared.stop.load(Ordering::Relaxed) {
+                        break;
+                    }
+                }
+            })
+            .ok();
+
+        Self { shared, root, cache_file, watcher, thread }
+    }
+
+    /// True once the table reflects a crawl (or a cache file).
+    pub fn is_ready(&self) -> bool {
+        self.shared.ready.load(Ordering::Relaxed)
+    }
+
+    /// Entries whose name contains `pattern` (case-insensitive), like
+    /// `search_files` but answered from memory.
+    pub fn search(&self, pattern: &str, max_results: usize) -> Vec<SearchResult> {
+        self.shared.table.read().unwrap().search(pattern, max_results)
+    }
+
+    /// `list_directory`, served from the listing cache when the watcher
+    /// is running.
+    pub fn list_directory(&self, path: &str) -> Result<Vec<SearchResult>, std::io::Error> {
+        let key = PathBuf::from(path);
+        if self.watcher.is_none() || !key.starts_with(&self.root) {
+            return super::list_directory(path);
+        }
+        if let Some(entries) = self.shared.listings.lock().unwrap().get(&key) {
+            return Ok(entries.clone());
+        }
+        let entries = super::list_directory(path)?;
+        let mut listings = self.shared.listings.lock().unwrap();
+        if listings.len() >= MAX_CACHED_LISTINGS {
+            listings.clear();
+        }
+        listings.insert(key, entries.clone());
+        Ok(entries)
+    }
+}
+
+impl Drop for FsIndex {
+    fn drop(&mut self) {
+        self.shared.stop.store(true, Ordering::Relaxed);
+        self.watcher.take();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+        let Some(path) = &self.cache_file else { return };
+        if self.is_ready() {
+            if let Err(e) = save_table(&self.shared.table.read().unwrap(), path) {
+                log::warn!("Failed to save file index {}: {}", path.display(), e);
+            }
+        }
+    }
+}
+
+/// One cache file per root. The hash only picks the name; `load` checks
+/// the root stored inside.
+fn cache_file_name(root: &Path) -> String {
+    use std::hash::{Hash, Hasher};
+    let mut hasher = std::collections::hash_map::DefaultHasher::new();
+    root.hash(&mut hasher);
+    format!("fs-index-{:016x}.bin", hasher.finish())
+}
+
+/// Write via a temporary file so a crash never leaves a torn index.
+fn save_table(table: &PathTable, path: &Path) -> std::io::Result<()> {
+    if let Some(dir) = path.parent() {
+        std::fs::create_dir_all(dir)?;
+    }
+    let tmp = path.with_extension("tmp");
+    let mut out = BufWriter::new(File::create(&tmp)?);
+    table.save(&mut out)?;
+    out.into_inner().map_err(|e| e.into_error())?.sync_all()?;
+    std::fs::rename(&tmp, path)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn temp_root(tag: &str) -> PathBuf {
+        let root = std::env::temp_dir().join(format!("pier-index-{}-{}", tag, std::process::id()));
+        let _ = std::fs::remove_dir_all(&root);
+        std::fs::create_dir_all(root.join("src/deep")).unwrap();
+        std::fs::write(root.join("src/Main.rs"), b"fn main() {}").unwrap();
+        std::fs::write(root.join("src/deep/main_test.rs"), b"").unwrap();
+        std::fs::write(root.join("README.md"), b"# pier").unwrap();
+        root
+    }
+
+    #[test]
+    fn test_table_search_refresh_and_lookup() {
+        let root = temp_root("table");
+        let stop = AtomicBool::new(false);
+        let mut table = PathTable::new(&root);
+        table.crawl_into(0, &root, &stop);
+
+        let mut names: Vec<String> = table.search("MAIN", 10).into_iter().map(|r| r.name).collect();
+        names.sort();
+        assert_eq!(names, vec!["Main.rs", "main_test.rs"]);
+        let deep = table.lookup(Path::new("src/deep")).unwrap();
+        assert_eq!(table.path(deep), root.join("src/deep"));
+
+        std::fs::write(root.join("src/deep/main2.rs"), b"").unwrap();
+        table.refresh(&root.join("src/deep/main2.rs"), false, &stop);
+        std::fs::remove_dir_all(root.join("src/deep")).unwrap();
+        table.refresh(&root.join("src/deep"), false, &stop);
+        let names: Vec<String> = table.search("main", 10).into_iter().map(|r| r.name).collect();
+        assert_eq!(names, vec!["Main.rs"]);
+        assert!(table.lookup(Path::new("src/deep")).is_none());
+
+        std::fs::create_dir_all(root.join("new/inner")).unwrap();
+        std::fs::write(root.join("new/inner/main.c"), b"").unwrap();
+        table.refresh(&root.join("new"), false, &stop);
+        assert_eq!(table.search("main.c", 10).len(), 1);
+
+        std::fs::remove_dir_all(&root).unwrap();
+    }
+
+    #[test]
+    fn test_refresh_skips_ignored() {
+        let root = temp_root("ignored");
+        std::fs::create_dir_all(root.join(".git")).unwrap();
+        std::fs::write(root.join(".gitignore"), b"target/\n*.log\n").unwrap();
+        let stop = AtomicBool::new(false);
+        let mut table = PathTable::new(&root);
+        table.crawl_into(0, &root, &stop);
+        let before = table.live_count();
+        let mut rules = IgnoreRules::new();
+        let mut refresh = |table: &mut PathTable, path: &str| {
+            let path = root.join(path);
+            rules.forget_changed(std::slice::from_ref(&path));
+            table.refresh(&path, rules.is_ignored(&path), &stop);
+        };
+
+        std::fs::create_dir_all(root.join("target/debug")).unwrap();
+        std::fs::write(root.join("target/debug/main.o"), b"").unwrap();
+        refresh(&mut table, "target");
+        std::fs::write(root.join("src/build.log"), b"").unwrap();
+        refresh(&mut table, "src/build.log");
+        assert!(table.lookup(Path::new("target")).is_none());
+        assert!(table.search("main.o", 10).is_empty());
+        assert!(table.lookup(Path::new("src/build.log")).is_none());
+        assert_eq!(table.live_count(), before);
+
+        std::fs::write(root.join("src/lib.rs"), b"").unwrap();
+        refresh(&mut table, "src/lib.rs");
+        assert!(table.lookup(Path::new("src/lib.rs")).is_some());
+
+        // A changed ignore file is read again.
+        std::fs::write(root.join("src/.gitignore"), b"*.tmp\n").unwrap();
+        refresh(&mut table, "src/.gitignore");
+        std::fs::write(root.join("src/scratch.tmp"), b"").unwrap();
+        refresh(&mut table, "src/scratch.tmp");
+        assert!(table.lookup(Path::new("src/scratch.tmp")).is_none());
+
+        std::fs::remove_dir_all(&root).unwrap();
+    }
+
+    #[test]
+    fn test_table_save_and_load() {
+        let root = temp_root("save");
+        let stop = AtomicBool::new(false);
+        let mut table = PathTable::new(&root);
+        table.crawl_into(0, &root, &stop);
+        table.remove(table.lookup(Path::new("README.md")).unwrap());
+
+        let mut bytes = Vec::new();
+        table.save(&mut bytes).unwrap();
+        let loaded = PathTable::load(&root, &mut bytes.as_slice()).unwrap();
+        assert_eq!(loaded.live_count(), table.live_count());
+        assert!(loaded.lookup(Path::new("src/deep/main_test.rs")).is_some());
+        assert!(loaded.lookup(Path::new("README.md")).is_none());
+        assert!(PathTable::load(Path::new("/elsewhere"), &mut bytes.as_slice()).is_err());
+
+        std::fs::remove_dir_all(&root).unwrap();
+    }
+}
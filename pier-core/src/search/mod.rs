@@ -1,6 +1,12 @@
+pub mod content;
+pub mod index;
+pub mod listing;
+pub mod parallel;
+
 use ignore::WalkBuilder;
 use serde::{Serialize, Deserialize};
 use std::path::Path;
+use std::sync::atomic::AtomicBool;
 
 /// A search result entry.
 #[derive(Clone, Debug, Serialize, Deserialize)]
@@ -11,85 +17,47 @@ pub struct SearchResult {
     pub size: u64,
 }
 
+/// Walker settings shared by every search: hidden files included,
+/// .gitignore respected, at most 10 levels deep.
+pub(crate) fn walk_builder(root: &Path) -> WalkBuilder {
+    let mut builder = WalkBuilder::new(root);
+    builder
+        .hidden(false)
+        .git_ignore(true)
+        .git_global(true)
+        .max_depth(Some(10));
+    builder
+}
+
 /// Search for files/directories matching a pattern.
 /// Uses the `ignore` crate (same engine as ripgrep) for respecting .gitignore.
+/// Runs the parallel walker and only stats the entries that matched; use
+/// `parallel::FileSearch` to stream results instead of waiting for all.
 pub fn search_files(
     root: &str,
     pattern: &str,
     max_results: usize,
 ) -> Vec<SearchResult> {
-    let root_path = Path::new(root);
-    if !root_path.exists() {
-        return Vec::new();
-    }
-
-    let pattern_lower = pattern.to_lowercase();
     let mut results = Vec::new();
-
-    let walker = WalkBuilder::new(root_path)
-        .hidden(false)
-        .git_ignore(true)
-        .git_global(true)
-        .max_depth(Some(10))
-        .build();
-
-    for entry in walker.flatten() {
-        if results.len() >= max_results {
-            break;
-        }
-
-        let path = entry.path();
-        let name = path
-            .file_name()
-            .and_then(|n| n.to_str())
-            .unwrap_or("");
-
-        if name.to_lowercase().contains(&pattern_lower) {
-            let metadata = entry.metadata().ok();
-            let is_dir = entry.file_type().map(|ft| ft.is_dir()).unwrap_or(false);
-            let size = metadata.as_ref().map(|m| m.len()).unwrap_or(0);
-
-            results.push(SearchResult {
-                path: path.to_string_lossy().to_string(),
-                name: name.to_string(),
-                is_dir,
-                size,
-            });
-        }
-    }
-
+    let cancel = AtomicBool::new(false);
+    parallel::search_parallel(root, pattern, max_results, &cancel, &mut |hits| {
+        results.extend(hits.iter().map(|hit| SearchResult {
+            path: hit.path.clone(),
+            name: hit.name().to_string(),
+            is_dir: hit.is_dir,
+            size: std::fs::symlink_metadata(&hit.path).map(|m| m.len()).unwrap_or(0),
+        }));
+        true
+    });
     results
 }
 
-/// List directory contents (non-recursive).
+/// List directory contents (non-recursive): directories first, then by
+/// name, case-insensitively. Use `listing::DirListing` to page through
+/// large directories instead.
 pub fn list_directory(path: &str) -> Result<Vec<SearchResult>, std::io::Error> {
-    let dir_path = Path::new(path);
-    let mut entries = Vec::new();
-
-    for entry in std::fs::read_dir(dir_path)? {
-        let entry = entry?;
-        let metadata = entry.metadata()?;
-        let name = entry
-            .file_name()
-            .to_string_lossy()
-            .to_string();
-
-        entries.push(SearchResult {
-            path: entry.path().to_string_lossy().to_string(),
-            name,
-            is_dir: metadata.is_dir(),
-            size: metadata.len(),
-        });
-    }
-
-    // Sort: directories first, then alphabetically
-    entries.sort_by(|a, b| {
-        b.is_dir
-            .cmp(&a.is_dir)
-            .then(a.name.to_lowercase().cmp(&b.name.to_lowercase()))
-    });
-
-    Ok(entries)
+    let mut listing = listing::DirListing::open(path)?;
+    Ok(listing.page(0, usize::MAX))
 }
 
 #[cfg(test)]
@@ -0,0 +1,339 @@
+//! Parallel, streaming filename search.
+//!
+//! Walks with `ignore`'s parallel walker on every core and matches names
+//! case-insensitively without allocating per entry. Matches are handed to a
+//! callback in small batches while the walk is still running, so the first
+//! results show up within milliseconds even for a home directory. Nothing is
+//! `stat`ed during the walk: a hit carries only what the directory entry
+//! already knows (path and `d_type`).
+
+use std::path::Path;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use ignore::{DirEntry, ParallelVisitor, ParallelVisitorBuilder, WalkState};
+
+/// Hits buffered per walker thread before they are handed out.
+pub const BATCH_SIZE: usize = 64;
+
+/// Longest a walker thread holds on to buffered hits.
+const FLUSH_INTERVAL: Duration = Duration::from_millis(15);
+
+/// A matching entry.
+#[derive(Clone, Debug)]
+pub struct SearchHit {
+    pub path: String,
+    /// Byte offset of the file name within `path`.
+    pub name_start: usize,
+    pub is_dir: bool,
+}
+
+impl SearchHit {
+    pub fn name(&self) -> &str {
+        &self.path[self.name_start..]
+    }
+}
+
+/// Case-insensitive substring matcher.
+pub struct NameMatcher {
+    /// ASCII-lowercased pattern bytes (ASCII patterns).
+    ascii: Vec<u8>,
+    /// Lowercased pattern chars (patterns with non-ASCII characters).
+    unicode: Option<Vec<char>>,
+}
+
+impl NameMatcher {
+    pub fn new(pattern: &str) -> Self {
+        if pattern.is_ascii() {
+            Self { ascii: pattern.to_ascii_lowercase().into_bytes(), unicode: None }
+        } else {
+            Self { ascii: Vec::new(), unicode: Some(pattern.chars().flat_map(char::to_lowercase).collect()) }
+        }
+    }
+
+    pub fn is_match(&self, name: &str) -> bool {
+        match &self.unicode {
+            None => {
+                let needle = &self.ascii;
+                needle.is_empty()
+                    || name.as_bytes().windows(needle.len()).any(|w| w.eq_ignore_ascii_case(needle))
+            }
+            Some(needle) => name.char_indices().any(|(start, _)| {
+                let mut hay = name[start..].chars().flat_map(char::to_lowercase);
+                needle.iter().all(|&c| hay.next() == Some(c))
+            }),
+        }
+    }
+}
+
+/// Walk `root` for names containing `pattern` (case-insensitive), calling
+/// `on_batch` with each batch of hits. The walk stops once `max_results`
+/// hits were delivered, when `on_batch` returns false, or when `cancel` is
+/// set. Blocks until all walker threads have finished; `on_batch` is never
+/// called concurrently.
+pub fn search_parallel(
+    root: &str,
+    pattern: &str,
+    max_results: usize,
+    cancel: &AtomicBool,
+    on_batch: &mut (dyn FnMut(&[SearchHit]) -> bool + Send),
+) {
+    let root_path = Path::new(root);
+    if !root_path.exists() || max_results == 0 {
+        return;
+    }
+
+    let matcher = NameMatcher::new(pattern);
+    let delivery = Delivery::new(max_results, cancel, on_batch);
+    super::walk_builder(root_path)
+        .threads(walker_threads())
+        .build_parallel()
+        .visit(&mut VisitorBuilder { matcher: &matcher, delivery: &delivery });
+}
+
+/// One walker thread per core.
+pub(crate) fn walker_threads() -> usize {
+    std::thread::available_parallelism().map_or(4, |n| n.get())
+}
+
+/// Hands batches from the walker threads to a single consumer and enforces
+/// the result limit. Shared by every parallel search.
+pub(crate) struct Delivery<'a, T> {
+    max_results: usize,
+    delivered: AtomicUsize,
+    done: AtomicBool,
+    cancel: &'a AtomicBool,
+    sink: Mutex<&'a mut (dyn FnMut(&[T]) -> bool + Send)>,
+}
+
+impl<'a, T> Delivery<'a, T> {
+    pub(crate) fn new(
+        max_results: usize,
+        cancel: &'a AtomicBool,
+        sink: &'a mut (dyn FnMut(&[T]) -> bool + Send),
+    ) -> Self {
+        Self {
+            max_results,
+            delivered: AtomicUsize::new(0),
+            done: AtomicBool::new(false),
+            cancel,
+            sink: Mutex::new(sink),
+        }
+    }
+
+    /// The limit was reached, the consumer declined, or the caller cancelled.
+    pub(crate) fn stopped(&self) -> bool {
+        self.done.load(Ordering::Relaxed) || self.cancel.load(Ordering::Relaxed)
+    }
+
+    /// Hand a thread's batch out and empty it. Returns false once the
+    /// search is over.
+    fn deliver(&self, batch: &mut Vec<T>) -> bool {
+        if batch.is_empty() {
+            return !self.stopped();
+        }
+        let mut sink = self.sink.lock().unwrap();
+        if self.stopped() {
+            batch.clear();
+            return false;
+        }
+        let delivered = self.delivered.load(Ordering::Relaxed);
+        batch.truncate(self.max_results - delivered);
+        let total = delivered + batch.len();
+        self.delivered.store(total, Ordering::Relaxed);
+
+        let more = (*sink)(batch);
+        batch.clear();
+        if !more || total >= self.max_results {
+            self.done.store(true, Ordering::Relaxed);
+            return false;
+        }
+        true
+    }
+}
+
+/// A walker thread's pending hits.
+pub(crate) struct Batch<T> {
+    items: Vec<T>,
+    last_flush: Instant,
+}
+
+impl<T> Batch<T> {
+    pub(crate) fn new() -> Self {
+        Self { items: Vec::with_capacity(BATCH_SIZE), last_flush: Instant::now() }
+    }
+
+    pub(crate) fn push(&mut self, item: T) {
+        self.items.push(item);
+    }
+
+    /// Full, or holding hits for longer than `FLUSH_INTERVAL`.
+    pub(crate) fn is_due(&self) -> bool {
+        self.items.len() >= BATCH_SIZE
+            || (!self.items.is_empty() && self.last_flush.elapsed() >= FLUSH_INTERVAL)
+    }
+
+    /// Deliver the pending hits. Returns false once the search is over.
+    pub(crate) fn flush(&mut self, delivery: &Delivery<'_, T>) -> bool {
+        self.last_flush = Instant::now();
+        delivery.deliver(&mut self.items)
+    }
+}
+
+struct VisitorBuilder<'s, 'a> {
+    matcher: &'s NameMatcher,
+    delivery: &'s Delivery<'a, SearchHit>,
+}
+
+impl<'s, 'a: 's> ParallelVisitorBuilder<'s> for VisitorBuilder<'s, 'a> {
+    fn build(&mut self) -> Box<dyn ParallelVisitor + 's> {
+        Box::new(Visitor { matcher: self.matcher, delivery: self.delivery, batch: Batch::new() })
+    }
+}
+
+/// One per walker thread; buffers its own hits.
+struct Visitor<'s, 'a> {
+    matcher: &'s NameMatcher,
+    delivery: &'s Delivery<'a, SearchHit>,
+    batch: Batch<SearchHit>,
+}
+
+impl Visitor<'_, '_> {
+    fn consider(&mut self, entry: &DirEntry) {
+        if entry.depth() == 0 {
+            return;
+        }
+        // Borrowed unless the name is not valid UTF-8
+        if !self.matcher.is_match(&entry.file_name().to_string_lossy()) {
+            return;
+        }
+        let path = entry.path().to_string_lossy().into_owned();
+        let name_start = path.rfind(std::path::MAIN_SEPARATOR).map_or(0, |i| i + 1);
+        self.batch.push(SearchHit {
+            path,
+            name_start,
+            is_dir: entry.file_type().is_some_and(|ft| ft.is_dir()),
+        });
+    }
+}
+
+impl ParallelVisitor for Visitor<'_, '_> {
+    fn visit(&mut self, entry: Result<DirEntry, ignore::Error>) -> WalkState {
+        if self.delivery.stopped() {
+            return WalkState::Quit;
+        }
+        if let Ok(entry) = entry {
+            self.consider(&entry);
+        }
+        if self.batch.is_due() && !self.batch.flush(self.delivery) {
+            return WalkState::Quit;
+        }
+        WalkState::Continue
+    }
+}
+
+impl Drop for Visitor<'_, '_> {
+    fn drop(&mut self) {
+        self.batch.flush(self.delivery);
+    }
+}
+
+/// A search running on a background thread.
+/// Dropping it cancels the walk and waits for the thread to exit, after
+/// which no further callbacks are made.
+pub struct FileSearch {
+    cancel: Arc<AtomicBool>,
+    thread: Option<std::thread::JoinHandle<()>>,
+}
+
+impl FileSearch {
+    /// Start searching. `on_event` receives each batch with `done == false`
+    /// (return false to stop), then a final empty call with `done == true`
+    /// unless the search was cancelled.
+    pub fn start<F>(root: String, pattern: String, max_results: usize, mut on_event: F) -> Self
+    where
+        F: FnMut(&[SearchHit], bool) -> bool + Send + 'static,
+    {
+        Self::spawn(move |cancel| {
+            search_parallel(&root, &pattern, max_results, cancel, &mut |hits| on_event(hits, false));
+            if !cancel.load(Ordering::Relaxed) {
+                on_event(&[], true);
+            }
+        })
+    }
+
+    /// Run `search` on a background thread with this handle's cancel flag.
+    pub(crate) fn spawn<F>(search: F) -> Self
+    where
+        F: FnOnce(&AtomicBool) + Send + 'static,
+    {
+        let cancel = Arc::new(AtomicBool::new(false));
+        let thread_cancel = Arc::clone(&cancel);
+        let thread = std::thread::Builder::new()
+            .name("pier-file-search".into())
+            .spawn(move || search(&thread_cancel))
+            .ok();
+        Self { cancel, thread }
+    }
+
+    /// Ask the walk to stop without waiting for it.
+    pub fn cancel(&self) {
+        self.cancel.store(true, Ordering::Relaxed);
+    }
+}
+
+impl Drop for FileSearch {
+    fn drop(&mut self) {
+        self.cancel();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_name_matcher() {
+        let m = NameMatcher::new("ReadMe");
+        assert!(m.is_match("README.md"));
+        assert!(m.is_match("old-readme"));
+        assert!(!m.is_match("read.me"));
+        assert!(NameMatcher::new("").is_match("anything"));
+
+        let m = NameMatcher::new("ÄRGER");
+        assert!(m.is_match("kein-ärger.txt"));
+        assert!(!m.is_match("arger"));
+    }
+
+    #[test]
+    fn test_search_streams_and_limits() {
+        let root = std::env::temp_dir().join(format!("pier-search-{}", std::process::id()));
+        std::fs::create_dir_all(root.join("sub/deeper")).unwrap();
+        for i in 0..10 {
+            std::fs::write(root.join(format!("sub/deeper/Match-{}.txt", i)), b"").unwrap();
+        }
+        std::fs::write(root.join("other.txt"), b"").unwrap();
+
+        let mut hits: Vec<SearchHit> = Vec::new();
+        let cancel = AtomicBool::new(false);
+        search_parallel(root.to_str().unwrap(), "match", 100, &cancel, &mut |batch| {
+            hits.extend_from_slice(batch);
+            true
+        });
+        assert_eq!(hits.len(), 10);
+        assert!(hits.iter().all(|h| h.name().starts_with("Match-") && !h.is_dir));
+
+        let mut count = 0;
+        search_parallel(root.to_str().unwrap(), "match", 3, &cancel, &mut |batch| {
+            count += batch.len();
+            true
+        });
+        assert_eq!(count, 3);
+
+        std::fs::remove_dir_all(&root).unwrap();
+    }
+}
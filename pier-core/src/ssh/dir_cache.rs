@@ -0,0 +1,194 @@
+//! Remote directory listing cache.
+//!
+//! On a 150 ms link, browsing is dominated by round trips. Each SFTP session
+//! therefore remembers the listings it fetched for a short TTL, and
+//! `SftpClient` speculatively fetches the subdirectories (and the parent) of
+//! whatever was just listed, so drilling down or going back is served from
+//! memory. Our own writes invalidate the affected directories explicitly;
+//! changes made by others show up once the TTL runs out.
+
+use std::collections::{HashMap, HashSet};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use super::sftp::RemoteFileEntry;
+
+/// How long a listing is served without asking the server again.
+pub const DEFAULT_TTL: Duration = Duration::from_secs(30);
+
+/// Prefetch requests kept in flight per session.
+pub const PREFETCH_CONCURRENCY: usize = 4;
+
+/// Subdirectories prefetched after listing a directory.
+pub const PREFETCH_PER_DIR: usize = 16;
+
+pub type Listing = Arc<Vec<RemoteFileEntry>>;
+
+#[derive(Default)]
+struct State {
+    listings: HashMap<String, (Instant, Listing)>,
+    /// Directories a prefetch is already fetching.
+    in_flight: HashSet<String>,
+    /// Bumped by every invalidation; fetches that started before it are
+    /// not stored, since they may have read the old contents.
+    generation: u64,
+}
+
+/// A fetch in progress; hand it back to `finish` or `abandon`.
+pub struct Ticket {
+    key: String,
+    generation: u64,
+    prefetch: bool,
+}
+
+/// Per-session listing cache.
+pub struct DirCache {
+    state: Mutex<State>,
+    ttl: Duration,
+}
+
+impl DirCache {
+    pub fn new(ttl: Duration) -> Self {
+        Self { state: Mutex::new(State::default()), ttl }
+    }
+
+    /// A listing fetched less than the TTL ago.
+    pub fn get(&self, path: &str) -> Option<Listing> {
+        let state = self.state.lock().unwrap();
+        match state.listings.get(&normalize(path)) {
+            Some((at, listing)) if at.elapsed() < self.ttl => Some(Arc::clone(listing)),
+            _ => None,
+        }
+    }
+
+    /// Start a foreground fetch of `path`.
+    pub fn ticket(&self, path: &str) -> Ticket {
+        let state = self.state.lock().unwrap();
+        Ticket { key: normalize(path), generation: state.generation, prefetch: false }
+    }
+
+    /// Start a prefetch of `path`, unless it is cached or already being
+    /// fetched.
+    pub fn begin_prefetch(&self, path: &str) -> Option<Ticket> {
+        let key = normalize(path);
+        let mut state = self.state.lock().unwrap();
+        let fresh = matches!(state.listings.get(&key), Some((at, _)) if at.elapsed() < self.ttl);
+        if fresh || !state.in_flight.insert(key.clone()) {
+            return None;
+        }
+        Some(Ticket { key, generation: state.generation, prefetch: true })
+    }
+
+    /// Store a fetched listing (unless an invalidation overtook the fetch).
+    pub fn finish(&self, ticket: Ticket, entries: Vec<RemoteFileEntry>) -> Listing {
+        let listing = Arc::new(entries);
+        let mut state = self.state.lock().unwrap();
+        if ticket.prefetch {
+            state.in_flight.remove(&ticket.key);
+        }
+        if ticket.generation == state.generation {
+            state.listings.insert(ticket.key, (Instant::now(), Arc::clone(&listing)));
+        }
+        listing
+    }
+
+    /// Give up on a failed fetch.
+    pub fn abandon(&self, ticket: Ticket) {
+        if ticket.prefetch {
+            self.state.lock().unwrap().in_flight.remove(&ticket.key);
+        }
+    }
+
+    /// Forget `path` and everything below it.
+    pub fn invalidate(&self, path: &str) {
+        let key = normalize(path);
+        let prefix = if key == "/" { key.clone() } else { format!("{}/", key) };
+        let mut state = self.state.lock().unwrap();
+        state.listings.retain(|k, _| *k != key && !k.starts_with(&prefix));
+        state.generation += 1;
+    }
+
+    /// Forget the directory containing `path`, after `path` was created,
+    /// replaced or removed, along with `path`'s own listing.
+    pub fn invalidate_entry(&self, path: &str) {
+        if let Some(parent) = parent(path) {
+            let mut state = self.state.lock().unwrap();
+            state.listings.remove(&parent);
+        }
+        self.invalidate(path);
+    }
+}
+
+/// Cache key: no trailing slash, except for the root itself.
+pub fn normalize(path: &str) -> String {
+    let trimmed = path.trim_end_matches('/');
+    if trimmed.is_empty() && path.starts_with('/') {
+        "/".to_string()
+    } else {
+        trimmed.to_string()
+    }
+}
+
+/// Parent directory of a remote path, if it has one.
+pub fn parent(path: &str) -> Option<String> {
+    let key = normalize(path);
+    match key.rfind('/') {
+        Some(0) if key.len() > 1 => Some("/".to_string()),
+        Some(0) | None => None,
+        Some(i) => Some(key[..i].to_string()),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn entry(name: &str) -> RemoteFileEntry {
+        RemoteFileEntry {
+            name: name.to_string(),
+            path: format!("/srv/{}", name),
+            is_dir: false,
+            size: 0,
+            modified: None,
+            permissions: None,
+        }
+    }
+
+    #[test]
+    fn test_paths() {
+        assert_eq!(normalize("/srv/app/"), "/srv/app");
+        assert_eq!(normalize("/"), "/");
+        assert_eq!(parent("/srv/app"), Some("/srv".to_string()));
+        assert_eq!(parent("/srv"), Some("/".to_string()));
+        assert_eq!(parent("/"), None);
+        assert_eq!(parent("relative"), None);
+    }
+
+    #[test]
+    fn test_cache_ttl_prefetch_and_invalidation() {
+        let cache = DirCache::new(Duration::from_secs(60));
+        let ticket = cache.ticket("/srv/");
+        cache.finish(ticket, vec![entry("a")]);
+        assert_eq!(cache.get("/srv").unwrap().len(), 1);
+        assert!(cache.begin_prefetch("/srv").is_none(), "fresh listings are not prefetched");
+
+        let first = cache.begin_prefetch("/srv/app").unwrap();
+        assert!(cache.begin_prefetch("/srv/app").is_none(), "already in flight");
+        cache.invalidate_entry("/srv/new.txt");
+        assert!(cache.get("/srv").is_none());
+        // The prefetch started before the invalidation; its result is dropped.
+        cache.finish(first, vec![entry("stale")]);
+        assert!(cache.get("/srv/app").is_none());
+
+        let again = cache.begin_prefetch("/srv/app").unwrap();
+        cache.finish(again, vec![entry("b")]);
+        assert_eq!(cache.get("/srv/app").unwrap()[0].name, "b");
+        cache.invalidate("/srv");
+        assert!(cache.get("/srv/app").is_none());
+
+        let expired = DirCache::new(Duration::ZERO);
+        let ticket = expired.ticket("/tmp");
+        expired.finish(ticket, vec![]);
+        assert!(expired.get("/tmp").is_none());
+    }
+}
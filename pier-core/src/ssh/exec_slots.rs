@@ -0,0 +1,144 @@
+//! Exec channel slots.
+//!
+//! A connection caps how many exec channels are open at once, and the cap
+//! can change while commands hold slots. It stays one semaphore, so its
+//! FIFO queue survives a resize: growing adds permits at once, shrinking
+//! retires the free ones now and the rest as commands give them back.
+
+use std::sync::{Arc, Mutex};
+use tokio::sync::{AcquireError, OwnedSemaphorePermit, Semaphore, TryAcquireError};
+
+pub struct ExecSlots {
+    semaphore: Arc<Semaphore>,
+    count: Mutex<SlotCount>,
+}
+
+struct SlotCount {
+    /// The cap in effect.
+    max: usize,
+    /// Permits still to retire, held by commands when the cap shrank.
+    owed: usize,
+}
+
+impl ExecSlots {
+    pub fn new(max: usize) -> Self {
+        let max = max.max(1);
+        Self { semaphore: Arc::new(Semaphore::new(max)), count: Mutex::new(SlotCount { max, owed: 0 }) }
+    }
+
+    pub fn max(&self) -> usize {
+        self.count.lock().unwrap().max
+    }
+
+    /// Change the cap. Commands already running keep their slot.
+    pub fn resize(&self, max: usize) {
+        let max = max.max(1);
+        let mut count = self.count.lock().unwrap();
+        if max > count.max {
+            let grow = max - count.max;
+            let repaid = grow.min(count.owed);
+            count.owed -= repaid;
+            self.semaphore.add_permits(grow - repaid);
+        } else {
+            let shrink = count.max - max;
+            count.owed += shrink - self.semaphore.forget_permits(shrink);
+        }
+        count.max = max;
+    }
+
+    /// Wait for a slot; it's free again when the permit is dropped.
+    pub async fn acquire(&self) -> Result<OwnedSemaphorePermit, AcquireError> {
+        loop {
+            let permit = Arc::clone(&self.semaphore).acquire_owned().await?;
+            {
+                let mut count = self.count.lock().unwrap();
+                if count.owed == 0 {
+                    return Ok(permit);
+                }
+                // A slot given back after the cap shrank: retire it.
+                count.owed -= 1;
+            }
+            permit.forget();
+        }
+    }
+
+    /// A slot if one is free now, without queueing.
+    pub fn try_acquire(&self) -> Option<OwnedSemaphorePermit> {
+        let mut count = self.count.lock().unwrap();
+        loop {
+            let permit = match Arc::clone(&self.semaphore).try_acquire_owned() {
+                Ok(permit) => permit,
+                Err(TryAcquireError::NoPermits | TryAcquireError::Closed) => return None,
+            };
+            if count.owed == 0 {
+                return Some(permit);
+            }
+            count.owed -= 1;
+            permit.forget();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn acquire_soon(slots: &ExecSlots) -> Option<OwnedSemaphorePermit> {
+        let runtime = tokio::runtime::Builder::new_current_thread().enable_time().build().unwrap();
+        runtime.block_on(async {
+            tokio::time::timeout(std::time::Duration::from_millis(20), slots.acquire()).await.ok()?.ok()
+        })
+    }
+
+    #[test]
+    fn test_shrink_waits_for_running_commands() {
+        let slots = ExecSlots::new(3);
+        let mut running: Vec<_> = (0..3).map(|_| acquire_soon(&slots).expect("under the cap")).collect();
+
+        slots.resize(1);
+        assert_eq!(slots.max(), 1);
+        running.pop();
+        assert!(acquire_soon(&slots).is_none(), "two still running, cap is one");
+        running.pop();
+        assert!(acquire_soon(&slots).is_none(), "one still running, cap is one");
+        running.pop();
+        let only = acquire_soon(&slots).expect("nothing running");
+        assert!(acquire_soon(&slots).is_none());
+        drop(only);
+        assert!(acquire_soon(&slots).is_some());
+    }
+
+    #[test]
+    fn test_try_acquire_respects_shrunk_cap() {
+        let slots = ExecSlots::new(2);
+        let first = slots.try_acquire().expect("free slot");
+        let second = slots.try_acquire().expect("free slot");
+        assert!(slots.try_acquire().is_none());
+
+        slots.resize(1);
+        drop(first);
+        assert!(slots.try_acquire().is_none(), "the returned slot was retired");
+        drop(second);
+        let only = slots.try_acquire().expect("cap is one");
+        assert!(slots.try_acquire().is_none());
+        drop(only);
+    }
+
+    #[test]
+    fn test_grow_repays_owed_slots_first() {
+        let slots = ExecSlots::new(2);
+        let held: Vec<_> = (0..2).map(|_| acquire_soon(&slots).unwrap()).collect();
+
+        slots.resize(1);
+        slots.resize(3);
+        // Two held, cap three: exactly one more.
+        let extra = acquire_soon(&slots).expect("one slot left");
+        assert!(acquire_soon(&slots).is_none());
+
+        drop(held);
+        drop(extra);
+        let all: Vec<_> = (0..3).map(|_| acquire_soon(&slots).expect("cap is three")).collect();
+        assert!(acquire_soon(&slots).is_none());
+        drop(all);
+    }
+}
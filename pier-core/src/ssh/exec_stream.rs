@@ -0,0 +1,226 @@
+//! Streaming command output.
+//!
+//! `ExecStream` is the reader side of a running remote command: stdout and
+//! stderr chunks are queued as they arrive and handed out with a blocking,
+//! timeout-bounded `read`. The queue is bounded by bytes; when the reader
+//! falls behind, the channel task stops pulling from the SSH channel, the
+//! channel window fills, and the server stops sending. So a 500 MB
+//! `journalctl` costs at most `MAX_BUFFERED` bytes here.
+
+use std::collections::VecDeque;
+use std::sync::{Arc, Condvar, Mutex};
+use std::time::{Duration, Instant};
+use tokio::sync::{watch, Notify};
+
+/// Bytes queued before the channel task waits for the reader.
+pub const MAX_BUFFERED: usize = 1024 * 1024;
+
+/// Which remote stream a chunk came from (values match the FFI).
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+#[repr(u8)]
+pub enum StreamKind {
+    Stdout = 1,
+    Stderr = 2,
+}
+
+/// Outcome of `ExecStream::read`.
+#[derive(Debug, PartialEq, Eq)]
+pub enum StreamRead {
+    /// `n` bytes of the given stream were copied into the buffer.
+    Data(StreamKind, usize),
+    /// Nothing arrived within the timeout.
+    TimedOut,
+    /// The command finished and all output has been read.
+    Finished,
+}
+
+#[derive(Default)]
+struct State {
+    chunks: VecDeque<(StreamKind, Vec<u8>)>,
+    buffered: usize,
+    exit_code: Option<i32>,
+    done: bool,
+}
+
+struct Shared {
+    state: Mutex<State>,
+    /// Signalled when a chunk is queued or the command finishes.
+    readable: Condvar,
+    /// Signalled when the reader frees buffer space.
+    drained: Notify,
+}
+
+/// Reader handle for a streaming command.
+/// Dropping it cancels the command and closes its channel.
+pub struct ExecStream {
+    shared: Arc<Shared>,
+    cancel: watch::Sender<bool>,
+}
+
+/// Producer handle owned by the task pumping the SSH channel.
+pub struct StreamWriter {
+    shared: Arc<Shared>,
+    cancel: watch::Receiver<bool>,
+}
+
+impl ExecStream {
+    /// Create a connected reader/writer pair.
+    pub fn new() -> (ExecStream, StreamWriter) {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State::default()),
+            readable: Condvar::new(),
+            drained: Notify::new(),
+        });
+        let (cancel_tx, cancel_rx) = watch::channel(false);
+        (
+            ExecStream { shared: Arc::clone(&shared), cancel: cancel_tx },
+            StreamWriter { shared, cancel: cancel_rx },
+        )
+    }
+
+    /// Copy the next available output into `buf`, waiting up to `timeout`.
+    /// A chunk larger than `buf` is handed out across several calls; each
+    /// call returns bytes from a single stream.
+    pub fn read(&self, buf: &mut [u8], timeout: Duration) -> StreamRead {
+        let deadline = Instant::now() + timeout;
+        let mut state = self.shared.state.lock().unwrap();
+        loop {
+            if let Some((kind, chunk)) = state.chunks.front_mut() {
+                let kind = *kind;
+                let n = chunk.len().min(buf.len());
+                buf[..n].copy_from_slice(&chunk[..n]);
+                if n == chunk.len() {
+                    state.chunks.pop_front();
+                } else {
+                    chunk.drain(..n);
+                }
+                state.buffered -= n;
+                drop(state);
+                self.shared.drained.notify_one();
+                return StreamRead::Data(kind, n);
+            }
+            if state.done {
+                return StreamRead::Finished;
+            }
+            let now = Instant::now();
+            if now >= deadline {
+                return StreamRead::TimedOut;
+            }
+            state = self.shared.readable.wait_timeout(state, deadline - now).unwrap().0;
+        }
+    }
+
+    /// Remote exit status, once the command has finished.
+    pub fn exit_code(&self) -> Option<i32> {
+        self.shared.state.lock().unwrap().exit_code
+    }
+
+    /// True once the command finished (output may still be queued).
+    pub fn is_done(&self) -> bool {
+        self.shared.state.lock().unwrap().done
+    }
+}
+
+impl Drop for ExecStream {
+    fn drop(&mut self) {
+        let _ = self.cancel.send(true);
+    }
+}
+
+impl StreamWriter {
+    /// Wait until the reader has room, or until the reader goes away.
+    /// Returns false if the stream was cancelled.
+    pub async fn reserve(&mut self) -> bool {
+        loop {
+            if *self.cancel.borrow() {
+                return false;
+            }
+            if self.shared.state.lock().unwrap().buffered < MAX_BUFFERED {
+                return true;
+            }
+            tokio::select! {
+                _ = self.shared.drained.notified() => {}
+                res = self.cancel.changed() => {
+                    if res.is_err() { return false; }
+                }
+            }
+        }
+    }
+
+    /// Resolves once the reader has cancelled the stream.
+    pub async fn cancelled(&mut self) {
+        while !*self.cancel.borrow() {
+            if self.cancel.changed().await.is_err() {
+                return;
+            }
+        }
+    }
+
+    /// Queue a chunk of output.
+    pub fn push(&self, kind: StreamKind, data: &[u8]) {
+        if data.is_empty() {
+            return;
+        }
+        let mut state = self.shared.state.lock().unwrap();
+        state.buffered += data.len();
+        state.chunks.push_back((kind, data.to_vec()));
+        drop(state);
+        self.shared.readable.notify_all();
+    }
+
+    /// Record the exit status.
+    pub fn set_exit_code(&self, code: i32) {
+        self.shared.state.lock().unwrap().exit_code = Some(code);
+    }
+}
+
+impl Drop for StreamWriter {
+    fn drop(&mut self) {
+        self.shared.state.lock().unwrap().done = true;
+        self.shared.readable.notify_all();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_stream_partial_reads_and_finish() {
+        let (reader, writer) = ExecStream::new();
+        writer.push(StreamKind::Stdout, b"hello world");
+        writer.push(StreamKind::Stderr, b"oops");
+        writer.set_exit_code(3);
+        drop(writer);
+
+        let mut buf = [0u8; 5];
+        assert_eq!(reader.read(&mut buf, Duration::ZERO), StreamRead::Data(StreamKind::Stdout, 5));
+        assert_eq!(&buf, b"hello");
+        assert_eq!(reader.read(&mut buf, Duration::ZERO), StreamRead::Data(StreamKind::Stdout, 5));
+        assert_eq!(reader.read(&mut buf, Duration::ZERO), StreamRead::Data(StreamKind::Stdout, 1));
+        assert_eq!(reader.read(&mut buf, Duration::ZERO), StreamRead::Data(StreamKind::Stderr, 4));
+        assert_eq!(&buf[..4], b"oops");
+        assert_eq!(reader.read(&mut buf, Duration::ZERO), StreamRead::Finished);
+        assert_eq!(reader.exit_code(), Some(3));
+    }
+
+    #[test]
+    fn test_stream_backpressure() {
+        let rt = tokio::runtime::Builder::new_current_thread().enable_all().build().unwrap();
+        let (reader, mut writer) = ExecStream::new();
+        writer.push(StreamKind::Stdout, &vec![0u8; MAX_BUFFERED]);
+
+        // Full: reserve must wait until the reader drains something.
+        let blocked = rt.block_on(async {
+            tokio::time::timeout(Duration::from_millis(20), writer.reserve()).await.is_err()
+        });
+        assert!(blocked);
+
+        let mut buf = vec![0u8; 4096];
+        assert!(matches!(reader.read(&mut buf, Duration::ZERO), StreamRead::Data(_, 4096)));
+        assert!(rt.block_on(writer.reserve()));
+
+        drop(reader);
+        assert!(!rt.block_on(writer.reserve()), "cancelled once the reader is gone");
+    }
+}
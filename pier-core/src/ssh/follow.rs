@@ -0,0 +1,308 @@
+//! Remote log following.
+//!
+//! A `Follower` keeps one long-lived `tail -F` / `docker logs -f` channel
+//! open per source instead of re-running `tail -n +N` on a timer. Output is
+//! split into lines, timestamp- and level-tagged in Rust, and kept in a
+//! bounded ring; consumers ask for lines newer than the last sequence number
+//! they saw, so only new lines cross the FFI boundary.
+
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Duration;
+
+use serde::Serialize;
+
+use super::exec_stream::{ExecStream, StreamRead};
+use super::shell_quote;
+
+/// Lines retained per follower by default.
+pub const DEFAULT_RING_LINES: usize = 10_000;
+
+/// Longest line kept; anything beyond is cut (binary junk, minified JSON).
+const MAX_LINE_BYTES: usize = 16 * 1024;
+
+/// What to follow on the remote host.
+#[derive(Clone, Debug)]
+pub enum FollowSource {
+    /// A file path, followed across rotation and truncation.
+    File(String),
+    /// A Docker container ID or name.
+    Docker(String),
+}
+
+impl FollowSource {
+    /// Remote command that streams the last `backlog` lines, then new ones.
+    pub fn command(&self, backlog: usize) -> String {
+        match self {
+            FollowSource::File(path) => format!("tail -n {} -F -- {} 2>&1", backlog, shell_quote(path)),
+            FollowSource::Docker(id) => format!("docker logs -f --tail {} {} 2>&1", backlog, shell_quote(id)),
+        }
+    }
+}
+
+/// Severity tag, spelled like the Swift `LogLevel` raw values.
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Serialize)]
+#[serde(rename_all = "UPPERCASE")]
+pub enum LogLevel {
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Fatal,
+}
+
+/// A parsed log line.
+#[derive(Clone, Debug, Serialize)]
+pub struct LogLine {
+    /// Monotonic sequence number within this follower.
+    pub seq: u64,
+    pub text: String,
+    pub timestamp: Option<String>,
+    pub level: Option<LogLevel>,
+    /// `text` with the timestamp removed.
+    pub message: String,
+}
+
+impl LogLine {
+    pub fn parse(seq: u64, text: String) -> Self {
+        let (timestamp, message) = match find_timestamp(&text) {
+            Some((start, end)) => (Some(text[start..end].to_string()), text[end..].trim().to_string()),
+            None => (None, text.clone()),
+        };
+        let level = detect_level(&message);
+        Self { seq, text, timestamp, level, message }
+    }
+}
+
+/// Locate the first `YYYY-MM-DD[T ]HH:MM:SS[.fff]` timestamp, falling back to
+/// a bare `HH:MM:SS[.fff]`. Returns the byte range.
+fn find_timestamp(text: &str) -> Option<(usize, usize)> {
+    let b = text.as_bytes();
+    let digits = |at: usize, n: usize| at + n <= b.len() && b[at..at + n].iter().all(u8::is_ascii_digit);
+    let is = |at: usize, c: u8| b.get(at) == Some(&c);
+    let clock = |at: usize| digits(at, 2) && is(at + 2, b':') && digits(at + 3, 2) && is(at + 5, b':') && digits(at + 6, 2);
+    let fraction = |mut at: usize| {
+        while at < b.len() && (b[at] == b'.' || b[at].is_ascii_digit()) {
+            at += 1;
+        }
+        at
+    };
+
+    for i in 0..b.len() {
+        if digits(i, 4) && is(i + 4, b'-') && digits(i + 5, 2) && is(i + 7, b'-') && digits(i + 8, 2)
+            && (is(i + 10, b'T') || is(i + 10, b' ')) && clock(i + 11)
+        {
+            return Some((i, fraction(i + 19)));
+        }
+    }
+    (0..b.len()).find(|&i| clock(i)).map(|i| (i, fraction(i + 8)))
+}
+
+/// Same rules as the Swift log parser: `[LEVEL]` anywhere, or `LEVEL ` /
+/// `LEVEL:` at the start of the message.
+fn detect_level(message: &str) -> Option<LogLevel> {
+    const PATTERNS: &[(&str, LogLevel)] = &[
+        ("DEBUG", LogLevel::Debug), ("DBG", LogLevel::Debug),
+        ("INFO", LogLevel::Info), ("INF", LogLevel::Info),
+        ("WARN", LogLevel::Warn), ("WARNING", LogLevel::Warn), ("WRN", LogLevel::Warn),
+        ("ERROR", LogLevel::Error), ("ERR", LogLevel::Error),
+        ("FATAL", LogLevel::Fatal), ("FTL", LogLevel::Fatal), ("PANIC", LogLevel::Fatal),
+    ];
+    let upper = message.to_uppercase();
+    PATTERNS.iter().find_map(|&(pat, level)| {
+        let bytes = upper.as_bytes();
+        let prefixed = upper.starts_with(pat) && matches!(bytes.get(pat.len()), Some(b' ') | Some(b':'));
+        let bracketed = upper.match_indices(pat).any(|(at, _)| {
+            at > 0 && bytes[at - 1] == b'[' && bytes.get(at + pat.len()) == Some(&b']')
+        });
+        (prefixed || bracketed).then_some(level)
+    })
+}
+
+/// Lines handed out by `Follower::lines_since`.
+#[derive(Debug, Serialize)]
+pub struct FollowBatch {
+    pub lines: Vec<LogLine>,
+    /// Pass this as `since` on the next call.
+    pub next: u64,
+    /// Lines between `since` and the oldest retained one that were evicted.
+    pub skipped: u64,
+    /// The follow command exited (e.g. container stopped).
+    pub finished: bool,
+}
+
+struct Ring {
+    lines: VecDeque<LogLine>,
+    capacity: usize,
+    next_seq: u64,
+    finished: bool,
+}
+
+impl Ring {
+    fn push(&mut self, text: String) {
+        if self.lines.len() == self.capacity {
+            self.lines.pop_front();
+        }
+        self.lines.push_back(LogLine::parse(self.next_seq, text));
+        self.next_seq += 1;
+    }
+}
+
+/// Splits a byte stream into lines, carrying partial lines across chunks.
+#[derive(Default)]
+struct LineSplitter {
+    partial: Vec<u8>,
+}
+
+impl LineSplitter {
+    fn feed(&mut self, mut data: &[u8], mut emit: impl FnMut(String)) {
+        while let Some(pos) = data.iter().position(|&b| b == b'\n') {
+            self.append(&data[..pos]);
+            emit(self.take());
+            data = &data[pos + 1..];
+        }
+        self.append(data);
+    }
+
+    fn append(&mut self, data: &[u8]) {
+        let room = MAX_LINE_BYTES.saturating_sub(self.partial.len());
+        self.partial.extend_from_slice(&data[..data.len().min(room)]);
+    }
+
+    fn take(&mut self) -> String {
+        let mut line = String::from_utf8_lossy(&self.partial).into_owned();
+        self.partial.clear();
+        if line.ends_with('\r') {
+            line.pop();
+        }
+        line
+    }
+
+    fn finish(&mut self, emit: impl FnOnce(String)) {
+        if !self.partial.is_empty() {
+            emit(self.take());
+        }
+    }
+}
+
+/// A running follow: one remote channel feeding a bounded line ring.
+/// Dropping it stops the remote command.
+pub struct Follower {
+    ring: Arc<Mutex<Ring>>,
+    stop: Arc<AtomicBool>,
+    thread: Option<std::thread::JoinHandle<()>>,
+}
+
+impl Follower {
+    /// Start parsing `stream` into a ring of at most `capacity` lines.
+    pub fn start(stream: ExecStream, capacity: usize) -> Self {
+        let ring = Arc::new(Mutex::new(Ring {
+            lines: VecDeque::with_capacity(capacity.min(1024)),
+            capacity: capacity.max(1),
+            next_seq: 0,
+            finished: false,
+        }));
+        let stop = Arc::new(AtomicBool::new(false));
+
+        let thread_ring = Arc::clone(&ring);
+        let thread_stop = Arc::clone(&stop);
+        let thread = std::thread::Builder::new()
+            .name("pier-log-follow".into())
+            .spawn(move || {
+                let mut splitter = LineSplitter::default();
+                let mut buf = vec![0u8; 64 * 1024];
+                while !thread_stop.load(Ordering::Relaxed) {
+                    match stream.read(&mut buf, Duration::from_millis(200)) {
+                        StreamRead::Data(_, n) => {
+                            let mut ring = thread_ring.lock().unwrap();
+                            splitter.feed(&buf[..n], |line| ring.push(line));
+                        }
+                        StreamRead::TimedOut => {}
+                        StreamRead::Finished => {
+                            let mut ring = thread_ring.lock().unwrap();
+                            splitter.finish(|line| ring.push(line));
+                            ring.finished = true;
+                            break;
+                        }
+                    }
+                }
+            })
+            .ok();
+
+        Self { ring, stop, thread }
+    }
+
+    /// Up to `max` lines with sequence number >= `since`.
+    pub fn lines_since(&self, since: u64, max: usize) -> FollowBatch {
+        let ring = self.ring.lock().unwrap();
+        let oldest = ring.next_seq - ring.lines.len() as u64;
+        let from = since.max(oldest);
+        let lines: Vec<LogLine> = ring
+            .lines
+            .iter()
+            .skip((from - oldest) as usize)
+            .take(max)
+            .cloned()
+            .collect();
+        FollowBatch {
+            next: from + lines.len() as u64,
+            skipped: from - since,
+            finished: ring.finished && from + lines.len() as u64 == ring.next_seq,
+            lines,
+        }
+    }
+}
+
+impl Drop for Follower {
+    fn drop(&mut self) {
+        self.stop.store(true, Ordering::Relaxed);
+        if let Some(thread) = self.thread.take() {
+            // The reader wakes at least every 200 ms; dropping its stream
+            // cancels the remote command.
+            let _ = thread.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ssh::exec_stream::StreamKind;
+
+    #[test]
+    fn test_parse_timestamp_and_level() {
+        let line = LogLine::parse(0, "2024-05-01 12:30:45.123 [ERROR] disk full".to_string());
+        assert_eq!(line.timestamp.as_deref(), Some("2024-05-01 12:30:45.123"));
+        assert_eq!(line.level, Some(LogLevel::Error));
+        assert_eq!(line.message, "[ERROR] disk full");
+
+        let line = LogLine::parse(1, "12:00:01 warn: retrying".to_string());
+        assert_eq!(line.level, Some(LogLevel::Warn));
+        assert_eq!(LogLine::parse(2, "INFORMATION only".to_string()).level, None);
+    }
+
+    #[test]
+    fn test_follower_ring_and_cursor() {
+        let (stream, writer) = ExecStream::new();
+        writer.push(StreamKind::Stdout, b"one\r\ntwo\nthr");
+        writer.push(StreamKind::Stdout, b"ee\nfour\nfive");
+        drop(writer);
+
+        let follower = Follower::start(stream, 3);
+        let mut batch = follower.lines_since(0, 100);
+        for _ in 0..50 {
+            if batch.finished {
+                break;
+            }
+            std::thread::sleep(Duration::from_millis(10));
+            batch = follower.lines_since(0, 100);
+        }
+        assert!(batch.finished);
+        let texts: Vec<&str> = batch.lines.iter().map(|l| l.text.as_str()).collect();
+        assert_eq!(texts, vec!["three", "four", "five"]);
+        assert_eq!(batch.skipped, 2);
+        assert_eq!(batch.next, 5);
+        assert!(follower.lines_since(batch.next, 100).lines.is_empty());
+    }
+}
@@ -0,0 +1,259 @@
+//! Local port forwarding data path.
+//!
+//! Each tunnelled connection is relayed by two independent pumps, one per
+//! direction, so a slow reader on one side never stalls traffic flowing the
+//! other way. A pump only reads once its previous chunk has been written:
+//! when the TCP peer stops reading, we stop draining the SSH channel, its
+//! window fills and the server stops sending; when the SSH window is
+//! exhausted, writes to the channel wait and the local socket's receive
+//! buffer pushes back on the client. Buffers start small for interactive
+//! traffic and grow while reads keep filling them (bulk result sets).
+
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Mutex;
+use std::time::{Duration, Instant};
+
+use serde::Serialize;
+use tokio::io::{AsyncRead, AsyncReadExt, AsyncWrite, AsyncWriteExt};
+use tokio::sync::watch;
+
+use crate::metrics::{self, Counter};
+
+/// First read buffer size of a pump.
+pub const MIN_BUFFER: usize = 16 * 1024;
+
+/// Largest read buffer a pump grows to.
+pub const MAX_BUFFER: usize = 256 * 1024;
+
+/// Rates are recomputed at most this often; snapshots taken sooner report
+/// the previous rate instead of a noisy one.
+const RATE_INTERVAL: Duration = Duration::from_millis(500);
+
+/// Byte and connection counters of one forward, shared by its connections.
+pub struct ForwardStats {
+    /// Local client → remote service.
+    bytes_up: AtomicU64,
+    /// Remote service → local client.
+    bytes_down: AtomicU64,
+    active_connections: AtomicU64,
+    total_connections: AtomicU64,
+    started: Instant,
+    rate: Mutex<RateSample>,
+}
+
+struct RateSample {
+    at: Instant,
+    up: u64,
+    down: u64,
+    up_per_sec: f64,
+    down_per_sec: f64,
+}
+
+/// Serializable state of one forward, as listed over FFI.
+#[derive(Debug, Clone, Serialize)]
+pub struct ForwardInfo {
+    pub local_port: u16,
+    pub remote_host: String,
+    pub remote_port: u16,
+    pub bytes_up: u64,
+    pub bytes_down: u64,
+    /// Bytes per second since the previous snapshot.
+    pub up_per_sec: f64,
+    pub down_per_sec: f64,
+    pub active_connections: u64,
+    pub total_connections: u64,
+    pub uptime_secs: u64,
+}
+
+impl ForwardStats {
+    pub fn new() -> Self {
+        let now = Instant::now();
+        Self {
+            bytes_up: AtomicU64::new(0),
+            bytes_down: AtomicU64::new(0),
+            active_connections: AtomicU64::new(0),
+            total_connections: AtomicU64::new(0),
+            started: now,
+            rate: Mutex::new(RateSample { at: now, up: 0, down: 0, up_per_sec: 0.0, down_per_sec: 0.0 }),
+        }
+    }
+
+    /// Count a new connection; it is counted as closed when the guard drops.
+    pub fn connection(&self) -> ConnectionGuard<'_> {
+        self.active_connections.fetch_add(1, Ordering::Relaxed);
+        self.total_connections.fetch_add(1, Ordering::Relaxed);
+        ConnectionGuard(self)
+    }
+
+    /// Current counters, with rates averaged since the previous snapshot.
+    pub fn snapshot(&self, local_port: u16, remote_host: &str, remote_port: u16) -> ForwardInfo {
+        let up = self.bytes_up.load(Ordering::Relaxed);
+        let down = self.bytes_down.load(Ordering::Relaxed);
+        let mut rate = self.rate.lock().unwrap();
+        let elapsed = rate.at.elapsed();
+        if elapsed >= RATE_INTERVAL {
+            let secs = elapsed.as_secs_f64();
+            rate.up_per_sec = (up - rate.up) as f64 / secs;
+            rate.down_per_sec = (down - rate.down) as f64 / secs;
+            rate.at = Instant::now();
+            rate.up = up;
+            rate.down = down;
+        }
+        ForwardInfo {
+            local_port,
+            remote_host: remote_host.to_string(),
+            remote_port,
+            bytes_up: up,
+            bytes_down: down,
+            up_per_sec: rate.up_per_sec,
+            down_per_sec: rate.down_per_sec,
+            active_connections: self.active_connections.load(Ordering::Relaxed),
+            total_connections: self.total_connections.load(Ordering::Relaxed),
+            uptime_secs: self.started.elapsed().as_secs(),
+        }
+    }
+}
+
+impl Default for ForwardStats {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Marks a connection as active for as long as it lives.
+pub struct ConnectionGuard<'a>(&'a ForwardStats);
+
+impl Drop for ConnectionGuard<'_> {
+    fn drop(&mut self) {
+        self.0.active_connections.fetch_sub(1, Ordering::Relaxed);
+    }
+}
+
+/// Copy `reader` into `writer` until EOF, then shut `writer` down so the
+/// far side sees the half-close. Returns the bytes copied, which are also
+/// added to `counter` (this forward) and `total` (all forwards) as they go.
+pub async fn pump<R, W>(
+    mut reader: R,
+    mut writer: W,
+    counter: &AtomicU64,
+    total: &Counter,
+) -> std::io::Result<u64>
+where
+    R: AsyncRead + Unpin,
+    W: AsyncWrite + Unpin,
+{
+    let mut buf = vec![0u8; MIN_BUFFER];
+    let mut copied = 0u64;
+    loop {
+        let n = reader.read(&mut buf).await?;
+        if n == 0 {
+            break;
+        }
+        writer.write_all(&buf[..n]).await?;
+        copied += n as u64;
+        counter.fetch_add(n as u64, Ordering::Relaxed);
+        total.add(n as u64);
+        // A full read means more is waiting; read bigger chunks next time.
+        if n == buf.len() && buf.len() < MAX_BUFFER {
+            buf.resize(buf.len() * 2, 0);
+        }
+    }
+    writer.shutdown().await?;
+    Ok(copied)
+}
+
+/// Relay `local` (the accepted TCP socket) and `remote` (the SSH channel)
+/// in both directions until both have closed, either side fails, or
+/// `cancel` turns true.
+pub async fn relay<L, R>(
+    local: L,
+    remote: R,
+    stats: &ForwardStats,
+    mut cancel: watch::Receiver<bool>,
+) -> std::io::Result<()>
+where
+    L: AsyncRead + AsyncWrite + Unpin,
+    R: AsyncRead + AsyncWrite + Unpin,
+{
+    let _connection = stats.connection();
+    let (local_read, local_write) = tokio::io::split(local);
+    let (remote_read, remote_write) = tokio::io::split(remote);
+    let up = pump(local_read, remote_write, &stats.bytes_up, &metrics::global().forward_bytes_up);
+    let down = pump(remote_read, local_write, &stats.bytes_down, &metrics::global().forward_bytes_down);
+
+    tokio::select! {
+        result = async { tokio::try_join!(up, down) } => result.map(|_| ()),
+        _ = async {
+            while !*cancel.borrow() {
+                if cancel.changed().await.is_err() { break; }
+            }
+        } => Ok(()),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[tokio::test]
+    async fn test_relay_full_duplex_and_counters() {
+        let stats = ForwardStats::new();
+        let (_cancel_tx, cancel_rx) = watch::channel(false);
+        let (local, mut client) = tokio::io::duplex(4096);
+        let (remote, mut server) = tokio::io::duplex(4096);
+
+        let payload = vec![7u8; 300 * 1024];
+        let expected = payload.clone();
+        let client_side = async move {
+            // Write the whole request while the response streams back,
+            // which deadlocks if the two directions share one loop.
+            let (mut read, mut write) = tokio::io::split(&mut client);
+            let send = async {
+                write.write_all(&payload).await.unwrap();
+                write.shutdown().await.unwrap();
+            };
+            let mut response = Vec::new();
+            let recv = read.read_to_end(&mut response);
+            let (_, received) = tokio::join!(send, recv);
+            received.unwrap();
+            response
+        };
+        let server_side = async move {
+            let (mut read, mut write) = tokio::io::split(&mut server);
+            let echo = async {
+                let mut request = Vec::new();
+                read.read_to_end(&mut request).await.unwrap();
+                request
+            };
+            let send = async {
+                write.write_all(b"hello").await.unwrap();
+            };
+            let (request, _) = tokio::join!(echo, send);
+            write.shutdown().await.unwrap();
+            request
+        };
+
+        let (relayed, response, request) =
+            tokio::join!(relay(local, remote, &stats, cancel_rx), client_side, server_side);
+        relayed.unwrap();
+        assert_eq!(request, expected);
+        assert_eq!(response, b"hello");
+
+        let info = stats.snapshot(3306, "db", 3306);
+        assert_eq!(info.bytes_up, 300 * 1024);
+        assert_eq!(info.bytes_down, 5);
+        assert_eq!(info.active_connections, 0);
+        assert_eq!(info.total_connections, 1);
+    }
+
+    #[tokio::test]
+    async fn test_relay_cancel() {
+        let stats = ForwardStats::new();
+        let (cancel_tx, cancel_rx) = watch::channel(false);
+        let (local, _client) = tokio::io::duplex(64);
+        let (remote, _server) = tokio::io::duplex(64);
+        let relayed = tokio::spawn(async move { relay(local, remote, &stats, cancel_rx).await });
+        cancel_tx.send(true).unwrap();
+        assert!(relayed.await.unwrap().is_ok());
+    }
+}
@@ -1,3 +1,10 @@
+pub mod dir_cache;
+pub mod exec_slots;
+pub mod exec_stream;
+pub mod follow;
+pub mod forward;
+pub mod monitor;
+pub mod pool;
 pub mod session;
 pub mod sftp;
 pub mod service_detector;
@@ -32,3 +39,8 @@ impl Default for SshConfig {
         }
     }
 }
+
+/// Single-quote `s` for a POSIX shell.
+pub(crate) fn shell_quote(s: &str) -> String {
+    format!("'{}'", s.replace('\'', r"'\''"))
+}
@@ -0,0 +1,465 @@
+//! Remote server monitoring.
+//!
+//! A `ServerMonitor` runs one long-lived sampling loop on the remote host
+//! over a single exec channel instead of spawning `cat /proc/...`, `free`,
+//! `df` and `ps` pipelines every few seconds. The agent is plain POSIX sh:
+//! the fast metrics are read from /proc with the `read` builtin and
+//! `$((...))` arithmetic, so a tick forks nothing but its `sleep`; `df`,
+//! `ps` and `nvidia-smi` run only every `slow_every` ticks. Cumulative
+//! counters (CPU jiffies, interface bytes) are sent as deltas. Rust turns
+//! the stream into fixed-layout `ServerSample`s and JSON detail snapshots.
+
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+
+use serde::Serialize;
+
+use super::exec_stream::{ExecStream, StreamKind, StreamRead};
+use super::shell_quote;
+
+/// Default seconds between samples.
+pub const DEFAULT_INTERVAL_SECS: u32 = 3;
+
+/// Default number of ticks between disk/process/GPU snapshots.
+pub const DEFAULT_SLOW_EVERY: u32 = 5;
+
+/// Processes listed per snapshot, busiest first.
+const TOP_PROCESSES: usize = 10;
+
+/// Longest agent line handled; longer ones (huge command lines) are cut.
+const MAX_LINE_BYTES: usize = 4096;
+
+/// One fast sample, laid out for the FFI.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct ServerSample {
+    /// Remote uptime in seconds, the sample's clock.
+    pub uptime_secs: f64,
+    /// Busy share of all CPUs since the previous sample, 0-100.
+    pub cpu_percent: f64,
+    pub mem_total_mb: f64,
+    /// Total minus available, like `free`'s "used".
+    pub mem_used_mb: f64,
+    pub swap_total_mb: f64,
+    pub swap_used_mb: f64,
+    /// Bytes summed over all interfaces since boot.
+    pub net_rx_bytes: u64,
+    pub net_tx_bytes: u64,
+    /// Bytes per second since the previous sample.
+    pub net_rx_per_sec: f64,
+    pub net_tx_per_sec: f64,
+    pub load_1: f64,
+    pub load_5: f64,
+    pub load_15: f64,
+    pub process_count: u32,
+}
+
+#[derive(Clone, Debug, Default, PartialEq, Serialize)]
+pub struct DiskUsage {
+    pub filesystem: String,
+    /// df -h style sizes ("20G", "512M").
+    pub size: String,
+    pub used: String,
+    pub available: String,
+    pub usage_percent: f64,
+    pub mountpoint: String,
+}
+
+#[derive(Clone, Debug, Default, PartialEq, Serialize)]
+pub struct ProcessUsage {
+    pub user: String,
+    pub pid: String,
+    pub cpu: f64,
+    pub memory: f64,
+    pub command: String,
+}
+
+/// nvidia-smi fields, as reported (no units).
+#[derive(Clone, Debug, Default, PartialEq, Serialize)]
+pub struct GpuUsage {
+    pub name: String,
+    pub temperature: String,
+    pub utilization: String,
+    pub memory_used: String,
+    pub memory_total: String,
+    pub fan_speed: String,
+}
+
+/// The slow-changing part of the monitor, sent every `slow_every` ticks.
+#[derive(Clone, Debug, Default, PartialEq, Serialize)]
+pub struct ServerDetails {
+    pub hostname: String,
+    pub kernel: String,
+    pub disks: Vec<DiskUsage>,
+    pub processes: Vec<ProcessUsage>,
+    /// Empty when the host has no NVIDIA GPU (or no nvidia-smi).
+    pub gpus: Vec<GpuUsage>,
+}
+
+/// Something the agent reported.
+#[derive(Clone, Debug, PartialEq)]
+pub enum MonitorEvent {
+    Sample(ServerSample),
+    Details(ServerDetails),
+}
+
+/// Remote command running the sampling loop under `sh`, whatever the
+/// login shell. The loop exits once its output can't be written (the
+/// channel closed, so `printf` gets SIGPIPE or fails).
+pub fn agent_command(interval_secs: u32, slow_every: u32) -> String {
+    format!("sh -c {}", shell_quote(&agent_script(interval_secs, slow_every)))
+}
+
+fn agent_script(interval_secs: u32, slow_every: u32) -> String {
+    format!(
+        r#"export LC_ALL=C
+read -r h < /proc/sys/kernel/hostname; read -r k < /proc/sys/kernel/osrelease
+printf 'H\t%s\t%s\n' "$h" "$k" || exit
+n=0; pt=0; pi=0; prx=0; ptx=0
+while :; do
+  read -r _ u ni sy id io ir si st _ < /proc/stat
+  t=$((u+ni+sy+id+io+ir+si+st)); i=$((id+io))
+  rx=0; tx=0
+  while IFS=: read -r _ rest; do
+    [ -n "$rest" ] || continue
+    set -- $rest; rx=$((rx+$1)); tx=$((tx+$9))
+  done < /proc/net/dev
+  mt=0; ma=; mf=0; mb=0; mc=0; wt=0; wf=0
+  while read -r key val _; do
+    case $key in
+      MemTotal:) mt=$val;; MemAvailable:) ma=$val;; MemFree:) mf=$val;;
+      Buffers:) mb=$val;; Cached:) mc=$val;; SwapTotal:) wt=$val;; SwapFree:) wf=$val;;
+    esac
+  done < /proc/meminfo
+  [ -n "$ma" ] || ma=$((mf+mb+mc))
+  read -r l1 l5 l15 procs _ < /proc/loadavg
+  read -r up _ < /proc/uptime
+  printf 'S %s %s %s %s %s %s %s %s %s %s %s %s %s\n' "$up" $((t-pt)) $((i-pi)) $((rx-prx)) $((tx-ptx)) \
+    "$mt" "$ma" "$wt" "$wf" "$l1" "$l5" "$l15" "${{procs#*/}}" || exit
+  pt=$t; pi=$i; prx=$rx; ptx=$tx
+  if [ $((n % {slow})) -eq 0 ]; then
+    printf '#D\n'; df -P -k 2>/dev/null
+    printf '#P\n'; ps -eo user=,pid=,pcpu=,pmem=,args= --sort=-pcpu 2>/dev/null | head -n {top} | cut -c 1-512
+    printf '#G\n'; command -v nvidia-smi >/dev/null 2>&1 && nvidia-smi --query-gpu=name,temperature.gpu,utilization.gpu,memory.used,memory.total,fan.speed --format=csv,noheader,nounits 2>/dev/null
+    printf '#E\n' || exit
+  fi
+  n=$((n+1))
+  sleep {interval}
+done
+"#,
+        slow = slow_every.max(1),
+        top = TOP_PROCESSES,
+        interval = interval_secs.max(1),
+    )
+}
+
+#[derive(Clone, Copy, PartialEq)]
+enum Section {
+    None,
+    Disks,
+    Processes,
+    Gpus,
+}
+
+/// Turns agent lines into events, undoing the delta encoding.
+pub struct MonitorParser {
+    rx_total: u64,
+    tx_total: u64,
+    /// Uptime of the previous sample; rates need two samples.
+    last_uptime: Option<f64>,
+    section: Section,
+    details: ServerDetails,
+}
+
+impl Default for MonitorParser {
+    fn default() -> Self {
+        Self { rx_total: 0, tx_total: 0, last_uptime: None, section: Section::None, details: ServerDetails::default() }
+    }
+}
+
+impl MonitorParser {
+    /// Parse one line; returns an event when a sample or a detail block is
+    /// complete.
+    pub fn feed(&mut self, line: &str) -> Option<MonitorEvent> {
+        if let Some(marker) = line.strip_prefix('#') {
+            match marker {
+                "D" => {
+                    self.section = Section::Disks;
+                    self.details.disks.clear();
+                    self.details.processes.clear();
+                    self.details.gpus.clear();
+                }
+                "P" => self.section = Section::Processes,
+                "G" => self.section = Section::Gpus,
+                "E" => {
+                    self.section = Section::None;
+                    return Some(MonitorEvent::Details(self.details.clone()));
+                }
+                _ => {}
+            }
+            return None;
+        }
+        match self.section {
+            Section::Disks => self.details.disks.extend(parse_disk(line)),
+            Section::Processes => self.details.processes.extend(parse_process(line)),
+            Section::Gpus => self.details.gpus.extend(parse_gpu(line)),
+            Section::None => {
+                if let Some(rest) = line.strip_prefix("H\t") {
+                    let (hostname, kernel) = rest.split_once('\t').unwrap_or((rest, ""));
+                    self.details.hostname = hostname.to_string();
+                    self.details.kernel = kernel.to_string();
+                } else if let Some(rest) = line.strip_prefix("S ") {
+                    return self.parse_sample(rest).map(MonitorEvent::Sample);
+                }
+            }
+        }
+        None
+    }
+
+    fn parse_sample(&mut self, rest: &str) -> Option<ServerSample> {
+        let f: Vec<&str> = rest.split_whitespace().collect();
+        if f.len() < 13 {
+            return None;
+        }
+        let int = |i: usize| f[i].parse::<i64>().unwrap_or(0);
+        let float = |i: usize| f[i].parse::<f64>().unwrap_or(0.0);
+        let kb_to_mb = |kb: i64| kb as f64 / 1024.0;
+
+        let uptime = float(0);
+        let (cpu_total, cpu_idle) = (int(1), int(2));
+        // Counters can only go back when an interface disappears.
+        let (rx_delta, tx_delta) = (int(3).max(0) as u64, int(4).max(0) as u64);
+        self.rx_total += rx_delta;
+        self.tx_total += tx_delta;
+
+        let first = self.last_uptime.is_none();
+        let elapsed = self.last_uptime.map_or(0.0, |last| uptime - last);
+        self.last_uptime = Some(uptime);
+        let rate = |delta: u64| if elapsed > 0.0 { delta as f64 / elapsed } else { 0.0 };
+        // The first sample's deltas are the totals since boot.
+        let cpu_percent = if !first && cpu_total > 0 {
+            (cpu_total - cpu_idle).max(0) as f64 * 100.0 / cpu_total as f64
+        } else {
+            0.0
+        };
+
+        let (mem_total, mem_available, swap_total, swap_free) = (int(5), int(6), int(7), int(8));
+        Some(ServerSample {
+            uptime_secs: uptime,
+            cpu_percent,
+            mem_total_mb: kb_to_mb(mem_total),
+            mem_used_mb: kb_to_mb((mem_total - mem_available).max(0)),
+            swap_total_mb: kb_to_mb(swap_total),
+            swap_used_mb: kb_to_mb((swap_total - swap_free).max(0)),
+            net_rx_bytes: self.rx_total,
+            net_tx_bytes: self.tx_total,
+            net_rx_per_sec: rate(rx_delta),
+            net_tx_per_sec: rate(tx_delta),
+            load_1: float(9),
+            load_5: float(10),
+            load_15: float(11),
+            process_count: f[12].parse().unwrap_or(0),
+        })
+    }
+}
+
+/// A `df -P -k` row for a real device (source starting with '/').
+fn parse_disk(line: &str) -> Option<DiskUsage> {
+    let f: Vec<&str> = line.split_whitespace().collect();
+    if f.len() < 6 || !f[0].starts_with('/') {
+        return None;
+    }
+    let kb = |s: &str| s.parse::<u64>().ok();
+    Some(DiskUsage {
+        filesystem: f[0].to_string(),
+        size: human_kb(kb(f[1])?),
+        used: human_kb(kb(f[2])?),
+        available: human_kb(kb(f[3])?),
+        usage_percent: f[4].trim_end_matches('%').parse().unwrap_or(0.0),
+        // Mount points may contain spaces.
+        mountpoint: f[5..].join(" "),
+    })
+}
+
+/// A `ps -eo user=,pid=,pcpu=,pmem=,args=` row.
+fn parse_process(line: &str) -> Option<ProcessUsage> {
+    let mut f = line.split_whitespace();
+    let (user, pid, cpu, memory) = (f.next()?, f.next()?, f.next()?, f.next()?);
+    let command = f.collect::<Vec<_>>().join(" ");
+    if command.is_empty() {
+        return None;
+    }
+    Some(ProcessUsage {
+        user: user.to_string(),
+        pid: pid.to_string(),
+        cpu: cpu.parse().unwrap_or(0.0),
+        memory: memory.parse().unwrap_or(0.0),
+        command,
+    })
+}
+
+/// An `nvidia-smi --format=csv,noheader,nounits` row.
+fn parse_gpu(line: &str) -> Option<GpuUsage> {
+    let f: Vec<&str> = line.split(',').map(str::trim).collect();
+    if f.len() < 5 {
+        return None;
+    }
+    Some(GpuUsage {
+        name: f[0].to_string(),
+        temperature: f[1].to_string(),
+        utilization: f[2].to_string(),
+        memory_used: f[3].to_string(),
+        memory_total: f[4].to_string(),
+        fan_speed: f.get(5).map_or("N/A", |s| s).to_string(),
+    })
+}
+
+/// Format KiB like `df -h`: powers of 1024, one decimal below 10.
+fn human_kb(kb: u64) -> String {
+    const UNITS: [&str; 5] = ["K", "M", "G", "T", "P"];
+    let mut value = kb as f64;
+    let mut unit = 0;
+    while value >= 1024.0 && unit + 1 < UNITS.len() {
+        value /= 1024.0;
+        unit += 1;
+    }
+    if value < 10.0 && unit > 0 {
+        format!("{:.1}{}", value, UNITS[unit])
+    } else {
+        format!("{:.0}{}", value, UNITS[unit])
+    }
+}
+
+/// A running remote monitor. Dropping it stops the agent and waits for
+/// the reader thread, after which no further callbacks are made.
+pub struct ServerMonitor {
+    stop: Arc<AtomicBool>,
+    thread: Option<std::thread::JoinHandle<()>>,
+}
+
+impl ServerMonitor {
+    /// Parse `stream` (running `agent_script`) on a background thread,
+    /// passing each event to `on_event`; `None` means the agent exited.
+    pub fn start<F>(stream: ExecStream, mut on_event: F) -> Self
+    where
+        F: FnMut(Option<MonitorEvent>) + Send + 'static,
+    {
+        let stop = Arc::new(AtomicBool::new(false));
+        let thread_stop = Arc::clone(&stop);
+        let thread = std::thread::Builder::new()
+            .name("pier-server-monitor".into())
+            .spawn(move || {
+                let mut parser = MonitorParser::default();
+                let mut partial: Vec<u8> = Vec::new();
+                let mut buf = vec![0u8; 16 * 1024];
+                while !thread_stop.load(Ordering::Relaxed) {
+                    match stream.read(&mut buf, Duration::from_millis(200)) {
+                        // The agent silences its tools; stray stderr is noise.
+                        StreamRead::Data(StreamKind::Stderr, _) => {}
+                        StreamRead::Data(StreamKind::Stdout, n) => {
+                            for chunk in buf[..n].split_inclusive(|&b| b == b'\n') {
+                                let room = MAX_LINE_BYTES.saturating_sub(partial.len());
+                                let complete = chunk.last() == Some(&b'\n');
+                                let body = if complete { &chunk[..chunk.len() - 1] } else { chunk };
+                                partial.extend_from_slice(&body[..body.len().min(room)]);
+                                if complete {
+                                    let line = String::from_utf8_lossy(&partial).into_owned();
+                                    partial.clear();
+                                    if let Some(event) = parser.feed(line.trim_end_matches('\r')) {
+                                        on_event(Some(event));
+                                    }
+                                }
+                            }
+                        }
+                        StreamRead::TimedOut => {}
+                        StreamRead::Finished => {
+                            on_event(None);
+                            break;
+                        }
+                    }
+                }
+            })
+            .ok();
+
+        Self { stop, thread }
+    }
+}
+
+impl Drop for ServerMonitor {
+    fn drop(&mut self) {
+        self.stop.store(true, Ordering::Relaxed);
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_parse_samples_and_deltas() {
+        let mut parser = MonitorParser::default();
+        assert_eq!(parser.feed("H\tweb-1\t6.1.0-18-amd64"), None);
+
+        let first = match parser.feed("S 1000.00 400000 300000 5000 2000 8192000 6144000 1024000 1024000 0.52 0.41 0.38 456") {
+            Some(MonitorEvent::Sample(s)) => s,
+            other => panic!("{:?}", other),
+        };
+        assert_eq!(first.cpu_percent, 0.0, "no CPU share from the totals since boot");
+        assert_eq!(first.mem_total_mb, 8000.0);
+        assert_eq!(first.mem_used_mb, 2000.0);
+        assert_eq!(first.swap_used_mb, 0.0);
+        assert_eq!((first.net_rx_bytes, first.net_rx_per_sec), (5000, 0.0));
+        assert_eq!(first.process_count, 456);
+
+        let second = match parser.feed("S 1003.00 300 75 3000 600 8192000 6144000 1024000 512000 0.60 0.42 0.38 460") {
+            Some(MonitorEvent::Sample(s)) => s,
+            other => panic!("{:?}", other),
+        };
+        assert_eq!(second.cpu_percent, 75.0);
+        assert_eq!(second.net_rx_bytes, 8000);
+        assert_eq!(second.net_rx_per_sec, 1000.0);
+        assert_eq!(second.net_tx_per_sec, 200.0);
+        assert_eq!(second.swap_used_mb, 500.0);
+        assert_eq!(parser.feed("S garbage"), None);
+    }
+
+    #[test]
+    fn test_parse_details_block() {
+        let mut parser = MonitorParser::default();
+        parser.feed("H\tdb-2\t5.15.0");
+        let lines = [
+            "#D",
+            "Filesystem     1024-blocks     Used Available Capacity Mounted on",
+            "tmpfs              1632404     1244   1631160       1% /run",
+            "/dev/sda1        497944404 52428800 420000000      12% /",
+            "/dev/sdb1          9437184  4718592   4718592      50% /mnt/backup disk",
+            "#P",
+            "postgres     812 12.5  3.1 postgres: checkpointer",
+            "root           1  0.0  0.1 /sbin/init splash",
+            "#G",
+            "NVIDIA A10, 41, 7, 1024, 23028, [N/A]",
+        ];
+        for line in lines {
+            assert_eq!(parser.feed(line), None);
+        }
+        let details = match parser.feed("#E") {
+            Some(MonitorEvent::Details(d)) => d,
+            other => panic!("{:?}", other),
+        };
+        assert_eq!(details.hostname, "db-2");
+        assert_eq!(details.disks.len(), 2);
+        assert_eq!(details.disks[0].size, "475G");
+        assert_eq!(details.disks[0].used, "50G");
+        assert_eq!(details.disks[1].size, "9.0G");
+        assert_eq!(details.disks[1].mountpoint, "/mnt/backup disk");
+        assert_eq!(details.processes[0].command, "postgres: checkpointer");
+        assert_eq!(details.processes[0].cpu, 12.5);
+        assert_eq!(details.gpus[0].memory_total, "23028");
+        assert_eq!(details.gpus[0].fan_speed, "[N/A]");
+        assert!(agent_command(3, 5).starts_with("sh -c '"));
+    }
+}
@@ -0,0 +1,156 @@
+//! Connection sharing.
+//!
+//! Sessions opened with the same (host, port, user, auth) share one
+//! transport, so a new panel on a server that's already connected costs a
+//! channel open instead of a TCP connect, key exchange and authentication.
+//! The pool only holds weak references: a transport lives as long as some
+//! session uses it. Accepted host keys are remembered for the life of the
+//! process, so reconnects after a network change skip the known_hosts
+//! lookup but still reject a changed key.
+
+use std::collections::hash_map::DefaultHasher;
+use std::collections::HashMap;
+use std::hash::{Hash, Hasher};
+use std::sync::{Arc, Mutex, Weak};
+
+use super::{SshAuth, SshConfig};
+
+/// What makes two configs interchangeable.
+#[derive(Clone, Debug, PartialEq, Eq, Hash)]
+pub struct PoolKey {
+    host: String,
+    port: u16,
+    username: String,
+    auth: AuthId,
+}
+
+/// Identifies credentials without keeping secrets in the key.
+#[derive(Clone, Debug, PartialEq, Eq, Hash)]
+enum AuthId {
+    Password(u64),
+    KeyFile(String, u64),
+    Agent,
+}
+
+fn secret_hash<T: Hash>(secret: &T) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    secret.hash(&mut hasher);
+    hasher.finish()
+}
+
+impl PoolKey {
+    pub fn of(config: &SshConfig) -> Self {
+        let auth = match &config.auth {
+            SshAuth::Password(password) => AuthId::Password(secret_hash(password)),
+            SshAuth::KeyFile { path, passphrase } => AuthId::KeyFile(path.clone(), secret_hash(passphrase)),
+            SshAuth::Agent => AuthId::Agent,
+        };
+        Self { host: config.host.clone(), port: config.port, username: config.username.clone(), auth }
+    }
+}
+
+/// Live transports by key.
+pub struct Pool<T> {
+    entries: Mutex<HashMap<PoolKey, Weak<T>>>,
+}
+
+impl<T> Default for Pool<T> {
+    fn default() -> Self {
+        Self { entries: Mutex::new(HashMap::new()) }
+    }
+}
+
+impl<T> Pool<T> {
+    /// The transport for `key`, if one is still in use.
+    pub fn get(&self, key: &PoolKey) -> Option<Arc<T>> {
+        let mut entries = self.entries.lock().unwrap();
+        entries.retain(|_, weak| weak.strong_count() > 0);
+        entries.get(key).and_then(Weak::upgrade)
+    }
+
+    /// Share `transport` under `key`, replacing any previous one.
+    pub fn insert(&self, key: PoolKey, transport: &Arc<T>) {
+        self.entries.lock().unwrap().insert(key, Arc::downgrade(transport));
+    }
+}
+
+/// Result of checking a server key against the remembered ones.
+#[derive(Debug, PartialEq)]
+pub enum HostKeyCheck {
+    Match,
+    Mismatch,
+    Unknown,
+}
+
+/// Host keys accepted during this process, by (host, port).
+pub struct HostKeyCache<K> {
+    keys: Mutex<HashMap<(String, u16), K>>,
+}
+
+impl<K> Default for HostKeyCache<K> {
+    fn default() -> Self {
+        Self { keys: Mutex::new(HashMap::new()) }
+    }
+}
+
+impl<K: PartialEq + Clone> HostKeyCache<K> {
+    pub fn check(&self, host: &str, port: u16, key: &K) -> HostKeyCheck {
+        match self.keys.lock().unwrap().get(&(host.to_string(), port)) {
+            Some(known) if known == key => HostKeyCheck::Match,
+            Some(_) => HostKeyCheck::Mismatch,
+            None => HostKeyCheck::Unknown,
+        }
+    }
+
+    pub fn remember(&self, host: &str, port: u16, key: &K) {
+        self.keys.lock().unwrap().insert((host.to_string(), port), key.clone());
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn config(auth: SshAuth) -> SshConfig {
+        SshConfig { host: "db".into(), port: 22, username: "deploy".into(), auth }
+    }
+
+    #[test]
+    fn test_pool_shares_while_in_use() {
+        let pool: Pool<String> = Pool::default();
+        let key = PoolKey::of(&config(SshAuth::Password("secret".into())));
+        let transport = Arc::new("transport".to_string());
+        pool.insert(key.clone(), &transport);
+
+        let shared = pool.get(&key).expect("live transport is shared");
+        assert!(Arc::ptr_eq(&shared, &transport));
+        assert!(pool.get(&PoolKey::of(&config(SshAuth::Password("other".into())))).is_none());
+        assert!(pool.get(&PoolKey::of(&config(SshAuth::Agent))).is_none());
+
+        // A key file only matches with the same passphrase.
+        let key_file = |passphrase: Option<&str>| {
+            PoolKey::of(&config(SshAuth::KeyFile {
+                path: "~/.ssh/id_ed25519".into(),
+                passphrase: passphrase.map(String::from),
+            }))
+        };
+        pool.insert(key_file(Some("right")), &transport);
+        assert!(pool.get(&key_file(Some("right"))).is_some());
+        assert!(pool.get(&key_file(Some("wrong"))).is_none());
+        assert!(pool.get(&key_file(None)).is_none());
+
+        drop(shared);
+        drop(transport);
+        assert!(pool.get(&key).is_none(), "nothing left to share");
+    }
+
+    #[test]
+    fn test_host_key_cache() {
+        let cache: HostKeyCache<Vec<u8>> = HostKeyCache::default();
+        assert_eq!(cache.check("db", 22, &vec![1]), HostKeyCheck::Unknown);
+        cache.remember("db", 22, &vec![1]);
+        assert_eq!(cache.check("db", 22, &vec![1]), HostKeyCheck::Match);
+        assert_eq!(cache.check("db", 22, &vec![2]), HostKeyCheck::Mismatch);
+        assert_eq!(cache.check("db", 2222, &vec![2]), HostKeyCheck::Unknown);
+    }
+}
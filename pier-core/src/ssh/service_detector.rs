@@ -1,9 +1,12 @@
 //! Service detection over SSH.
 //!
-//! Probes a remote server for installed services (MySQL, Redis, Docker, PostgreSQL)
-//! by executing lightweight detection commands via SSH exec.
+//! Probes a remote server for installed services in a single round trip:
+//! the `DETECTORS` registry is compiled into one POSIX shell script, run as
+//! one exec, and the script prints one tab-separated line per service it
+//! finds. Supporting another service means adding a registry entry.
 
 use super::session::SshSession;
+use super::shell_quote;
 use serde::{Deserialize, Serialize};
 
 /// Status of a detected service.
@@ -24,137 +27,192 @@ pub struct DetectedService {
     pub port: u16,
 }
 
-/// Detect all known services on the remote server.
-pub async fn detect_all(session: &SshSession) -> Vec<DetectedService> {
-    let mut services = Vec::new();
-
-    // Run all detections concurrently
-    let (mysql, redis, postgres, docker) = tokio::join!(
-        detect_mysql(session),
-        detect_redis(session),
-        detect_postgresql(session),
-        detect_docker(session),
-    );
-
-    if let Some(s) = mysql { services.push(s); }
-    if let Some(s) = redis { services.push(s); }
-    if let Some(s) = postgres { services.push(s); }
-    if let Some(s) = docker { services.push(s); }
-
-    log::info!("Detected {} services on remote server", services.len());
-    services
+/// How to recognise one service. It counts as installed when any of
+/// `binaries` is found, and as running when `probe` succeeds, any of
+/// `units` is active, or a process named like one of `processes` exists.
+pub struct Detector {
+    pub name: &'static str,
+    /// Names looked up on `PATH`, or absolute paths.
+    pub binaries: &'static [&'static str],
+    /// Prints the version (stdout or stderr); may be empty.
+    pub version: &'static str,
+    /// Exits 0 when the service answers; may be empty.
+    pub probe: &'static str,
+    /// systemd units.
+    pub units: &'static [&'static str],
+    /// Exact process names, for hosts without systemd.
+    pub processes: &'static [&'static str],
+    /// Default port to tunnel; 0 if there is none.
+    pub port: u16,
 }
 
-/// Detect MySQL/MariaDB
-async fn detect_mysql(session: &SshSession) -> Option<DetectedService> {
-    // Check if mysql or mysqld exists
-    let (code, _) = session.exec_command("which mysql 2>/dev/null || which mysqld 2>/dev/null").await.ok()?;
-    if code != 0 { return None; }
-
-    // Get version
-    let (_, version_out) = session.exec_command("mysql --version 2>/dev/null").await.unwrap_or((-1, String::new()));
-    let version = parse_version(&version_out, "mysql");
-
-    // Check if running
-    let status = check_service_status(session, &[
-        "systemctl is-active mysql 2>/dev/null || systemctl is-active mysqld 2>/dev/null || systemctl is-active mariadb 2>/dev/null",
-        "pgrep -x mysqld >/dev/null 2>&1 && echo active",
-    ]).await;
-
-    Some(DetectedService {
-        name: "mysql".to_string(),
-        version,
-        status,
+/// Services probed by `detect_all`.
+pub const DETECTORS: &[Detector] = &[
+    Detector {
+        name: "mysql",
+        binaries: &["mysql", "mysqld"],
+        version: "mysql --version",
+        probe: "",
+        units: &["mysql", "mysqld", "mariadb"],
+        processes: &["mysqld", "mariadbd"],
         port: 3306,
-    })
-}
-
-/// Detect Redis
-async fn detect_redis(session: &SshSession) -> Option<DetectedService> {
-    let (code, _) = session.exec_command("which redis-server 2>/dev/null || which redis-cli 2>/dev/null").await.ok()?;
-    if code != 0 { return None; }
-
-    let (_, version_out) = session.exec_command("redis-cli --version 2>/dev/null").await.unwrap_or((-1, String::new()));
-    let version = parse_version(&version_out, "redis");
-
-    // Try ping — if it responds, redis is running
-    let (ping_code, ping_out) = session.exec_command("redis-cli ping 2>/dev/null").await.unwrap_or((-1, String::new()));
-    let status = if ping_code == 0 && ping_out.contains("PONG") {
-        ServiceStatus::Running
-    } else {
-        // Check systemctl / pgrep
-        check_service_status(session, &[
-            "systemctl is-active redis 2>/dev/null || systemctl is-active redis-server 2>/dev/null",
-            "pgrep -x redis-server >/dev/null 2>&1 && echo active",
-        ]).await
-    };
-
-    Some(DetectedService {
-        name: "redis".to_string(),
-        version,
-        status,
+    },
+    Detector {
+        name: "redis",
+        binaries: &["redis-server", "redis-cli"],
+        version: "redis-cli --version",
+        probe: "redis-cli ping | grep -q PONG",
+        units: &["redis", "redis-server"],
+        processes: &["redis-server"],
         port: 6379,
-    })
-}
-
-/// Detect PostgreSQL
-async fn detect_postgresql(session: &SshSession) -> Option<DetectedService> {
-    let (code, _) = session.exec_command("which psql 2>/dev/null").await.ok()?;
-    if code != 0 { return None; }
-
-    let (_, version_out) = session.exec_command("psql --version 2>/dev/null").await.unwrap_or((-1, String::new()));
-    let version = parse_version(&version_out, "psql");
-
-    let status = check_service_status(session, &[
-        "systemctl is-active postgresql 2>/dev/null",
-        "pgrep -x postgres >/dev/null 2>&1 && echo active",
-    ]).await;
-
-    Some(DetectedService {
-        name: "postgresql".to_string(),
-        version,
-        status,
+    },
+    Detector {
+        name: "postgresql",
+        binaries: &["psql"],
+        version: "psql --version",
+        probe: "",
+        units: &["postgresql"],
+        processes: &["postgres"],
         port: 5432,
-    })
+    },
+    Detector {
+        name: "docker",
+        binaries: &["docker"],
+        version: "docker --version",
+        // Succeeds only if the daemon is running.
+        probe: "docker info",
+        units: &["docker"],
+        processes: &[],
+        port: 0, // Docker doesn't use a specific tunnel port
+    },
+    Detector {
+        name: "nginx",
+        binaries: &["nginx", "/usr/sbin/nginx"],
+        version: "nginx -v",
+        probe: "",
+        units: &["nginx"],
+        processes: &["nginx"],
+        port: 80,
+    },
+    Detector {
+        name: "mongodb",
+        binaries: &["mongod", "mongosh", "mongo"],
+        version: "mongod --version || mongosh --version",
+        probe: "",
+        units: &["mongod", "mongodb"],
+        processes: &["mongod"],
+        port: 27017,
+    },
+    Detector {
+        name: "kafka",
+        binaries: &["kafka-server-start.sh", "kafka-server-start", "/opt/kafka/bin/kafka-server-start.sh"],
+        // `kafka-topics.sh --version` starts a JVM; too slow for a probe.
+        version: "",
+        // The bracket keeps the pattern from matching the command lines
+        // of this probe and of the script it runs in.
+        probe: r"pgrep -f '[k]afka\.Kafka'",
+        units: &["kafka", "confluent-kafka"],
+        processes: &[],
+        port: 9092,
+    },
+];
+
+/// Marks report lines, so login banners and stray output are ignored.
+const REPORT_TAG: &str = "PIER_SVC";
+
+/// Bounds each probe when coreutils `timeout` exists, so a hung daemon
+/// (e.g. `docker info`) can't stall the whole report.
+const PRELUDE: &str = r#"if command -v timeout >/dev/null 2>&1; then t() { timeout 5 "$@"; }; else t() { "$@"; }; fi
+"#;
+
+/// Detect all known services on the remote server.
+pub async fn detect_all(session: &SshSession) -> Vec<DetectedService> {
+    detect_with(session, DETECTORS).await
 }
 
-/// Detect Docker
-async fn detect_docker(session: &SshSession) -> Option<DetectedService> {
-    let (code, _) = session.exec_command("which docker 2>/dev/null").await.ok()?;
-    if code != 0 { return None; }
-
-    let (_, version_out) = session.exec_command("docker --version 2>/dev/null").await.unwrap_or((-1, String::new()));
-    let version = parse_version(&version_out, "docker");
-
-    // docker info succeeds only if daemon is running
-    let (info_code, _) = session.exec_command("docker info >/dev/null 2>&1").await.unwrap_or((-1, String::new()));
-    let status = if info_code == 0 {
-        ServiceStatus::Running
-    } else {
-        check_service_status(session, &[
-            "systemctl is-active docker 2>/dev/null",
-        ]).await
+/// Detect the given services with one remote exec.
+pub async fn detect_with(session: &SshSession, detectors: &[Detector]) -> Vec<DetectedService> {
+    let command = format!("sh -c {}", shell_quote(&probe_script(detectors)));
+    let services = match session.exec_command(&command).await {
+        Ok((_, output)) => parse_report(&output, detectors),
+        Err(e) => {
+            log::warn!("Service detection failed: {}", e);
+            Vec::new()
+        }
     };
 
-    Some(DetectedService {
-        name: "docker".to_string(),
-        version,
-        status,
-        port: 0, // Docker doesn't use a specific tunnel port
-    })
+    log::info!("Detected {} services on remote server", services.len());
+    services
 }
 
-/// Check if a service is running via multiple fallback commands.
-async fn check_service_status(session: &SshSession, commands: &[&str]) -> ServiceStatus {
-    for cmd in commands {
-        if let Ok((code, output)) = session.exec_command(cmd).await {
-            if code == 0 && output.contains("active") {
-                return ServiceStatus::Running;
-            }
+/// Build the probe script for `detectors`. For each installed service it
+/// prints `PIER_SVC<TAB>name<TAB>running|stopped<TAB>first version line`.
+pub fn probe_script(detectors: &[Detector]) -> String {
+    let mut script = String::from(PRELUDE);
+    for d in detectors {
+        let lookup: Vec<String> = d
+            .binaries
+            .iter()
+            .map(|b| format!("command -v {} 2>/dev/null", shell_quote(b)))
+            .collect();
+        script.push_str(&format!("b=$({})\nif [ -n \"$b\" ]; then\n", lookup.join(" || ")));
+
+        if d.version.is_empty() {
+            script.push_str("  v=\n");
+        } else {
+            script.push_str(&format!("  v=$(t sh -c {} 2>&1 | head -n 1)\n", shell_quote(d.version)));
+        }
+        script.push_str("  s=stopped\n");
+        if !d.probe.is_empty() {
+            script.push_str(&format!("  t sh -c {} >/dev/null 2>&1 && s=running\n", shell_quote(d.probe)));
+        }
+        if !d.units.is_empty() {
+            // is-active succeeds if any of the units is active.
+            let units: Vec<String> = d.units.iter().map(|u| shell_quote(u)).collect();
+            script.push_str(&format!(
+                "  [ $s = stopped ] && systemctl is-active --quiet {} 2>/dev/null && s=running\n",
+                units.join(" ")
+            ));
+        }
+        for process in d.processes {
+            script.push_str(&format!(
+                "  [ $s = stopped ] && pgrep -x {} >/dev/null 2>&1 && s=running\n",
+                shell_quote(process)
+            ));
         }
+        script.push_str(&format!(
+            "  printf '{}\\t%s\\t%s\\t%s\\n' {} \"$s\" \"$v\"\nfi\n",
+            REPORT_TAG,
+            shell_quote(d.name)
+        ));
     }
-    // Service binary exists but isn't running
-    ServiceStatus::Stopped
+    script
+}
+
+/// Parse the output of `probe_script`. Untagged lines and services missing
+/// from `detectors` are skipped.
+pub fn parse_report(output: &str, detectors: &[Detector]) -> Vec<DetectedService> {
+    output
+        .lines()
+        .filter_map(|line| {
+            let mut fields = line.trim_end_matches('\r').splitn(4, '\t');
+            if fields.next() != Some(REPORT_TAG) {
+                return None;
+            }
+            let name = fields.next()?;
+            let detector = detectors.iter().find(|d| d.name == name)?;
+            let status = match fields.next()? {
+                "running" => ServiceStatus::Running,
+                _ => ServiceStatus::Stopped,
+            };
+            Some(DetectedService {
+                name: name.to_string(),
+                version: parse_version(fields.next().unwrap_or(""), name),
+                status,
+                port: detector.port,
+            })
+        })
+        .collect()
 }
 
 /// Extract version string from command output.
@@ -164,10 +222,16 @@ fn parse_version(output: &str, _tool: &str) -> String {
     // - "redis-cli 7.0.11"
     // - "psql (PostgreSQL) 15.4"
     // - "Docker version 24.0.5, ..."
+    // - "nginx version: nginx/1.24.0"
+    // - "db version v7.0.2"
 
     // Try to extract a version-like pattern (digits.digits.digits)
-    for word in output.split_whitespace() {
+    for word in output.split(|c: char| c.is_whitespace() || c == '/') {
         let trimmed = word.trim_end_matches(',').trim_end_matches(';');
+        let trimmed = match trimmed.strip_prefix('v') {
+            Some(rest) if rest.starts_with(|c: char| c.is_ascii_digit()) => rest,
+            _ => trimmed,
+        };
         if trimmed.chars().next().map_or(false, |c| c.is_ascii_digit())
             && trimmed.contains('.')
         {
@@ -207,6 +271,63 @@ mod tests {
         assert_eq!(parse_version(output, "psql"), "15.4");
     }
 
+    #[test]
+    fn test_parse_version_nginx_and_mongo() {
+        assert_eq!(parse_version("nginx version: nginx/1.24.0", "nginx"), "1.24.0");
+        assert_eq!(parse_version("db version v7.0.2", "mongod"), "7.0.2");
+        assert_eq!(parse_version("", "kafka"), "unknown");
+    }
+
+    #[test]
+    fn test_probe_script_and_report() {
+        let script = probe_script(DETECTORS);
+        for d in DETECTORS {
+            assert!(script.contains(&format!("printf 'PIER_SVC\\t%s\\t%s\\t%s\\n' '{}'", d.name)));
+        }
+        assert!(script.contains("systemctl is-active --quiet 'mysql' 'mysqld' 'mariadb'"));
+
+        let output = "Welcome to Ubuntu\n\
+                      PIER_SVC\tmysql\tstopped\tmysql  Ver 8.0.35 Distrib 8.0.35\n\
+                      PIER_SVC\tredis\trunning\tredis-cli 7.0.11\r\n\
+                      PIER_SVC\tunknown\trunning\t1.0\n\
+                      PIER_SVC\tkafka\trunning\t\n";
+        let services = parse_report(output, DETECTORS);
+        let summary: Vec<(&str, &str, ServiceStatus, u16)> = services
+            .iter()
+            .map(|s| (s.name.as_str(), s.version.as_str(), s.status.clone(), s.port))
+            .collect();
+        assert_eq!(summary, vec![
+            ("mysql", "8.0.35", ServiceStatus::Stopped, 3306),
+            ("redis", "7.0.11", ServiceStatus::Running, 6379),
+            ("kafka", "unknown", ServiceStatus::Running, 9092),
+        ]);
+    }
+
+    #[test]
+    fn test_pgrep_probes_dont_match_themselves() {
+        use std::io::Write;
+        use std::process::{Command, Stdio};
+
+        // Every command line `pgrep -f` will see while the probe runs.
+        let script = probe_script(DETECTORS);
+        let command = format!("sh -c {}", shell_quote(&script));
+        for d in DETECTORS {
+            let Some(pattern) = d.probe.strip_prefix("pgrep -f ") else { continue };
+            let pattern = pattern.trim_matches('\'');
+            let wrapper = format!("sh -c {}", shell_quote(d.probe));
+            for text in [&command, &script, &wrapper] {
+                let mut grep = Command::new("grep")
+                    .args(["-qE", pattern])
+                    .stdin(Stdio::piped())
+                    .spawn()
+                    .unwrap();
+                grep.stdin.take().unwrap().write_all(text.as_bytes()).unwrap();
+                assert!(!grep.wait().unwrap().success(), "{} probe matches its own command line", d.name);
+            }
+        }
+        assert!(DETECTORS.iter().any(|d| d.probe.starts_with("pgrep -f ")));
+    }
+
     #[test]
     fn test_detected_service_json() {
         let service = DetectedService {
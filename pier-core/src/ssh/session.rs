@@ -1,18 +1,79 @@
 use super::{SshConfig, SshAuth};
+use super::exec_slots::ExecSlots;
+use super::exec_stream::{ExecStream, StreamKind};
+use super::follow::{FollowSource, Follower};
+use super::forward::{self, ForwardInfo, ForwardStats};
+use super::monitor::{self, MonitorEvent, ServerMonitor};
+use super::pool::{HostKeyCache, HostKeyCheck, Pool, PoolKey};
+use super::sftp::SftpClient;
+use crate::metrics::{self, ConnectionMetrics, ConnectionSnapshot};
 use russh::*;
 use russh::keys::*;
-use std::sync::Arc;
+use std::sync::{Arc, OnceLock};
 use std::collections::HashMap;
-use tokio::sync::Mutex;
+use tokio::sync::{Mutex, MutexGuard, OwnedSemaphorePermit};
 use tokio::sync::watch;
 use tokio::net::TcpListener;
 
+/// Default cap on exec channels open at once on one connection.
+/// OpenSSH's `MaxSessions` defaults to 10; with the long-lived streams'
+/// cap this leaves room for the interactive shell and SFTP.
+pub const DEFAULT_MAX_CONCURRENT_EXECS: usize = 5;
+
+/// Cap on long-lived streams (log follows, monitors) open at once on one
+/// connection. They never give their channel back on their own, so they
+/// get slots of their own instead of starving short commands.
+pub const MAX_LONG_LIVED_STREAMS: usize = 3;
+
+/// Idle connections send a keepalive this often, so a dead network path
+/// is noticed (and the next request reconnects) instead of hanging.
+const KEEPALIVE_INTERVAL: std::time::Duration = std::time::Duration::from_secs(15);
+
+/// Unanswered keepalives before the connection counts as lost.
+const KEEPALIVE_MAX: usize = 3;
+
 /// SSH session manager.
 pub struct SshSession {
     config: SshConfig,
-    handle: Option<Arc<Mutex<client::Handle<SshHandler>>>>,
-    /// Active port forwards: local_port → cancel sender (send true to stop)
-    forwards: HashMap<u16, watch::Sender<bool>>,
+    transport: Option<Arc<Transport>>,
+    /// Active port forwards by local port.
+    forwards: HashMap<u16, PortForward>,
+    /// Exec cap applied when this session creates the transport.
+    max_execs: usize,
+}
+
+/// One authenticated connection, shared by all sessions with the same
+/// `PoolKey` and re-established in place when it drops.
+struct Transport {
+    config: SshConfig,
+    handle: Mutex<client::Handle<SshHandler>>,
+    /// Exec channel slots. Tokio's semaphore queues waiters FIFO, so
+    /// commands beyond the cap run in arrival order. Kept per transport:
+    /// the server's session limit is per connection.
+    exec_slots: ExecSlots,
+    /// Long-lived stream slots. These don't queue: a stream may never
+    /// end, so one beyond the cap fails at once.
+    stream_slots: ExecSlots,
+    metrics: ConnectionMetrics,
+}
+
+fn pool() -> &'static Pool<Transport> {
+    static POOL: OnceLock<Pool<Transport>> = OnceLock::new();
+    POOL.get_or_init(Pool::default)
+}
+
+fn host_keys() -> &'static HostKeyCache<ssh_key::PublicKey> {
+    static HOST_KEYS: OnceLock<HostKeyCache<ssh_key::PublicKey>> = OnceLock::new();
+    HOST_KEYS.get_or_init(HostKeyCache::default)
+}
+
+/// One local port forward.
+struct PortForward {
+    remote_host: String,
+    remote_port: u16,
+    /// Send true to stop the listener and its connections.
+    cancel: watch::Sender<bool>,
+    stats: Arc<ForwardStats>,
 }
 
 /// Minimal SSH client handler with host key verification.
@@ -32,9 +93,16 @@ impl client::Handler for SshHandler {
     ) -> Result<bool, Self::Error> {
         use russh::keys::known_hosts::{check_known_hosts, learn_known_hosts};
 
+        // Seen this run: skip re-reading known_hosts. Anything else,
+        // including a changed key, goes through the full check.
+        if host_keys().check(&self.host, self.port, server_public_key) == HostKeyCheck::Match {
+            return Ok(true);
+        }
+
         match check_known_hosts(&self.host, self.port, server_public_key) {
             Ok(true) => {
                 log::info!("Host key verified for {}:{}", self.host, self.port);
+                host_keys().remember(&self.host, self.port, server_public_key);
                 Ok(true)
             }
             Ok(false) => {
@@ -55,27 +123,24 @@ impl client::Handler for SshHandler {
                 if let Err(e) = learn_known_hosts(&self.host, self.port, server_public_key) {
                     log::warn!("Failed to save host key: {}", e);
                 }
+                host_keys().remember(&self.host, self.port, server_public_key);
                 Ok(true)
             }
         }
     }
 }
 
-impl SshSession {
-    pub fn new(config: SshConfig) -> Self {
-        Self {
-            config,
-            handle: None,
-            forwards: HashMap::new(),
-        }
-    }
-
-    /// Establish an SSH connection.
-    pub async fn connect(&mut self) -> Result<(), anyhow::Error> {
-        let ssh_config = client::Config::default();
+impl Transport {
+    /// Connect and authenticate.
+    async fn handshake(config: &SshConfig) -> Result<client::Handle<SshHandler>, anyhow::Error> {
+        let ssh_config = client::Config {
+            keepalive_interval: Some(KEEPALIVE_INTERVAL),
+            keepalive_max: KEEPALIVE_MAX,
+            ..Default::default()
+        };
         let handler = SshHandler {
-            host: self.config.host.clone(),
-            port: self.config.port,
+            host: config.host.clone(),
+            port: config.port,
         };
 
         // 10-second timeout for TCP connect to avoid blocking indefinitely
@@ -84,7 +149,7 @@ impl SshSession {
             std::time::Duration::from_secs(10),
             client::connect(
                 Arc::new(ssh_config),
-                (self.config.host.as_str(), self.config.port),
+                (config.host.as_str(), config.port),
                 handler,
             ),
         ).await {
@@ -93,10 +158,10 @@ impl SshSession {
         };
 
         // Authenticate
-        let result = match &self.config.auth {
+        let result = match &config.auth {
             SshAuth::Password(password) => {
                 session
-                    .authenticate_password(&self.config.username, password)
+                    .authenticate_password(&config.username, password)
                     .await?
             }
             SshAuth::KeyFile { path, passphrase } => {
@@ -106,7 +171,7 @@ impl SshSession {
                     None, // Use default hash algorithm
                 );
                 session
-                    .authenticate_publickey(&self.config.username, pk)
+                    .authenticate_publickey(&config.username, pk)
                     .await?
             }
             SshAuth::Agent => {
@@ -122,24 +187,69 @@ impl SshSession {
             }
         }
 
-        self.handle = Some(Arc::new(Mutex::new(session)));
+        Ok(session)
+    }
+
+    /// Lock the connection for opening a channel, reconnecting first if it
+    /// was lost (network change, server restart, missed keepalives).
+    async fn lock(&self) -> Result<MutexGuard<'_, client::Handle<SshHandler>>, anyhow::Error> {
+        let mut handle = self.handle.lock().await;
+        if handle.is_closed() {
+            log::info!("SSH connection to {}:{} lost, reconnecting", self.config.host, self.config.port);
+            *handle = Self::handshake(&self.config).await?;
+            self.metrics.reconnected();
+        }
+        // Every caller is about to open a channel.
+        self.metrics.channel_opened();
+        Ok(handle)
+    }
+}
+
+impl SshSession {
+    pub fn new(config: SshConfig) -> Self {
+        Self {
+            config,
+            transport: None,
+            forwards: HashMap::new(),
+            max_execs: DEFAULT_MAX_CONCURRENT_EXECS,
+        }
+    }
+
+    /// Establish an SSH connection, or join the one already open with the
+    /// same host, port, user and credentials.
+    pub async fn connect(&mut self) -> Result<(), anyhow::Error> {
+        let key = PoolKey::of(&self.config);
+        if let Some(transport) = pool().get(&key) {
+            log::info!("SSH reusing connection to {}:{}", self.config.host, self.config.port);
+            self.transport = Some(transport);
+            return Ok(());
+        }
+
+        let handle = Transport::handshake(&self.config).await?;
+        let transport = Arc::new(Transport {
+            config: self.config.clone(),
+            handle: Mutex::new(handle),
+            exec_slots: ExecSlots::new(self.max_execs),
+            stream_slots: ExecSlots::new(MAX_LONG_LIVED_STREAMS),
+            metrics: ConnectionMetrics::new(),
+        });
+        pool().insert(key, &transport);
+        self.transport = Some(transport);
         log::info!("SSH connected to {}:{}", self.config.host, self.config.port);
         Ok(())
     }
 
+    fn transport(&self) -> Result<&Arc<Transport>, anyhow::Error> {
+        self.transport.as_ref().ok_or_else(|| anyhow::anyhow!("Not connected"))
+    }
+
     /// Open an interactive shell channel.
     pub async fn open_shell(
         &self,
         cols: u32,
         rows: u32,
     ) -> Result<russh::Channel<client::Msg>, anyhow::Error> {
-        let handle = self
-            .handle
-            .as_ref()
-            .ok_or_else(|| anyhow::anyhow!("Not connected"))?;
-
-        let handle = handle.lock().await;
-        let channel = handle.channel_open_session().await?;
+        let channel = self.transport()?.lock().await?.channel_open_session().await?;
 
         channel
             .request_pty(false, "xterm-256color", cols, rows, 0, 0, &[])
@@ -149,15 +259,44 @@ impl SshSession {
         Ok(channel)
     }
 
+    /// Open an SFTP subsystem channel on this connection.
+    pub async fn open_sftp(&self) -> Result<SftpClient, anyhow::Error> {
+        let channel = self.transport()?.lock().await?.channel_open_session().await?;
+        let mut client = SftpClient::new();
+        client.init(channel).await?;
+        Ok(client)
+    }
+
+    /// Open a direct-tcpip channel to `host:port` as seen from the server,
+    /// for a client that speaks to it without a local listener.
+    pub async fn open_direct_tcpip(
+        &self,
+        host: &str,
+        port: u16,
+    ) -> Result<russh::ChannelStream<client::Msg>, anyhow::Error> {
+        let channel = self
+            .transport()?
+            .lock()
+            .await?
+            .channel_open_direct_tcpip(host, port as u32, "127.0.0.1", 0)
+            .await?;
+        Ok(channel.into_stream())
+    }
+
     /// Disconnect the SSH session.
     pub async fn disconnect(&mut self) -> Result<(), anyhow::Error> {
-        if let Some(handle) = self.handle.take() {
+        self.stop_all_forwards();
+        if let Some(transport) = self.transport.take() {
+            // Other sessions still use the connection; just let go of it.
+            if Arc::strong_count(&transport) > 1 {
+                return Ok(());
+            }
             // 5-second timeout: if the server is unreachable, the disconnect
             // handshake will hang. We'd rather drop the handle than block.
             let result = tokio::time::timeout(
                 std::time::Duration::from_secs(5),
                 async {
-                    let h = handle.lock().await;
+                    let h = transport.handle.lock().await;
                     h.disconnect(Disconnect::ByApplication, "User disconnect", "en")
                         .await
                 },
@@ -172,13 +311,23 @@ impl SshSession {
     }
 
     pub fn is_connected(&self) -> bool {
-        self.handle.is_some()
+        self.transport.is_some()
+    }
+
+    pub fn config(&self) -> &SshConfig {
+        &self.config
+    }
+
+    /// Activity on this session's connection, shared with every session
+    /// on the same transport. None when not connected.
+    pub fn metrics(&self) -> Option<ConnectionSnapshot> {
+        self.transport.as_ref().map(|transport| transport.metrics.snapshot())
     }
 
     /// Start local port forwarding: 127.0.0.1:local_port → remote_host:remote_port
     ///
     /// Spawns an async TCP listener. Each incoming connection opens
-    /// an SSH direct-tcpip channel for bidirectional data transfer.
+    /// an SSH direct-tcpip channel, relayed by `forward::relay`.
     pub async fn start_port_forward(
         &mut self,
         local_port: u16,
@@ -189,15 +338,14 @@ impl SshSession {
             return Err(anyhow::anyhow!("Port {} already forwarded", local_port));
         }
 
-        let handle = self
-            .handle
-            .as_ref()
-            .ok_or_else(|| anyhow::anyhow!("Not connected"))?
-            .clone();
+        // Forwards don't keep a shared connection alive on their own.
+        let transport = Arc::downgrade(self.transport()?);
 
         let listener = TcpListener::bind(format!("127.0.0.1:{}", local_port)).await?;
         let (cancel_tx, cancel_rx) = watch::channel(false);
         let rhost = remote_host.to_string();
+        let stats = Arc::new(ForwardStats::new());
+        let conn_stats = Arc::clone(&stats);
 
         log::info!(
             "SSH tunnel: 127.0.0.1:{} → {}:{}",
@@ -216,14 +364,21 @@ impl SshSession {
                     }
                     result = listener.accept() => {
                         match result {
-                            Ok((mut tcp_stream, peer)) => {
+                            Ok((tcp_stream, peer)) => {
                                 log::debug!("Tunnel connection from {} on port {}", peer, local_port);
-                                let h = handle.clone();
+                                // Small request/response exchanges (queries,
+                                // Redis commands) shouldn't wait on Nagle.
+                                let _ = tcp_stream.set_nodelay(true);
+                                let Some(transport) = transport.upgrade() else {
+                                    log::info!("Port forward on {} closed with its connection", local_port);
+                                    break;
+                                };
                                 let host = rhost.clone();
                                 let conn_rx = rx.clone();
+                                let stats = Arc::clone(&conn_stats);
                                 tokio::spawn(async move {
                                     if let Err(e) = Self::handle_forward_connection(
-                                        &h, &mut tcp_stream, &host, remote_port, conn_rx,
+                                        transport, tcp_stream, &host, remote_port, &stats, conn_rx,
                                     ).await {
                                         log::debug!("Tunnel connection ended: {}", e);
                                     }
@@ -238,20 +393,26 @@ impl SshSession {
             }
         });
 
-        self.forwards.insert(local_port, cancel_tx);
+        self.forwards.insert(local_port, PortForward {
+            remote_host: remote_host.to_string(),
+            remote_port,
+            cancel: cancel_tx,
+            stats,
+        });
         Ok(())
     }
 
     /// Handle a single forwarded connection.
     async fn handle_forward_connection(
-        handle: &Arc<Mutex<client::Handle<SshHandler>>>,
-        tcp_stream: &mut tokio::net::TcpStream,
+        transport: Arc<Transport>,
+        tcp_stream: tokio::net::TcpStream,
         remote_host: &str,
         remote_port: u16,
-        mut cancel_rx: watch::Receiver<bool>,
+        stats: &ForwardStats,
+        cancel_rx: watch::Receiver<bool>,
     ) -> Result<(), anyhow::Error> {
-        let h = handle.lock().await;
-        let mut channel = h
+        let h = transport.lock().await?;
+        let channel = h
             .channel_open_direct_tcpip(
                 remote_host,
                 remote_port as u32,
@@ -260,49 +421,16 @@ impl SshSession {
             )
             .await?;
         drop(h); // Release the lock
+        drop(transport);
 
-        use tokio::io::{AsyncReadExt, AsyncWriteExt};
-        let (mut tcp_read, mut tcp_write) = tcp_stream.split();
-        let mut buf = vec![0u8; 8192];
-
-        loop {
-            tokio::select! {
-                res = cancel_rx.changed() => {
-                    if res.is_err() || *cancel_rx.borrow() { break; }
-                }
-                // TCP → SSH channel
-                n = tcp_read.read(&mut buf) => {
-                    match n {
-                        Ok(0) | Err(_) => break,
-                        Ok(n) => {
-                            if channel.data(&buf[..n]).await.is_err() {
-                                break;
-                            }
-                        }
-                    }
-                }
-                // SSH channel → TCP
-                msg = channel.wait() => {
-                    match msg {
-                        Some(russh::ChannelMsg::Data { ref data }) => {
-                            if tcp_write.write_all(data).await.is_err() {
-                                break;
-                            }
-                        }
-                        Some(russh::ChannelMsg::Eof) | None => break,
-                        _ => {}
-                    }
-                }
-            }
-        }
-
+        forward::relay(tcp_stream, channel.into_stream(), stats, cancel_rx).await?;
         Ok(())
     }
 
     /// Stop a port forward.
     pub fn stop_port_forward(&mut self, local_port: u16) -> Result<(), anyhow::Error> {
-        if let Some(tx) = self.forwards.remove(&local_port) {
-            let _ = tx.send(true);
+        if let Some(forward) = self.forwards.remove(&local_port) {
+            let _ = forward.cancel.send(true);
             log::info!("Stopped port forward on {}", local_port);
             Ok(())
         } else {
@@ -312,8 +440,8 @@ impl SshSession {
 
     /// Stop all port forwards.
     pub fn stop_all_forwards(&mut self) {
-        for (port, tx) in self.forwards.drain() {
-            let _ = tx.send(true);
+        for (port, forward) in self.forwards.drain() {
+            let _ = forward.cancel.send(true);
             log::info!("Stopped port forward on {}", port);
         }
     }
@@ -323,16 +451,100 @@ impl SshSession {
         self.forwards.keys().copied().collect()
     }
 
-    /// Execute a single command over SSH and return (exit_code, stdout).
-    pub async fn exec_command(&self, command: &str) -> Result<(i32, String), anyhow::Error> {
-        let handle = self
-            .handle
-            .as_ref()
-            .ok_or_else(|| anyhow::anyhow!("Not connected"))?;
+    /// Counters of every active forward, ordered by local port.
+    pub fn forward_stats(&self) -> Vec<ForwardInfo> {
+        let mut infos: Vec<ForwardInfo> = self
+            .forwards
+            .iter()
+            .map(|(&port, f)| f.stats.snapshot(port, &f.remote_host, f.remote_port))
+            .collect();
+        infos.sort_by_key(|info| info.local_port);
+        infos
+    }
+
+    /// Set how many exec channels may be open at once on this connection
+    /// (shared by every session on it). Commands already running keep their
+    /// slot; new ones use the new cap.
+    pub fn set_max_concurrent_execs(&mut self, max: usize) {
+        self.max_execs = max.max(1);
+        if let Some(transport) = &self.transport {
+            transport.exec_slots.resize(self.max_execs);
+        }
+    }
+
+    /// Wait for an exec slot, then open a session channel running `command`.
+    ///
+    /// The connection lock is held only while the channel is opened, so
+    /// commands on one connection run concurrently. The returned permit
+    /// frees the slot when dropped.
+    async fn start_exec(
+        &self,
+        command: &str,
+    ) -> Result<(russh::Channel<client::Msg>, OwnedSemaphorePermit), anyhow::Error> {
+        let transport = self.transport()?;
+        let wait = transport.metrics.exec_wait.start().and(&metrics::global().ssh.exec_wait);
+        let permit = transport.exec_slots.acquire().await?;
+        drop(wait);
+        Ok((Self::open_exec(transport, command).await?, permit))
+    }
+
+    /// Like `start_exec`, for a command that runs until it's stopped. It
+    /// takes a long-lived stream slot, failing when none is free.
+    async fn start_long_lived(
+        &self,
+        command: &str,
+    ) -> Result<(russh::Channel<client::Msg>, OwnedSemaphorePermit), anyhow::Error> {
+        let transport = self.transport()?;
+        let permit = transport.stream_slots.try_acquire().ok_or_else(|| {
+            anyhow::anyhow!("Too many long-lived streams on this connection (max {})", transport.stream_slots.max())
+        })?;
+        Ok((Self::open_exec(transport, command).await?, permit))
+    }
 
-        let handle = handle.lock().await;
-        let mut channel = handle.channel_open_session().await?;
+    async fn open_exec(transport: &Transport, command: &str) -> Result<russh::Channel<client::Msg>, anyhow::Error> {
+        let channel = transport.lock().await?.channel_open_session().await?;
         channel.exec(true, command).await?;
+        Ok(channel)
+    }
+
+    /// Start `command` and stream its stdout/stderr as it arrives.
+    /// The command holds an exec slot until it exits or the stream is dropped.
+    pub async fn exec_stream(&self, command: &str) -> Result<ExecStream, anyhow::Error> {
+        let (channel, permit) = self.start_exec(command).await?;
+        Ok(stream_channel(channel, permit))
+    }
+
+    /// Follow a remote log over one long-lived channel, starting with the
+    /// last `backlog` lines and keeping at most `capacity` lines buffered.
+    pub async fn follow(
+        &self,
+        source: &FollowSource,
+        backlog: usize,
+        capacity: usize,
+    ) -> Result<Follower, anyhow::Error> {
+        let (channel, permit) = self.start_long_lived(&source.command(backlog)).await?;
+        Ok(Follower::start(stream_channel(channel, permit), capacity))
+    }
+
+    /// Start the server monitor agent: a sample every `interval_secs`, and
+    /// disk/process/GPU details every `slow_every` samples.
+    pub async fn monitor<F>(
+        &self,
+        interval_secs: u32,
+        slow_every: u32,
+        on_event: F,
+    ) -> Result<ServerMonitor, anyhow::Error>
+    where
+        F: FnMut(Option<MonitorEvent>) + Send + 'static,
+    {
+        let (channel, permit) = self.start_long_lived(&monitor::agent_command(interval_secs, slow_every)).await?;
+        Ok(ServerMonitor::start(stream_channel(channel, permit), on_event))
+    }
+
+    /// Execute a single command over SSH and return (exit_code, stdout).
+    pub async fn exec_command(&self, command: &str) -> Result<(i32, String), anyhow::Error> {
+        let (mut channel, _permit) = self.start_exec(command).await?;
+        let _rtt = self.transport()?.metrics.exec_rtt.start().and(&metrics::global().ssh.exec_rtt);
 
         let mut stdout = Vec::new();
         let mut exit_code: i32 = -1;
@@ -391,3 +603,42 @@ impl SshSession {
         Ok((exit_code, output))
     }
 }
+
+/// Pump `channel`'s output into a new stream; `permit` is held until the
+/// command exits or the stream is dropped.
+fn stream_channel(mut channel: russh::Channel<client::Msg>, permit: OwnedSemaphorePermit) -> ExecStream {
+    let (stream, mut writer) = ExecStream::new();
+
+    tokio::spawn(async move {
+        let _permit = permit;
+        loop {
+            // Stop pulling from the channel while the reader is behind,
+            // so the SSH window throttles the server.
+            if !writer.reserve().await {
+                let _ = channel.close().await;
+                break;
+            }
+            tokio::select! {
+                _ = writer.cancelled() => {
+                    let _ = channel.close().await;
+                    break;
+                }
+                msg = channel.wait() => match msg {
+                    Some(russh::ChannelMsg::Data { ref data }) => {
+                        writer.push(StreamKind::Stdout, data);
+                    }
+                    Some(russh::ChannelMsg::ExtendedData { ref data, .. }) => {
+                        writer.push(StreamKind::Stderr, data);
+                    }
+                    Some(russh::ChannelMsg::ExitStatus { exit_status }) => {
+                        writer.set_exit_code(exit_status as i32);
+                    }
+                    Some(russh::ChannelMsg::Close) | None => break,
+                    _ => {}
+                }
+            }
+        }
+    });
+
+    stream
+}
@@ -1,6 +1,33 @@
+use std::collections::VecDeque;
+use std::io::SeekFrom;
 use std::path::Path;
+use std::sync::{Arc, Weak};
 use russh_sftp::client::SftpSession;
+use russh_sftp::client::fs::File;
+use russh_sftp::protocol::OpenFlags;
 use serde::{Serialize, Deserialize};
+use tokio::io::{AsyncReadExt, AsyncSeekExt, AsyncWriteExt};
+use tokio::sync::Semaphore;
+
+use super::dir_cache::{self, DirCache, Listing};
+use crate::metrics;
+
+/// Bytes per SFTP read/write request.
+const CHUNK_SIZE: usize = 64 * 1024;
+
+/// SFTP requests kept in flight per transfer. Each one uses its own remote
+/// file handle and a fixed `CHUNK_SIZE` buffer, so a transfer holds at most
+/// `WINDOW * CHUNK_SIZE` bytes regardless of file size.
+const WINDOW: usize = 8;
+
+/// How a transfer ended.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum TransferOutcome {
+    Completed,
+    /// The progress callback asked to stop; the partial file is kept so the
+    /// transfer can be resumed.
+    Cancelled,
+}
 
 /// Represents a remote file entry.
 #[derive(Clone, Debug, Serialize, Deserialize)]
@@ -15,12 +42,19 @@ pub struct RemoteFileEntry {
 
 /// SFTP operations wrapper.
 pub struct SftpClient {
-    session: Option<SftpSession>,
+    session: Option<Arc<SftpSession>>,
+    /// Listings fetched on this session, see `dir_cache`.
+    cache: Arc<DirCache>,
+    prefetch_slots: Arc<Semaphore>,
 }
 
 impl SftpClient {
     pub fn new() -> Self {
-        Self { session: None }
+        Self {
+            session: None,
+            cache: Arc::new(DirCache::new(dir_cache::DEFAULT_TTL)),
+            prefetch_slots: Arc::new(Semaphore::new(dir_cache::PREFETCH_CONCURRENCY)),
+        }
     }
 
     /// Initialize SFTP session from an existing SSH channel.
@@ -30,48 +64,63 @@ impl SftpClient {
     ) -> Result<(), anyhow::Error> {
         channel.request_subsystem(false, "sftp").await?;
         let sftp = SftpSession::new(channel.into_stream()).await?;
-        self.session = Some(sftp);
+        self.session = Some(Arc::new(sftp));
         Ok(())
     }
 
-    /// List directory contents on the remote server.
+    /// List directory contents on the remote server. Served from the
+    /// session's cache while fresh; the subdirectories and the parent are
+    /// then fetched in the background.
     pub async fn list_dir(&self, path: &str) -> Result<Vec<RemoteFileEntry>, anyhow::Error> {
         let sftp = self
             .session
             .as_ref()
             .ok_or_else(|| anyhow::anyhow!("SFTP session not initialized"))?;
 
-        let dir = sftp.read_dir(path).await?;
-        let mut entries = Vec::new();
-
-        for entry in dir {
-            let name = entry.file_name();
-            if name == "." || name == ".." {
-                continue;
-            }
-            let file_path = format!("{}/{}", path.trim_end_matches('/'), name);
-            let is_dir = entry.file_type().is_dir();
-            let size = entry.metadata().size.unwrap_or(0);
-            let modified = entry.metadata().mtime.map(|v| v as u64);
-
-            entries.push(RemoteFileEntry {
-                name,
-                path: file_path,
-                is_dir,
-                size,
-                modified,
-                permissions: entry.metadata().permissions,
-            });
+        if let Some(listing) = self.cache.get(path) {
+            self.prefetch_around(sftp, path, &listing);
+            return Ok(listing.to_vec());
         }
+        let ticket = self.cache.ticket(path);
+        let listing = match read_dir_sorted(sftp, path).await {
+            Ok(entries) => self.cache.finish(ticket, entries),
+            Err(e) => {
+                self.cache.abandon(ticket);
+                return Err(e);
+            }
+        };
+        self.prefetch_around(sftp, path, &listing);
+        Ok(listing.to_vec())
+    }
 
-        // Sort: directories first, then files, alphabetically
-        entries.sort_by(|a, b| {
-            b.is_dir
-                .cmp(&a.is_dir)
-                .then(a.name.to_lowercase().cmp(&b.name.to_lowercase()))
-        });
+    /// Drop cached listings for `path` and below, e.g. after a change made
+    /// outside this session.
+    pub fn invalidate(&self, path: &str) {
+        self.cache.invalidate(path);
+    }
 
-        Ok(entries)
+    /// Fetch, with at most `PREFETCH_CONCURRENCY` requests in flight, the
+    /// listings the user is likely to open next. The tasks only hold a weak
+    /// reference, so closing the session cancels what hasn't started.
+    fn prefetch_around(&self, sftp: &Arc<SftpSession>, path: &str, listing: &Listing) {
+        let children = listing.iter().filter(|e| e.is_dir).take(dir_cache::PREFETCH_PER_DIR);
+        let targets = children.map(|e| e.path.clone()).chain(dir_cache::parent(path));
+        for target in targets {
+            let Some(ticket) = self.cache.begin_prefetch(&target) else { continue };
+            let session = Arc::downgrade(sftp);
+            let cache = Arc::clone(&self.cache);
+            let slots = Arc::clone(&self.prefetch_slots);
+            tokio::spawn(async move {
+                let Ok(_permit) = slots.acquire_owned().await else { return cache.abandon(ticket) };
+                let Some(sftp) = Weak::upgrade(&session) else { return cache.abandon(ticket) };
+                match read_dir_sorted(&sftp, &target).await {
+                    Ok(entries) => {
+                        cache.finish(ticket, entries);
+                    }
+                    Err(_) => cache.abandon(ticket),
+                }
+            });
+        }
     }
 
     /// Download a file from remote to local path.
@@ -80,20 +129,96 @@ impl SftpClient {
         remote_path: &str,
         local_path: &Path,
     ) -> Result<(), anyhow::Error> {
+        self.download_with_progress(remote_path, local_path, false, |_, _| true).await?;
+        Ok(())
+    }
+
+    /// Download with `WINDOW` pipelined reads, writing the local file in
+    /// order. `progress(done, total)` is called after each chunk; returning
+    /// false cancels. With `resume`, an existing shorter local file is kept
+    /// and the transfer continues from its end. A chunk that comes back
+    /// short (the remote file shrank) fails the download.
+    pub async fn download_with_progress<F>(
+        &self,
+        remote_path: &str,
+        local_path: &Path,
+        resume: bool,
+        mut progress: F,
+    ) -> Result<TransferOutcome, anyhow::Error>
+    where
+        F: FnMut(u64, u64) -> bool,
+    {
         let sftp = self
             .session
             .as_ref()
             .ok_or_else(|| anyhow::anyhow!("SFTP session not initialized"))?;
 
-        let data = sftp.read(remote_path).await?;
-        tokio::fs::write(local_path, data).await?;
+        let total = sftp.metadata(remote_path).await?.size.unwrap_or(0);
+        let mut offset = 0;
+        if resume {
+            if let Ok(meta) = tokio::fs::metadata(local_path).await {
+                if meta.len() <= total {
+                    offset = meta.len();
+                }
+            }
+        }
+
+        let mut local = tokio::fs::OpenOptions::new()
+            .create(true)
+            .write(true)
+            .open(local_path)
+            .await?;
+        local.set_len(offset).await?;
+        local.seek(SeekFrom::Start(offset)).await?;
+        if offset > 0 {
+            log::info!("Resuming download of {} at {} of {} bytes", remote_path, offset, total);
+        }
+
+        let mut next = offset;
+        let mut in_flight = VecDeque::new();
+        while in_flight.len() < WINDOW && next < total {
+            let file = sftp.open_with_flags(remote_path, OpenFlags::READ).await?;
+            let len = chunk_len(next, total);
+            in_flight.push_back(tokio::spawn(read_chunk(file, vec![0u8; CHUNK_SIZE], next, len)));
+            next += len as u64;
+        }
+
+        let mut done = offset;
+        while let Some(task) = in_flight.pop_front() {
+            let (file, buf, n) = task.await??;
+            let expected = chunk_len(done, total);
+            if n != expected {
+                // The remote file shrank while we were reading it. Keep the
+                // prefix written so far (a resume can continue from it) but
+                // don't report a truncated file as downloaded.
+                in_flight.iter().for_each(|t| t.abort());
+                local.flush().await?;
+                return Err(anyhow::anyhow!(
+                    "{} changed during download: got {} of {} bytes at offset {}",
+                    remote_path, n, expected, done
+                ));
+            }
+            local.write_all(&buf[..n]).await?;
+            done += n as u64;
+            if !progress(done, total) {
+                in_flight.iter().for_each(|t| t.abort());
+                local.flush().await?;
+                return Ok(TransferOutcome::Cancelled);
+            }
+            if next < total {
+                let len = chunk_len(next, total);
+                in_flight.push_back(tokio::spawn(read_chunk(file, buf, next, len)));
+                next += len as u64;
+            }
+        }
+        local.flush().await?;
 
         log::info!(
             "Downloaded {} -> {}",
             remote_path,
             local_path.display()
         );
-        Ok(())
+        Ok(TransferOutcome::Completed)
     }
 
     /// Upload a local file to remote path.
@@ -102,20 +227,98 @@ impl SftpClient {
         local_path: &Path,
         remote_path: &str,
     ) -> Result<(), anyhow::Error> {
+        self.upload_with_progress(local_path, remote_path, false, |_, _| true).await?;
+        Ok(())
+    }
+
+    /// Upload with `WINDOW` pipelined writes. `progress(done, total)` only
+    /// counts the contiguous prefix the server has acknowledged; returning
+    /// false cancels. With `resume`, the transfer continues from an existing
+    /// remote file; since up to `WINDOW` writes may have landed out of order
+    /// before an interruption, the last window is sent again. A remote file
+    /// longer than the local one is truncated and sent from the start.
+    pub async fn upload_with_progress<F>(
+        &self,
+        local_path: &Path,
+        remote_path: &str,
+        resume: bool,
+        mut progress: F,
+    ) -> Result<TransferOutcome, anyhow::Error>
+    where
+        F: FnMut(u64, u64) -> bool,
+    {
         let sftp = self
             .session
             .as_ref()
             .ok_or_else(|| anyhow::anyhow!("SFTP session not initialized"))?;
 
-        let data = tokio::fs::read(local_path).await?;
-        sftp.write(remote_path, &data).await?;
+        let mut local = tokio::fs::File::open(local_path).await?;
+        let total = local.metadata().await?.len();
+        let mut resume_at = None;
+        if resume {
+            if let Ok(meta) = sftp.metadata(remote_path).await {
+                resume_at = resume_offset(meta.size.unwrap_or(0), total);
+                if resume_at.is_none() {
+                    log::info!("{} is longer than {}, uploading it again", remote_path, local_path.display());
+                }
+            }
+        }
+        let offset = resume_at.unwrap_or(0);
+        local.seek(SeekFrom::Start(offset)).await?;
+        if offset > 0 {
+            log::info!("Resuming upload to {} at {} of {} bytes", remote_path, offset, total);
+        }
+
+        let first_flags = if resume_at.is_some() {
+            OpenFlags::WRITE | OpenFlags::CREATE
+        } else {
+            OpenFlags::WRITE | OpenFlags::CREATE | OpenFlags::TRUNCATE
+        };
+        let mut idle = vec![sftp.open_with_flags(remote_path, first_flags).await?];
+
+        let mut next = offset;
+        let mut done = offset;
+        let mut buffers: Vec<Vec<u8>> = Vec::new();
+        let mut in_flight = VecDeque::new();
+        loop {
+            while in_flight.len() < WINDOW && next < total {
+                let file = match idle.pop() {
+                    Some(file) => file,
+                    None => sftp.open_with_flags(remote_path, OpenFlags::WRITE).await?,
+                };
+                let mut buf = buffers.pop().unwrap_or_else(|| vec![0u8; CHUNK_SIZE]);
+                let len = chunk_len(next, total);
+                local.read_exact(&mut buf[..len]).await?;
+                in_flight.push_back(tokio::spawn(write_chunk(file, buf, next, len)));
+                next += len as u64;
+            }
+
+            let Some(task) = in_flight.pop_front() else { break };
+            let (file, buf, n) = task.await??;
+            idle.push(file);
+            buffers.push(buf);
+            done += n as u64;
+            if !progress(done, total) {
+                // Let outstanding writes land so the remote prefix stays valid.
+                for task in in_flight.drain(..) {
+                    if let Ok(Ok((file, _, _))) = task.await {
+                        idle.push(file);
+                    }
+                }
+                close_all(idle).await;
+                self.cache.invalidate_entry(remote_path);
+                return Ok(TransferOutcome::Cancelled);
+            }
+        }
+        close_all(idle).await;
+        self.cache.invalidate_entry(remote_path);
 
         log::info!(
             "Uploaded {} -> {}",
             local_path.display(),
             remote_path
         );
-        Ok(())
+        Ok(TransferOutcome::Completed)
     }
 
     /// Remove a file on the remote server.
@@ -125,6 +328,7 @@ impl SftpClient {
             .as_ref()
             .ok_or_else(|| anyhow::anyhow!("SFTP session not initialized"))?;
         sftp.remove_file(path).await?;
+        self.cache.invalidate_entry(path);
         Ok(())
     }
 
@@ -135,6 +339,7 @@ impl SftpClient {
             .as_ref()
             .ok_or_else(|| anyhow::anyhow!("SFTP session not initialized"))?;
         sftp.create_dir(path).await?;
+        self.cache.invalidate_entry(path);
         Ok(())
     }
 
@@ -148,3 +353,116 @@ impl SftpClient {
         Ok(path)
     }
 }
+
+/// One `read_dir` round trip: directories first, then by name,
+/// case-insensitively.
+async fn read_dir_sorted(sftp: &SftpSession, path: &str) -> Result<Vec<RemoteFileEntry>, anyhow::Error> {
+    let dir = sftp.read_dir(path).await?;
+    let mut entries = Vec::new();
+
+    for entry in dir {
+        let name = entry.file_name();
+        if name == "." || name == ".." {
+            continue;
+        }
+        let file_path = format!("{}/{}", path.trim_end_matches('/'), name);
+        let is_dir = entry.file_type().is_dir();
+        let size = entry.metadata().size.unwrap_or(0);
+        let modified = entry.metadata().mtime.map(|v| v as u64);
+
+        entries.push(RemoteFileEntry {
+            name,
+            path: file_path,
+            is_dir,
+            size,
+            modified,
+            permissions: entry.metadata().permissions,
+        });
+    }
+
+    // Sort: directories first, then files, alphabetically
+    entries.sort_by_cached_key(|e| (!e.is_dir, e.name.to_lowercase()));
+    Ok(entries)
+}
+
+/// Where to resume an upload of `total` bytes over a remote file of
+/// `remote_size`: a chunk boundary a window before its end, or None when
+/// the remote file is longer and can't be a partial copy, so it's
+/// truncated and sent from the start.
+fn resume_offset(remote_size: u64, total: u64) -> Option<u64> {
+    if remote_size > total {
+        return None;
+    }
+    let safe = remote_size.saturating_sub((WINDOW * CHUNK_SIZE) as u64);
+    Some(safe - safe % CHUNK_SIZE as u64)
+}
+
+/// Length of the chunk starting at `offset`.
+fn chunk_len(offset: u64, total: u64) -> usize {
+    (total - offset).min(CHUNK_SIZE as u64) as usize
+}
+
+/// Read up to `len` bytes at `offset` into `buf`; hands the file and buffer
+/// back for reuse along with the byte count (short only at EOF).
+async fn read_chunk(
+    mut file: File,
+    mut buf: Vec<u8>,
+    offset: u64,
+    len: usize,
+) -> Result<(File, Vec<u8>, usize), anyhow::Error> {
+    let _timer = metrics::global().sftp_chunk.start();
+    file.seek(SeekFrom::Start(offset)).await?;
+    let mut filled = 0;
+    while filled < len {
+        let n = file.read(&mut buf[filled..len]).await?;
+        if n == 0 {
+            break;
+        }
+        filled += n;
+    }
+    metrics::global().sftp_bytes_down.add(filled as u64);
+    Ok((file, buf, filled))
+}
+
+/// Write `buf[..len]` at `offset`; hands the file and buffer back for reuse.
+async fn write_chunk(
+    mut file: File,
+    buf: Vec<u8>,
+    offset: u64,
+    len: usize,
+) -> Result<(File, Vec<u8>, usize), anyhow::Error> {
+    let _timer = metrics::global().sftp_chunk.start();
+    file.seek(SeekFrom::Start(offset)).await?;
+    file.write_all(&buf[..len]).await?;
+    metrics::global().sftp_bytes_up.add(len as u64);
+    Ok((file, buf, len))
+}
+
+/// Close remote handles, flushing any buffered writes.
+async fn close_all(files: Vec<File>) {
+    for mut file in files {
+        if let Err(e) = file.shutdown().await {
+            log::warn!("SFTP close failed: {}", e);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_resume_offset() {
+        let chunk = CHUNK_SIZE as u64;
+        let window = (WINDOW * CHUNK_SIZE) as u64;
+        let total = 100 * chunk;
+
+        assert_eq!(resume_offset(0, total), Some(0));
+        assert_eq!(resume_offset(window - 1, total), Some(0));
+        // A window back from the end, down to a chunk boundary.
+        assert_eq!(resume_offset(window + 3 * chunk + 10, total), Some(3 * chunk));
+        assert_eq!(resume_offset(total, total), Some(total - window));
+        // Longer than the local file: start over on a truncated file.
+        assert_eq!(resume_offset(total + 1, total), None);
+    }
+}
@@ -1,4 +1,6 @@
 use vte::{Parser, Perform};
+use crate::terminal::scan;
+use crate::terminal::scrollback::{Scrollback, ScrollbackConfig};
 
 /// VT100/ANSI escape sequence parser wrapping `vte` crate.
 /// Tracks cursor position, text attributes, and screen content.
@@ -8,73 +10,342 @@ pub struct VtEmulator {
     pub cursor_y: usize,
     pub cols: usize,
     pub rows: usize,
-    /// Screen buffer: rows x cols of characters
-    pub cells: Vec<Vec<Cell>>,
+    /// Screen buffer: rows x cols of cells
+    grid: Grid,
+    /// Attributes applied to newly printed characters (set via SGR).
+    pen: Cell,
+    /// Lines scrolled off the top of the screen.
+    scrollback: Scrollback,
+    /// Known to be in vte's ground state (safe to bypass it for plain text).
+    ground: bool,
+    /// UTF-8 continuation bytes vte is still waiting for.
+    utf8_pending: u8,
 }
 
-/// A single cell in the terminal grid.
-#[derive(Clone, Debug)]
+/// Packed color tag (high byte of a packed color): terminal default color.
+pub const PIER_COLOR_DEFAULT: u32 = 0;
+/// Packed color tag: 256-color palette index in the low byte.
+pub const PIER_COLOR_INDEXED: u32 = 0x0100_0000;
+/// Packed color tag: 24-bit RGB in the low three bytes (0xRRGGBB).
+pub const PIER_COLOR_RGB: u32 = 0x0200_0000;
+
+/// Cell attribute flag: bold.
+pub const PIER_CELL_BOLD: u32 = 1 << 0;
+/// Cell attribute flag: underline.
+pub const PIER_CELL_UNDERLINE: u32 = 1 << 1;
+/// Cell attribute flag: italic.
+pub const PIER_CELL_ITALIC: u32 = 1 << 2;
+/// Cell attribute flag: reverse video (swap fg/bg when drawing).
+pub const PIER_CELL_INVERSE: u32 = 1 << 3;
+/// Cell attribute flag: dim / faint.
+pub const PIER_CELL_DIM: u32 = 1 << 4;
+/// Cell attribute flag: strikethrough.
+pub const PIER_CELL_STRIKETHROUGH: u32 = 1 << 5;
+
+/// Terminal color, packed into a u32: `PIER_COLOR_*` tag in the high byte,
+/// palette index or 0xRRGGBB payload below.
+#[repr(transparent)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct Color(u32);
+
+impl Color {
+    pub const DEFAULT: Color = Color(PIER_COLOR_DEFAULT);
+
+    pub const fn indexed(index: u8) -> Self {
+        Color(PIER_COLOR_INDEXED | index as u32)
+    }
+
+    pub const fn rgb(r: u8, g: u8, b: u8) -> Self {
+        Color(PIER_COLOR_RGB | (r as u32) << 16 | (g as u32) << 8 | b as u32)
+    }
+
+    /// The packed representation handed across FFI.
+    pub fn packed(self) -> u32 {
+        self.0
+    }
+}
+
+/// Number of low bits of `Cell::bits` holding the Unicode scalar value.
+const CHAR_BITS: u32 = 21;
+const CHAR_MASK: u32 = (1 << CHAR_BITS) - 1;
+
+/// A single cell in the terminal grid (12 bytes).
+///
+/// The character and the `PIER_CELL_*` attribute flags share one u32:
+/// Unicode scalars fit in 21 bits, leaving the upper 11 bits for flags.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
 pub struct Cell {
-    pub ch: char,
+    bits: u32,
     pub fg: Color,
     pub bg: Color,
-    pub bold: bool,
-    pub underline: bool,
 }
 
-/// Terminal color representation.
-#[derive(Clone, Debug, Copy)]
-pub enum Color {
-    Default,
-    Indexed(u8),
-    Rgb(u8, u8, u8),
+impl Cell {
+    pub const BLANK: Cell = Cell {
+        bits: ' ' as u32,
+        fg: Color::DEFAULT,
+        bg: Color::DEFAULT,
+    };
+
+    pub fn ch(&self) -> char {
+        char::from_u32(self.bits & CHAR_MASK).unwrap_or(' ')
+    }
+
+    pub fn set_ch(&mut self, ch: char) {
+        self.bits = (self.bits & !CHAR_MASK) | ch as u32;
+    }
+
+    /// The same attributes carrying a different character.
+    #[inline]
+    pub fn with_ch(self, ch: char) -> Cell {
+        Cell { bits: (self.bits & !CHAR_MASK) | ch as u32, ..self }
+    }
+
+    /// Attribute bits (`PIER_CELL_*`) for this cell.
+    pub fn flags(&self) -> u32 {
+        self.bits >> CHAR_BITS
+    }
+
+    pub fn has_flag(&self, flag: u32) -> bool {
+        self.flags() & flag != 0
+    }
+
+    /// Raw (char+flags, fg, bg) words, for compact serialization.
+    pub fn to_raw(self) -> [u32; 3] {
+        [self.bits, self.fg.0, self.bg.0]
+    }
+
+    /// Inverse of `to_raw`.
+    pub fn from_raw(raw: [u32; 3]) -> Cell {
+        Cell { bits: raw[0], fg: Color(raw[1]), bg: Color(raw[2]) }
+    }
+
+    pub fn set_flag(&mut self, flag: u32, on: bool) {
+        if on {
+            self.bits |= flag << CHAR_BITS;
+        } else {
+            self.bits &= !(flag << CHAR_BITS);
+        }
+    }
 }
 
 impl Default for Cell {
     fn default() -> Self {
+        Cell::BLANK
+    }
+}
+
+/// Screen grid stored as one contiguous ring of rows.
+///
+/// All `rows * cols` cells live in a single `Vec`; logical row `r` is the
+/// physical row `(top + r) % rows`. Scrolling the full screen up clears the
+/// recycled top row in place and bumps `top` — no per-line allocation and no
+/// memmove of the remaining rows.
+pub struct Grid {
+    cells: Vec<Cell>,
+    cols: usize,
+    rows: usize,
+    /// Physical index of logical row 0.
+    top: usize,
+    /// Per-row damage flags (logical rows): set when a row changes,
+    /// cleared by `drain_dirty`.
+    dirty: Vec<bool>,
+    /// Every row is damaged (set on scroll/resize without touching `dirty`).
+    all_dirty: bool,
+}
+
+impl Grid {
+    fn new(cols: usize, rows: usize) -> Self {
         Self {
-            ch: ' ',
-            fg: Color::Default,
-            bg: Color::Default,
-            bold: false,
-            underline: false,
+            cells: vec![Cell::BLANK; cols * rows],
+            cols,
+            rows,
+            top: 0,
+            dirty: vec![false; rows],
+            all_dirty: true,
+        }
+    }
+
+    pub fn cols(&self) -> usize {
+        self.cols
+    }
+
+    pub fn rows(&self) -> usize {
+        self.rows
+    }
+
+    #[inline]
+    fn offset(&self, row: usize) -> usize {
+        let mut physical = self.top + row;
+        if physical >= self.rows {
+            physical -= self.rows;
         }
+        physical * self.cols
+    }
+
+    /// Cells of logical row `row`.
+    #[inline]
+    pub fn row(&self, row: usize) -> &[Cell] {
+        let start = self.offset(row);
+        &self.cells[start..start + self.cols]
+    }
+
+    /// Mutable cells of logical row `row`. Marks the row dirty.
+    #[inline]
+    pub fn row_mut(&mut self, row: usize) -> &mut [Cell] {
+        self.dirty[row] = true;
+        let start = self.offset(row);
+        &mut self.cells[start..start + self.cols]
+    }
+
+    /// Scroll the whole screen up by one line; the new bottom row is blank.
+    fn scroll_up(&mut self) {
+        let start = self.offset(0);
+        self.cells[start..start + self.cols].fill(Cell::BLANK);
+        self.top = if self.top + 1 == self.rows { 0 } else { self.top + 1 };
+        // Every visible row shifted up by one.
+        self.all_dirty = true;
+    }
+
+    /// Resize, keeping the top-left region and linearizing the ring.
+    fn resize(&mut self, cols: usize, rows: usize) {
+        let mut cells = vec![Cell::BLANK; cols * rows];
+        let keep_cols = cols.min(self.cols);
+        for row in 0..rows.min(self.rows) {
+            cells[row * cols..row * cols + keep_cols].copy_from_slice(&self.row(row)[..keep_cols]);
+        }
+        self.cells = cells;
+        self.cols = cols;
+        self.rows = rows;
+        self.top = 0;
+        self.dirty = vec![false; rows];
+        self.all_dirty = true;
+    }
+
+    fn mark_all_dirty(&mut self) {
+        self.all_dirty = true;
+    }
+
+    fn dirty_count(&self) -> usize {
+        if self.all_dirty {
+            self.rows
+        } else {
+            self.dirty.iter().filter(|&&d| d).count()
+        }
+    }
+
+    fn drain_dirty<F: FnMut(usize, &[Cell])>(&mut self, max_rows: usize, mut f: F) -> usize {
+        let mut visited = 0;
+        let mut row = 0;
+        while row < self.rows && visited < max_rows {
+            if self.all_dirty || self.dirty[row] {
+                self.dirty[row] = false;
+                f(row, self.row(row));
+                visited += 1;
+            }
+            row += 1;
+        }
+        if self.all_dirty {
+            // Rows past the cap keep their damage for the next drain.
+            for pending in &mut self.dirty[row..] {
+                *pending = true;
+            }
+            self.all_dirty = false;
+        }
+        visited
     }
 }
 
 impl VtEmulator {
     pub fn new(cols: usize, rows: usize) -> Self {
-        let cells = vec![vec![Cell::default(); cols]; rows];
+        let cols = cols.max(1);
+        let rows = rows.max(1);
         Self {
             parser: Parser::new(),
             cursor_x: 0,
             cursor_y: 0,
             cols,
             rows,
-            cells,
+            grid: Grid::new(cols, rows),
+            pen: Cell::BLANK,
+            scrollback: Scrollback::new(ScrollbackConfig::default()),
+            ground: true,
+            utf8_pending: 0,
         }
     }
 
     /// Feed raw bytes from PTY into the VT parser.
+    ///
+    /// Runs of printable ASCII seen while the parser is in its ground state
+    /// are found with a vectorized scan and blitted into the current row in
+    /// bulk; only control, escape and non-ASCII bytes go through `vte`.
     pub fn process(&mut self, bytes: &[u8]) {
         let mut performer = EmulatorPerformer {
             cursor_x: &mut self.cursor_x,
             cursor_y: &mut self.cursor_y,
             cols: self.cols,
             rows: self.rows,
-            cells: &mut self.cells,
+            grid: &mut self.grid,
+            pen: &mut self.pen,
+            scrollback: &mut self.scrollback,
+            returned_to_ground: false,
         };
-        self.parser.advance(&mut performer, bytes);
+
+        let mut i = 0;
+        while i < bytes.len() {
+            let rest = &bytes[i..];
+            if !self.ground {
+                // Inside an escape sequence: let vte run until a dispatch
+                // puts it back in the ground state.
+                performer.returned_to_ground = false;
+                i += self.parser.advance_until_terminated(&mut performer, rest);
+                if performer.returned_to_ground {
+                    self.ground = true;
+                    self.utf8_pending = 0;
+                }
+                continue;
+            }
+
+            if self.utf8_pending == 0 {
+                let run = scan::printable_ascii_run(rest);
+                if run > 0 {
+                    performer.print_ascii(&rest[..run]);
+                    i += run;
+                    continue;
+                }
+            }
+
+            // Controls, DEL and UTF-8 keep vte in ground; an ESC leaves it.
+            // Hand vte everything up to the next printable byte, or up to
+            // and including the next ESC.
+            let end = if rest[0] == 0x1B {
+                1
+            } else {
+                match rest[1..].iter().position(|&b| b == 0x1B || scan::is_printable(b)) {
+                    Some(p) if rest[1 + p] == 0x1B => p + 2,
+                    Some(p) => p + 1,
+                    None => rest.len(),
+                }
+            };
+            let segment = &rest[..end];
+            self.parser.advance(&mut performer, segment);
+            if segment[end - 1] == 0x1B {
+                self.ground = false;
+                self.utf8_pending = 0;
+            } else {
+                self.utf8_pending = pending_utf8_continuations(self.utf8_pending, segment);
+            }
+            i += end;
+        }
     }
 
     /// Resize the emulator grid.
     pub fn resize(&mut self, cols: usize, rows: usize) {
+        let cols = cols.max(1);
+        let rows = rows.max(1);
         self.cols = cols;
         self.rows = rows;
-        self.cells.resize(rows, vec![Cell::default(); cols]);
-        for row in self.cells.iter_mut() {
-            row.resize(cols, Cell::default());
-        }
+        self.grid.resize(cols, rows);
         if self.cursor_x >= cols {
             self.cursor_x = cols - 1;
         }
@@ -83,29 +354,222 @@ impl VtEmulator {
         }
     }
 
+    /// The screen grid.
+    pub fn grid(&self) -> &Grid {
+        &self.grid
+    }
+
+    /// Lines that have scrolled off the top of the screen.
+    pub fn scrollback(&self) -> &Scrollback {
+        &self.scrollback
+    }
+
+    pub fn scrollback_mut(&mut self) -> &mut Scrollback {
+        &mut self.scrollback
+    }
+
+    /// Cell at (`row`, `col`) of the visible screen.
+    pub fn cell(&self, row: usize, col: usize) -> Cell {
+        self.grid.row(row)[col]
+    }
+
+    /// Mark every row as damaged (e.g. after the renderer lost its state).
+    pub fn mark_all_dirty(&mut self) {
+        self.grid.mark_all_dirty();
+    }
+
+    /// Number of rows changed since the last `drain_dirty`.
+    pub fn dirty_count(&self) -> usize {
+        self.grid.dirty_count()
+    }
+
+    /// Visit up to `max_rows` damaged rows in top-to-bottom order, clearing
+    /// their flags. Rows beyond `max_rows` stay dirty for the next call.
+    /// Returns the number of rows visited.
+    pub fn drain_dirty<F: FnMut(usize, &[Cell])>(&mut self, max_rows: usize, f: F) -> usize {
+        self.grid.drain_dirty(max_rows, f)
+    }
+
+    /// Not inside an escape sequence or a multi-byte character, so output
+    /// that follows can be parsed from a fresh emulator.
+    pub fn in_ground_state(&self) -> bool {
+        self.ground && self.utf8_pending == 0
+    }
+
+    /// Append escape sequences that redraw the visible screen, pen and
+    /// cursor on a blank terminal of the same size. Trailing blanks of each
+    /// row are skipped.
+    pub fn write_screen(&self, out: &mut Vec<u8>) {
+        use std::io::Write;
+        out.extend_from_slice(b"\x1b[0m\x1b[2J");
+        let mut current = Cell::BLANK;
+        for row in 0..self.rows {
+            let cells = self.grid.row(row);
+            let end = cells.iter().rposition(|c| *c != Cell::BLANK).map_or(0, |i| i + 1);
+            if end == 0 {
+                continue;
+            }
+            let _ = write!(out, "\x1b[{};1H", row + 1);
+            for cell in &cells[..end] {
+                if !same_attributes(cell, &current) {
+                    write_sgr(out, cell);
+                    current = *cell;
+                }
+                let mut utf8 = [0u8; 4];
+                out.extend_from_slice(cell.ch().encode_utf8(&mut utf8).as_bytes());
+            }
+        }
+        write_sgr(out, &self.pen);
+        let _ = write!(out, "\x1b[{};{}H", self.cursor_y + 1, self.cursor_x.min(self.cols - 1) + 1);
+    }
+
     /// Get the text content of a specific line.
     pub fn get_line_text(&self, row: usize) -> String {
-        if row < self.cells.len() {
-            self.cells[row].iter().map(|c| c.ch).collect()
+        if row < self.rows {
+            self.grid.row(row).iter().map(|c| c.ch()).collect()
         } else {
             String::new()
         }
     }
 }
 
+fn same_attributes(a: &Cell, b: &Cell) -> bool {
+    a.flags() == b.flags() && a.fg == b.fg && a.bg == b.bg
+}
+
+/// SGR sequence setting exactly `cell`'s attributes and colors.
+fn write_sgr(out: &mut Vec<u8>, cell: &Cell) {
+    use std::io::Write;
+    out.extend_from_slice(b"\x1b[0");
+    for (flag, code) in [
+        (PIER_CELL_BOLD, 1),
+        (PIER_CELL_DIM, 2),
+        (PIER_CELL_ITALIC, 3),
+        (PIER_CELL_UNDERLINE, 4),
+        (PIER_CELL_INVERSE, 7),
+        (PIER_CELL_STRIKETHROUGH, 9),
+    ] {
+        if cell.has_flag(flag) {
+            let _ = write!(out, ";{}", code);
+        }
+    }
+    for (color, base) in [(cell.fg, 38), (cell.bg, 48)] {
+        let packed = color.packed();
+        match packed & 0xff00_0000 {
+            PIER_COLOR_INDEXED => { let _ = write!(out, ";{};5;{}", base, packed & 0xff); }
+            PIER_COLOR_RGB => {
+                let _ = write!(out, ";{};2;{};{};{}", base, (packed >> 16) & 0xff, (packed >> 8) & 0xff, packed & 0xff);
+            }
+            _ => {}
+        }
+    }
+    out.push(b'm');
+}
+
 /// Internal performer that implements vte::Perform.
 struct EmulatorPerformer<'a> {
     cursor_x: &'a mut usize,
     cursor_y: &'a mut usize,
     cols: usize,
     rows: usize,
-    cells: &'a mut Vec<Vec<Cell>>,
+    grid: &'a mut Grid,
+    pen: &'a mut Cell,
+    scrollback: &'a mut Scrollback,
+    /// Set by dispatches that leave vte in its ground state.
+    returned_to_ground: bool,
 }
 
 impl<'a> EmulatorPerformer<'a> {
+    /// Bulk equivalent of `print` for a run of printable ASCII.
+    fn print_ascii(&mut self, mut bytes: &[u8]) {
+        while !bytes.is_empty() {
+            if *self.cursor_x >= self.cols {
+                self.newline();
+            }
+            let x = *self.cursor_x;
+            let take = (self.cols - x).min(bytes.len());
+            let pen = *self.pen;
+            let row = self.grid.row_mut(*self.cursor_y);
+            for (cell, &b) in row[x..x + take].iter_mut().zip(&bytes[..take]) {
+                *cell = pen.with_ch(b as char);
+            }
+            *self.cursor_x += take;
+            bytes = &bytes[take..];
+        }
+    }
+
     fn scroll_up(&mut self) {
-        self.cells.remove(0);
-        self.cells.push(vec![Cell::default(); self.cols]);
+        self.scrollback.push_line(self.grid.row(0));
+        self.grid.scroll_up();
+    }
+
+    /// Reset cells `[from, to)` of `row` to blanks and mark the row damaged.
+    fn erase(&mut self, row: usize, from: usize, to: usize) {
+        if row >= self.rows {
+            return;
+        }
+        let to = to.min(self.cols);
+        if from < to {
+            self.grid.row_mut(row)[from..to].fill(Cell::BLANK);
+        }
+    }
+
+    /// Apply an SGR (Select Graphic Rendition) parameter list to the pen.
+    fn set_graphic_rendition(&mut self, params: &vte::Params) {
+        let mut iter = params.iter();
+        if params.is_empty() {
+            *self.pen = Cell::BLANK;
+            return;
+        }
+        while let Some(param) = iter.next() {
+            match param[0] {
+                0 => *self.pen = Cell::BLANK,
+                1 => self.pen.set_flag(PIER_CELL_BOLD, true),
+                2 => self.pen.set_flag(PIER_CELL_DIM, true),
+                3 => self.pen.set_flag(PIER_CELL_ITALIC, true),
+                4 => self.pen.set_flag(PIER_CELL_UNDERLINE, true),
+                7 => self.pen.set_flag(PIER_CELL_INVERSE, true),
+                9 => self.pen.set_flag(PIER_CELL_STRIKETHROUGH, true),
+                22 => self.pen.set_flag(PIER_CELL_BOLD | PIER_CELL_DIM, false),
+                23 => self.pen.set_flag(PIER_CELL_ITALIC, false),
+                24 => self.pen.set_flag(PIER_CELL_UNDERLINE, false),
+                27 => self.pen.set_flag(PIER_CELL_INVERSE, false),
+                29 => self.pen.set_flag(PIER_CELL_STRIKETHROUGH, false),
+                n @ 30..=37 => self.pen.fg = Color::indexed((n - 30) as u8),
+                39 => self.pen.fg = Color::DEFAULT,
+                n @ 40..=47 => self.pen.bg = Color::indexed((n - 40) as u8),
+                49 => self.pen.bg = Color::DEFAULT,
+                n @ 90..=97 => self.pen.fg = Color::indexed((n - 90 + 8) as u8),
+                n @ 100..=107 => self.pen.bg = Color::indexed((n - 100 + 8) as u8),
+                38 | 48 => {
+                    // Extended color: either colon sub-params (38:5:n / 38:2:r:g:b)
+                    // or the legacy semicolon form consuming following params.
+                    let color = if param.len() > 1 {
+                        parse_extended_color(&param[1..])
+                    } else {
+                        let mut rest: Vec<u16> = Vec::with_capacity(4);
+                        match iter.next().map(|p| p[0]) {
+                            Some(5) => {
+                                rest.push(5);
+                                if let Some(p) = iter.next() { rest.push(p[0]); }
+                            }
+                            Some(2) => {
+                                rest.push(2);
+                                for _ in 0..3 {
+                                    if let Some(p) = iter.next() { rest.push(p[0]); }
+                                }
+                            }
+                            _ => {}
+                        }
+                        parse_extended_color(&rest)
+                    };
+                    if let Some(color) = color {
+                        if param[0] == 38 { self.pen.fg = color; } else { self.pen.bg = color; }
+                    }
+                }
+                _ => {}
+            }
+        }
     }
 
     fn newline(&mut self) {
@@ -123,8 +587,8 @@ impl<'a> Perform for EmulatorPerformer<'a> {
         if *self.cursor_x >= self.cols {
             self.newline();
         }
-        if *self.cursor_y < self.cells.len() && *self.cursor_x < self.cols {
-            self.cells[*self.cursor_y][*self.cursor_x].ch = ch;
+        if *self.cursor_y < self.rows && *self.cursor_x < self.cols {
+            self.grid.row_mut(*self.cursor_y)[*self.cursor_x] = self.pen.with_ch(ch);
             *self.cursor_x += 1;
         }
     }
@@ -164,11 +628,16 @@ impl<'a> Perform for EmulatorPerformer<'a> {
     fn put(&mut self, _byte: u8) {}
     fn unhook(&mut self) {}
 
-    fn osc_dispatch(&mut self, _params: &[&[u8]], _bell_terminated: bool) {
+    fn osc_dispatch(&mut self, _params: &[&[u8]], bell_terminated: bool) {
+        // ST-terminated OSC continues into an ESC \ dispatch.
+        if bell_terminated {
+            self.returned_to_ground = true;
+        }
         // TODO: handle OSC sequences (window title, clipboard, etc.)
     }
 
     fn csi_dispatch(&mut self, params: &vte::Params, _intermediates: &[u8], _ignore: bool, action: char) {
+        self.returned_to_ground = true;
         let mut params_iter = params.iter();
         let first = params_iter.next().and_then(|p| p.first().copied()).unwrap_or(0);
         let second = params_iter.next().and_then(|p| p.first().copied()).unwrap_or(0);
@@ -203,68 +672,87 @@ impl<'a> Perform for EmulatorPerformer<'a> {
             }
             // Erase in Display
             'J' => {
+                let (cx, cy) = (*self.cursor_x, *self.cursor_y);
                 match first {
                     0 => {
                         // Clear from cursor to end of screen
-                        for x in *self.cursor_x..self.cols {
-                            self.cells[*self.cursor_y][x] = Cell::default();
-                        }
-                        for y in (*self.cursor_y + 1)..self.rows {
-                            for x in 0..self.cols {
-                                self.cells[y][x] = Cell::default();
-                            }
+                        self.erase(cy, cx, self.cols);
+                        for y in (cy + 1)..self.rows {
+                            self.erase(y, 0, self.cols);
                         }
                     }
                     1 => {
                         // Clear from start to cursor
-                        for y in 0..*self.cursor_y {
-                            for x in 0..self.cols {
-                                self.cells[y][x] = Cell::default();
-                            }
-                        }
-                        for x in 0..=*self.cursor_x {
-                            self.cells[*self.cursor_y][x] = Cell::default();
+                        for y in 0..cy {
+                            self.erase(y, 0, self.cols);
                         }
+                        self.erase(cy, 0, cx + 1);
                     }
-                    2 | 3 => {
+                    2 => {
                         // Clear entire screen
                         for y in 0..self.rows {
-                            for x in 0..self.cols {
-                                self.cells[y][x] = Cell::default();
-                            }
+                            self.erase(y, 0, self.cols);
+                        }
+                    }
+                    3 => {
+                        // Clear entire screen and the saved lines
+                        for y in 0..self.rows {
+                            self.erase(y, 0, self.cols);
                         }
+                        self.scrollback.clear();
                     }
                     _ => {}
                 }
             }
             // Erase in Line
             'K' => {
+                let (cx, cy) = (*self.cursor_x, *self.cursor_y);
                 match first {
-                    0 => {
-                        for x in *self.cursor_x..self.cols {
-                            self.cells[*self.cursor_y][x] = Cell::default();
-                        }
-                    }
-                    1 => {
-                        for x in 0..=*self.cursor_x {
-                            self.cells[*self.cursor_y][x] = Cell::default();
-                        }
-                    }
-                    2 => {
-                        for x in 0..self.cols {
-                            self.cells[*self.cursor_y][x] = Cell::default();
-                        }
-                    }
+                    0 => self.erase(cy, cx, self.cols),
+                    1 => self.erase(cy, 0, cx + 1),
+                    2 => self.erase(cy, 0, self.cols),
                     _ => {}
                 }
             }
+            // Select Graphic Rendition
+            'm' => self.set_graphic_rendition(params),
             _ => {
-                // TODO: handle more CSI sequences (SGR, scroll, etc.)
+                // TODO: handle more CSI sequences (scroll regions, insert/delete, etc.)
             }
         }
     }
 
-    fn esc_dispatch(&mut self, _intermediates: &[u8], _ignore: bool, _byte: u8) {}
+    fn esc_dispatch(&mut self, _intermediates: &[u8], _ignore: bool, _byte: u8) {
+        self.returned_to_ground = true;
+    }
+
+    fn terminated(&self) -> bool {
+        self.returned_to_ground
+    }
+}
+
+/// Continuation bytes still owed after `bytes`, given `pending` before it.
+fn pending_utf8_continuations(mut pending: u8, bytes: &[u8]) -> u8 {
+    for &b in bytes {
+        pending = match b {
+            0x00..=0x7F => 0,
+            0x80..=0xBF => pending.saturating_sub(1),
+            0xC0..=0xDF => 1,
+            0xE0..=0xEF => 2,
+            0xF0..=0xF7 => 3,
+            _ => 0,
+        };
+    }
+    pending
+}
+
+/// Parse the tail of an extended color SGR (`5;n` or `2;r;g;b`).
+fn parse_extended_color(params: &[u16]) -> Option<Color> {
+    match params {
+        [5, idx, ..] => Some(Color::indexed(*idx as u8)),
+        [2, r, g, b, ..] => Some(Color::rgb(*r as u8, *g as u8, *b as u8)),
+        _ => None,
+    }
 }
 
 #[cfg(test)]
@@ -280,6 +768,25 @@ mod tests {
         assert_eq!(emu.cursor_y, 0);
     }
 
+    #[test]
+    fn test_write_screen_roundtrip() {
+        let mut emu = VtEmulator::new(20, 4);
+        emu.process("plain \x1b[1;31mred\x1b[0m\r\n\x1b[38;2;1;2;3;48;5;200mrgb é\x1b[4m".as_bytes());
+        emu.process(b"\x1b[4;18Hend");
+        let mut screen = Vec::new();
+        emu.write_screen(&mut screen);
+
+        let mut copy = VtEmulator::new(20, 4);
+        copy.process(&screen);
+        for row in 0..4 {
+            assert_eq!(copy.grid().row(row), emu.grid().row(row), "row {}", row);
+        }
+        assert_eq!((copy.cursor_x, copy.cursor_y), (emu.cursor_x.min(19), emu.cursor_y));
+        // The pen carries over to whatever is printed next.
+        copy.process(b"x");
+        assert!(copy.cell(3, 19).has_flag(PIER_CELL_UNDERLINE));
+    }
+
     #[test]
     fn test_newline() {
         let mut emu = VtEmulator::new(80, 24);
@@ -293,7 +800,7 @@ mod tests {
         let mut emu = VtEmulator::new(80, 24);
         // ESC[5;10H moves cursor to row 5, col 10
         emu.process(b"\x1b[5;10HX");
-        assert_eq!(emu.cells[4][9].ch, 'X');
+        assert_eq!(emu.cell(4, 9).ch(), 'X');
     }
 
     #[test]
@@ -303,4 +810,84 @@ mod tests {
         emu.process(b"\x1b[2J");
         assert_eq!(emu.get_line_text(0).trim(), "");
     }
+
+    #[test]
+    fn test_sgr_colors() {
+        let mut emu = VtEmulator::new(80, 24);
+        emu.process(b"\x1b[1;31mA\x1b[38;5;200mB\x1b[38;2;1;2;3mC\x1b[0mD");
+        assert!(emu.cell(0, 0).has_flag(PIER_CELL_BOLD));
+        assert_eq!(emu.cell(0, 0).fg, Color::indexed(1));
+        assert_eq!(emu.cell(0, 1).fg, Color::indexed(200));
+        assert_eq!(emu.cell(0, 2).fg.packed(), PIER_COLOR_RGB | 0x010203);
+        assert_eq!(emu.cell(0, 3).fg, Color::DEFAULT);
+        assert!(!emu.cell(0, 3).has_flag(PIER_CELL_BOLD));
+    }
+
+    #[test]
+    fn test_dirty_tracking() {
+        let mut emu = VtEmulator::new(10, 4);
+        assert_eq!(emu.drain_dirty(usize::MAX, |_, _| {}), 4);
+        assert_eq!(emu.dirty_count(), 0);
+
+        emu.process(b"\x1b[3;1Hx");
+        let mut rows = Vec::new();
+        emu.drain_dirty(usize::MAX, |row, cells| {
+            rows.push(row);
+            assert_eq!(cells[0].ch(), 'x');
+        });
+        assert_eq!(rows, vec![2]);
+
+        // Scrolling damages every row; a capped drain leaves the rest queued.
+        emu.process(b"\n\n\n");
+        assert_eq!(emu.drain_dirty(3, |_, _| {}), 3);
+        assert_eq!(emu.dirty_count(), 1);
+    }
+
+    #[test]
+    fn test_scroll_ring() {
+        assert_eq!(std::mem::size_of::<Cell>(), 12);
+
+        let mut emu = VtEmulator::new(10, 3);
+        emu.process(b"a\r\nb\r\nc\r\nd\r\ne");
+        assert_eq!(emu.get_line_text(0).trim(), "c");
+        assert_eq!(emu.get_line_text(1).trim(), "d");
+        assert_eq!(emu.get_line_text(2).trim(), "e");
+
+        // Resizing linearizes the ring and keeps row order.
+        emu.resize(5, 4);
+        assert_eq!(emu.get_line_text(0), "c    ");
+        assert_eq!(emu.get_line_text(2), "e    ");
+        assert_eq!(emu.get_line_text(3), "     ");
+
+        // The two lines pushed off the top went to scrollback.
+        assert_eq!(emu.scrollback_mut().line_text(0).as_deref(), Some("a"));
+        assert_eq!(emu.scrollback_mut().line_text(1).as_deref(), Some("b"));
+    }
+
+    #[test]
+    fn test_fast_path_matches_split_feeds() {
+        let stream: &[u8] = b"plain text \x1b[1;32mgreen\x1b[0m caf\xc3\xa9 \xe2\x94\x80\r\n\
+            \x1b]0;title\x07after osc\ttab\x1b[5;3Hmoved\x1b[K end\r\nwrap-around-line-that-is-long";
+
+        let mut whole = VtEmulator::new(16, 6);
+        whole.process(stream);
+
+        for chunk in [1usize, 2, 3, 5, 7] {
+            let mut split = VtEmulator::new(16, 6);
+            for part in stream.chunks(chunk) {
+                split.process(part);
+            }
+            for row in 0..6 {
+                assert_eq!(split.grid().row(row), whole.grid().row(row), "chunk={} row={}", chunk, row);
+            }
+            assert_eq!((split.cursor_x, split.cursor_y), (whole.cursor_x, whole.cursor_y));
+        }
+
+        // CSI parameters split from their ESC must not be printed as text.
+        let mut emu = VtEmulator::new(10, 2);
+        emu.process(b"\x1b[3");
+        emu.process(b"1mX");
+        assert_eq!(emu.cell(0, 0).ch(), 'X');
+        assert_eq!(emu.cell(0, 0).fg, Color::indexed(1));
+    }
 }
@@ -1,8 +1,16 @@
 pub mod emulator;
 pub mod pty;
+pub mod reactor;
+pub mod recording;
+pub mod scan;
+pub mod scrollback;
 
-use std::sync::{Arc, Mutex};
+use crate::metrics::{self, TerminalMetrics};
+use crate::terminal::emulator::VtEmulator;
 use crate::terminal::pty::PtyProcess;
+use crate::terminal::reactor::OutputSink;
+use crate::terminal::recording::Tap;
+use std::sync::Arc;
 
 /// Represents a terminal session with a PTY backend and VT parser.
 pub struct TerminalSession {
@@ -11,36 +19,39 @@ pub struct TerminalSession {
     /// Terminal grid dimensions
     pub cols: u16,
     pub rows: u16,
-    /// Scrollback buffer: each line is a string of rendered characters
-    pub scrollback: Arc<Mutex<Vec<String>>>,
-    /// Current screen buffer (rows x cols)
-    pub screen: Arc<Mutex<Vec<Vec<char>>>>,
+    /// VT emulator holding the current screen grid, its damage state and
+    /// the compressed scrollback history
+    pub emulator: VtEmulator,
+    /// Output volume and VT parse time for this terminal
+    pub metrics: TerminalMetrics,
+    /// Tees PTY output into a session recording while one is running.
+    pub recording: Arc<Tap>,
 }
 
 impl TerminalSession {
     /// Create a new terminal session with given dimensions.
     pub fn new(cols: u16, rows: u16, shell: &str) -> Result<Self, std::io::Error> {
         let pty = PtyProcess::spawn(cols, rows, shell)?;
-        let screen = vec![vec![' '; cols as usize]; rows as usize];
         Ok(Self {
             pty,
             cols,
             rows,
-            scrollback: Arc::new(Mutex::new(Vec::new())),
-            screen: Arc::new(Mutex::new(screen)),
+            emulator: VtEmulator::new(cols as usize, rows as usize),
+            metrics: TerminalMetrics::default(),
+            recording: Arc::default(),
         })
     }
 
     /// Create a new terminal session running a specific command with arguments.
     pub fn new_with_command(cols: u16, rows: u16, program: &str, args: &[&str]) -> Result<Self, std::io::Error> {
         let pty = PtyProcess::spawn_command(cols, rows, program, args)?;
-        let screen = vec![vec![' '; cols as usize]; rows as usize];
         Ok(Self {
             pty,
             cols,
             rows,
-            scrollback: Arc::new(Mutex::new(Vec::new())),
-            screen: Arc::new(Mutex::new(screen)),
+            emulator: VtEmulator::new(cols as usize, rows as usize),
+            metrics: TerminalMetrics::default(),
+            recording: Arc::default(),
         })
     }
 
@@ -49,11 +60,8 @@ impl TerminalSession {
         self.cols = cols;
         self.rows = rows;
         self.pty.resize(cols, rows)?;
-        let mut screen = self.screen.lock().unwrap();
-        screen.resize(rows as usize, vec![' '; cols as usize]);
-        for row in screen.iter_mut() {
-            row.resize(cols as usize, ' ');
-        }
+        self.emulator.resize(cols as usize, rows as usize);
+        self.recording.resize(cols, rows);
         Ok(())
     }
 
@@ -62,9 +70,48 @@ impl TerminalSession {
         self.pty.write(data)
     }
 
-    /// Read available output from the PTY.
-    /// Returns the raw bytes for VT parsing.
-    pub fn read(&mut self) -> Result<Vec<u8>, std::io::Error> {
-        self.pty.read()
+    /// Feed PTY output through the VT emulator, updating the screen grid
+    /// and marking changed rows dirty.
+    pub fn process(&mut self, data: &[u8]) {
+        let _signpost = metrics::signpost!("vt_process");
+        let _timer = self.metrics.vt_process.start().and(&metrics::global().vt_process);
+        self.metrics.bytes_processed.add(data.len() as u64);
+        self.emulator.process(data);
+    }
+
+    /// Read available output from the PTY into `buf`.
+    /// Returns the number of raw bytes (for VT parsing) written to `buf`.
+    pub fn read_into(&mut self, buf: &mut [u8]) -> Result<usize, std::io::Error> {
+        let n = self.pty.read_into(buf)?;
+        self.recording.output(&buf[..n]);
+        Ok(n)
+    }
+
+    /// Have the shared reactor push this session's output to `sink`
+    /// instead of the caller polling `read_into`.
+    pub fn watch_output(&mut self, mut sink: OutputSink) -> Result<(), std::io::Error> {
+        let recording = Arc::clone(&self.recording);
+        let sink: OutputSink = Box::new(move |output| {
+            if let Some(bytes) = output {
+                recording.output(bytes);
+            }
+            sink(output);
+        });
+        match reactor::global() {
+            Some(reactor) => reactor.watch(self.pty.raw_fd(), sink),
+            None => Err(std::io::Error::other("PTY reactor unavailable")),
+        }
+    }
+
+    /// Stop reactor delivery for this session.
+    pub fn unwatch_output(&mut self) -> bool {
+        reactor::running().is_some_and(|reactor| reactor.unwatch(self.pty.raw_fd()))
+    }
+}
+
+impl Drop for TerminalSession {
+    fn drop(&mut self) {
+        // The fd closes with `pty`; make sure the reactor lets go of it first.
+        self.unwatch_output();
     }
 }
@@ -1,4 +1,5 @@
 use std::os::fd::{FromRawFd, OwnedFd, AsRawFd};
+use crate::metrics;
 
 /// Manages a pseudo-terminal (PTY) process on macOS/Unix.
 pub struct PtyProcess {
@@ -152,32 +153,51 @@ impl PtyProcess {
         }
     }
 
-    /// Read available data from the PTY master (output from the shell).
-    pub fn read(&self) -> Result<Vec<u8>, std::io::Error> {
-        let mut buf = vec![0u8; 65536];
-        let fd = self.master_fd.as_raw_fd();
+    /// Read available data from the PTY master straight into `buf`.
+    ///
+    /// Issues `read(2)` directly into the caller's buffer (no intermediate
+    /// allocation) and keeps reading until the buffer is full or the fd
+    /// would block, so a single call drains as much as the caller can hold.
+    /// Returns the number of bytes written to `buf`; 0 means no data is
+    /// currently available (or the child closed the PTY).
+    pub fn read_into(&self, buf: &mut [u8]) -> Result<usize, std::io::Error> {
+        read_fd_into(self.master_fd.as_raw_fd(), buf)
+    }
+
+    /// Get the raw file descriptor for polling/select.
+    pub fn raw_fd(&self) -> i32 {
+        self.master_fd.as_raw_fd()
+    }
+}
+
+/// `read(2)` from a non-blocking fd into `buf` until it is full or the fd
+/// would block. Shared by `PtyProcess::read_into` and the output reactor.
+pub(crate) fn read_fd_into(fd: i32, buf: &mut [u8]) -> Result<usize, std::io::Error> {
+    let mut filled = 0;
+    while filled < buf.len() {
+        let remaining = &mut buf[filled..];
         let result = unsafe {
-            libc::read(fd, buf.as_mut_ptr() as *mut libc::c_void, buf.len())
+            libc::read(fd, remaining.as_mut_ptr() as *mut libc::c_void, remaining.len())
         };
+        metrics::global().pty_reads.add(1);
         if result > 0 {
-            buf.truncate(result as usize);
-            Ok(buf)
+            filled += result as usize;
+            metrics::global().pty_bytes_read.add(result as u64);
         } else if result == 0 {
-            Ok(Vec::new())
+            break; // EOF
         } else {
             let err = std::io::Error::last_os_error();
-            if err.kind() == std::io::ErrorKind::WouldBlock {
-                Ok(Vec::new())
-            } else {
-                Err(err)
+            match err.kind() {
+                std::io::ErrorKind::Interrupted => continue,
+                std::io::ErrorKind::WouldBlock => break,
+                // Hand back what we already have; the error will
+                // resurface on the next call.
+                _ if filled > 0 => break,
+                _ => return Err(err),
             }
         }
     }
-
-    /// Get the raw file descriptor for polling/select.
-    pub fn raw_fd(&self) -> i32 {
-        self.master_fd.as_raw_fd()
-    }
+    Ok(filled)
 }
 
 impl Drop for PtyProcess {
@@ -206,3 +226,27 @@ impl Drop for PtyProcess {
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_read_into_small_buffer_keeps_remainder() {
+        let pty = PtyProcess::spawn_command(80, 24, "/bin/echo", &["0123456789"]).unwrap();
+        let mut small = [0u8; 4];
+        let mut out = Vec::new();
+        for _ in 0..100 {
+            let n = pty.read_into(&mut small).unwrap_or(0);
+            assert!(n <= small.len());
+            out.extend_from_slice(&small[..n]);
+            if out.windows(10).any(|w| w == b"0123456789") {
+                break;
+            }
+            if n == 0 {
+                std::thread::sleep(std::time::Duration::from_millis(10));
+            }
+        }
+        assert!(String::from_utf8_lossy(&out).contains("0123456789"));
+    }
+}
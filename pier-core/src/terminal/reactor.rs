@@ -0,0 +1,346 @@
+//! Shared PTY output reactor.
+//!
+//! One background thread watches every registered PTY master fd with
+//! epoll (Linux) or kqueue (macOS/BSD). Output is drained as soon as the fd
+//! becomes readable and coalesced per session; each session's sink is
+//! invoked at most once per frame interval with everything that arrived in
+//! that frame. The first chunk after an idle period is delivered right away,
+//! so typing echo is not delayed by frame pacing. When nothing is pending the
+//! thread blocks without a timeout, so idle tabs cost no wakeups.
+
+use std::collections::HashMap;
+use std::io;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex, OnceLock};
+use std::time::{Duration, Instant};
+
+use crate::terminal::pty::read_fd_into;
+
+/// Receives coalesced output for one session: `Some(bytes)` for output,
+/// `None` once the PTY has closed (the watch is removed afterwards).
+///
+/// Sinks run on the reactor thread with the watch table locked, so they
+/// must not call `watch`/`unwatch` themselves.
+pub type OutputSink = Box<dyn FnMut(Option<&[u8]>) + Send>;
+
+/// Default pacing: one delivery per 60 Hz display frame.
+pub const DEFAULT_FRAME_INTERVAL: Duration = Duration::from_micros(16_667);
+
+/// Size of each `read(2)` issued by the reactor.
+const READ_CHUNK: usize = 64 * 1024;
+
+/// Pending output above this is delivered immediately instead of waiting for
+/// the next frame, bounding per-session memory under heavy output.
+const MAX_PENDING: usize = 1024 * 1024;
+
+struct Watch {
+    sink: OutputSink,
+    pending: Vec<u8>,
+    last_flush: Option<Instant>,
+}
+
+impl Watch {
+    fn flush(&mut self, now: Instant) {
+        if !self.pending.is_empty() {
+            (self.sink)(Some(&self.pending));
+            self.pending.clear();
+            self.last_flush = Some(now);
+        }
+    }
+
+    /// Read everything currently available on `fd`.
+    /// Returns true if the PTY has closed.
+    fn drain(&mut self, fd: i32, buf: &mut [u8], hup: bool, now: Instant) -> bool {
+        loop {
+            match read_fd_into(fd, buf) {
+                Ok(0) => return hup,
+                Ok(n) => {
+                    self.pending.extend_from_slice(&buf[..n]);
+                    if self.pending.len() >= MAX_PENDING {
+                        self.flush(now);
+                    }
+                    if n < buf.len() {
+                        return false;
+                    }
+                }
+                // EIO once the child side is gone (Linux), or a dead fd.
+                Err(_) => return true,
+            }
+        }
+    }
+}
+
+/// The output reactor. Use [`global`] from FFI; tests may start their own.
+pub struct Reactor {
+    poller: sys::Poller,
+    watches: Mutex<HashMap<i32, Watch>>,
+    frame_interval_us: AtomicU64,
+}
+
+impl Reactor {
+    /// Create a reactor and start its thread.
+    pub fn start() -> io::Result<Arc<Reactor>> {
+        let reactor = Arc::new(Reactor {
+            poller: sys::Poller::new()?,
+            watches: Mutex::new(HashMap::new()),
+            frame_interval_us: AtomicU64::new(DEFAULT_FRAME_INTERVAL.as_micros() as u64),
+        });
+        let runner = Arc::clone(&reactor);
+        std::thread::Builder::new()
+            .name("pier-pty-reactor".into())
+            .spawn(move || runner.run())?;
+        Ok(reactor)
+    }
+
+    /// Deliver output from `fd` to `sink`, replacing any existing watch.
+    /// The fd must be non-blocking and stay open until `unwatch` returns.
+    pub fn watch(&self, fd: i32, sink: OutputSink) -> io::Result<()> {
+        let mut watches = self.watches.lock().unwrap();
+        if watches.remove(&fd).is_some() {
+            let _ = self.poller.remove(fd);
+        }
+        self.poller.add(fd)?;
+        watches.insert(fd, Watch { sink, pending: Vec::new(), last_flush: None });
+        Ok(())
+    }
+
+    /// Stop watching `fd`. Once this returns the sink will not be called
+    /// again; output still pending is dropped.
+    pub fn unwatch(&self, fd: i32) -> bool {
+        let mut watches = self.watches.lock().unwrap();
+        if watches.remove(&fd).is_some() {
+            let _ = self.poller.remove(fd);
+            true
+        } else {
+            false
+        }
+    }
+
+    /// Change the coalescing interval (takes effect on the next wakeup).
+    pub fn set_frame_interval(&self, interval: Duration) {
+        self.frame_interval_us.store(interval.as_micros() as u64, Ordering::Relaxed);
+    }
+
+    fn frame_interval(&self) -> Duration {
+        Duration::from_micros(self.frame_interval_us.load(Ordering::Relaxed))
+    }
+
+    fn run(&self) {
+        let mut events = Vec::with_capacity(64);
+        let mut buf = vec![0u8; READ_CHUNK];
+        let mut closed = Vec::new();
+        let mut deadline: Option<Instant> = None;
+
+        loop {
+            let timeout = deadline.map(|d| d.saturating_duration_since(Instant::now()));
+            if let Err(e) = self.poller.wait(&mut events, timeout) {
+                if e.kind() != io::ErrorKind::Interrupted {
+                    log::error!("PTY reactor wait failed: {}", e);
+                    std::thread::sleep(Duration::from_millis(100));
+                }
+                continue;
+            }
+
+            let now = Instant::now();
+            let frame = self.frame_interval();
+            let mut watches = self.watches.lock().unwrap();
+
+            for &(fd, hup) in &events {
+                if let Some(watch) = watches.get_mut(&fd) {
+                    if watch.drain(fd, &mut buf, hup, now) {
+                        closed.push(fd);
+                    }
+                }
+            }
+            for fd in closed.drain(..) {
+                if let Some(mut watch) = watches.remove(&fd) {
+                    let _ = self.poller.remove(fd);
+                    watch.flush(now);
+                    (watch.sink)(None);
+                }
+            }
+
+            deadline = None;
+            for watch in watches.values_mut() {
+                if watch.pending.is_empty() {
+                    continue;
+                }
+                match watch.last_flush {
+                    Some(last) if now.duration_since(last) < frame => {
+                        let due = last + frame;
+                        deadline = Some(deadline.map_or(due, |d| d.min(due)));
+                    }
+                    _ => watch.flush(now),
+                }
+            }
+        }
+    }
+}
+
+static REACTOR: OnceLock<Option<Arc<Reactor>>> = OnceLock::new();
+
+/// The process-wide reactor, started on first use.
+/// Returns None if the OS poller could not be created.
+pub fn global() -> Option<&'static Arc<Reactor>> {
+    REACTOR
+        .get_or_init(|| match Reactor::start() {
+            Ok(reactor) => Some(reactor),
+            Err(e) => {
+                log::error!("Failed to start PTY reactor: {}", e);
+                None
+            }
+        })
+        .as_ref()
+}
+
+/// The process-wide reactor if it has already been started.
+pub fn running() -> Option<&'static Arc<Reactor>> {
+    REACTOR.get().and_then(|reactor| reactor.as_ref())
+}
+
+#[cfg(any(target_os = "linux", target_os = "android"))]
+mod sys {
+    use std::io;
+    use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+    use std::time::Duration;
+
+    pub struct Poller {
+        epoll: OwnedFd,
+    }
+
+    impl Poller {
+        pub fn new() -> io::Result<Self> {
+            let fd = unsafe { libc::epoll_create1(libc::EPOLL_CLOEXEC) };
+            if fd < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(Self { epoll: unsafe { OwnedFd::from_raw_fd(fd) } })
+        }
+
+        pub fn add(&self, fd: i32) -> io::Result<()> {
+            let mut event = libc::epoll_event {
+                events: (libc::EPOLLIN | libc::EPOLLRDHUP) as u32,
+                u64: fd as u64,
+            };
+            let result = unsafe { libc::epoll_ctl(self.epoll.as_raw_fd(), libc::EPOLL_CTL_ADD, fd, &mut event) };
+            if result < 0 { Err(io::Error::last_os_error()) } else { Ok(()) }
+        }
+
+        pub fn remove(&self, fd: i32) -> io::Result<()> {
+            let result = unsafe {
+                libc::epoll_ctl(self.epoll.as_raw_fd(), libc::EPOLL_CTL_DEL, fd, std::ptr::null_mut())
+            };
+            if result < 0 { Err(io::Error::last_os_error()) } else { Ok(()) }
+        }
+
+        /// Wait for readiness; fills `out` with `(fd, hung_up)` pairs.
+        pub fn wait(&self, out: &mut Vec<(i32, bool)>, timeout: Option<Duration>) -> io::Result<()> {
+            let mut events = [libc::epoll_event { events: 0, u64: 0 }; 64];
+            // Round up so a pending deadline never turns into a busy loop.
+            let timeout_ms = timeout.map_or(-1, |t| t.as_micros().div_ceil(1000).min(i32::MAX as u128) as i32);
+            let n = unsafe {
+                libc::epoll_wait(self.epoll.as_raw_fd(), events.as_mut_ptr(), events.len() as i32, timeout_ms)
+            };
+            out.clear();
+            if n < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            for event in &events[..n as usize] {
+                let hup = event.events & (libc::EPOLLHUP | libc::EPOLLRDHUP | libc::EPOLLERR) as u32 != 0;
+                out.push((event.u64 as i32, hup));
+            }
+            Ok(())
+        }
+    }
+}
+
+#[cfg(any(target_os = "macos", target_os = "ios", target_os = "freebsd", target_os = "openbsd", target_os = "netbsd"))]
+mod sys {
+    use std::io;
+    use std::os::fd::{AsRawFd, FromRawFd, OwnedFd};
+    use std::time::Duration;
+
+    pub struct Poller {
+        kq: OwnedFd,
+    }
+
+    impl Poller {
+        pub fn new() -> io::Result<Self> {
+            let fd = unsafe { libc::kqueue() };
+            if fd < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            unsafe { libc::fcntl(fd, libc::F_SETFD, libc::FD_CLOEXEC) };
+            Ok(Self { kq: unsafe { OwnedFd::from_raw_fd(fd) } })
+        }
+
+        fn change(&self, fd: i32, flags: u16) -> io::Result<()> {
+            let mut event: libc::kevent = unsafe { std::mem::zeroed() };
+            event.ident = fd as libc::uintptr_t;
+            event.filter = libc::EVFILT_READ;
+            event.flags = flags;
+            let result = unsafe {
+                libc::kevent(self.kq.as_raw_fd(), &event, 1, std::ptr::null_mut(), 0, std::ptr::null())
+            };
+            if result < 0 { Err(io::Error::last_os_error()) } else { Ok(()) }
+        }
+
+        pub fn add(&self, fd: i32) -> io::Result<()> {
+            self.change(fd, libc::EV_ADD | libc::EV_ENABLE)
+        }
+
+        pub fn remove(&self, fd: i32) -> io::Result<()> {
+            self.change(fd, libc::EV_DELETE)
+        }
+
+        /// Wait for readiness; fills `out` with `(fd, hung_up)` pairs.
+        pub fn wait(&self, out: &mut Vec<(i32, bool)>, timeout: Option<Duration>) -> io::Result<()> {
+            let mut events: [libc::kevent; 64] = unsafe { std::mem::zeroed() };
+            let ts = timeout.map(|t| libc::timespec {
+                tv_sec: t.as_secs() as libc::time_t,
+                tv_nsec: t.subsec_nanos() as libc::c_long,
+            });
+            let ts_ptr = ts.as_ref().map_or(std::ptr::null(), |t| t as *const libc::timespec);
+            let n = unsafe {
+                libc::kevent(self.kq.as_raw_fd(), std::ptr::null(), 0, events.as_mut_ptr(), events.len() as i32, ts_ptr)
+            };
+            out.clear();
+            if n < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            for event in &events[..n as usize] {
+                out.push((event.ident as i32, event.flags & libc::EV_EOF != 0));
+            }
+            Ok(())
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::terminal::pty::PtyProcess;
+    use std::sync::mpsc;
+
+    #[test]
+    fn test_reactor_delivers_output_and_close() {
+        let reactor = Reactor::start().unwrap();
+        let pty = PtyProcess::spawn_command(80, 24, "/bin/echo", &["reactor-output"]).unwrap();
+        let (tx, rx) = mpsc::channel();
+        reactor
+            .watch(pty.raw_fd(), Box::new(move |data| {
+                let _ = tx.send(data.map(|d| d.to_vec()));
+            }))
+            .unwrap();
+
+        let mut out = Vec::new();
+        loop {
+            match rx.recv_timeout(Duration::from_secs(5)).expect("reactor event") {
+                Some(chunk) => out.extend_from_slice(&chunk),
+                None => break,
+            }
+        }
+        assert!(String::from_utf8_lossy(&out).contains("reactor-output"));
+        assert!(!reactor.unwatch(pty.raw_fd()), "closed PTY is unwatched automatically");
+    }
+}
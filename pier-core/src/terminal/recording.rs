@@ -0,0 +1,847 @@
+//! Session recording and replay.
+//!
+//! A [`Tap`] sits on a terminal's read path. While it is recording, each
+//! chunk of PTY output is appended to an in-memory block as a timestamped
+//! frame: one uncontended lock and a copy into the block buffer. No parsing,
+//! compression or I/O happens there. Full blocks go to a writer thread. That
+//! thread compresses them, appends them to the file and runs the output
+//! through its own emulator to place keyframes.
+//!
+//! File layout, all integers little-endian:
+//!
+//! ```text
+//! header  = "PIERREC1" | start (unix ms, u64) | cols u16 | rows u16 | 0u32
+//! block   = "PRB1" | flags u32 | first_us u64 | last_us u64
+//!           | raw_len u32 | data_len u32 | text bloom (2 KiB) | LZ4 data
+//!           (size-prepended, as in the scrollback)
+//! trailer = index entries | index offset u64 | "PRECIDX1"
+//! ```
+//!
+//! A block's data decompresses to frames of `kind u8 | time_us u64 |
+//! len u32 | payload`, with times relative to the start of the recording.
+//! The file is only ever appended to. The index is written when recording
+//! stops; without it, as after a crash or while the session is still being
+//! recorded, the block headers are scanned instead.
+//!
+//! Every `KEYFRAME_BYTES` of output, the next block starts with a keyframe.
+//! This is a frame holding escape sequences that redraw the screen as it
+//! was at that point. Seeking replays from the nearest keyframe, so it
+//! never parses more than about that much output. Each block's bloom
+//! filter holds the trigrams of its text, plus those of the previous
+//! block's tail. Search only decompresses blocks whose filter admits
+//! every trigram of the query.
+
+use std::fs::File;
+use std::io::Write;
+use std::path::Path;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{mpsc, Mutex};
+use std::time::{Duration, Instant, SystemTime};
+
+use crate::terminal::emulator::VtEmulator;
+use crate::terminal::scrollback::ScrollbackConfig;
+
+const FILE_MAGIC: &[u8; 8] = b"PIERREC1";
+const FILE_HEADER_LEN: usize = 24;
+const BLOCK_MAGIC: &[u8; 4] = b"PRB1";
+const INDEX_MAGIC: &[u8; 8] = b"PRECIDX1";
+const INDEX_ENTRY_LEN: usize = 32;
+
+const BLOOM_BYTES: usize = 2048;
+const BLOCK_HEADER_LEN: usize = 32 + BLOOM_BYTES;
+const FRAME_HEADER_LEN: usize = 13;
+
+/// Raw frame bytes collected before a block is sealed.
+const BLOCK_BYTES: usize = 64 * 1024;
+
+/// A block is sealed at the first output after it has been open this
+/// long, even if it isn't full, so little is lost to a crash.
+const FLUSH_INTERVAL: Duration = Duration::from_secs(10);
+
+/// Output between keyframes, bounding the work of a seek.
+const KEYFRAME_BYTES: usize = 1024 * 1024;
+
+/// Text carried from one block into the next block's bloom filter, so
+/// matches up to this long that straddle a block boundary are found.
+const TAIL_LEN: usize = 256;
+
+/// Block flag: the block starts with a keyframe.
+const FLAG_KEYFRAME: u32 = 1;
+
+const FRAME_OUTPUT: u8 = 0;
+const FRAME_RESIZE: u8 = 1;
+const FRAME_KEYFRAME: u8 = 2;
+
+// ═══════════════════════════════════════════════════════════
+// Recording
+// ═══════════════════════════════════════════════════════════
+
+/// A terminal's recording switch. Costs one atomic load per read while
+/// not recording.
+#[derive(Default)]
+pub struct Tap {
+    active: AtomicBool,
+    recorder: Mutex<Option<Recorder>>,
+}
+
+struct Recorder {
+    start: Instant,
+    /// Frames of the block being filled.
+    pending: Vec<u8>,
+    /// When the block being filled was started.
+    opened: Instant,
+    blocks: mpsc::Sender<Vec<u8>>,
+    writer: std::thread::JoinHandle<Result<(), anyhow::Error>>,
+}
+
+impl Tap {
+    /// Start recording to a new file at `path`, replacing any recording
+    /// already in progress.
+    pub fn start(&self, path: &Path, cols: u16, rows: u16) -> Result<(), anyhow::Error> {
+        let mut file = File::create(path)?;
+        let start_ms = SystemTime::now()
+            .duration_since(SystemTime::UNIX_EPOCH)
+            .map_or(0, |d| d.as_millis() as u64);
+        let mut header = [0u8; FILE_HEADER_LEN];
+        header[..8].copy_from_slice(FILE_MAGIC);
+        header[8..16].copy_from_slice(&start_ms.to_le_bytes());
+        header[16..18].copy_from_slice(&cols.to_le_bytes());
+        header[18..20].copy_from_slice(&rows.to_le_bytes());
+        file.write_all(&header)?;
+
+        let (blocks, received) = mpsc::channel();
+        let writer = std::thread::Builder::new()
+            .name("pier-recorder".into())
+            .spawn(move || BlockWriter::new(file, cols, rows).run(received))?;
+        let recorder = Recorder {
+            start: Instant::now(),
+            pending: Vec::with_capacity(BLOCK_BYTES * 2),
+            opened: Instant::now(),
+            blocks,
+            writer,
+        };
+
+        let previous = self.recorder.lock().unwrap().replace(recorder);
+        self.active.store(true, Ordering::Release);
+        if let Some(previous) = previous {
+            previous.finish()?;
+        }
+        Ok(())
+    }
+
+    /// Stop recording and wait for the file to be complete. Returns false
+    /// if nothing was being recorded.
+    pub fn stop(&self) -> Result<bool, anyhow::Error> {
+        self.active.store(false, Ordering::Release);
+        let recorder = self.recorder.lock().unwrap().take();
+        match recorder {
+            Some(recorder) => recorder.finish().map(|_| true),
+            None => Ok(false),
+        }
+    }
+
+    pub fn is_recording(&self) -> bool {
+        self.active.load(Ordering::Acquire)
+    }
+
+    /// Record PTY output.
+    #[inline]
+    pub fn output(&self, data: &[u8]) {
+        if self.is_recording() && !data.is_empty() {
+            self.frame(FRAME_OUTPUT, data);
+        }
+    }
+
+    /// Record a terminal resize.
+    pub fn resize(&self, cols: u16, rows: u16) {
+        if self.is_recording() {
+            let mut size = [0u8; 4];
+            size[..2].copy_from_slice(&cols.to_le_bytes());
+            size[2..].copy_from_slice(&rows.to_le_bytes());
+            self.frame(FRAME_RESIZE, &size);
+        }
+    }
+
+    fn frame(&self, kind: u8, payload: &[u8]) {
+        let mut guard = self.recorder.lock().unwrap();
+        let Some(recorder) = guard.as_mut() else { return };
+        let now = Instant::now();
+        let time_us = now.duration_since(recorder.start).as_micros() as u64;
+        push_frame(&mut recorder.pending, kind, time_us, payload);
+        if recorder.pending.len() >= BLOCK_BYTES || now.duration_since(recorder.opened) >= FLUSH_INTERVAL {
+            recorder.opened = now;
+            let block = std::mem::replace(&mut recorder.pending, Vec::with_capacity(BLOCK_BYTES * 2));
+            // A failed writer has logged why; further output is dropped.
+            let _ = recorder.blocks.send(block);
+        }
+    }
+}
+
+impl Drop for Tap {
+    fn drop(&mut self) {
+        if let Err(e) = self.stop() {
+            log::error!("Recording failed: {}", e);
+        }
+    }
+}
+
+impl Recorder {
+    fn finish(self) -> Result<(), anyhow::Error> {
+        if !self.pending.is_empty() {
+            let _ = self.blocks.send(self.pending);
+        }
+        // Closing the channel tells the writer to write the index.
+        drop(self.blocks);
+        self.writer.join().map_err(|_| anyhow::anyhow!("Recording writer panicked"))?
+    }
+}
+
+fn push_frame(out: &mut Vec<u8>, kind: u8, time_us: u64, payload: &[u8]) {
+    out.push(kind);
+    out.extend_from_slice(&time_us.to_le_bytes());
+    out.extend_from_slice(&(payload.len() as u32).to_le_bytes());
+    out.extend_from_slice(payload);
+}
+
+/// Iterate `(kind, time_us, payload)` over decompressed frames; stops at a
+/// truncated frame.
+fn frames(raw: &[u8]) -> impl Iterator<Item = (u8, u64, &[u8])> {
+    let mut rest = raw;
+    std::iter::from_fn(move || {
+        if rest.len() < FRAME_HEADER_LEN {
+            return None;
+        }
+        let kind = rest[0];
+        let time_us = u64::from_le_bytes(rest[1..9].try_into().unwrap());
+        let len = u32::from_le_bytes(rest[9..13].try_into().unwrap()) as usize;
+        let payload = rest.get(FRAME_HEADER_LEN..FRAME_HEADER_LEN + len)?;
+        rest = &rest[FRAME_HEADER_LEN + len..];
+        Some((kind, time_us, payload))
+    })
+}
+
+#[derive(Clone, Copy, Debug)]
+struct BlockEntry {
+    offset: u64,
+    first_us: u64,
+    last_us: u64,
+    flags: u32,
+}
+
+/// The writer thread's side: compression, keyframes, bloom filters, I/O.
+struct BlockWriter {
+    file: File,
+    offset: u64,
+    index: Vec<BlockEntry>,
+    /// Mirrors the recorded terminal, for keyframes.
+    emulator: VtEmulator,
+    since_keyframe: usize,
+    text: TextExtractor,
+}
+
+impl BlockWriter {
+    fn new(file: File, cols: u16, rows: u16) -> Self {
+        let mut emulator = VtEmulator::new(cols as usize, rows as usize);
+        emulator.scrollback_mut().set_config(ScrollbackConfig { max_lines: 0, ..ScrollbackConfig::default() });
+        Self {
+            file,
+            offset: FILE_HEADER_LEN as u64,
+            index: Vec::new(),
+            emulator,
+            since_keyframe: KEYFRAME_BYTES,
+            text: TextExtractor::default(),
+        }
+    }
+
+    fn run(mut self, blocks: mpsc::Receiver<Vec<u8>>) -> Result<(), anyhow::Error> {
+        let result = (|| {
+            for block in blocks {
+                self.write_block(block)?;
+            }
+            self.write_index()
+        })();
+        if let Err(e) = &result {
+            log::error!("Recording write failed: {}", e);
+        }
+        result
+    }
+
+    fn write_block(&mut self, mut raw: Vec<u8>) -> Result<(), anyhow::Error> {
+        let first_us = frames(&raw).next().map_or(0, |(_, t, _)| t);
+        let mut flags = 0;
+        if self.since_keyframe >= KEYFRAME_BYTES && self.emulator.in_ground_state() {
+            let mut screen = Vec::with_capacity(16 * 1024);
+            screen.extend_from_slice(&(self.emulator.cols as u16).to_le_bytes());
+            screen.extend_from_slice(&(self.emulator.rows as u16).to_le_bytes());
+            self.emulator.write_screen(&mut screen);
+            let mut with_keyframe = Vec::with_capacity(FRAME_HEADER_LEN + screen.len() + raw.len());
+            push_frame(&mut with_keyframe, FRAME_KEYFRAME, first_us, &screen);
+            with_keyframe.extend_from_slice(&raw);
+            raw = with_keyframe;
+            flags |= FLAG_KEYFRAME;
+            self.since_keyframe = 0;
+        }
+
+        let mut bloom = [0u8; BLOOM_BYTES];
+        let mut last_us = first_us;
+        self.text.begin_block();
+        for (kind, time_us, payload) in frames(&raw) {
+            last_us = time_us;
+            match kind {
+                FRAME_OUTPUT => {
+                    self.emulator.process(payload);
+                    self.text.feed(payload);
+                    self.since_keyframe += payload.len();
+                }
+                FRAME_RESIZE => {
+                    let (cols, rows) = parse_size(payload);
+                    self.emulator.resize(cols as usize, rows as usize);
+                }
+                _ => {}
+            }
+        }
+        bloom_add_all(&mut bloom, self.text.block_text());
+
+        let data = lz4_flex::block::compress_prepend_size(&raw);
+        let mut out = Vec::with_capacity(BLOCK_HEADER_LEN + data.len());
+        out.extend_from_slice(BLOCK_MAGIC);
+        out.extend_from_slice(&flags.to_le_bytes());
+        out.extend_from_slice(&first_us.to_le_bytes());
+        out.extend_from_slice(&last_us.to_le_bytes());
+        out.extend_from_slice(&(raw.len() as u32).to_le_bytes());
+        out.extend_from_slice(&(data.len() as u32).to_le_bytes());
+        out.extend_from_slice(&bloom);
+        out.extend_from_slice(&data);
+        self.file.write_all(&out)?;
+
+        self.index.push(BlockEntry { offset: self.offset, first_us, last_us, flags });
+        self.offset += out.len() as u64;
+        Ok(())
+    }
+
+    fn write_index(&mut self) -> Result<(), anyhow::Error> {
+        let mut out = Vec::with_capacity(self.index.len() * INDEX_ENTRY_LEN + 16);
+        for entry in &self.index {
+            out.extend_from_slice(&entry.offset.to_le_bytes());
+            out.extend_from_slice(&entry.first_us.to_le_bytes());
+            out.extend_from_slice(&entry.last_us.to_le_bytes());
+            out.extend_from_slice(&entry.flags.to_le_bytes());
+            out.extend_from_slice(&0u32.to_le_bytes());
+        }
+        out.extend_from_slice(&self.offset.to_le_bytes());
+        out.extend_from_slice(INDEX_MAGIC);
+        self.file.write_all(&out)?;
+        self.file.sync_all()?;
+        Ok(())
+    }
+}
+
+fn parse_size(payload: &[u8]) -> (u16, u16) {
+    if payload.len() < 4 {
+        return (1, 1);
+    }
+    (u16::from_le_bytes([payload[0], payload[1]]), u16::from_le_bytes([payload[2], payload[3]]))
+}
+
+// ═══════════════════════════════════════════════════════════
+// Text and bloom filters
+// ═══════════════════════════════════════════════════════════
+
+/// Printable text of terminal output: escape sequences and control
+/// characters other than newline are dropped, ASCII is lowercased.
+#[derive(Default)]
+struct TextExtractor {
+    state: EscapeState,
+    /// Tail of the previous block, then this block's text.
+    text: Vec<u8>,
+    /// Where this block's own text starts in `text`.
+    block_start: usize,
+}
+
+#[derive(Clone, Copy, Default, PartialEq)]
+enum EscapeState {
+    #[default]
+    Ground,
+    Escape,
+    Csi,
+    /// OSC, DCS and friends: until BEL or ST.
+    String,
+    StringEscape,
+}
+
+impl TextExtractor {
+    /// Keep the last `TAIL_LEN` bytes of text and start a new block.
+    fn begin_block(&mut self) {
+        let keep = self.text.len().saturating_sub(TAIL_LEN);
+        self.text.drain(..keep);
+        self.block_start = self.text.len();
+    }
+
+    /// Tail of the previous block followed by everything fed since.
+    fn block_text(&self) -> &[u8] {
+        &self.text
+    }
+
+    fn feed(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            self.state = match (self.state, b) {
+                (_, 0x1b) if self.state != EscapeState::String => EscapeState::Escape,
+                (EscapeState::Ground, b'\n') => {
+                    self.text.push(b'\n');
+                    EscapeState::Ground
+                }
+                (EscapeState::Ground, b) if b < 0x20 || b == 0x7f => EscapeState::Ground,
+                (EscapeState::Ground, b) => {
+                    self.text.push(b.to_ascii_lowercase());
+                    EscapeState::Ground
+                }
+                (EscapeState::Escape, b'[') => EscapeState::Csi,
+                (EscapeState::Escape, b']' | b'P' | b'_' | b'^' | b'X') => EscapeState::String,
+                (EscapeState::Escape, b) if (0x20..0x30).contains(&b) => EscapeState::Escape,
+                (EscapeState::Escape, _) => EscapeState::Ground,
+                (EscapeState::Csi, 0x40..=0x7e) => EscapeState::Ground,
+                (EscapeState::Csi, _) => EscapeState::Csi,
+                (EscapeState::String, 0x07) => EscapeState::Ground,
+                (EscapeState::String, 0x1b) => EscapeState::StringEscape,
+                (EscapeState::String, _) => EscapeState::String,
+                (EscapeState::StringEscape, b'\\') => EscapeState::Ground,
+                (EscapeState::StringEscape, _) => EscapeState::String,
+            };
+        }
+    }
+}
+
+fn trigram_bits(trigram: &[u8]) -> [usize; 2] {
+    // FNV-1a; two probes from the halves of one 32-bit hash.
+    let mut hash: u32 = 0x811c_9dc5;
+    for &b in trigram {
+        hash = (hash ^ b as u32).wrapping_mul(0x0100_0193);
+    }
+    let bits = BLOOM_BYTES * 8;
+    [(hash & 0xffff) as usize % bits, (hash >> 16) as usize % bits]
+}
+
+fn bloom_add_all(bloom: &mut [u8; BLOOM_BYTES], text: &[u8]) {
+    for trigram in text.windows(3) {
+        for bit in trigram_bits(trigram) {
+            bloom[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+}
+
+fn bloom_admits(bloom: &[u8], query: &[u8]) -> bool {
+    query.windows(3).all(|trigram| {
+        trigram_bits(trigram).iter().all(|&bit| bloom[bit / 8] & (1 << (bit % 8)) != 0)
+    })
+}
+
+// ═══════════════════════════════════════════════════════════
+// Replay and search
+// ═══════════════════════════════════════════════════════════
+
+/// Read-only mapping of a whole file.
+struct Mmap {
+    ptr: *mut libc::c_void,
+    len: usize,
+}
+
+unsafe impl Send for Mmap {}
+unsafe impl Sync for Mmap {}
+
+impl Mmap {
+    fn open(file: &File) -> Result<Self, anyhow::Error> {
+        use std::os::fd::AsRawFd;
+        let len = file.metadata()?.len() as usize;
+        if len == 0 {
+            return Err(anyhow::anyhow!("Empty recording"));
+        }
+        let ptr = unsafe {
+            libc::mmap(std::ptr::null_mut(), len, libc::PROT_READ, libc::MAP_PRIVATE, file.as_raw_fd(), 0)
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(std::io::Error::last_os_error().into());
+        }
+        Ok(Self { ptr, len })
+    }
+
+    fn bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr as *const u8, self.len) }
+    }
+}
+
+impl Drop for Mmap {
+    fn drop(&mut self) {
+        unsafe {
+            libc::munmap(self.ptr, self.len);
+        }
+    }
+}
+
+/// One recorded change, as replayed.
+pub enum Frame<'a> {
+    Output(&'a [u8]),
+    Resize { cols: u16, rows: u16 },
+}
+
+/// A text match in a recording.
+#[derive(Clone, Debug, serde::Serialize)]
+pub struct RecordingHit {
+    /// Microseconds into the recording at which the match was printed.
+    pub time_us: u64,
+    /// The line around the match, lowercased.
+    pub line: String,
+}
+
+/// An open recording. Blocks are decompressed straight from the mapped
+/// file as they're needed.
+pub struct Recording {
+    map: Mmap,
+    pub start_unix_ms: u64,
+    pub cols: u16,
+    pub rows: u16,
+    blocks: Vec<BlockEntry>,
+}
+
+impl Recording {
+    /// Open a finished or in-progress recording.
+    pub fn open(path: &Path) -> Result<Self, anyhow::Error> {
+        let map = Mmap::open(&File::open(path)?)?;
+        let bytes = map.bytes();
+        if bytes.len() < FILE_HEADER_LEN || &bytes[..8] != FILE_MAGIC {
+            return Err(anyhow::anyhow!("Not a Pier recording"));
+        }
+        let start_unix_ms = u64::from_le_bytes(bytes[8..16].try_into()?);
+        let cols = u16::from_le_bytes([bytes[16], bytes[17]]);
+        let rows = u16::from_le_bytes([bytes[18], bytes[19]]);
+        let blocks = read_index(bytes).unwrap_or_else(|| scan_blocks(bytes));
+        Ok(Self { map, start_unix_ms, cols, rows, blocks })
+    }
+
+    /// Time of the last recorded frame.
+    pub fn duration_us(&self) -> u64 {
+        self.blocks.last().map_or(0, |b| b.last_us)
+    }
+
+    pub fn block_count(&self) -> usize {
+        self.blocks.len()
+    }
+
+    fn header(&self, block: usize) -> Result<&[u8], anyhow::Error> {
+        let offset = self.blocks[block].offset as usize;
+        self.map.bytes()
+            .get(offset..offset + BLOCK_HEADER_LEN)
+            .ok_or_else(|| anyhow::anyhow!("Block {} is past the end of the recording", block))
+    }
+
+    fn decompress(&self, block: usize) -> Result<Vec<u8>, anyhow::Error> {
+        let header = self.header(block)?;
+        let raw_len = u32::from_le_bytes(header[24..28].try_into()?) as usize;
+        let data_len = u32::from_le_bytes(header[28..32].try_into()?) as usize;
+        let start = self.blocks[block].offset as usize + BLOCK_HEADER_LEN;
+        let data = self.map.bytes()
+            .get(start..start + data_len)
+            .ok_or_else(|| anyhow::anyhow!("Block {} is truncated", block))?;
+        // The size prefix comes from the file; don't let it pick the
+        // allocation. LZ4 can't expand data more than 255x.
+        let prefix = data.get(..4).map(|p| u32::from_le_bytes(p.try_into().unwrap()) as usize);
+        if prefix != Some(raw_len) || raw_len > data_len.saturating_mul(255) {
+            return Err(anyhow::anyhow!("Corrupt block {}: bad size", block));
+        }
+        lz4_flex::block::decompress_size_prepended(data)
+            .map_err(|e| anyhow::anyhow!("Corrupt block {}: {}", block, e))
+    }
+
+    /// The screen as it was `time_us` into the recording.
+    pub fn screen_at(&self, time_us: u64) -> Result<VtEmulator, anyhow::Error> {
+        let first = self.blocks
+            .iter()
+            .rposition(|b| b.flags & FLAG_KEYFRAME != 0 && b.first_us <= time_us)
+            .unwrap_or(0);
+        let mut emulator = VtEmulator::new(self.cols as usize, self.rows as usize);
+        emulator.scrollback_mut().set_config(ScrollbackConfig { max_lines: 0, ..ScrollbackConfig::default() });
+        for block in first..self.blocks.len() {
+            if self.blocks[block].first_us > time_us {
+                break;
+            }
+            let raw = self.decompress(block)?;
+            for (kind, frame_us, payload) in frames(&raw) {
+                if frame_us > time_us {
+                    break;
+                }
+                match kind {
+                    FRAME_KEYFRAME if block == first => {
+                        let (cols, rows) = parse_size(payload);
+                        emulator.resize(cols as usize, rows as usize);
+                        emulator.process(payload.get(4..).unwrap_or_default());
+                    }
+                    FRAME_OUTPUT => emulator.process(payload),
+                    FRAME_RESIZE => {
+                        let (cols, rows) = parse_size(payload);
+                        emulator.resize(cols as usize, rows as usize);
+                    }
+                    _ => {}
+                }
+            }
+        }
+        Ok(emulator)
+    }
+
+    /// Visit the frames recorded from `from_us` up to (not including)
+    /// `to_us`, for playback after `screen_at(from_us)`.
+    pub fn frames_between<F: FnMut(u64, Frame<'_>)>(&self, from_us: u64, to_us: u64, mut f: F) -> Result<(), anyhow::Error> {
+        for block in 0..self.blocks.len() {
+            let entry = self.blocks[block];
+            if entry.last_us < from_us {
+                continue;
+            }
+            if entry.first_us >= to_us {
+                break;
+            }
+            let raw = self.decompress(block)?;
+            for (kind, time_us, payload) in frames(&raw) {
+                if time_us >= to_us {
+                    break;
+                }
+                if time_us < from_us {
+                    continue;
+                }
+                match kind {
+                    FRAME_OUTPUT => f(time_us, Frame::Output(payload)),
+                    FRAME_RESIZE => {
+                        let (cols, rows) = parse_size(payload);
+                        f(time_us, Frame::Resize { cols, rows });
+                    }
+                    _ => {}
+                }
+            }
+        }
+        Ok(())
+    }
+
+    /// Case-insensitive text search. Only blocks whose bloom filter admits
+    /// the query (and the block before each, for its tail) are decompressed.
+    pub fn search(&self, query: &str, max_hits: usize) -> Result<Vec<RecordingHit>, anyhow::Error> {
+        let query = query.to_ascii_lowercase().into_bytes();
+        let mut hits = Vec::new();
+        if query.is_empty() {
+            return Ok(hits);
+        }
+        for block in 0..self.blocks.len() {
+            if hits.len() >= max_hits {
+                break;
+            }
+            if !bloom_admits(&self.header(block)?[32..], &query) {
+                continue;
+            }
+            let mut extractor = TextExtractor::default();
+            if block > 0 {
+                for (kind, _, payload) in frames(&self.decompress(block - 1)?) {
+                    if kind == FRAME_OUTPUT {
+                        extractor.feed(payload);
+                    }
+                }
+            }
+            extractor.begin_block();
+            let raw = self.decompress(block)?;
+            // (text offset, time) at the start of each output frame.
+            let mut times = Vec::new();
+            for (kind, time_us, payload) in frames(&raw) {
+                if kind == FRAME_OUTPUT {
+                    times.push((extractor.text.len(), time_us));
+                    extractor.feed(payload);
+                }
+            }
+            let text = &extractor.text;
+            let mut from = 0;
+            while let Some(pos) = find(&text[from..], &query).map(|p| p + from) {
+                let end = pos + query.len();
+                from = pos + 1;
+                // Matches wholly inside the tail belong to the previous block.
+                if end <= extractor.block_start {
+                    continue;
+                }
+                let frame = times.partition_point(|&(offset, _)| offset < end).saturating_sub(1);
+                let time_us = times.get(frame).map_or(self.blocks[block].first_us, |&(_, t)| t);
+                hits.push(RecordingHit { time_us, line: line_around(text, pos, end) });
+                if hits.len() >= max_hits {
+                    break;
+                }
+            }
+        }
+        Ok(hits)
+    }
+}
+
+fn find(haystack: &[u8], needle: &[u8]) -> Option<usize> {
+    haystack.windows(needle.len()).position(|w| w == needle)
+}
+
+fn line_around(text: &[u8], start: usize, end: usize) -> String {
+    const CONTEXT: usize = 100;
+    let line_start = text[..start].iter().rposition(|&b| b == b'\n').map_or(0, |i| i + 1);
+    let line_end = text[end..].iter().position(|&b| b == b'\n').map_or(text.len(), |i| end + i);
+    let from = line_start.max(start.saturating_sub(CONTEXT));
+    let to = line_end.min(end + CONTEXT);
+    String::from_utf8_lossy(&text[from..to]).trim().to_string()
+}
+
+/// The index from the trailer, if there is one and every entry points at
+/// a whole block.
+fn read_index(bytes: &[u8]) -> Option<Vec<BlockEntry>> {
+    let trailer = bytes.len().checked_sub(16)?;
+    if &bytes[trailer + 8..] != INDEX_MAGIC {
+        return None;
+    }
+    let index_start = u64::from_le_bytes(bytes[trailer..trailer + 8].try_into().ok()?) as usize;
+    let index = bytes.get(index_start..trailer)?;
+    if index.len() % INDEX_ENTRY_LEN != 0 {
+        return None;
+    }
+    let u64_at = |entry: &[u8], at: usize| u64::from_le_bytes(entry[at..at + 8].try_into().unwrap());
+    index
+        .chunks_exact(INDEX_ENTRY_LEN)
+        .map(|entry| {
+            let offset = u64_at(entry, 0);
+            block_len(bytes, usize::try_from(offset).ok()?)?;
+            Some(BlockEntry {
+                offset,
+                first_us: u64_at(entry, 8),
+                last_us: u64_at(entry, 16),
+                flags: u32::from_le_bytes(entry[24..28].try_into().unwrap()),
+            })
+        })
+        .collect()
+}
+
+/// Length of the block at `offset`, header included, if a whole block is
+/// there.
+fn block_len(bytes: &[u8], offset: usize) -> Option<usize> {
+    let header = bytes.get(offset..offset.checked_add(BLOCK_HEADER_LEN)?)?;
+    if &header[..4] != BLOCK_MAGIC {
+        return None;
+    }
+    let data_len = u32::from_le_bytes(header[28..32].try_into().unwrap()) as usize;
+    let len = BLOCK_HEADER_LEN + data_len;
+    (offset + len <= bytes.len()).then_some(len)
+}
+
+/// Rebuild the index from block headers, stopping at the first block that
+/// is incomplete (a crash, or still being written).
+fn scan_blocks(bytes: &[u8]) -> Vec<BlockEntry> {
+    let mut blocks = Vec::new();
+    let mut offset = FILE_HEADER_LEN;
+    while let Some(len) = block_len(bytes, offset) {
+        let header = &bytes[offset..offset + BLOCK_HEADER_LEN];
+        blocks.push(BlockEntry {
+            offset: offset as u64,
+            first_us: u64::from_le_bytes(header[8..16].try_into().unwrap()),
+            last_us: u64::from_le_bytes(header[16..24].try_into().unwrap()),
+            flags: u32::from_le_bytes(header[4..8].try_into().unwrap()),
+        });
+        offset += len;
+    }
+    blocks
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_record_replay_and_search() {
+        let dir = std::env::temp_dir().join(format!("pier-recording-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("session.pierrec");
+
+        let tap = Tap::default();
+        tap.output(b"not recorded");
+        tap.start(&path, 80, 24).unwrap();
+        // Enough output for several blocks and keyframes.
+        for i in 0..60_000 {
+            tap.output(format!("\x1b[32mline {}\x1b[0m of build output\r\n", i).as_bytes());
+        }
+        tap.output(b"\x1b[1mNeedle\x1b[0m in the \x1b]0;title\x07haystack\r\n");
+        tap.resize(100, 30);
+        tap.output(b"after resize");
+        assert!(tap.stop().unwrap());
+        assert!(!tap.stop().unwrap());
+
+        let recording = Recording::open(&path).unwrap();
+        assert_eq!((recording.cols, recording.rows), (80, 24));
+        assert!(recording.block_count() > 16);
+        let keyframes = recording.blocks.iter().filter(|b| b.flags & FLAG_KEYFRAME != 0).count();
+        assert!(keyframes > 1);
+
+        // Same screen whether replayed from a keyframe or from the start.
+        let end = recording.duration_us();
+        let screen = recording.screen_at(end).unwrap();
+        assert_eq!((screen.cols, screen.rows), (100, 30));
+        assert!((0..screen.rows).any(|row| screen.get_line_text(row).trim() == "Needle in the haystack"));
+        let mut replayed = 0;
+        recording.frames_between(0, end + 1, |_, frame| {
+            if let Frame::Output(bytes) = frame {
+                replayed += bytes.len();
+            }
+        }).unwrap();
+        assert!(replayed > 1_000_000);
+
+        let hits = recording.search("NEEDLE in the haystack", 10).unwrap();
+        assert_eq!(hits.len(), 1);
+        assert_eq!(hits[0].line, "needle in the haystack");
+        assert_eq!(recording.search("line 12345 of", 10).unwrap().len(), 1);
+        assert!(recording.search("not recorded", 10).unwrap().is_empty());
+
+        // Without the trailer (as after a crash) the blocks are rescanned.
+        let bytes = std::fs::read(&path).unwrap();
+        let index_start = u64::from_le_bytes(bytes[bytes.len() - 16..bytes.len() - 8].try_into().unwrap()) as usize;
+        std::fs::write(&path, &bytes[..index_start]).unwrap();
+        let rescanned = Recording::open(&path).unwrap();
+        assert_eq!(rescanned.block_count(), recording.block_count());
+        assert_eq!(rescanned.duration_us(), end);
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_corrupt_recording() {
+        let dir = std::env::temp_dir().join(format!("pier-recording-corrupt-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("session.pierrec");
+        let tap = Tap::default();
+        tap.start(&path, 80, 24).unwrap();
+        for i in 0..10_000 {
+            tap.output(format!("line {}\r\n", i).as_bytes());
+        }
+        assert!(tap.stop().unwrap());
+        let bytes = std::fs::read(&path).unwrap();
+        let blocks = Recording::open(&path).unwrap().block_count();
+        let index_start = u64::from_le_bytes(bytes[bytes.len() - 16..bytes.len() - 8].try_into().unwrap()) as usize;
+
+        // An index entry pointing past the end falls back to scanning.
+        let mut garbled = bytes.clone();
+        garbled[index_start..index_start + 8].copy_from_slice(&u64::MAX.to_le_bytes());
+        std::fs::write(&path, &garbled).unwrap();
+        assert_eq!(Recording::open(&path).unwrap().block_count(), blocks);
+
+        // Truncated mid-block with the trailer kept: the index is rejected
+        // and the scan stops at the last whole block.
+        let second_entry = index_start + INDEX_ENTRY_LEN;
+        let second_block = u64::from_le_bytes(bytes[second_entry..second_entry + 8].try_into().unwrap()) as usize;
+        let mut truncated = bytes[..second_block + 100].to_vec();
+        truncated.extend_from_slice(&bytes[index_start..]);
+        std::fs::write(&path, &truncated).unwrap();
+        let recording = Recording::open(&path).unwrap();
+        assert_eq!(recording.block_count(), 1);
+        assert!(recording.screen_at(u64::MAX).is_ok());
+
+        // A bad size prefix is an error, not an allocation.
+        let mut bad_size = bytes.clone();
+        let prefix = FILE_HEADER_LEN + BLOCK_HEADER_LEN;
+        bad_size[prefix..prefix + 4].copy_from_slice(&u32::MAX.to_le_bytes());
+        std::fs::write(&path, &bad_size).unwrap();
+        let recording = Recording::open(&path).unwrap();
+        assert!(recording.screen_at(u64::MAX).is_err());
+        assert!(recording.search("line 5", 10).is_err());
+        assert!(recording.frames_between(0, u64::MAX, |_, _| {}).is_err());
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+}
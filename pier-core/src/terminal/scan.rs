@@ -0,0 +1,120 @@
+//! Vectorized byte scanning for the VT fast path.
+//!
+//! `printable_ascii_run` returns the length of the leading run of printable
+//! ASCII (0x20..=0x7E) — bytes that need no escape/control/UTF-8 handling and
+//! can be blitted straight into the grid. Uses SSE2 on x86_64, NEON on
+//! aarch64, and an 8-bytes-at-a-time SWAR loop elsewhere and for tails.
+
+/// Length of the leading run of printable ASCII bytes in `bytes`.
+#[inline]
+pub fn printable_ascii_run(bytes: &[u8]) -> usize {
+    let mut i = simd_run(bytes);
+    if i < bytes.len() {
+        i += swar_run(&bytes[i..]);
+    }
+    i
+}
+
+/// Printable ASCII: needs no escape, control or UTF-8 handling.
+#[inline]
+pub fn is_printable(b: u8) -> bool {
+    (0x20..=0x7E).contains(&b)
+}
+
+/// Scalar tail: 8 bytes per step, then byte by byte.
+#[inline]
+fn swar_run(bytes: &[u8]) -> usize {
+    const LO: u64 = 0x0101_0101_0101_0101;
+    const HI: u64 = 0x8080_8080_8080_8080;
+
+    let mut i = 0;
+    while i + 8 <= bytes.len() {
+        let x = u64::from_le_bytes(bytes[i..i + 8].try_into().unwrap());
+        // Any byte >= 0x80, < 0x20 (valid once all bytes are < 0x80), or == 0x7F.
+        let non_ascii = x & HI;
+        let below_space = x.wrapping_sub(LO * 0x20) & !x & HI;
+        let del = x.wrapping_add(LO) & HI;
+        if non_ascii | below_space | del != 0 {
+            break;
+        }
+        i += 8;
+    }
+    while i < bytes.len() && is_printable(bytes[i]) {
+        i += 1;
+    }
+    i
+}
+
+#[cfg(target_arch = "x86_64")]
+#[inline]
+fn simd_run(bytes: &[u8]) -> usize {
+    use std::arch::x86_64::*;
+
+    let mut i = 0;
+    // SSE2 is part of the x86_64 baseline, so no runtime detection needed.
+    unsafe {
+        let space_minus_one = _mm_set1_epi8(0x1F);
+        let del = _mm_set1_epi8(0x7F);
+        while i + 16 <= bytes.len() {
+            let v = _mm_loadu_si128(bytes.as_ptr().add(i) as *const __m128i);
+            // Signed compare: bytes >= 0x80 are negative, so `v > 0x1F`
+            // selects exactly 0x20..=0x7F; then drop DEL.
+            let printable = _mm_andnot_si128(_mm_cmpeq_epi8(v, del), _mm_cmpgt_epi8(v, space_minus_one));
+            let mask = _mm_movemask_epi8(printable) as u32;
+            if mask != 0xFFFF {
+                return i + mask.trailing_ones() as usize;
+            }
+            i += 16;
+        }
+    }
+    i
+}
+
+#[cfg(target_arch = "aarch64")]
+#[inline]
+fn simd_run(bytes: &[u8]) -> usize {
+    use std::arch::aarch64::*;
+
+    let mut i = 0;
+    // NEON is mandatory on aarch64 (Apple Silicon included).
+    unsafe {
+        let space = vdupq_n_u8(0x20);
+        let del = vdupq_n_u8(0x7F);
+        while i + 16 <= bytes.len() {
+            let v = vld1q_u8(bytes.as_ptr().add(i));
+            let printable = vandq_u8(vcgeq_u8(v, space), vcltq_u8(v, del));
+            if vminvq_u8(printable) != 0xFF {
+                // Locate the first offending byte within this block.
+                return i + swar_run(&bytes[i..i + 16]);
+            }
+            i += 16;
+        }
+    }
+    i
+}
+
+#[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+#[inline]
+fn simd_run(_bytes: &[u8]) -> usize {
+    0
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_printable_run_matches_scalar() {
+        let mut data: Vec<u8> = (0..200).map(|i| b'a' + (i % 26) as u8).collect();
+        for stop in [0usize, 1, 7, 8, 15, 16, 17, 31, 64, 199] {
+            for bad in [0x1Bu8, b'\n', 0x7F, 0xC3, 0x00, 0x1F] {
+                let saved = data[stop];
+                data[stop] = bad;
+                assert_eq!(printable_ascii_run(&data), stop, "stop={} bad={:#x}", stop, bad);
+                data[stop] = saved;
+            }
+        }
+        assert_eq!(printable_ascii_run(&data), data.len());
+        assert_eq!(printable_ascii_run(b" ~"), 2);
+    }
+}
@@ -0,0 +1,307 @@
+//! Memory-bounded scrollback store.
+//!
+//! Lines that scroll off the top of the screen land in an uncompressed hot
+//! tail. Once the tail holds `block_lines` lines it is sealed into a fixed-size
+//! block and LZ4-compressed. Old blocks are evicted whole when the line or
+//! byte cap is exceeded. Reading a line range only decompresses the blocks that
+//! overlap it, and the most recently decompressed block is cached, so scrolling
+//! back through history stays cheap.
+
+use std::collections::VecDeque;
+use crate::terminal::emulator::Cell;
+
+/// Size and retention limits for a scrollback store.
+#[derive(Clone, Copy, Debug)]
+pub struct ScrollbackConfig {
+    /// Maximum number of retained lines (0 disables scrollback).
+    pub max_lines: usize,
+    /// Maximum memory used by stored lines, compressed blocks included.
+    pub max_bytes: usize,
+    /// Lines per compressed block.
+    pub block_lines: usize,
+}
+
+impl Default for ScrollbackConfig {
+    fn default() -> Self {
+        Self {
+            max_lines: 50_000,
+            max_bytes: 8 * 1024 * 1024,
+            block_lines: 256,
+        }
+    }
+}
+
+/// Serialized size of one cell inside a compressed block.
+const CELL_BYTES: usize = 12;
+
+/// A sealed, compressed run of `line_ends.len()` lines.
+struct Block {
+    /// LZ4 block (size-prepended) of the serialized cells.
+    data: Box<[u8]>,
+    /// End offset (in cells) of each line within the decompressed block.
+    line_ends: Box<[u32]>,
+}
+
+impl Block {
+    fn lines(&self) -> usize {
+        self.line_ends.len()
+    }
+
+    fn memory_bytes(&self) -> usize {
+        self.data.len() + self.line_ends.len() * std::mem::size_of::<u32>()
+    }
+}
+
+/// Scrollback history for one terminal.
+pub struct Scrollback {
+    config: ScrollbackConfig,
+    blocks: VecDeque<Block>,
+    /// Sequence number of `blocks[0]`; increases as blocks are evicted.
+    first_block_seq: u64,
+    /// Lines held in sealed blocks.
+    block_line_count: usize,
+    /// Bytes held in sealed blocks.
+    block_bytes: usize,
+    /// Hot tail: cells of the newest lines, trailing blanks trimmed.
+    hot_cells: Vec<Cell>,
+    /// End offset (in cells) of each hot line within `hot_cells`.
+    hot_ends: Vec<u32>,
+    /// Last decompressed block: (sequence number, cells).
+    cache: Option<(u64, Vec<Cell>)>,
+}
+
+impl Scrollback {
+    pub fn new(config: ScrollbackConfig) -> Self {
+        Self {
+            config,
+            blocks: VecDeque::new(),
+            first_block_seq: 0,
+            block_line_count: 0,
+            block_bytes: 0,
+            hot_cells: Vec::new(),
+            hot_ends: Vec::new(),
+            cache: None,
+        }
+    }
+
+    pub fn config(&self) -> ScrollbackConfig {
+        self.config
+    }
+
+    /// Change the limits, evicting old lines right away if needed.
+    pub fn set_config(&mut self, config: ScrollbackConfig) {
+        self.config = ScrollbackConfig {
+            block_lines: config.block_lines.max(1),
+            ..config
+        };
+        self.enforce_limits();
+    }
+
+    /// Number of retained lines.
+    pub fn len(&self) -> usize {
+        self.block_line_count + self.hot_ends.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Approximate memory held by stored lines.
+    pub fn memory_bytes(&self) -> usize {
+        self.block_bytes
+            + self.hot_cells.len() * std::mem::size_of::<Cell>()
+            + self.hot_ends.len() * std::mem::size_of::<u32>()
+    }
+
+    /// Drop all history.
+    pub fn clear(&mut self) {
+        self.first_block_seq += self.blocks.len() as u64;
+        self.blocks.clear();
+        self.block_line_count = 0;
+        self.block_bytes = 0;
+        self.hot_cells.clear();
+        self.hot_ends.clear();
+        self.cache = None;
+    }
+
+    /// Append a line leaving the top of the screen.
+    pub fn push_line(&mut self, row: &[Cell]) {
+        if self.config.max_lines == 0 {
+            return;
+        }
+        let len = row.iter().rposition(|c| *c != Cell::BLANK).map_or(0, |i| i + 1);
+        self.hot_cells.extend_from_slice(&row[..len]);
+        self.hot_ends.push(self.hot_cells.len() as u32);
+
+        if self.hot_ends.len() >= self.config.block_lines {
+            self.seal_hot();
+        }
+        self.enforce_limits();
+    }
+
+    /// Visit lines `[start, start + count)`, where 0 is the oldest retained
+    /// line. Only blocks overlapping the range are decompressed.
+    /// Returns the number of lines visited.
+    pub fn read_lines<F: FnMut(usize, &[Cell])>(&mut self, start: usize, count: usize, mut f: F) -> usize {
+        let end = start.saturating_add(count).min(self.len());
+        if start >= end {
+            return 0;
+        }
+
+        let mut line = start;
+        let mut block_first = 0;
+        let mut block_index = 0;
+        while line < end && block_index < self.blocks.len() {
+            let block_len = self.blocks[block_index].lines();
+            if line < block_first + block_len {
+                let seq = self.first_block_seq + block_index as u64;
+                self.ensure_cached(seq, block_index);
+                let cells = &self.cache.as_ref().expect("block cached").1;
+                let block = &self.blocks[block_index];
+                while line < end && line < block_first + block_len {
+                    let local = line - block_first;
+                    let from = if local == 0 { 0 } else { block.line_ends[local - 1] as usize };
+                    let to = block.line_ends[local] as usize;
+                    f(line, &cells[from..to]);
+                    line += 1;
+                }
+            }
+            block_first += block_len;
+            block_index += 1;
+        }
+
+        while line < end {
+            let local = line - self.block_line_count;
+            let from = if local == 0 { 0 } else { self.hot_ends[local - 1] as usize };
+            let to = self.hot_ends[local] as usize;
+            f(line, &self.hot_cells[from..to]);
+            line += 1;
+        }
+
+        end - start
+    }
+
+    /// Text of a single retained line (trailing blanks trimmed).
+    pub fn line_text(&mut self, index: usize) -> Option<String> {
+        let mut text = None;
+        self.read_lines(index, 1, |_, cells| {
+            text = Some(cells.iter().map(|c| c.ch()).collect());
+        });
+        text
+    }
+
+    /// Compress the hot tail into a new sealed block.
+    fn seal_hot(&mut self) {
+        if self.hot_ends.is_empty() {
+            return;
+        }
+        let mut raw = Vec::with_capacity(self.hot_cells.len() * CELL_BYTES);
+        for cell in &self.hot_cells {
+            for word in cell.to_raw() {
+                raw.extend_from_slice(&word.to_le_bytes());
+            }
+        }
+        let block = Block {
+            data: lz4_flex::block::compress_prepend_size(&raw).into_boxed_slice(),
+            line_ends: std::mem::take(&mut self.hot_ends).into_boxed_slice(),
+        };
+        self.hot_cells.clear();
+        self.block_line_count += block.lines();
+        self.block_bytes += block.memory_bytes();
+        self.blocks.push_back(block);
+    }
+
+    /// Evict the oldest blocks (or hot lines) until within both caps.
+    fn enforce_limits(&mut self) {
+        while (self.len() > self.config.max_lines || self.memory_bytes() > self.config.max_bytes)
+            && !self.blocks.is_empty()
+        {
+            let block = self.blocks.pop_front().expect("non-empty");
+            self.block_line_count -= block.lines();
+            self.block_bytes -= block.memory_bytes();
+            if let Some((seq, _)) = self.cache {
+                if seq == self.first_block_seq {
+                    self.cache = None;
+                }
+            }
+            self.first_block_seq += 1;
+        }
+
+        // Caps smaller than one block: trim the hot tail from the front.
+        let excess = self.hot_ends.len().saturating_sub(self.config.max_lines);
+        if excess > 0 {
+            let cut = self.hot_ends[excess - 1];
+            self.hot_cells.drain(..cut as usize);
+            self.hot_ends.drain(..excess);
+            for end in &mut self.hot_ends {
+                *end -= cut;
+            }
+        }
+    }
+
+    /// Make sure block `index` (sequence `seq`) is the decompressed cache entry.
+    fn ensure_cached(&mut self, seq: u64, index: usize) {
+        if matches!(self.cache, Some((cached, _)) if cached == seq) {
+            return;
+        }
+        let raw = lz4_flex::block::decompress_size_prepended(&self.blocks[index].data)
+            .unwrap_or_default();
+        let cells = raw
+            .chunks_exact(CELL_BYTES)
+            .map(|c| {
+                let word = |i: usize| u32::from_le_bytes([c[i], c[i + 1], c[i + 2], c[i + 3]]);
+                Cell::from_raw([word(0), word(4), word(8)])
+            })
+            .collect();
+        self.cache = Some((seq, cells));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn line(text: &str) -> Vec<Cell> {
+        let mut row: Vec<Cell> = text.chars().map(|ch| Cell::BLANK.with_ch(ch)).collect();
+        row.resize(20, Cell::BLANK);
+        row
+    }
+
+    #[test]
+    fn test_read_across_blocks() {
+        let mut sb = Scrollback::new(ScrollbackConfig { max_lines: 1000, max_bytes: usize::MAX, block_lines: 4 });
+        for i in 0..10 {
+            sb.push_line(&line(&format!("line {}", i)));
+        }
+        assert_eq!(sb.len(), 10);
+        assert_eq!(sb.line_text(0).as_deref(), Some("line 0"));
+        assert_eq!(sb.line_text(5).as_deref(), Some("line 5"));
+        assert_eq!(sb.line_text(9).as_deref(), Some("line 9"));
+
+        let mut seen = Vec::new();
+        assert_eq!(sb.read_lines(2, 5, |i, _| seen.push(i)), 5);
+        assert_eq!(seen, vec![2, 3, 4, 5, 6]);
+    }
+
+    #[test]
+    fn test_line_cap_evicts_oldest_block() {
+        let mut sb = Scrollback::new(ScrollbackConfig { max_lines: 8, max_bytes: usize::MAX, block_lines: 4 });
+        for i in 0..13 {
+            sb.push_line(&line(&format!("{}", i)));
+        }
+        assert!(sb.len() <= 8);
+        assert_eq!(sb.line_text(sb.len() - 1).as_deref(), Some("12"));
+        assert_eq!(sb.line_text(0).as_deref(), Some("8"));
+    }
+
+    #[test]
+    fn test_byte_cap() {
+        let mut sb = Scrollback::new(ScrollbackConfig { max_lines: usize::MAX, max_bytes: 4096, block_lines: 16 });
+        for i in 0..10_000 {
+            sb.push_line(&line(&format!("entry {:>6}", i)));
+        }
+        assert!(sb.memory_bytes() <= 4096);
+        let last = sb.len() - 1;
+        assert_eq!(sb.line_text(last).as_deref(), Some("entry   9999"));
+    }
+}
@@ -0,0 +1,81 @@
+#!/bin/bash
+# ============================================================
+# Pier — pier-core Benchmarks
+# ============================================================
+# Runs the criterion benches, saves them as a baseline named after the
+# current commit, and appends each median to a CSV history so results
+# can be compared across commits.
+#
+# Usage:
+#   ./scripts/bench.sh                  # all benches
+#   ./scripts/bench.sh git_graph        # one bench target
+#   COMPARE=<baseline> ./scripts/bench.sh   # also report change vs a baseline
+#
+# Baselines live in pier-core/target/criterion; HTML reports in
+# pier-core/target/criterion/report/index.html.
+# ============================================================
+
+set -euo pipefail
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+CORE_DIR="$ROOT/pier-core"
+HISTORY="${PIER_BENCH_HISTORY:-$ROOT/build/benchmarks/history.csv}"
+COMMIT=$(git -C "$ROOT" rev-parse --short HEAD)
+if ! git -C "$ROOT" diff --quiet HEAD -- pier-core; then
+    COMMIT="$COMMIT-dirty"
+fi
+
+BENCH_ARGS=()
+if [ $# -gt 0 ]; then
+    BENCH_ARGS=(--bench "$1")
+fi
+CRITERION_ARGS=(--save-baseline "$COMMIT")
+if [ -n "${COMPARE:-}" ]; then
+    CRITERION_ARGS=(--baseline "$COMPARE")
+fi
+
+echo "========================================"
+echo "  pier-core benchmarks @ $COMMIT"
+echo "========================================"
+
+cd "$CORE_DIR"
+RUN_START=$(date +%s)
+cargo bench ${BENCH_ARGS[@]+"${BENCH_ARGS[@]}"} -- "${CRITERION_ARGS[@]}"
+
+if [ -n "${COMPARE:-}" ]; then
+    echo ""
+    echo "  Compared against baseline '$COMPARE' (not recorded)"
+    exit 0
+fi
+
+# ── Record medians (ns) of everything estimated in this run ──
+mkdir -p "$(dirname "$HISTORY")"
+if [ ! -f "$HISTORY" ]; then
+    echo "date,commit,benchmark,median_ns" > "$HISTORY"
+fi
+
+# File mtime in epoch seconds. GNU `stat -f` means --file-system and
+# succeeds with the wrong output, so pick the syntax by platform.
+if [ "$(uname)" = "Darwin" ]; then
+    mtime() { stat -f %m "$1"; }
+else
+    mtime() { stat -c %Y "$1"; }
+fi
+
+DATE=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+COUNT=0
+while IFS= read -r estimates; do
+    # Only benches this run touched.
+    [ "$(mtime "$estimates")" -ge "$RUN_START" ] || continue
+    dir=$(dirname "$(dirname "$estimates")")
+    name=${dir#target/criterion/}
+    median=$(sed -E 's/.*"median":\{"confidence_interval":\{[^}]*\},"point_estimate":([0-9.eE+-]+).*/\1/' "$estimates")
+    echo "$DATE,$COMMIT,$name,$median" >> "$HISTORY"
+    COUNT=$((COUNT + 1))
+done < <(find target/criterion -path "*/$COMMIT/estimates.json" | sort)
+
+echo ""
+echo "========================================"
+echo "  Recorded $COUNT results in $HISTORY"
+echo "  Compare later with: COMPARE=$COMMIT ./scripts/bench.sh"
+echo "========================================"